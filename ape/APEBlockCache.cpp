@@ -0,0 +1,327 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "APEBlockCache"
+#include <utils/Log.h>
+
+#include "APEBlockCache.h"
+
+#include <media/stagefright/MediaErrors.h>
+#include <cutils/properties.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Most blocks loaded by one readAt() on the source.
+#define APE_BLOCK_MAX_RUN 32
+
+namespace android {
+
+// static
+sp<APEBlockCache> APEBlockCache::create(const sp<DataSource> &source) {
+    size_t capacity = 0;
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.ape.block_cache.size", value, NULL) > 0) {
+        capacity = strtoul(value, NULL, 0);
+    }
+
+    //Fewer than two blocks could not hold even one bypass-sized read.
+    if (capacity < 2 * APE_BLOCK_SIZE) {
+        return NULL;
+    }
+
+    sp<APEBlockCache> cache = new APEBlockCache(source, capacity);
+    if (cache->initCheck() != OK) {
+        return NULL;
+    }
+    return cache;
+}
+
+APEBlockCache::APEBlockCache(const sp<DataSource> &source, size_t capacity)
+        :mSource(source),
+         mData(NULL),
+         mBlocks(NULL),
+         mBlockCount(0),
+         mHead(NULL),
+         mTail(NULL) {
+    memset(&mStats, 0, sizeof(mStats));
+
+    size_t count = capacity / APE_BLOCK_SIZE;
+    mData = (uint8_t *)malloc(count * APE_BLOCK_SIZE);
+    mBlocks = (Block *)malloc(count * sizeof(Block));
+    if (!mData || !mBlocks) {
+        LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        mBlocks[i].index = -1;
+        mBlocks[i].length = 0;
+        mBlocks[i].loading = false;
+        mBlocks[i].data = mData + i * APE_BLOCK_SIZE;
+        pushBack_l(&mBlocks[i]);
+    }
+    mBlockCount = count;
+}
+
+APEBlockCache::~APEBlockCache() {
+    free(mBlocks);
+    mBlocks = NULL;
+
+    free(mData);
+    mData = NULL;
+}
+
+status_t APEBlockCache::initCheck() const {
+    if (mBlockCount == 0) {
+        return NO_MEMORY;
+    }
+    return mSource->initCheck();
+}
+
+ssize_t APEBlockCache::readAt(off64_t offset, void *data, size_t size) {
+    if (offset < 0 || size > mBlockCount / 2 * APE_BLOCK_SIZE) {
+        {
+            Mutex::Autolock autoLock(mLock);
+            mStats.bypassed++;
+            mStats.reads++;
+        }
+        return mSource->readAt(offset, data, size);
+    }
+
+    uint8_t *out = (uint8_t *)data;
+    size_t done = 0;
+    //Blocks up to here were loaded by this call, they are no hits.
+    int64_t loadedEnd = -1;
+
+    Mutex::Autolock autoLock(mLock);
+    while (done < size) {
+        off64_t pos = offset + done;
+        int64_t index = pos / APE_BLOCK_SIZE;
+        size_t within = pos % APE_BLOCK_SIZE;
+
+        Block *block = findBlock_l(index);
+        if (block == NULL) {
+            int64_t last = (offset + size - 1) / APE_BLOCK_SIZE;
+            status_t err = loadBlocks_l(index, last);
+            if (err != OK) {
+                return done > 0 ? (ssize_t)done : err;
+            }
+            loadedEnd = last;
+            continue;
+        }
+        if (block->loading) {
+            mLoadedCondition.wait(mLock);
+            continue;
+        }
+
+        unlink_l(block);
+        pushFront_l(block);
+        if (index > loadedEnd) {
+            mStats.hits++;
+        }
+
+        size_t n = 0;
+        if (within < block->length) {
+            n = block->length - within;
+            if (n > size - done) {
+                n = size - done;
+            }
+            memcpy(out + done, block->data + within, n);
+            done += n;
+        }
+
+        //A short block is used once. The source may grow, or have failed
+        //only this time, a later read has to ask it again.
+        if (block->length < APE_BLOCK_SIZE) {
+            drop_l(block);
+        }
+        if (n == 0) {
+            //End of the source.
+            break;
+        }
+    }
+
+    return done;
+}
+
+APEBlockCache::Block *APEBlockCache::findBlock_l(int64_t index) {
+    ssize_t i = mIndex.indexOfKey(index);
+    return i >= 0 ? mIndex.valueAt(i) : NULL;
+}
+
+//An unused block, or else the least recently used one nobody is loading.
+//It is taken off the list and out of the index.
+APEBlockCache::Block *APEBlockCache::findVictim_l() {
+    Block *victim = mTail;
+    if (victim == NULL) {
+        return NULL;
+    }
+    unlink_l(victim);
+    if (victim->index >= 0) {
+        mIndex.removeItem(victim->index);
+        victim->index = -1;
+    }
+    return victim;
+}
+
+void APEBlockCache::unlink_l(Block *block) {
+    if (block->prev != NULL) {
+        block->prev->next = block->next;
+    } else {
+        mHead = block->next;
+    }
+    if (block->next != NULL) {
+        block->next->prev = block->prev;
+    } else {
+        mTail = block->prev;
+    }
+    block->prev = block->next = NULL;
+}
+
+void APEBlockCache::pushFront_l(Block *block) {
+    block->prev = NULL;
+    block->next = mHead;
+    if (mHead != NULL) {
+        mHead->prev = block;
+    } else {
+        mTail = block;
+    }
+    mHead = block;
+}
+
+void APEBlockCache::pushBack_l(Block *block) {
+    block->next = NULL;
+    block->prev = mTail;
+    if (mTail != NULL) {
+        mTail->next = block;
+    } else {
+        mHead = block;
+    }
+    mTail = block;
+}
+
+//Forgets the data of a block on the list, making it the next victim.
+void APEBlockCache::drop_l(Block *block) {
+    mIndex.removeItem(block->index);
+    block->index = -1;
+    unlink_l(block);
+    pushBack_l(block);
+}
+
+//Claims the run of missing blocks from first to at most last, and reads
+//it from the source with the lock released. Returns OK without loading
+//anything when every block is busy, after waiting for one to be loaded.
+status_t APEBlockCache::loadBlocks_l(int64_t first, int64_t last) {
+    Block *victims[APE_BLOCK_MAX_RUN];
+    size_t count = 0;
+    const size_t maxCount = mBlockCount / 2 < APE_BLOCK_MAX_RUN
+            ? mBlockCount / 2 : APE_BLOCK_MAX_RUN;
+
+    while (first + (int64_t)count <= last && count < maxCount
+            && findBlock_l(first + count) == NULL) {
+        Block *victim = findVictim_l();
+        if (victim == NULL) {
+            break;
+        }
+        victim->index = first + count;
+        victim->length = 0;
+        victim->loading = true;
+        mIndex.add(victim->index, victim);
+        victims[count++] = victim;
+    }
+    if (count == 0) {
+        mLoadedCondition.wait(mLock);
+        return OK;
+    }
+
+    //The blocks are scattered over the cache, so a run is read into one
+    //buffer first. A single block is read in place.
+    uint8_t *buffer = victims[0]->data;
+    if (count > 1) {
+        buffer = (uint8_t *)malloc(count * APE_BLOCK_SIZE);
+    }
+
+    ssize_t n = ERROR_IO;
+    if (buffer != NULL) {
+        mLock.unlock();
+        n = mSource->readAt(first * APE_BLOCK_SIZE, buffer, count * APE_BLOCK_SIZE);
+        mLock.lock();
+    } else {
+        LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+        n = NO_MEMORY;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        Block *block = victims[i];
+        block->loading = false;
+        if (n < 0) {
+            mIndex.removeItem(block->index);
+            block->index = -1;
+            pushBack_l(block);
+            continue;
+        }
+        pushFront_l(block);
+
+        size_t start = i * APE_BLOCK_SIZE;
+        block->length = (size_t)n > start ? (size_t)n - start : 0;
+        if (block->length > APE_BLOCK_SIZE) {
+            block->length = APE_BLOCK_SIZE;
+        }
+        if (count > 1) {
+            memcpy(block->data, buffer + start, block->length);
+        }
+    }
+    if (count > 1) {
+        free(buffer);
+    }
+
+    mStats.misses += count;
+    mStats.reads++;
+    mLoadedCondition.broadcast();
+
+    return n < 0 ? (status_t)n : OK;
+}
+
+status_t APEBlockCache::getSize(off64_t *size) {
+    return mSource->getSize(size);
+}
+
+uint32_t APEBlockCache::flags() {
+    return mSource->flags();
+}
+
+String8 APEBlockCache::getUri() {
+    return mSource->getUri();
+}
+
+void APEBlockCache::getStats(ApeBlockCacheStats *stats) {
+    Mutex::Autolock autoLock(mLock);
+    *stats = mStats;
+}
+
+}  // namespace android
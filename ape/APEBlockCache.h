@@ -0,0 +1,123 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_BLOCK_CACHE_H_
+
+#define APE_BLOCK_CACHE_H_
+
+#include <media/stagefright/DataSource.h>
+#include <utils/Errors.h>
+#include <utils/KeyedVector.h>
+#include <utils/threads.h>
+
+namespace android {
+
+#define APE_BLOCK_SIZE (32 * 1024)
+
+typedef struct {
+    //Blocks served from the cache, and blocks read from the source.
+    uint64_t hits;
+    uint64_t misses;
+    //readAt() calls on the source, misses included and bypasses.
+    uint64_t reads;
+    //Requests too large for the cache, passed straight to the source.
+    uint64_t bypassed;
+} ApeBlockCacheStats;
+
+//LRU cache of APE_BLOCK_SIZE blocks over a DataSource, shared by every
+//APESource of one extractor. Sources reading the same part of the file,
+//whether at once or one after the other, hit storage only once: a block
+//another thread is loading is waited for rather than read again. A run
+//of missing blocks is loaded with a single readAt() without the lock held.
+//Requests larger than half the cache bypass it, they would only evict
+//what the other readers are using.
+class APEBlockCache : public DataSource {
+public:
+    //capacity is rounded down to whole blocks.
+    APEBlockCache(const sp<DataSource> &source, size_t capacity);
+
+    //Returns a cache of media.ape.block_cache.size bytes over source. NULL
+    //if that is unset or 0.
+    static sp<APEBlockCache> create(const sp<DataSource> &source);
+
+    virtual status_t initCheck() const;
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size);
+
+    virtual status_t getSize(off64_t *size);
+
+    virtual uint32_t flags();
+
+    virtual String8 getUri();
+
+    void getStats(ApeBlockCacheStats *stats);
+
+protected:
+    virtual ~APEBlockCache();
+
+private:
+    typedef struct Block {
+        //Block number in the source, -1 while unused.
+        int64_t index;
+        //Bytes read. A short block is dropped once it has been read from.
+        size_t length;
+        //Set while a thread reads the block, the others wait for it.
+        bool loading;
+        //LRU list, most recently used first. Loading blocks are not on it.
+        struct Block *prev;
+        struct Block *next;
+        uint8_t *data;
+    } Block;
+
+    sp<DataSource> mSource;
+
+    uint8_t *mData;
+    Block *mBlocks;
+    size_t mBlockCount;
+
+    Mutex mLock;
+    Condition mLoadedCondition;
+    //Blocks that hold or are loading data, by block number.
+    KeyedVector<int64_t, Block *> mIndex;
+    //Unused blocks are at the tail, so they are the first victims.
+    Block *mHead;
+    Block *mTail;
+    ApeBlockCacheStats mStats;
+
+    Block *findBlock_l(int64_t index);
+    Block *findVictim_l();
+    void unlink_l(Block *block);
+    void pushFront_l(Block *block);
+    void pushBack_l(Block *block);
+    void drop_l(Block *block);
+    status_t loadBlocks_l(int64_t first, int64_t last);
+
+    APEBlockCache(const APEBlockCache &);
+    APEBlockCache &operator=(const APEBlockCache &);
+};
+
+}  // namespace android
+
+#endif  // APE_BLOCK_CACHE_H_
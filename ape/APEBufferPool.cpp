@@ -0,0 +1,343 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "APEBufferPool"
+#include <utils/Log.h>
+
+#include "APEBufferPool.h"
+
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define APE_POOL_DEFAULT_CAP    (16 * 1024 * 1024)
+//Longest acquire() waits at the cap before it allocates past it.
+#define APE_POOL_WAIT_MS        20
+
+namespace android {
+
+static Mutex gInstanceLock;
+static APEBufferPool *gInstance = NULL;
+
+// static
+APEBufferPool *APEBufferPool::getInstance() {
+    Mutex::Autolock autoLock(gInstanceLock);
+    if (gInstance == NULL) {
+        size_t cap = APE_POOL_DEFAULT_CAP;
+
+        char value[PROPERTY_VALUE_MAX];
+        if (property_get("media.ape.buffer_pool.size", value, NULL) > 0) {
+            cap = strtoul(value, NULL, 0);
+        }
+        //Lives as long as the process, buffers may come back at any time.
+        gInstance = new APEBufferPool(cap);
+    }
+    return gInstance;
+}
+
+APEBufferPool::APEBufferPool(size_t capBytes)
+        :mTotalBytes(0),
+         mCachedBytes(0),
+         mPeakBytes(0),
+         mAcquires(0),
+         mWaits(0),
+         mOvercommits(0),
+         mFrees(0),
+         mOversize(0),
+         mWaiters(0) {
+    memset(mFreeLists, 0, sizeof(mFreeLists));
+    memset((void *)mAllocations, 0, sizeof(mAllocations));
+    memset((void *)mHits, 0, sizeof(mHits));
+    memset((void *)mCached, 0, sizeof(mCached));
+    setCap(capBytes);
+}
+
+APEBufferPool::~APEBufferPool() {
+    trim();
+}
+
+// static
+size_t APEBufferPool::getClassSize(size_t index) {
+    return (size_t)(4 + (index & 3)) << (index / 4 + APE_POOL_MIN_SHIFT - 2);
+}
+
+//Index of the smallest class holding size bytes, APE_POOL_CLASSES if none.
+// static
+size_t APEBufferPool::getClass(size_t size) {
+    if (size <= ((size_t)1 << APE_POOL_MIN_SHIFT)) {
+        return 0;
+    }
+    if (size > ((size_t)1 << APE_POOL_MAX_SHIFT)) {
+        return APE_POOL_CLASSES;
+    }
+
+    //size - 1 lies in [4, 8) << (shift - 2), the two bits below the top
+    //one pick the quarter it is in.
+    size_t n = size - 1;
+    size_t shift = APE_POOL_MIN_SHIFT;
+    while ((n >> (shift + 1)) != 0) {
+        shift++;
+    }
+    size_t quarter = (n >> (shift - 2)) & 3;
+    return (shift - APE_POOL_MIN_SHIFT) * 4 + quarter + 1;
+}
+
+void APEBufferPool::setCap(size_t bytes) {
+    if (bytes > INT32_MAX) {
+        bytes = INT32_MAX;
+    }
+    android_atomic_release_store(bytes, &mCapBytes);
+    if (bytes == 0) {
+        trim();
+    }
+}
+
+status_t APEBufferPool::acquire(size_t size, MediaBuffer **out) {
+    *out = NULL;
+    android_atomic_inc(&mAcquires);
+
+    const size_t index = getClass(size);
+    const size_t buffersize = index < APE_POOL_CLASSES ? getClassSize(index) : size;
+    if (buffersize > INT32_MAX) {
+        return NO_MEMORY;
+    }
+
+    bool waited = false;
+    for (;;) {
+        MediaBuffer *buffer = index < APE_POOL_CLASSES ? popFree(index) : NULL;
+        if (buffer != NULL) {
+            android_atomic_inc(&mHits[index]);
+            buffer->add_ref();
+            buffer->reset();
+            *out = buffer;
+            return OK;
+        }
+
+        if (reserve(buffersize) || (freeIdle(buffersize) && reserve(buffersize))) {
+            break;
+        }
+        if (waited) {
+            android_atomic_inc(&mOvercommits);
+            android_atomic_add(buffersize, &mTotalBytes);
+            break;
+        }
+
+        //Every byte is in use elsewhere. Wait for a return, which either
+        //brings back a buffer of this class or frees room under the cap.
+        android_atomic_inc(&mWaiters);
+        {
+            Mutex::Autolock autoLock(mLock);
+            int32_t total = android_atomic_acquire_load(&mTotalBytes);
+            if (total + buffersize > (size_t)android_atomic_acquire_load(&mCapBytes)
+                    && (index >= APE_POOL_CLASSES
+                        || android_atomic_acquire_load(&mCached[index]) == 0)) {
+                mReturnedCondition.waitRelative(mLock, ms2ns(APE_POOL_WAIT_MS));
+            }
+        }
+        android_atomic_dec(&mWaiters);
+        android_atomic_inc(&mWaits);
+        waited = true;
+    }
+
+    int32_t total = android_atomic_acquire_load(&mTotalBytes);
+    int32_t peak;
+    do {
+        peak = android_atomic_acquire_load(&mPeakBytes);
+    } while (total > peak && android_atomic_cmpxchg(peak, total, &mPeakBytes));
+
+    MediaBuffer *buffer = new MediaBuffer(buffersize);
+    if (buffer->data() == NULL) {
+        LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+        buffer->release();
+        android_atomic_add(-(int32_t)buffersize, &mTotalBytes);
+        return NO_MEMORY;
+    }
+    if (index < APE_POOL_CLASSES) {
+        android_atomic_inc(&mAllocations[index]);
+    } else {
+        android_atomic_inc(&mOversize);
+    }
+
+    buffer->setObserver(this);
+    buffer->add_ref();
+    *out = buffer;
+    return OK;
+}
+
+void APEBufferPool::signalBufferReturned(MediaBuffer *buffer) {
+    const size_t index = getClass(buffer->size());
+    const int32_t cap = android_atomic_acquire_load(&mCapBytes);
+
+    //Over the cap the memory goes back to the system, so that it is not
+    //held idle while acquire() calls are about to allocate past it.
+    if (index >= APE_POOL_CLASSES
+            || android_atomic_acquire_load(&mTotalBytes) > cap
+            || cap == 0
+            || !pushFree(index, buffer)) {
+        freeBuffer(buffer);
+    }
+
+    if (android_atomic_acquire_load(&mWaiters) > 0) {
+        Mutex::Autolock autoLock(mLock);
+        mReturnedCondition.broadcast();
+    }
+}
+
+MediaBuffer *APEBufferPool::popFree(size_t index) {
+    FreeList *list = &mFreeLists[index];
+    for (size_t i = 0; i < APE_POOL_SLOTS; i++) {
+        if (android_atomic_acquire_load(&list->state[i]) != SLOT_FULL
+                || android_atomic_acquire_cas(SLOT_FULL, SLOT_BUSY, &list->state[i])) {
+            continue;
+        }
+        MediaBuffer *buffer = list->buffers[i];
+        list->buffers[i] = NULL;
+        android_atomic_release_store(SLOT_EMPTY, &list->state[i]);
+
+        android_atomic_dec(&mCached[index]);
+        android_atomic_add(-(int32_t)buffer->size(), &mCachedBytes);
+        return buffer;
+    }
+    return NULL;
+}
+
+bool APEBufferPool::pushFree(size_t index, MediaBuffer *buffer) {
+    FreeList *list = &mFreeLists[index];
+    for (size_t i = 0; i < APE_POOL_SLOTS; i++) {
+        if (android_atomic_acquire_load(&list->state[i]) != SLOT_EMPTY
+                || android_atomic_acquire_cas(SLOT_EMPTY, SLOT_BUSY, &list->state[i])) {
+            continue;
+        }
+        //Counted before the slot is published, so a concurrent popFree()
+        //never takes the counters below zero.
+        android_atomic_inc(&mCached[index]);
+        android_atomic_add(buffer->size(), &mCachedBytes);
+
+        list->buffers[i] = buffer;
+        android_atomic_release_store(SLOT_FULL, &list->state[i]);
+        return true;
+    }
+    return false;
+}
+
+//Accounts size bytes against the cap, if they fit. A request that is
+//alone in the pool always fits, or it could never be served.
+bool APEBufferPool::reserve(size_t size) {
+    int32_t total;
+    do {
+        total = android_atomic_acquire_load(&mTotalBytes);
+        int32_t cap = android_atomic_acquire_load(&mCapBytes);
+        if (cap > 0 && total > 0 && (size_t)total + size > (size_t)cap) {
+            return false;
+        }
+    } while (android_atomic_cmpxchg(total, total + size, &mTotalBytes));
+    return true;
+}
+
+//Frees idle buffers, the largest first, until size more bytes fit under
+//the cap. Returns whether anything was freed.
+bool APEBufferPool::freeIdle(size_t size) {
+    const int32_t cap = android_atomic_acquire_load(&mCapBytes);
+    bool freed = false;
+
+    for (size_t index = APE_POOL_CLASSES; index-- > 0;) {
+        while (android_atomic_acquire_load(&mCached[index]) > 0) {
+            if ((size_t)android_atomic_acquire_load(&mTotalBytes) + size <= (size_t)cap) {
+                return freed;
+            }
+            MediaBuffer *buffer = popFree(index);
+            if (buffer == NULL) {
+                break;
+            }
+            freeBuffer(buffer);
+            freed = true;
+        }
+    }
+    return freed;
+}
+
+void APEBufferPool::freeBuffer(MediaBuffer *buffer) {
+    android_atomic_inc(&mFrees);
+    android_atomic_add(-(int32_t)buffer->size(), &mTotalBytes);
+
+    //Without an observer the last release deletes the buffer.
+    buffer->setObserver(NULL);
+    buffer->release();
+}
+
+void APEBufferPool::trim() {
+    for (size_t index = 0; index < APE_POOL_CLASSES; index++) {
+        MediaBuffer *buffer;
+        while ((buffer = popFree(index)) != NULL) {
+            freeBuffer(buffer);
+        }
+    }
+}
+
+void APEBufferPool::getSnapshot(Snapshot *snapshot) const {
+    memset(snapshot, 0, sizeof(*snapshot));
+    snapshot->capBytes = android_atomic_acquire_load(&mCapBytes);
+    snapshot->totalBytes = android_atomic_acquire_load(&mTotalBytes);
+    snapshot->cachedBytes = android_atomic_acquire_load(&mCachedBytes);
+    snapshot->peakBytes = android_atomic_acquire_load(&mPeakBytes);
+    snapshot->acquires = android_atomic_acquire_load(&mAcquires);
+    snapshot->waits = android_atomic_acquire_load(&mWaits);
+    snapshot->overcommits = android_atomic_acquire_load(&mOvercommits);
+    snapshot->frees = android_atomic_acquire_load(&mFrees);
+    snapshot->oversize = android_atomic_acquire_load(&mOversize);
+
+    for (size_t i = 0; i < APE_POOL_CLASSES; i++) {
+        ApeBufferPoolClass *data = &snapshot->classes[i];
+        data->size = getClassSize(i);
+        data->allocations = android_atomic_acquire_load(&mAllocations[i]);
+        data->hits = android_atomic_acquire_load(&mHits[i]);
+        data->cached = android_atomic_acquire_load(&mCached[i]);
+    }
+}
+
+void APEBufferPool::dump(String8 *out) const {
+    Snapshot data;
+    getSnapshot(&data);
+
+    out->appendFormat("APE buffer pool: cap %zu, live %zu, idle %zu, peak %zu bytes\n",
+            data.capBytes, data.totalBytes, data.cachedBytes, data.peakBytes);
+    out->appendFormat("  %u acquires, %u waits, %u past the cap, %u freed, %u oversize\n",
+            data.acquires, data.waits, data.overcommits, data.frees, data.oversize);
+
+    for (size_t i = 0; i < APE_POOL_CLASSES; i++) {
+        const ApeBufferPoolClass &poolclass = data.classes[i];
+        if (poolclass.allocations == 0) {
+            continue;
+        }
+        out->appendFormat("  %9zu bytes: %u allocated, %u reused, %u idle\n",
+                poolclass.size, poolclass.allocations, poolclass.hits, poolclass.cached);
+    }
+}
+
+}  // namespace android
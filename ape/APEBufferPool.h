@@ -0,0 +1,157 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_BUFFER_POOL_H_
+
+#define APE_BUFFER_POOL_H_
+
+#include <media/stagefright/MediaBuffer.h>
+#include <utils/Errors.h>
+#include <utils/String8.h>
+#include <utils/threads.h>
+
+namespace android {
+
+//Buffer sizes go up in steps of a quarter octave, from 4 KB to 16 MB, so
+//a frame wastes at most a fifth of its buffer. Larger requests are served
+//outside the classes and freed on return.
+#define APE_POOL_MIN_SHIFT  12
+#define APE_POOL_MAX_SHIFT  24
+#define APE_POOL_CLASSES    ((APE_POOL_MAX_SHIFT - APE_POOL_MIN_SHIFT) * 4 + 1)
+//Idle buffers kept per class.
+#define APE_POOL_SLOTS      32
+
+typedef struct {
+    size_t size;
+    //Buffers malloc'ed, and acquires served from the free list instead.
+    uint32_t allocations;
+    uint32_t hits;
+    //Buffers currently idle in the free list.
+    uint32_t cached;
+} ApeBufferPoolClass;
+
+//Process wide pool of the MediaBuffers APESource hands out, shared by all
+//sources so that idle memory is bounded by the pool rather than by the
+//number of open files times their largest frame. Buffers are taken per
+//frame by the size actually needed and come back through
+//signalBufferReturned() when the last reference is released.
+//
+//The free lists are lock free. The cap on the bytes held by the pool,
+//idle and in use, is soft: when it is reached, idle buffers are freed
+//first, then acquire() waits a bounded time for one to come back and
+//finally allocates past the cap rather than stall playback.
+class APEBufferPool : public MediaBufferObserver {
+public:
+    typedef struct {
+        size_t capBytes;
+        //Bytes of all live buffers, in use or idle, and of the idle ones.
+        size_t totalBytes;
+        size_t cachedBytes;
+        size_t peakBytes;
+        uint32_t acquires;
+        //acquire() calls that waited for a buffer to come back, and those
+        //that still went past the cap afterwards.
+        uint32_t waits;
+        uint32_t overcommits;
+        //Buffers freed because the free list was full or over the cap.
+        uint32_t frees;
+        uint32_t oversize;
+        ApeBufferPoolClass classes[APE_POOL_CLASSES];
+    } Snapshot;
+
+    //The cap comes from media.ape.buffer_pool.size in bytes, 16 MB if unset.
+    static APEBufferPool *getInstance();
+
+    //Returns a buffer of at least size bytes with one reference held, its
+    //range covering all of it and no meta data.
+    status_t acquire(size_t size, MediaBuffer **buffer);
+
+    //0 turns off caching, every buffer is then freed on return.
+    void setCap(size_t bytes);
+
+    //Frees every idle buffer.
+    void trim();
+
+    void getSnapshot(Snapshot *snapshot) const;
+
+    void dump(String8 *out) const;
+
+    static size_t getClassSize(size_t index);
+
+    virtual void signalBufferReturned(MediaBuffer *buffer);
+
+private:
+    enum {
+        SLOT_EMPTY,
+        SLOT_BUSY,
+        SLOT_FULL,
+    };
+
+    //A slot is claimed by moving its state to SLOT_BUSY, so no two threads
+    //touch the same buffer pointer and there is no ABA to worry about.
+    typedef struct {
+        volatile int32_t state[APE_POOL_SLOTS];
+        MediaBuffer *buffers[APE_POOL_SLOTS];
+    } FreeList;
+
+    FreeList mFreeLists[APE_POOL_CLASSES];
+
+    volatile int32_t mCapBytes;
+    volatile int32_t mTotalBytes;
+    volatile int32_t mCachedBytes;
+    volatile int32_t mPeakBytes;
+    volatile int32_t mAcquires;
+    volatile int32_t mWaits;
+    volatile int32_t mOvercommits;
+    volatile int32_t mFrees;
+    volatile int32_t mOversize;
+    volatile int32_t mAllocations[APE_POOL_CLASSES];
+    volatile int32_t mHits[APE_POOL_CLASSES];
+    volatile int32_t mCached[APE_POOL_CLASSES];
+
+    //Only taken by acquire() calls waiting at the cap, and by returns
+    //while there are any.
+    Mutex mLock;
+    Condition mReturnedCondition;
+    volatile int32_t mWaiters;
+
+    APEBufferPool(size_t capBytes);
+    ~APEBufferPool();
+
+    static size_t getClass(size_t size);
+
+    MediaBuffer *popFree(size_t index);
+    bool pushFree(size_t index, MediaBuffer *buffer);
+    bool reserve(size_t size);
+    bool freeIdle(size_t size);
+    void freeBuffer(MediaBuffer *buffer);
+
+    APEBufferPool(const APEBufferPool &);
+    APEBufferPool &operator=(const APEBufferPool &);
+};
+
+}  // namespace android
+
+#endif  // APE_BUFFER_POOL_H_
@@ -0,0 +1,567 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "APEClipWriter"
+#include <utils/Log.h>
+
+#include "APEClipWriter.h"
+#include "APEExtractor.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaErrors.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+//Most bytes handed to the kernel, or copied through the buffer, at once.
+#define APE_CLIP_COPY_CHUNK_SIZE (1024 * 1024)
+//Descriptor and header are copied through memory; anything longer is not
+//a header this reader would have parsed.
+#define APE_CLIP_MAX_HEADER_SIZE (64 * 1024)
+
+#define APE_FLAG_HAS_PEAK_LEVEL        4
+#define APE_FLAG_HAS_SEEK_ELEMENTS    16
+#define APE_FLAG_CREATE_WAV_HEADER    32
+
+#define APE_TAG_HEADER_SIZE 32
+#define APE_TAG_VERSION 2000
+#define APE_TAG_FLAG_HAS_HEADER (1u << 31)
+#define APE_TAG_FLAG_IS_HEADER  (1u << 29)
+
+namespace android {
+
+enum {
+    kCopyFileRange,
+    kCopySendfile,
+    kCopyBuffered,
+};
+
+struct APEClipWriter::Clip {
+    int fd;
+    int outFd;
+    //Start of the APE stream in fd, past any ID3v2 tags. Offsets in source
+    //count from there.
+    off64_t sourceOffset;
+    sp<DataSource> source;
+    sp<APEFrameData> frameData;
+    const ApeHeaderData *header;
+
+    //Frames [firstFrame, endFrame) of the source.
+    uint32_t firstFrame;
+    uint32_t endFrame;
+
+    //Frame data of the clip in the source: from the word the first frame
+    //starts in up to the end of the last frame.
+    off64_t dataStart;
+    off64_t dataEnd;
+    //Bytes at dataStart that are repacked in memory, zero when the first
+    //frame starts on a word.
+    size_t headSize;
+    //Where the frames start in the clip, and their length there.
+    off64_t outDataStart;
+    off64_t outDataLength;
+
+    //Next byte written to outFd.
+    off64_t outOffset;
+    //Best copy that has worked so far, a failing one is not tried again.
+    int copyMethod;
+    uint8_t *copyBuffer;
+
+    ApeClipResult *result;
+};
+
+static inline void writeLE16(uint8_t *ptr, uint16_t x) {
+    ptr[0] = x & 0xff;
+    ptr[1] = (x >> 8) & 0xff;
+}
+
+static inline void writeLE32(uint8_t *ptr, uint32_t x) {
+    ptr[0] = x & 0xff;
+    ptr[1] = (x >> 8) & 0xff;
+    ptr[2] = (x >> 16) & 0xff;
+    ptr[3] = (x >> 24) & 0xff;
+}
+
+static inline uint16_t readLE16(const uint8_t *ptr) {
+    return ptr[0] | (ptr[1] << 8);
+}
+
+//The decoder reads the frame data as little endian 32-bit words, most
+//significant byte first, so the byte stream of a frame is every word of
+//the file reversed. Reversing again turns it back.
+static void swapWords(uint8_t *data, size_t size) {
+    for (size_t i = 0; i + 4 <= size; i += 4) {
+        uint8_t t = data[i];
+        data[i] = data[i + 3];
+        data[i + 3] = t;
+        t = data[i + 1];
+        data[i + 1] = data[i + 2];
+        data[i + 2] = t;
+    }
+}
+
+//Start of the frame in the source, before it is moved back to its word.
+static inline off64_t framePosition(const ApeFrame &frame) {
+    return frame.pos + frame.skip;
+}
+
+//Errors that say the kernel cannot copy between this pair of files, as
+//opposed to the copy itself failing.
+static bool isCopyUnsupported(int err) {
+    return err == ENOSYS || err == EXDEV || err == EINVAL
+            || err == EOPNOTSUPP || err == ENOTSUP;
+}
+
+status_t APEClipWriter::write(int fd, int64_t startTimeUs, int64_t endTimeUs, int outFd,
+        ApeClipResult *result) {
+    memset(result, 0, sizeof(*result));
+
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        LOGE("Failed to stat the source. (%s)", strerror(errno));
+        return ERROR_IO;
+    }
+    int sourceFd = dup(fd);
+    if (sourceFd < 0) {
+        return ERROR_IO;
+    }
+
+    //Looks past any ID3v2 tags, the first FileSource closes its descriptor
+    //once done with.
+    Clip clip;
+    uint8_t start[16];
+    APEFrameData::readStreamStart(new FileSource(sourceFd, 0, st.st_size),
+            start, sizeof(start), &clip.sourceOffset);
+    sourceFd = dup(fd);
+    if (sourceFd < 0) {
+        return ERROR_IO;
+    }
+    clip.fd = fd;
+    clip.outFd = outFd;
+    clip.source = new FileSource(sourceFd, clip.sourceOffset,
+            st.st_size - clip.sourceOffset);
+    clip.frameData = new APEFrameData(clip.source);
+    clip.outOffset = 0;
+    clip.copyMethod = kCopyFileRange;
+    clip.copyBuffer = NULL;
+    clip.result = result;
+
+    status_t err = clip.frameData->initCheck();
+    if (err == OK) {
+        err = clip.frameData->buildIndex();
+    }
+    if (err != OK) {
+        LOGE("Source is not a readable APE file");
+        return err;
+    }
+    const ApeHeaderData *header = clip.frameData->getApeHeaderData();
+    clip.header = header;
+
+    //Before 3810 a table of seek bits follows the seek table, which is not
+    //rebuilt here.
+    if (header->version < 3810) {
+        LOGE("Clips of version %d files are not supported", header->version);
+        return ERROR_UNSUPPORTED;
+    }
+
+    //Whole frames around the range.
+    uint64_t totalblocks = (uint64_t)(header->totalframes - 1) * header->blocksperframe
+                           + header->finalframeblocks;
+    if (startTimeUs < 0) {
+        return ERROR_OUT_OF_RANGE;
+    }
+    uint64_t startblock = startTimeUs * header->samplerate / 1000000;
+    if (startblock >= totalblocks) {
+        return ERROR_OUT_OF_RANGE;
+    }
+    clip.firstFrame = startblock / header->blocksperframe;
+    clip.endFrame = header->totalframes;
+    if (endTimeUs >= 0) {
+        uint64_t endblock = (endTimeUs * header->samplerate + 999999) / 1000000;
+        if (endblock <= startblock) {
+            return ERROR_OUT_OF_RANGE;
+        }
+        if (endblock < totalblocks) {
+            clip.endFrame = (endblock + header->blocksperframe - 1) / header->blocksperframe;
+        }
+    }
+
+    ApeFrame first = clip.frameData->getCurrentFrame(clip.firstFrame);
+    ApeFrame last = clip.frameData->getCurrentFrame(clip.endFrame - 1);
+    clip.dataStart = first.pos;
+    clip.dataEnd = last.pos + last.size;
+    clip.headSize = 0;
+    if (first.skip != 0) {
+        //Up to the word the next frame starts in, which is the whole
+        //first frame, or to the end of the data if there is no next one.
+        off64_t next = clip.firstFrame + 1 < header->totalframes
+                ? framePosition(clip.frameData->getCurrentFrame(clip.firstFrame + 1))
+                : clip.dataEnd;
+        clip.headSize = (next - first.pos + 3) & ~3;
+    }
+    clip.outDataLength = clip.dataEnd - clip.dataStart;
+    if ((off64_t)clip.headSize > clip.outDataLength) {
+        clip.outDataLength = clip.headSize;
+    }
+
+    uint32_t framecount = clip.endFrame - clip.firstFrame;
+    result->firstFrame = clip.firstFrame;
+    result->frameCount = framecount;
+    result->startTimeUs = first.pts;
+    result->durationUs = ((uint64_t)(framecount - 1) * header->blocksperframe + last.nblocks)
+                         * 1000000 / header->samplerate;
+
+    ALOGV("Clip of frames %u..%u, %lld bytes of frame data from %lld",
+            clip.firstFrame, clip.endFrame - 1, (long long)clip.outDataLength,
+            (long long)clip.dataStart);
+
+    err = writeHeader(&clip);
+    if (err == OK) {
+        err = writeFrames(&clip);
+    }
+    if (err == OK) {
+        err = writeTag(&clip);
+    }
+    if (err == OK && ftruncate(outFd, clip.outOffset) != 0) {
+        LOGE("Failed to truncate the clip. (%s)", strerror(errno));
+        err = ERROR_IO;
+    }
+    free(clip.copyBuffer);
+
+    result->bytesWritten = clip.outOffset;
+    return err;
+}
+
+//Descriptor and header as in the source with the lengths of the clip,
+//followed by its seek table.
+status_t APEClipWriter::writeHeader(Clip *clip) {
+    const ApeHeaderData *header = clip->header;
+    uint32_t framecount = clip->endFrame - clip->firstFrame;
+    uint32_t finalframeblocks = clip->endFrame == header->totalframes
+            ? header->finalframeblocks : header->blocksperframe;
+
+    //Before 3980 headerlength counts from the start of the file.
+    size_t headersize = header->descriptorlength + header->headerlength;
+    if ((header->version >= 3980 && header->descriptorlength < 52)
+            || headersize > APE_CLIP_MAX_HEADER_SIZE) {
+        return ERROR_MALFORMED;
+    }
+    size_t tablesize = framecount * sizeof(uint32_t);
+    uint8_t *buffer = (uint8_t *)malloc(headersize + tablesize);
+    if (buffer == NULL) {
+        return NO_MEMORY;
+    }
+    if (clip->source->readAt(0, buffer, headersize) != (ssize_t)headersize) {
+        free(buffer);
+        return ERROR_IO;
+    }
+
+    if (header->version >= 3980) {
+        uint8_t *descriptor = buffer;
+        uint8_t *data = buffer + header->descriptorlength;
+
+        writeLE32(&descriptor[16], tablesize);
+        writeLE32(&descriptor[20], 0);
+        writeLE32(&descriptor[24], clip->outDataLength & 0xffffffff);
+        writeLE32(&descriptor[28], (uint64_t)clip->outDataLength >> 32);
+        writeLE32(&descriptor[32], 0);
+        memset(&descriptor[36], 0, 16);
+
+        writeLE16(&data[2], readLE16(&data[2]) | APE_FLAG_CREATE_WAV_HEADER);
+        writeLE32(&data[8], finalframeblocks);
+        writeLE32(&data[12], framecount);
+    } else {
+        uint16_t formatflags = header->formatflags;
+
+        writeLE16(&buffer[8], formatflags | APE_FLAG_CREATE_WAV_HEADER);
+        writeLE32(&buffer[16], 0);
+        writeLE32(&buffer[20], 0);
+        writeLE32(&buffer[24], framecount);
+        writeLE32(&buffer[28], finalframeblocks);
+        if (formatflags & APE_FLAG_HAS_SEEK_ELEMENTS) {
+            writeLE32(&buffer[formatflags & APE_FLAG_HAS_PEAK_LEVEL ? 36 : 32], framecount);
+        }
+    }
+
+    //The first frame starts right behind the table, the others keep their
+    //distance to the word the first one starts in.
+    clip->outDataStart = headersize + tablesize;
+    uint8_t *table = buffer + headersize;
+    writeLE32(&table[0], clip->outDataStart);
+    for (uint32_t i = 1; i < framecount; i++) {
+        off64_t pos = framePosition(clip->frameData->getCurrentFrame(clip->firstFrame + i));
+        writeLE32(&table[i * sizeof(uint32_t)],
+                (clip->outDataStart + pos - clip->dataStart) & 0xffffffff);
+    }
+
+    status_t err = writeAt(clip, buffer, headersize + tablesize);
+    free(buffer);
+    return err;
+}
+
+//The reader expects the first frame on a word of the frame data. When it
+//is not the frame is moved to the front of its first word and the bytes
+//it leaves behind up to the second frame are zeroed, which keeps every
+//later frame at its place within its word.
+status_t APEClipWriter::writeFrames(Clip *clip) {
+    off64_t offset = clip->dataStart;
+
+    if (clip->headSize > 0) {
+        ApeFrame first = clip->frameData->getCurrentFrame(clip->firstFrame);
+        size_t skip = first.skip;
+        size_t size = clip->headSize;
+
+        uint8_t *words = (uint8_t *)calloc(2, size);
+        if (words == NULL) {
+            return NO_MEMORY;
+        }
+        uint8_t *packed = words + size;
+
+        //The last frame may end short of a whole word at the end of the file.
+        ssize_t n = clip->source->readAt(offset, words, size);
+        if (n < (ssize_t)(clip->dataEnd - offset < (off64_t)size
+                    ? clip->dataEnd - offset : size)) {
+            free(words);
+            return ERROR_IO;
+        }
+        swapWords(words, size);
+
+        //Bytes of the first frame, then skip zero bytes, then whatever of
+        //the second frame shares the last word.
+        size_t framesize = clip->firstFrame + 1 < clip->header->totalframes
+                ? framePosition(clip->frameData->getCurrentFrame(clip->firstFrame + 1))
+                  - framePosition(first)
+                : clip->dataEnd - framePosition(first);
+        memcpy(packed, words + skip, framesize);
+        if (skip + framesize < size) {
+            memcpy(packed + skip + framesize, words + skip + framesize,
+                    size - skip - framesize);
+        }
+        swapWords(packed, size);
+
+        status_t err = writeAt(clip, packed, size);
+        free(words);
+        if (err != OK) {
+            return err;
+        }
+        offset += size;
+    }
+
+    if (offset < clip->dataEnd) {
+        return copyAt(clip, offset, clip->dataEnd - offset);
+    }
+    return OK;
+}
+
+//A new APEv2 tag with every item of the source's tag, read from an APEv1,
+//APEv2 or ID3v1 tag alike. Values that were not read while parsing the tag,
+//cover art above all, are copied like the frames.
+status_t APEClipWriter::writeTag(Clip *clip) {
+    sp<APETagData> tag = new APETagData(clip->source);
+    if (tag->initCheck() != OK) {
+        return OK;
+    }
+
+    uint32_t count = 0;
+    uint64_t size = APE_TAG_HEADER_SIZE;
+    for (size_t i = 0; i < tag->countItems(); i++) {
+        const ApeTagItem *item = tag->getItem(i);
+        //Its times are those of the source.
+        if (!strcasecmp(item->key.string(), "Cuesheet")) {
+            continue;
+        }
+        size += 8 + item->key.length() + 1 + item->size;
+        count++;
+    }
+    if (count == 0) {
+        return OK;
+    }
+    if (size > 0xffffffff) {
+        return ERROR_MALFORMED;
+    }
+
+    uint8_t header[APE_TAG_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    memcpy(header, "APETAGEX", 8);
+    writeLE32(&header[8], APE_TAG_VERSION);
+    writeLE32(&header[12], size);
+    writeLE32(&header[16], count);
+    writeLE32(&header[20], APE_TAG_FLAG_HAS_HEADER | APE_TAG_FLAG_IS_HEADER);
+    status_t err = writeAt(clip, header, sizeof(header));
+
+    for (size_t i = 0; err == OK && i < tag->countItems(); i++) {
+        const ApeTagItem *item = tag->getItem(i);
+        if (!strcasecmp(item->key.string(), "Cuesheet")) {
+            continue;
+        }
+
+        size_t keysize = item->key.length() + 1;
+        uint8_t *buffer = (uint8_t *)malloc(8 + keysize);
+        if (buffer == NULL) {
+            return NO_MEMORY;
+        }
+        writeLE32(&buffer[0], item->size);
+        writeLE32(&buffer[4], item->flags);
+        memcpy(&buffer[8], item->key.string(), keysize);
+        err = writeAt(clip, buffer, 8 + keysize);
+        free(buffer);
+
+        if (err != OK) {
+            break;
+        } else if (item->value.length() == item->size) {
+            err = writeAt(clip, item->value.string(), item->size);
+        } else {
+            err = copyAt(clip, item->offset, item->size);
+        }
+    }
+
+    if (err == OK) {
+        writeLE32(&header[20], APE_TAG_FLAG_HAS_HEADER);
+        err = writeAt(clip, header, sizeof(header));
+    }
+    return err;
+}
+
+status_t APEClipWriter::writeAt(Clip *clip, const void *data, size_t size) {
+    const uint8_t *ptr = (const uint8_t *)data;
+    while (size > 0) {
+        ssize_t n = pwrite64(clip->outFd, ptr, size, clip->outOffset);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            LOGE("Failed to write the clip. (%s)", strerror(errno));
+            return ERROR_IO;
+        }
+        ptr += n;
+        size -= n;
+        clip->outOffset += n;
+    }
+    return OK;
+}
+
+//Copies size bytes of the source at offset to the clip. copy_file_range()
+//leaves the data in the kernel, and may share the blocks rather than copy
+//them; sendfile() at least saves the copy into this process. Either may be
+//missing or refuse the pair of files, then the next one is used for the
+//rest of the clip.
+status_t APEClipWriter::copyAt(Clip *clip, off64_t offset, off64_t size) {
+#ifdef __NR_copy_file_range
+    while (size > 0 && clip->copyMethod == kCopyFileRange) {
+        loff_t in = clip->sourceOffset + offset;
+        loff_t out = clip->outOffset;
+        size_t chunk = size < APE_CLIP_COPY_CHUNK_SIZE ? size : APE_CLIP_COPY_CHUNK_SIZE;
+        ssize_t n = syscall(__NR_copy_file_range, clip->fd, &in, clip->outFd, &out, chunk, 0);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && isCopyUnsupported(errno)) {
+            ALOGV("copy_file_range() not usable. (%s)", strerror(errno));
+            clip->copyMethod = kCopySendfile;
+            break;
+        }
+        if (n <= 0) {
+            LOGE("Failed to copy %lld bytes at %lld. (%s)", (long long)size,
+                    (long long)offset, n < 0 ? strerror(errno) : "end of file");
+            return ERROR_IO;
+        }
+        offset += n;
+        size -= n;
+        clip->outOffset += n;
+        clip->result->bytesInKernel += n;
+    }
+#else
+    if (clip->copyMethod == kCopyFileRange) {
+        clip->copyMethod = kCopySendfile;
+    }
+#endif
+
+    //sendfile() writes at the file position of the output, and takes an
+    //off_t that may not reach past 2 GB.
+    if (size > 0 && clip->copyMethod == kCopySendfile) {
+        off64_t end = clip->sourceOffset + offset + size;
+        if ((off64_t)(off_t)end != end
+                || lseek64(clip->outFd, clip->outOffset, SEEK_SET) < 0) {
+            clip->copyMethod = kCopyBuffered;
+        }
+    }
+    while (size > 0 && clip->copyMethod == kCopySendfile) {
+        off_t in = clip->sourceOffset + offset;
+        size_t chunk = size < APE_CLIP_COPY_CHUNK_SIZE ? size : APE_CLIP_COPY_CHUNK_SIZE;
+        ssize_t n = sendfile(clip->outFd, clip->fd, &in, chunk);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n < 0 && isCopyUnsupported(errno)) {
+            ALOGV("sendfile() not usable. (%s)", strerror(errno));
+            clip->copyMethod = kCopyBuffered;
+            break;
+        }
+        if (n <= 0) {
+            LOGE("Failed to send %lld bytes at %lld. (%s)", (long long)size,
+                    (long long)offset, n < 0 ? strerror(errno) : "end of file");
+            return ERROR_IO;
+        }
+        offset += n;
+        size -= n;
+        clip->outOffset += n;
+        clip->result->bytesInKernel += n;
+    }
+
+    if (size > 0 && clip->copyBuffer == NULL) {
+        clip->copyBuffer = (uint8_t *)malloc(APE_CLIP_COPY_CHUNK_SIZE);
+        if (clip->copyBuffer == NULL) {
+            return NO_MEMORY;
+        }
+    }
+    while (size > 0) {
+        size_t chunk = size < APE_CLIP_COPY_CHUNK_SIZE ? size : APE_CLIP_COPY_CHUNK_SIZE;
+        ssize_t n = clip->source->readAt(offset, clip->copyBuffer, chunk);
+        if (n <= 0) {
+            LOGE("Failed to read %zu bytes at %lld", chunk, (long long)offset);
+            return ERROR_IO;
+        }
+        status_t err = writeAt(clip, clip->copyBuffer, n);
+        if (err != OK) {
+            return err;
+        }
+        offset += n;
+        size -= n;
+    }
+
+    return OK;
+}
+
+}  // namespace android
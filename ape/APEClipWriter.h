@@ -0,0 +1,90 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+
+#ifndef APE_CLIP_WRITER_H_
+
+#define APE_CLIP_WRITER_H_
+
+#include <utils/Errors.h>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace android {
+
+typedef struct {
+    //Frames of the source that went into the clip, and the time range they
+    //cover in the source.
+    uint32_t firstFrame;
+    uint32_t frameCount;
+    int64_t startTimeUs;
+    int64_t durationUs;
+    //Length of the clip, and how much of it the kernel moved from file to
+    //file without a copy through this process.
+    off64_t bytesWritten;
+    off64_t bytesInKernel;
+} ApeClipResult;
+
+//Cuts a time range out of an APE file into a new APE file, without
+//decoding. The clip is made of whole frames, from the one holding
+//startTimeUs up to the one holding the sample before endTimeUs, so it may
+//start and end up to a frame early and late.
+//
+//The header is copied with the frame count, final frame blocks and data
+//length patched, the seek table is rebased onto the new data start and
+//the APE tag is written again behind the frames. The frame data itself is
+//moved with copy_file_range(), sendfile() where that is missing, and
+//pread()/pwrite() where neither works for the pair of files. Only a first
+//frame that does not start on a word of the frame data is repacked in
+//memory.
+//
+//The clip has no MD5, no wav header and wav tail (the decoder is asked to
+//create the header instead) and no cue sheet, which would not match it.
+//ID3v2 tags in front of the source are left out as well.
+class APEClipWriter {
+public:
+    //fd is the source file, outFd a regular file open for writing that is
+    //overwritten from the start and truncated to the clip. A negative
+    //endTimeUs, or one past the end, runs to the end of the source. Neither
+    //descriptor is closed.
+    static status_t write(int fd, int64_t startTimeUs, int64_t endTimeUs, int outFd,
+            ApeClipResult *result);
+
+private:
+    struct Clip;
+
+    static status_t writeHeader(Clip *clip);
+    static status_t writeFrames(Clip *clip);
+    static status_t writeTag(Clip *clip);
+    static status_t writeAt(Clip *clip, const void *data, size_t size);
+    static status_t copyAt(Clip *clip, off64_t offset, off64_t size);
+
+    APEClipWriter();
+};
+
+}  // namespace android
+
+#endif  // APE_CLIP_WRITER_H_
@@ -0,0 +1,237 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "APECueSheet"
+#include <utils/Log.h>
+
+#include "APECueSheet.h"
+
+#include <media/stagefright/MediaErrors.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+namespace android {
+
+//CD frames per second, the unit of INDEX positions.
+#define CUE_FRAMES_PER_SECOND 75
+
+//Start of a track without any INDEX yet.
+#define CUE_NO_INDEX 0xffffffff
+
+//Returns the next token of the line, unquoted, and advances *pos past it.
+//Returns false at the end of the line.
+static bool nextToken(const char *line, size_t length, size_t *pos, String8 *token) {
+    size_t i = *pos;
+    while (i < length && (line[i] == ' ' || line[i] == '\t')) {
+        i++;
+    }
+    if (i == length) {
+        return false;
+    }
+
+    size_t start, end;
+    if (line[i] == '"') {
+        start = ++i;
+        while (i < length && line[i] != '"') {
+            i++;
+        }
+        end = i;
+        if (i < length) {
+            i++;
+        }
+    } else {
+        start = i;
+        while (i < length && line[i] != ' ' && line[i] != '\t') {
+            i++;
+        }
+        end = i;
+    }
+
+    token->setTo(line + start, end - start);
+    *pos = i;
+    return true;
+}
+
+//mm:ss:ff, minutes may go past 99 for long images. Worked out in 64 bits,
+//times that do not fit below CUE_NO_INDEX are rejected rather than wrapped.
+static bool parseTime(const char *text, uint32_t *cdframes) {
+    unsigned minutes, seconds, frames;
+    char extra;
+    if (sscanf(text, "%u:%u:%u%c", &minutes, &seconds, &frames, &extra) != 3
+            || seconds >= 60 || frames >= CUE_FRAMES_PER_SECOND) {
+        return false;
+    }
+
+    uint64_t total = ((uint64_t)minutes * 60 + seconds) * CUE_FRAMES_PER_SECOND + frames;
+    if (total >= CUE_NO_INDEX) {
+        return false;
+    }
+    *cdframes = total;
+    return true;
+}
+
+APECueSheet::APECueSheet(const char *text, size_t size)
+        :mInitCheck(NO_INIT) {
+    //UTF-8 byte order mark.
+    if (size >= 3 && !memcmp(text, "\xef\xbb\xbf", 3)) {
+        text += 3;
+        size -= 3;
+    }
+
+    bool hasfile = false;
+    size_t start = 0;
+    while (start < size) {
+        size_t end = start;
+        while (end < size && text[end] != '\n' && text[end] != '\r') {
+            end++;
+        }
+        if (parseLine(text + start, end - start, &hasfile) != OK) {
+            mTracks.clear();
+            return;
+        }
+        start = end + 1;
+    }
+
+    if (mTracks.isEmpty()) {
+        return;
+    }
+    for (size_t i = 0; i < mTracks.size(); i++) {
+        if (mTracks[i].start == CUE_NO_INDEX) {
+            LOGE("Cue sheet track %u has no INDEX", mTracks[i].number);
+            mTracks.clear();
+            return;
+        }
+        if (i > 0 && mTracks[i].start <= mTracks[i - 1].start) {
+            LOGE("Cue sheet track %u starts before the one preceding it",
+                    mTracks[i].number);
+            mTracks.clear();
+            return;
+        }
+    }
+
+    mInitCheck = OK;
+}
+
+APECueSheet::~APECueSheet() {
+}
+
+status_t APECueSheet::parseLine(const char *line, size_t length, bool *hasfile) {
+    size_t pos = 0;
+    String8 keyword;
+    if (!nextToken(line, length, &pos, &keyword)) {
+        return OK;
+    }
+
+    String8 value;
+    bool hasvalue = nextToken(line, length, &pos, &value);
+    ApeCueTrack *track = mTracks.isEmpty() ? NULL : &mTracks.editItemAt(mTracks.size() - 1);
+
+    if (!strcasecmp(keyword.string(), "FILE")) {
+        //Tracks of a second file are not in this image.
+        if (*hasfile) {
+            LOGE("Cue sheet refers to more than one file");
+            return ERROR_UNSUPPORTED;
+        }
+        *hasfile = true;
+    } else if (!strcasecmp(keyword.string(), "TRACK")) {
+        String8 type;
+        if (!hasvalue || !nextToken(line, length, &pos, &type)) {
+            return ERROR_MALFORMED;
+        }
+        if (strcasecmp(type.string(), "AUDIO")) {
+            LOGE("Unsupported cue sheet track type %s", type.string());
+            return ERROR_UNSUPPORTED;
+        }
+
+        ApeCueTrack newtrack;
+        newtrack.number = strtoul(value.string(), NULL, 10);
+        newtrack.start = CUE_NO_INDEX;
+        mTracks.push(newtrack);
+    } else if (!strcasecmp(keyword.string(), "TITLE") && hasvalue) {
+        if (track != NULL) {
+            track->title = value;
+        } else {
+            mTitle = value;
+        }
+    } else if (!strcasecmp(keyword.string(), "PERFORMER") && hasvalue) {
+        if (track != NULL) {
+            track->performer = value;
+        } else {
+            mPerformer = value;
+        }
+    } else if (!strcasecmp(keyword.string(), "INDEX")) {
+        String8 time;
+        uint32_t cdframes;
+        if (track == NULL || !hasvalue || !nextToken(line, length, &pos, &time)
+                || !parseTime(time.string(), &cdframes)) {
+            return ERROR_MALFORMED;
+        }
+
+        //INDEX 01 is where the track starts, INDEX 00 only stands in for it.
+        uint32_t index = strtoul(value.string(), NULL, 10);
+        if (index == 1 || (index == 0 && track->start == CUE_NO_INDEX)) {
+            track->start = cdframes;
+        }
+    }
+    //REM, CATALOG, FLAGS, ISRC, PREGAP and the like do not affect playback.
+
+    return OK;
+}
+
+status_t APECueSheet::initCheck() const {
+    return mInitCheck;
+}
+
+const String8 &APECueSheet::getTitle() const {
+    return mTitle;
+}
+
+const String8 &APECueSheet::getPerformer() const {
+    return mPerformer;
+}
+
+size_t APECueSheet::countTracks() const {
+    return mTracks.size();
+}
+
+const ApeCueTrack *APECueSheet::getTrack(size_t index) const {
+    if (index >= mTracks.size()) {
+        return NULL;
+    }
+    return &mTracks[index];
+}
+
+// static
+uint64_t APECueSheet::toSamples(uint32_t cdframes, uint32_t samplerate) {
+    return (uint64_t)cdframes * samplerate / CUE_FRAMES_PER_SECOND;
+}
+
+}  // namespace android
@@ -0,0 +1,82 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_CUE_SHEET_H_
+
+#define APE_CUE_SHEET_H_
+
+#include <utils/Errors.h>
+#include <utils/RefBase.h>
+#include <utils/String8.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+typedef struct {
+    uint32_t number;
+    String8 title;
+    String8 performer;
+    //Position of INDEX 01 in CD frames of 1/75 s, or of INDEX 00 if the
+    //track has no INDEX 01.
+    uint32_t start;
+} ApeCueTrack;
+
+//Cue sheet embedded in the "Cuesheet" tag item of a whole-disc image. Only
+//sheets with a single FILE are accepted, that file being the image itself.
+class APECueSheet : public RefBase {
+public:
+    APECueSheet(const char *text, size_t size);
+
+    status_t initCheck() const;
+
+    //Album title and performer, empty if the sheet has none.
+    const String8 &getTitle() const;
+    const String8 &getPerformer() const;
+
+    //Tracks in file order, with strictly increasing start positions.
+    size_t countTracks() const;
+    const ApeCueTrack *getTrack(size_t index) const;
+
+    static uint64_t toSamples(uint32_t cdframes, uint32_t samplerate);
+
+protected:
+    virtual ~APECueSheet();
+
+private:
+    String8 mTitle;
+    String8 mPerformer;
+    Vector<ApeCueTrack> mTracks;
+
+    status_t mInitCheck;
+
+    status_t parseLine(const char *line, size_t length, bool *hasfile);
+
+    APECueSheet(const APECueSheet &);
+    APECueSheet &operator=(const APECueSheet &);
+};
+
+}  // namespace android
+
+#endif  // APE_CUE_SHEET_H_
@@ -0,0 +1,200 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "APEDSP"
+#include <utils/Log.h>
+
+#include "APEDSP.h"
+
+#include <cutils/properties.h>
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#define APE_DSP_X86 1
+#elif defined(__ARM_NEON__) || defined(__ARM_NEON)
+#include <arm_neon.h>
+#define APE_DSP_NEON 1
+#endif
+
+namespace android {
+
+int32_t apeScalarProductC(int16_t *coeffs, const int16_t *history,
+        const int16_t *adapt, int order, int mul) {
+    //Unsigned so the sum wraps instead of overflowing, like the SIMD lanes.
+    uint32_t res = 0;
+
+    for (int i = 0; i < order; i++) {
+        res += (uint32_t)(coeffs[i] * history[i]);
+        coeffs[i] += mul * adapt[i];
+    }
+
+    return res;
+}
+
+#ifdef APE_DSP_X86
+
+__attribute__((target("sse2")))
+static int32_t apeScalarProductSSE2(int16_t *coeffs, const int16_t *history,
+        const int16_t *adapt, int order, int mul) {
+    const __m128i m = _mm_set1_epi16(mul);
+    __m128i sum = _mm_setzero_si128();
+
+    for (int i = 0; i < order; i += 8) {
+        __m128i c = _mm_loadu_si128((const __m128i *)&coeffs[i]);
+        __m128i h = _mm_loadu_si128((const __m128i *)&history[i]);
+        __m128i a = _mm_loadu_si128((const __m128i *)&adapt[i]);
+
+        sum = _mm_add_epi32(sum, _mm_madd_epi16(c, h));
+        c = _mm_add_epi16(c, _mm_mullo_epi16(a, m));
+        _mm_storeu_si128((__m128i *)&coeffs[i], c);
+    }
+
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum);
+}
+
+__attribute__((target("avx2")))
+static int32_t apeScalarProductAVX2(int16_t *coeffs, const int16_t *history,
+        const int16_t *adapt, int order, int mul) {
+    const __m256i m = _mm256_set1_epi16(mul);
+    __m256i sum = _mm256_setzero_si256();
+
+    for (int i = 0; i < order; i += 16) {
+        __m256i c = _mm256_loadu_si256((const __m256i *)&coeffs[i]);
+        __m256i h = _mm256_loadu_si256((const __m256i *)&history[i]);
+        __m256i a = _mm256_loadu_si256((const __m256i *)&adapt[i]);
+
+        sum = _mm256_add_epi32(sum, _mm256_madd_epi16(c, h));
+        c = _mm256_add_epi16(c, _mm256_mullo_epi16(a, m));
+        _mm256_storeu_si256((__m256i *)&coeffs[i], c);
+    }
+
+    __m128i sum128 = _mm_add_epi32(_mm256_castsi256_si128(sum),
+                                   _mm256_extracti128_si256(sum, 1));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(1, 0, 3, 2)));
+    sum128 = _mm_add_epi32(sum128, _mm_shuffle_epi32(sum128, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(sum128);
+}
+
+#endif
+
+#ifdef APE_DSP_NEON
+
+static int32_t apeScalarProductNEON(int16_t *coeffs, const int16_t *history,
+        const int16_t *adapt, int order, int mul) {
+    const int16x8_t m = vdupq_n_s16(mul);
+    int32x4_t sum0 = vdupq_n_s32(0);
+    int32x4_t sum1 = vdupq_n_s32(0);
+
+    for (int i = 0; i < order; i += 8) {
+        int16x8_t c = vld1q_s16(&coeffs[i]);
+        int16x8_t h = vld1q_s16(&history[i]);
+        int16x8_t a = vld1q_s16(&adapt[i]);
+
+        sum0 = vmlal_s16(sum0, vget_low_s16(c), vget_low_s16(h));
+        sum1 = vmlal_s16(sum1, vget_high_s16(c), vget_high_s16(h));
+        vst1q_s16(&coeffs[i], vmlaq_s16(c, a, m));
+    }
+
+    int32x4_t sum = vaddq_s32(sum0, sum1);
+    int32x2_t half = vadd_s32(vget_low_s32(sum), vget_high_s32(sum));
+    return vget_lane_s32(vpadd_s32(half, half), 0);
+}
+
+#endif
+
+#define APE_DSP_MAX_VARIANTS 4
+
+static ApeScalarProductFunc gScalarProduct = NULL;
+static const char *gScalarProductName = NULL;
+
+//Supported variants, fastest first.
+static ApeScalarProductFunc gVariants[APE_DSP_MAX_VARIANTS];
+static const char *gVariantNames[APE_DSP_MAX_VARIANTS];
+static size_t gVariantCount = 0;
+
+static void addVariant(ApeScalarProductFunc func, const char *name) {
+    gVariants[gVariantCount] = func;
+    gVariantNames[gVariantCount] = name;
+    gVariantCount++;
+}
+
+static void selectScalarProductFunc() {
+#if defined(APE_DSP_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        addVariant(apeScalarProductAVX2, "avx2");
+    }
+    if (__builtin_cpu_supports("sse2")) {
+        addVariant(apeScalarProductSSE2, "sse2");
+    }
+#elif defined(APE_DSP_NEON)
+    //NEON builds only run on CPUs that have it.
+    addVariant(apeScalarProductNEON, "neon");
+#endif
+    addVariant(apeScalarProductC, "c");
+
+    char value[PROPERTY_VALUE_MAX];
+    bool simd = !(property_get("media.ape.decoder.simd", value, NULL) > 0
+                  && !strcmp(value, "0"));
+    size_t index = simd ? 0 : gVariantCount - 1;
+
+    gScalarProductName = gVariantNames[index];
+    gScalarProduct = gVariants[index];
+}
+
+static void initScalarProductFuncs() {
+    static pthread_once_t once = PTHREAD_ONCE_INIT;
+    pthread_once(&once, selectScalarProductFunc);
+}
+
+ApeScalarProductFunc apeGetScalarProductFunc() {
+    initScalarProductFuncs();
+    ALOGV("Using the %s NN filter", gScalarProductName);
+    return gScalarProduct;
+}
+
+ApeScalarProductFunc apeGetScalarProductVariant(size_t index, const char **name) {
+    initScalarProductFuncs();
+    if (index >= gVariantCount) {
+        return NULL;
+    }
+    if (name != NULL) {
+        *name = gVariantNames[index];
+    }
+    return gVariants[index];
+}
+
+const char *apeGetScalarProductName() {
+    apeGetScalarProductFunc();
+    return gScalarProductName;
+}
+
+}  // namespace android
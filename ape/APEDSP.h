@@ -0,0 +1,58 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_DSP_H_
+
+#define APE_DSP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+//Core of the NN filter: returns the dot product of coeffs and history, and
+//adds mul (-1, 0 or 1) times adapt to coeffs. order is a multiple of 16.
+//All variants wrap exactly like the scalar one, so their output is identical.
+typedef int32_t (*ApeScalarProductFunc)(int16_t *coeffs, const int16_t *history,
+        const int16_t *adapt, int order, int mul);
+
+int32_t apeScalarProductC(int16_t *coeffs, const int16_t *history,
+        const int16_t *adapt, int order, int mul);
+
+//Returns the fastest variant the CPU supports. Setting media.ape.decoder.simd
+//to 0 forces the scalar one.
+ApeScalarProductFunc apeGetScalarProductFunc();
+
+//Name of the variant returned by apeGetScalarProductFunc(), for logging.
+const char *apeGetScalarProductName();
+
+//The index-th of the variants the CPU supports, fastest first and the
+//scalar one last, whatever media.ape.decoder.simd says; NULL past them.
+//For checking the variants against each other.
+ApeScalarProductFunc apeGetScalarProductVariant(size_t index, const char **name);
+
+}  // namespace android
+
+#endif  // APE_DSP_H_
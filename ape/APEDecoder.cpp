@@ -0,0 +1,1471 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "APEDecoder"
+#include <utils/Log.h>
+
+#include "APEDecoder.h"
+#include "APEExtractor.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaBufferGroup.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+//3800 to 3809 need the per-frame bit offsets of the bit table, which the
+//extractor does not load; those are left to FFmpeg.
+#define APE_MIN_NATIVE_VERSION 3810
+#define APE_MAX_NATIVE_VERSION 3990
+
+#define APE_FRAMECODE_MONO_SILENCE      1
+#define APE_FRAMECODE_STEREO_SILENCE    3
+#define APE_FRAMECODE_PSEUDO_STEREO     4
+
+//Offsets into the predictor history of the delayed values and adaption
+//signs of the Y (first) and X (second) channel.
+#define PREDICTOR_ORDER 8
+#define YDELAYA         (18 + PREDICTOR_ORDER * 4)
+#define YDELAYB         (18 + PREDICTOR_ORDER * 3)
+#define XDELAYA         (18 + PREDICTOR_ORDER * 2)
+#define XDELAYB         (18 + PREDICTOR_ORDER)
+#define YADAPTCOEFFSA   18
+#define XADAPTCOEFFSA   14
+#define YADAPTCOEFFSB   10
+#define XADAPTCOEFFSB   5
+
+//Range coder, 32-bit code values with 7 extra bits in the first byte.
+#define CODE_BITS       32
+#define TOP_VALUE       ((uint32_t)1 << (CODE_BITS - 1))
+#define EXTRA_BITS      ((CODE_BITS - 2) % 8 + 1)
+#define BOTTOM_VALUE    (TOP_VALUE >> 8)
+
+#define MODEL_ELEMENTS  64
+
+namespace android {
+
+//NN filter orders and fraction bits per compression level, fast to insane.
+static const uint16_t kFilterOrders[5][APE_FILTER_LEVELS] = {
+    {  0,   0,    0 },
+    { 16,   0,    0 },
+    { 64,   0,    0 },
+    { 32, 256,    0 },
+    { 16, 256, 1024 },
+};
+
+static const uint8_t kFilterFracBits[5][APE_FILTER_LEVELS] = {
+    {  0,  0,  0 },
+    { 11,  0,  0 },
+    { 11,  0,  0 },
+    { 10, 13,  0 },
+    { 11, 13, 15 },
+};
+
+//Cumulative frequencies of the overflow symbol, before and from version 3990.
+static const uint16_t kCounts3970[22] = {
+        0, 14824, 28224, 39348, 47855, 53994, 58171, 60926,
+    62682, 63786, 64463, 64878, 65126, 65276, 65365, 65419,
+    65450, 65469, 65480, 65487, 65491, 65493,
+};
+
+static const uint16_t kCountsDiff3970[21] = {
+    14824, 13400, 11124, 8507, 6139, 4177, 2755, 1756,
+     1104,   677,   415,  248,  150,   89,   54,   31,
+       19,    11,     7,    4,    2,
+};
+
+static const uint16_t kCounts3980[22] = {
+        0, 19578, 36160, 48417, 56323, 60899, 63265, 64435,
+    64971, 65232, 65351, 65416, 65447, 65466, 65476, 65482,
+    65485, 65488, 65490, 65491, 65492, 65493,
+};
+
+static const uint16_t kCountsDiff3980[21] = {
+    19578, 16582, 12257, 7906, 4576, 2366, 1170, 536,
+      261,   119,    65,   31,   19,   10,    6,   3,
+        3,     2,     1,    1,    1,
+};
+
+static const int32_t kInitialCoeffsFast3320[1] = { 375 };
+static const int32_t kInitialCoeffsA3800[3] = { 64, 115, 64 };
+static const int32_t kInitialCoeffsB3800[2] = { 740, 0 };
+static const int32_t kInitialCoeffs3930[4] = { 360, 317, -109, 98 };
+
+//CRC-32 (IEEE, reflected) four bits at a time.
+static const uint32_t kCRCTable[16] = {
+    0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+    0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+    0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+    0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+};
+
+static inline uint32_t updateCRC(uint32_t crc, uint8_t byte) {
+    crc = (crc >> 4) ^ kCRCTable[(crc ^ byte) & 0xf];
+    return (crc >> 4) ^ kCRCTable[(crc ^ (byte >> 4)) & 0xf];
+}
+
+//Note the inverted sign, the adaption runs against the error.
+static inline int32_t apeSign(int32_t x) {
+    return (x < 0) - (x > 0);
+}
+
+static inline int16_t clip16(int32_t x) {
+    if (x > 32767) {
+        return 32767;
+    } else if (x < -32768) {
+        return -32768;
+    }
+    return x;
+}
+
+static inline uint32_t readBE32(const uint8_t *ptr) {
+    return ((uint32_t)ptr[0] << 24) | (ptr[1] << 16) | (ptr[2] << 8) | ptr[3];
+}
+
+//Index of the highest bit set, 0 for 0.
+static inline int log2Floor(uint32_t x) {
+    return x ? 31 - __builtin_clz(x) : 0;
+}
+
+APEDecoder::APEDecoder(const sp<MediaSource> &source)
+        :mSource(source),
+         mMeta(new MetaData),
+         mGroup(NULL),
+         mStarted(false),
+         mVersion(0),
+         mCompressionLevel(0),
+         mChannels(0),
+         mBitsPerSample(0),
+         mSampleRate(0),
+         mOutputBytes(0),
+         mFilterSet(0),
+         mScalarProduct(NULL),
+         mData(NULL),
+         mDataSize(0),
+         mPtr(NULL),
+         mDataEnd(NULL),
+         mBitPos(0),
+         mError(false),
+         mCRC(0),
+         mCRCState(0),
+         mFrameFlags(0),
+         mSamples(0),
+         mFramePosition(0),
+         mFrameTimeUs(0),
+         mSkipSamples(0),
+         mFrameEnd(0),
+         mDecodedSize(0),
+         mDecodedPos(0),
+         mDecodedCount(0),
+         mInitCheck(NO_INIT) {
+    memset(mFilterBuf, 0, sizeof(mFilterBuf));
+    mDecoded[0] = mDecoded[1] = NULL;
+
+    sp<MetaData> meta = source->getFormat();
+    uint32_t type;
+    const void *data;
+    size_t size;
+    if (!meta->findInt32(kKeyChannelCount, &mChannels)
+            || !meta->findInt32(kKeySampleRate, &mSampleRate)
+            || !meta->findInt32(kKeyBitsPerSample, &mBitsPerSample)
+            || !meta->findData(kFfmpegCodecSpecificData, &type, &data, &size) || size < 6) {
+        LOGE("Source is not an APE track");
+        return;
+    }
+
+    //Version, compression type and format flags, see APEExtractor.
+    const uint16_t *extradata = (const uint16_t *)data;
+    mVersion = extradata[0];
+    mCompressionLevel = extradata[1];
+
+    if (mVersion < APE_MIN_NATIVE_VERSION || mVersion > APE_MAX_NATIVE_VERSION) {
+        LOGE("Native decoding of version %u is not supported", mVersion);
+        mInitCheck = ERROR_UNSUPPORTED;
+        return;
+    }
+    if (mCompressionLevel == 0 || mCompressionLevel % 1000 || mCompressionLevel > 5000
+            || (mVersion < 3930 && mCompressionLevel == 5000)) {
+        LOGE("Unsupported compression level %u", mCompressionLevel);
+        mInitCheck = ERROR_UNSUPPORTED;
+        return;
+    }
+    if (mChannels < 1 || mChannels > 2 || mSampleRate <= 0
+            || (mBitsPerSample != 8 && mBitsPerSample != 16 && mBitsPerSample != 24)) {
+        LOGE("Unsupported format, %d channels of %d bits", mChannels, mBitsPerSample);
+        mInitCheck = ERROR_UNSUPPORTED;
+        return;
+    }
+    mFilterSet = mCompressionLevel / 1000 - 1;
+    //8-bit samples are widened to 16, 24-bit ones kept at full width.
+    mOutputBytes = mBitsPerSample == 24 ? 3 : 2;
+
+    for (int i = 0; i < 2; i++) {
+        mDecoded[i] = (int32_t *)malloc(APE_BLOCKS_PER_LOOP * sizeof(int32_t));
+        if (!mDecoded[i]) {
+            LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+            mInitCheck = NO_MEMORY;
+            return;
+        }
+    }
+    mDecodedSize = APE_BLOCKS_PER_LOOP;
+    for (int i = 0; i < APE_FILTER_LEVELS; i++) {
+        int order = getFilterOrder(i);
+        if (!order) {
+            break;
+        }
+        //Coefficients and history of both channels.
+        mFilterBuf[i] = (int16_t *)malloc((order * 3 + APE_HISTORY_SIZE) * 2 * sizeof(int16_t));
+        if (!mFilterBuf[i]) {
+            LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+            mInitCheck = NO_MEMORY;
+            return;
+        }
+    }
+
+    mScalarProduct = apeGetScalarProductFunc();
+
+    int64_t durationUs;
+    mMeta->setCString(kKeyMIMEType, MEDIA_MIMETYPE_AUDIO_RAW);
+    mMeta->setInt32(kKeyChannelCount, mChannels);
+    mMeta->setInt32(kKeySampleRate, mSampleRate);
+    mMeta->setInt32(kKeyBitsPerSample, mOutputBytes * 8);
+    if (meta->findInt64(kKeyDuration, &durationUs)) {
+        mMeta->setInt64(kKeyDuration, durationUs);
+    }
+
+    ALOGV("Native decoder for version %u, level %u, %s NN filter",
+            mVersion, mCompressionLevel, apeGetScalarProductName());
+
+    mInitCheck = OK;
+}
+
+APEDecoder::~APEDecoder() {
+    stop();
+
+    free(mData);
+    for (int i = 0; i < APE_FILTER_LEVELS; i++) {
+        free(mFilterBuf[i]);
+    }
+    free(mDecoded[0]);
+    free(mDecoded[1]);
+}
+
+status_t APEDecoder::initCheck() const {
+    return mInitCheck;
+}
+
+status_t APEDecoder::start(MetaData *params) {
+    if (mInitCheck != OK) {
+        return mInitCheck;
+    }
+    if (mStarted) {
+        return OK;
+    }
+
+    //Frames are always taken one per buffer, so multi-frame reads are not passed on.
+    sp<MetaData> sourceparams = new MetaData;
+    int32_t value;
+    if (params != NULL) {
+        if (params->findInt32(kKeyApePrefetchFrames, &value)) {
+            sourceparams->setInt32(kKeyApePrefetchFrames, value);
+        }
+        if (params->findInt32(kKeyApeReadBudget, &value)) {
+            sourceparams->setInt32(kKeyApeReadBudget, value);
+        }
+        if (params->findInt32(kKeyApeZeroCopy, &value)) {
+            sourceparams->setInt32(kKeyApeZeroCopy, value);
+        }
+    }
+
+    status_t err = mSource->start(sourceparams.get());
+    if (err != OK) {
+        return err;
+    }
+
+    mGroup = new MediaBufferGroup;
+    mGroup->add_buffer(new MediaBuffer(APE_BLOCKS_PER_LOOP * mChannels * mOutputBytes));
+
+    mSamples = 0;
+    mSkipSamples = 0;
+    mDecodedPos = mDecodedCount = 0;
+    mStarted = true;
+
+    return OK;
+}
+
+status_t APEDecoder::stop() {
+    if (!mStarted) {
+        return OK;
+    }
+
+    delete mGroup;
+    mGroup = NULL;
+
+    mStarted = false;
+    return mSource->stop();
+}
+
+sp<MetaData> APEDecoder::getFormat() {
+    return mMeta;
+}
+
+status_t APEDecoder::read(
+        MediaBuffer **out, const ReadOptions *options) {
+    *out = NULL;
+    status_t err;
+    int64_t seekTimeUs;
+    ReadOptions::SeekMode mode;
+
+    if (options != NULL && options->getSeekTo(&seekTimeUs, &mode)) {
+        //The rest of the current frame is dropped, the source picks the frame.
+        err = readFrame(options);
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    for (;;) {
+        if (mDecodedPos == mDecodedCount) {
+            err = decodeNextBlocks();
+            if (err != OK) {
+                return err;
+            }
+        }
+
+        //Whole frames are handed out a loop at a time.
+        uint32_t count = mDecodedCount - mDecodedPos;
+        if (count > APE_BLOCKS_PER_LOOP) {
+            count = APE_BLOCKS_PER_LOOP;
+        }
+        const uint32_t first = mDecodedPos;
+        const uint32_t position = mFramePosition;
+        mDecodedPos += count;
+        mFramePosition += count;
+
+        uint32_t skip = mSkipSamples < count ? mSkipSamples : count;
+        mSkipSamples -= skip;
+        uint32_t end = count;
+        if (position + end > mFrameEnd) {
+            end = mFrameEnd > position ? mFrameEnd - position : 0;
+        }
+        if (skip >= end) {
+            continue;
+        }
+
+        MediaBuffer *buffer;
+        err = mGroup->acquire_buffer(&buffer);
+        if (err != OK) {
+            return err;
+        }
+
+        if (mOutputBytes == 3) {
+            uint8_t *pcm = (uint8_t *)buffer->data();
+            for (uint32_t i = first + skip; i < first + end; i++) {
+                for (int ch = 0; ch < mChannels; ch++) {
+                    int32_t sample = mDecoded[ch][i];
+                    pcm[0] = sample;
+                    pcm[1] = sample >> 8;
+                    pcm[2] = sample >> 16;
+                    pcm += 3;
+                }
+            }
+        } else {
+            int16_t *pcm = (int16_t *)buffer->data();
+            const int shift = 16 - mBitsPerSample;
+            for (uint32_t i = first + skip; i < first + end; i++) {
+                for (int ch = 0; ch < mChannels; ch++) {
+                    *pcm++ = mDecoded[ch][i] << shift;
+                }
+            }
+        }
+
+        buffer->set_range(0, (end - skip) * mChannels * mOutputBytes);
+        buffer->meta_data()->setInt64(kKeyTime,
+                mFrameTimeUs + (int64_t)(position + skip) * 1000000 / mSampleRate);
+
+        *out = buffer;
+        return OK;
+    }
+}
+
+//Decodes the next blocks of the frame, reading a new one when it is done.
+status_t APEDecoder::decodeNextBlocks() {
+    if (mSamples == 0) {
+        status_t err = readFrame(NULL);
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    //The frame is decoded at once: before 3930 each channel is stored
+    //whole, one after the other, and the CRC has to match before any of
+    //the blocks are handed out.
+    uint32_t count = mSamples;
+    decodeBlocks(count);
+    if (mError) {
+        LOGE("Corrupt frame at %lld us", (long long)mFrameTimeUs);
+        mSamples = 0;
+        return ERROR_MALFORMED;
+    }
+    mSamples -= count;
+    mDecodedPos = 0;
+    mDecodedCount = count;
+
+    //The frame CRC covers the samples as stored, in little-endian bytes.
+    //Files before 3900 compute it differently, it is not checked for them.
+    if (mVersion < 3900) {
+        return OK;
+    }
+    uint32_t crc = mCRCState;
+    const int bytes = mBitsPerSample / 8;
+    for (uint32_t i = 0; i < count; i++) {
+        for (int ch = 0; ch < mChannels; ch++) {
+            int32_t sample = mDecoded[ch][i];
+            if (bytes == 1) {
+                crc = updateCRC(crc, sample + 0x80);
+            } else {
+                for (int b = 0; b < bytes; b++) {
+                    crc = updateCRC(crc, sample >> (b * 8));
+                }
+            }
+        }
+    }
+    mCRCState = crc;
+    if (mSamples == 0 && ((~crc >> 1) ^ mCRC)) {
+        //The frame is dropped, as a corrupt one is.
+        LOGE("CRC mismatch in frame at %lld us", (long long)mFrameTimeUs);
+        mDecodedCount = 0;
+        return ERROR_MALFORMED;
+    }
+    return OK;
+}
+
+status_t APEDecoder::readFrame(const ReadOptions *options) {
+    MediaBuffer *in;
+
+    mSamples = 0;
+    mDecodedPos = mDecodedCount = 0;
+    status_t err = mSource->read(&in, options);
+    if (err != OK) {
+        return err;
+    }
+
+    const uint8_t *data = (const uint8_t *)in->data() + in->range_offset();
+    size_t size = in->range_length();
+    int32_t nblocks, skip;
+    if (!in->meta_data()->findInt32(kKeyApeFrameBlocks, &nblocks)
+            || !in->meta_data()->findInt32(kKeyApeFrameSkip, &skip)) {
+        //Regular buffers carry block num and skip in an 8-byte prefix.
+        if (size < 8) {
+            in->release();
+            return ERROR_MALFORMED;
+        }
+        uint32_t prefix[2];
+        memcpy(prefix, data, sizeof(prefix));
+        nblocks = prefix[0];
+        skip = prefix[1];
+        data += 8;
+        size -= 8;
+    }
+
+    int32_t skipsamples = 0;
+    int32_t trimsamples = 0;
+    in->meta_data()->findInt32(kKeyApeSkipSamples, &skipsamples);
+    in->meta_data()->findInt32(kKeyApeTrimSamples, &trimsamples);
+    if (!in->meta_data()->findInt64(kKeyTime, &mFrameTimeUs)) {
+        mFrameTimeUs = 0;
+    }
+
+    //The bitstream is made of 32-bit little-endian words, read most
+    //significant byte first. Decoders before 3950 read two bytes past the
+    //frame, they are zero.
+    size &= ~3;
+    const size_t overread = mVersion < 3950 ? 2 : 0;
+    if (size + overread > mDataSize) {
+        uint8_t *buffer = (uint8_t *)realloc(mData, size + overread);
+        if (!buffer) {
+            in->release();
+            LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+            return NO_MEMORY;
+        }
+        mData = buffer;
+        mDataSize = size + overread;
+    }
+    for (size_t i = 0; i < size; i += 4) {
+        mData[i] = data[i + 3];
+        mData[i + 1] = data[i + 2];
+        mData[i + 2] = data[i + 1];
+        mData[i + 3] = data[i];
+    }
+    memset(mData + size, 0, overread);
+    in->release();
+
+    if (nblocks <= 0 || skip < 0 || skip > 3 || (size_t)skip >= size) {
+        LOGE("Invalid frame, %d blocks, skip %d, %zu bytes", nblocks, skip, size);
+        return ERROR_MALFORMED;
+    }
+
+    if ((uint32_t)nblocks > mDecodedSize) {
+        for (int i = 0; i < 2; i++) {
+            int32_t *decoded = (int32_t *)realloc(mDecoded[i], nblocks * sizeof(int32_t));
+            if (!decoded) {
+                LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+                return NO_MEMORY;
+            }
+            mDecoded[i] = decoded;
+        }
+        mDecodedSize = nblocks;
+    }
+
+    mPtr = mData + skip;
+    mDataEnd = mData + size + overread;
+    mError = false;
+    mFramePosition = 0;
+    mSkipSamples = skipsamples > 0 ? skipsamples : 0;
+
+    err = initFrameDecoder();
+    if (err != OK) {
+        return err;
+    }
+
+    mSamples = nblocks;
+    mFrameEnd = trimsamples > 0 && trimsamples < nblocks ? nblocks - trimsamples : nblocks;
+    return OK;
+}
+
+status_t APEDecoder::initFrameDecoder() {
+    //Before 3900 the whole frame is a bit stream, the words after the CRC
+    //and frame flags are range coded from then on.
+    if (mVersion < 3900) {
+        mBitPos = (mPtr - mData) * 8;
+        mCRC = getBits(32);
+    } else {
+        if (mDataEnd - mPtr < 6) {
+            return ERROR_MALFORMED;
+        }
+        mCRC = readBE32(mPtr);
+        mPtr += 4;
+    }
+
+    //The top bit of the CRC says that frame flags follow.
+    mFrameFlags = 0;
+    mCRCState = 0xffffffff;
+    if (mVersion > 3820 && (mCRC & 0x80000000)) {
+        mCRC &= ~0x80000000;
+        if (mVersion < 3900) {
+            mFrameFlags = getBits(32);
+        } else {
+            if (mDataEnd - mPtr < 6) {
+                return ERROR_MALFORMED;
+            }
+            mFrameFlags = readBE32(mPtr);
+            mPtr += 4;
+        }
+    }
+    if (mError) {
+        return ERROR_MALFORMED;
+    }
+
+    mRiceX.k = 10;
+    mRiceX.ksum = (1 << mRiceX.k) * 16;
+    mRiceY.k = 10;
+    mRiceY.ksum = (1 << mRiceY.k) * 16;
+
+    //The first byte of the range coder output carries no data.
+    if (mVersion >= 3900) {
+        mPtr++;
+        rangeStartDecoding();
+    }
+
+    initPredictor();
+
+    for (int i = 0; i < APE_FILTER_LEVELS; i++) {
+        int order = getFilterOrder(i);
+        if (!order) {
+            break;
+        }
+        initFilter(&mFilters[i][0], mFilterBuf[i], order);
+        initFilter(&mFilters[i][1], mFilterBuf[i] + order * 3 + APE_HISTORY_SIZE, order);
+    }
+
+    return OK;
+}
+
+void APEDecoder::decodeBlocks(uint32_t count) {
+    int32_t *decoded0 = mDecoded[0];
+    int32_t *decoded1 = mDecoded[1];
+
+    memset(decoded0, 0, count * sizeof(int32_t));
+    memset(decoded1, 0, count * sizeof(int32_t));
+
+    if (mChannels == 1 || (mFrameFlags & APE_FRAMECODE_PSEUDO_STEREO)) {
+        if (mFrameFlags & APE_FRAMECODE_STEREO_SILENCE) {
+            return;
+        }
+
+        entropyDecode(count, false);
+        if (mVersion < 3930) {
+            predictorDecodeMono3800(count);
+        } else if (mVersion < 3950) {
+            predictorDecodeMono3930(count);
+        } else {
+            predictorDecodeMono(count);
+        }
+
+        if (mChannels == 2) {
+            memcpy(decoded1, decoded0, count * sizeof(int32_t));
+        }
+        return;
+    }
+
+    if ((mFrameFlags & APE_FRAMECODE_STEREO_SILENCE) == APE_FRAMECODE_STEREO_SILENCE) {
+        return;
+    }
+
+    entropyDecode(count, true);
+    if (mVersion < 3930) {
+        predictorDecodeStereo3800(count);
+    } else if (mVersion < 3950) {
+        predictorDecodeStereo3930(count);
+    } else {
+        predictorDecodeStereo(count);
+    }
+
+    //Y holds the difference and X the mid channel.
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t left = decoded1[i] - (decoded0[i] / 2);
+        int32_t right = left + decoded0[i];
+        decoded0[i] = left;
+        decoded1[i] = right;
+    }
+}
+
+//Bit reader of frames before 3900, most significant bit first. Reads past
+//the frame return zeros and flag the frame as corrupt.
+uint32_t APEDecoder::getBits(int n) {
+    const size_t end = (mDataEnd - mData) * 8;
+    if (n == 0) {
+        return 0;
+    }
+    if (mBitPos + n > end) {
+        mBitPos = end;
+        mError = true;
+        return 0;
+    }
+
+    size_t byte = mBitPos >> 3;
+    uint64_t window = 0;
+    for (int i = 0; i < 8; i++) {
+        window <<= 8;
+        if (byte + i < end / 8) {
+            window |= mData[byte + i];
+        }
+    }
+    mBitPos += n;
+    return (uint32_t)((window << ((mBitPos - n) & 7)) >> (64 - n));
+}
+
+//Zero bits up to the next one bit, which is dropped.
+uint32_t APEDecoder::getUnary() {
+    const size_t end = (mDataEnd - mData) * 8;
+    uint32_t count = 0;
+    while (mBitPos < end) {
+        if ((mBitPos & 7) == 0 && mData[mBitPos >> 3] == 0) {
+            mBitPos += 8;
+            count += 8;
+            continue;
+        }
+        bool bit = mData[mBitPos >> 3] & (0x80 >> (mBitPos & 7));
+        mBitPos++;
+        if (bit) {
+            return count;
+        }
+        count++;
+    }
+    mError = true;
+    return count;
+}
+
+void APEDecoder::rangeStartDecoding() {
+    mRangeCoder.buffer = *mPtr++;
+    mRangeCoder.low = mRangeCoder.buffer >> (8 - EXTRA_BITS);
+    mRangeCoder.range = (uint32_t)1 << EXTRA_BITS;
+    mRangeCoder.help = 0;
+}
+
+void APEDecoder::rangeNormalize() {
+    while (mRangeCoder.range <= BOTTOM_VALUE) {
+        mRangeCoder.buffer <<= 8;
+        if (mPtr < mDataEnd) {
+            mRangeCoder.buffer += *mPtr++;
+        } else {
+            mError = true;
+        }
+        mRangeCoder.low = (mRangeCoder.low << 8) | ((mRangeCoder.buffer >> 1) & 0xff);
+        mRangeCoder.range <<= 8;
+    }
+}
+
+uint32_t APEDecoder::rangeDecodeCulFreq(uint32_t totf) {
+    rangeNormalize();
+    mRangeCoder.help = mRangeCoder.range / totf;
+    return mRangeCoder.low / mRangeCoder.help;
+}
+
+uint32_t APEDecoder::rangeDecodeCulShift(int shift) {
+    rangeNormalize();
+    mRangeCoder.help = mRangeCoder.range >> shift;
+    return mRangeCoder.low / mRangeCoder.help;
+}
+
+void APEDecoder::rangeDecodeUpdate(uint32_t syf, uint32_t ltf) {
+    mRangeCoder.low -= mRangeCoder.help * ltf;
+    mRangeCoder.range = mRangeCoder.help * syf;
+}
+
+uint32_t APEDecoder::rangeDecodeBits(int n) {
+    uint32_t sym = rangeDecodeCulShift(n);
+    rangeDecodeUpdate(1, sym);
+    return sym;
+}
+
+uint32_t APEDecoder::rangeGetSymbol(const uint16_t *counts, const uint16_t *countsdiff) {
+    uint32_t cf = rangeDecodeCulShift(16);
+
+    //Symbols past the table have a frequency of one each.
+    if (cf > 65492) {
+        rangeDecodeUpdate(1, cf);
+        if (cf > 65535) {
+            mError = true;
+        }
+        return cf - 65535 + 63;
+    }
+
+    uint32_t symbol = 0;
+    while (counts[symbol + 1] <= cf) {
+        symbol++;
+    }
+    rangeDecodeUpdate(countsdiff[symbol], counts[symbol]);
+    return symbol;
+}
+
+static inline void updateRice(ApeRice *rice, uint32_t x) {
+    uint32_t lim = rice->k ? (1u << (rice->k + 4)) : 0;
+    rice->ksum += ((x + 1) / 2) - ((rice->ksum + 16) >> 5);
+
+    if (rice->ksum < lim) {
+        rice->k--;
+    } else if (rice->ksum >= (1u << (rice->k + 5)) && rice->k < 24) {
+        rice->k++;
+    }
+}
+
+int32_t APEDecoder::decodeValue3900(ApeRice *rice) {
+    uint32_t x;
+    uint32_t overflow = rangeGetSymbol(kCounts3970, kCountsDiff3970);
+    int tmpk;
+
+    if (overflow == MODEL_ELEMENTS - 1) {
+        tmpk = rangeDecodeBits(5);
+        overflow = 0;
+    } else {
+        tmpk = rice->k < 1 ? 0 : rice->k - 1;
+    }
+
+    if (mVersion < 3910) {
+        if (tmpk > 23) {
+            mError = true;
+            return 0;
+        }
+        x = rangeDecodeBits(tmpk);
+    } else if (tmpk <= 16) {
+        x = rangeDecodeBits(tmpk);
+    } else if (tmpk <= 31) {
+        x = rangeDecodeBits(16);
+        x |= rangeDecodeBits(tmpk - 16) << 16;
+    } else {
+        mError = true;
+        return 0;
+    }
+    x += overflow << tmpk;
+
+    updateRice(rice, x);
+
+    //Odd values are positive, even ones zero or negative.
+    return ((x >> 1) ^ ((x & 1) - 1)) + 1;
+}
+
+int32_t APEDecoder::decodeValue3990(ApeRice *rice) {
+    uint32_t x, base;
+    uint32_t pivot = rice->ksum >> 5;
+    if (pivot == 0) {
+        pivot = 1;
+    }
+
+    uint32_t overflow = rangeGetSymbol(kCounts3980, kCountsDiff3980);
+    if (overflow == MODEL_ELEMENTS - 1) {
+        overflow = rangeDecodeBits(16) << 16;
+        overflow |= rangeDecodeBits(16);
+    }
+
+    if (pivot < 0x10000) {
+        base = rangeDecodeCulFreq(pivot);
+        rangeDecodeUpdate(1, base);
+    } else {
+        uint32_t basehi = pivot, baselo;
+        int bbits = 0;
+
+        while (basehi & ~0xffff) {
+            basehi >>= 1;
+            bbits++;
+        }
+        basehi = rangeDecodeCulFreq(basehi + 1);
+        rangeDecodeUpdate(1, basehi);
+        baselo = rangeDecodeCulFreq(1 << bbits);
+        rangeDecodeUpdate(1, baselo);
+
+        base = (basehi << bbits) + baselo;
+    }
+
+    x = base + overflow * pivot;
+
+    updateRice(rice, x);
+
+    return ((x >> 1) ^ ((x & 1) - 1)) + 1;
+}
+
+//Rice codes of 3860 to 3899, an adaptive k and the overflow in unary.
+int32_t APEDecoder::decodeValue3860(ApeRice *rice) {
+    uint32_t x;
+    uint32_t overflow = getUnary();
+
+    if (mVersion > 3880) {
+        while (overflow >= 16) {
+            overflow -= 16;
+            rice->k += 4;
+        }
+    }
+
+    if (rice->k == 0) {
+        x = overflow;
+    } else if (rice->k <= 25) {
+        x = (overflow << rice->k) + getBits(rice->k);
+    } else {
+        mError = true;
+        return 0;
+    }
+
+    rice->ksum += x - ((rice->ksum + 8) >> 4);
+    if (rice->ksum < (rice->k ? 1u << (rice->k + 4) : 0)) {
+        rice->k--;
+    } else if (rice->ksum >= (1u << (rice->k + 5)) && rice->k < 24) {
+        rice->k++;
+    }
+
+    return ((x >> 1) ^ ((x & 1) - 1)) + 1;
+}
+
+uint32_t APEDecoder::getRice(int k) {
+    uint32_t x = getUnary();
+    if (k) {
+        x = (x << k) | getBits(k);
+    }
+    return x;
+}
+
+//Rice codes before 3860. k follows the running sum of the last 64 values,
+//and comes from the mean of what there is for the first of them.
+void APEDecoder::decodeArray0000(int32_t *out, ApeRice *rice, uint32_t count) {
+    uint32_t i;
+
+    rice->ksum = 0;
+    for (i = 0; i < count && i < 5; i++) {
+        out[i] = getRice(10);
+        rice->ksum += out[i];
+    }
+
+    if (count > 5) {
+        rice->k = log2Floor(rice->ksum / 10) + 1;
+    }
+    for (; i < count && i < 64 && rice->k < 24; i++) {
+        out[i] = getRice(rice->k);
+        rice->ksum += out[i];
+        rice->k = log2Floor(rice->ksum / ((i + 1) * 2)) + 1;
+    }
+    if (rice->k >= 24) {
+        mError = true;
+        return;
+    }
+
+    uint32_t ksummax = 1u << (rice->k + 7);
+    uint32_t ksummin = rice->k ? 1u << (rice->k + 6) : 0;
+    for (; i < count && !mError; i++) {
+        out[i] = getRice(rice->k);
+        rice->ksum += out[i] - (uint32_t)out[i - 64];
+        while (rice->ksum < ksummin) {
+            rice->k--;
+            ksummin = rice->k ? ksummin >> 1 : 0;
+            ksummax >>= 1;
+        }
+        while (rice->ksum >= ksummax) {
+            if (++rice->k > 24) {
+                mError = true;
+                return;
+            }
+            ksummax <<= 1;
+            ksummin = ksummin ? ksummin << 1 : 128;
+        }
+    }
+    if (mError) {
+        return;
+    }
+
+    for (i = 0; i < count; i++) {
+        uint32_t x = out[i];
+        out[i] = ((x >> 1) ^ ((x & 1) - 1)) + 1;
+    }
+}
+
+void APEDecoder::entropyDecode(uint32_t count, bool stereo) {
+    int32_t *decoded0 = mDecoded[0];
+    int32_t *decoded1 = mDecoded[1];
+
+    //Channels are interleaved per block from version 3930 on, before that
+    //the whole frame of the first channel is followed by the second.
+    if (mVersion < 3860) {
+        decodeArray0000(decoded0, &mRiceY, count);
+        if (stereo) {
+            decodeArray0000(decoded1, &mRiceX, count);
+        }
+    } else if (mVersion < 3900) {
+        for (uint32_t i = 0; i < count; i++) {
+            decoded0[i] = decodeValue3860(&mRiceY);
+        }
+        for (uint32_t i = 0; stereo && i < count; i++) {
+            decoded1[i] = decodeValue3860(&mRiceX);
+        }
+    } else if (mVersion < 3930) {
+        for (uint32_t i = 0; i < count; i++) {
+            decoded0[i] = decodeValue3900(&mRiceY);
+        }
+        if (stereo) {
+            //The second channel is coded from a restart of the range
+            //coder, on the last byte the first one loaded.
+            rangeNormalize();
+            mPtr--;
+            rangeStartDecoding();
+            for (uint32_t i = 0; i < count; i++) {
+                decoded1[i] = decodeValue3900(&mRiceX);
+            }
+        }
+    } else if (mVersion >= 3990) {
+        for (uint32_t i = 0; i < count; i++) {
+            decoded0[i] = decodeValue3990(&mRiceY);
+            if (stereo) {
+                decoded1[i] = decodeValue3990(&mRiceX);
+            }
+        }
+    } else {
+        for (uint32_t i = 0; i < count; i++) {
+            decoded0[i] = decodeValue3900(&mRiceY);
+            if (stereo) {
+                decoded1[i] = decodeValue3900(&mRiceX);
+            }
+        }
+    }
+}
+
+void APEDecoder::initPredictor() {
+    ApePredictor *p = &mPredictor;
+
+    memset(p->historybuffer, 0, APE_PREDICTOR_SIZE * sizeof(*p->historybuffer));
+    p->buf = p->historybuffer;
+
+    memset(p->coeffsA, 0, sizeof(p->coeffsA));
+    memset(p->coeffsB, 0, sizeof(p->coeffsB));
+    for (int i = 0; i < 2; i++) {
+        if (mVersion >= 3930) {
+            for (int j = 0; j < 4; j++) {
+                p->coeffsA[i][j] = kInitialCoeffs3930[j];
+            }
+        } else if (mCompressionLevel == 1000) {
+            p->coeffsA[i][0] = kInitialCoeffsFast3320[0];
+        } else {
+            for (int j = 0; j < 3; j++) {
+                p->coeffsA[i][j] = kInitialCoeffsA3800[j];
+            }
+            for (int j = 0; j < 2; j++) {
+                p->coeffsB[i][j] = kInitialCoeffsB3800[j];
+            }
+        }
+    }
+
+    p->filterA[0] = p->filterA[1] = 0;
+    p->filterB[0] = p->filterB[1] = 0;
+    p->lastA[0] = p->lastA[1] = 0;
+    p->samplepos = 0;
+}
+
+//Moves the predictor on by one block.
+void APEDecoder::advancePredictor() {
+    ApePredictor *p = &mPredictor;
+
+    p->buf++;
+    p->samplepos++;
+    if (p->buf == p->historybuffer + APE_HISTORY_SIZE) {
+        memmove(p->historybuffer, p->buf, APE_PREDICTOR_SIZE * sizeof(*p->historybuffer));
+        p->buf = p->historybuffer;
+    }
+}
+
+//First-order predictor of the fast level before 3930.
+int32_t APEDecoder::predictorFast3320(int32_t decoded, int filter, int delayA) {
+    ApePredictor *p = &mPredictor;
+    int32_t predictionA;
+
+    p->buf[delayA] = p->lastA[filter];
+    if (p->samplepos < 3) {
+        p->lastA[filter] = decoded;
+        p->filterA[filter] = decoded;
+        return decoded;
+    }
+
+    predictionA = p->buf[delayA] * 2u - p->buf[delayA - 1];
+    p->lastA[filter] = decoded + (uint32_t)((int32_t)(predictionA * p->coeffsA[filter][0]) >> 9);
+
+    if ((decoded ^ predictionA) > 0) {
+        p->coeffsA[filter][0]++;
+    } else {
+        p->coeffsA[filter][0]--;
+    }
+
+    p->filterA[filter] += (uint32_t)p->lastA[filter];
+    return p->filterA[filter];
+}
+
+//Predictor of the higher levels before 3930, the first start blocks of a
+//frame only seed it.
+int32_t APEDecoder::predictor3800(int32_t decoded, int filter,
+        int delayA, int delayB, uint32_t start, int shift) {
+    ApePredictor *p = &mPredictor;
+    int32_t predictionA, predictionB, sign;
+    int32_t d0, d1, d2, d3, d4;
+
+    p->buf[delayA] = p->lastA[filter];
+    p->buf[delayB] = p->filterB[filter];
+    if (p->samplepos < start) {
+        predictionA = decoded + (uint32_t)p->filterA[filter];
+        p->lastA[filter] = decoded;
+        p->filterB[filter] = decoded;
+        p->filterA[filter] = predictionA;
+        return predictionA;
+    }
+
+    d2 = p->buf[delayA];
+    d1 = (p->buf[delayA] - (uint32_t)p->buf[delayA - 1]) * 2;
+    d0 = p->buf[delayA] + ((p->buf[delayA - 2] - (uint32_t)p->buf[delayA - 1]) * 8);
+    d3 = p->buf[delayB] * 2u - p->buf[delayB - 1];
+    d4 = p->buf[delayB];
+
+    predictionA = d0 * p->coeffsA[filter][0] +
+                  d1 * p->coeffsA[filter][1] +
+                  d2 * p->coeffsA[filter][2];
+
+    sign = apeSign(decoded);
+    p->coeffsA[filter][0] += (((d0 >> 30) & 2) - 1) * sign;
+    p->coeffsA[filter][1] += (((d1 >> 28) & 8) - 4) * sign;
+    p->coeffsA[filter][2] += (((d2 >> 28) & 8) - 4) * sign;
+
+    predictionB = d3 * p->coeffsB[filter][0] -
+                  d4 * p->coeffsB[filter][1];
+    p->lastA[filter] = decoded + (uint32_t)(predictionA >> 11);
+    sign = apeSign(p->lastA[filter]);
+    p->coeffsB[filter][0] += (((d3 >> 29) & 4) - 2) * sign;
+    p->coeffsB[filter][1] -= (((d4 >> 30) & 2) - 1) * sign;
+
+    p->filterB[filter] = p->lastA[filter] + (uint32_t)(predictionB >> shift);
+    p->filterA[filter] = p->filterB[filter]
+                         + (uint32_t)((int32_t)(p->filterA[filter] * 31u) >> 5);
+
+    return p->filterA[filter];
+}
+
+//Sign-sign LMS filter of the high and extra high levels before 3930, over
+//a whole frame. Its history is the output.
+static void longFilterHigh3800(int32_t *buffer, int order, int shift, uint32_t length) {
+    int32_t coeffs[256], delay[256 + 256];
+    int32_t *delayp = delay;
+
+    if ((uint32_t)order >= length) {
+        return;
+    }
+
+    memset(coeffs, 0, order * sizeof(*coeffs));
+    for (int i = 0; i < order; i++) {
+        delay[i] = buffer[i];
+    }
+    for (uint32_t i = order; i < length; i++) {
+        int32_t dotprod = 0;
+        int32_t sign = apeSign(buffer[i]);
+        for (int j = 0; j < order; j++) {
+            dotprod += delayp[j] * (uint32_t)coeffs[j];
+            coeffs[j] += ((delayp[j] >> 31) | 1) * sign;
+        }
+        buffer[i] -= (uint32_t)(dotprod >> shift);
+        delayp++;
+        delayp[order - 1] = buffer[i];
+        if (delayp - delay == 256) {
+            memcpy(delay, delayp, sizeof(*delay) * 256);
+            delayp = delay;
+        }
+    }
+}
+
+//Order 8 stage in front of it from 3830, with the input as history.
+static void longFilterExtraHigh3830(int32_t *buffer, int32_t length) {
+    int32_t delay[8] = { 0 };
+    uint32_t coeffs[8] = { 0 };
+
+    for (int32_t i = 0; i < length; i++) {
+        int32_t dotprod = 0;
+        int32_t sign = apeSign(buffer[i]);
+        for (int j = 7; j >= 0; j--) {
+            dotprod += delay[j] * coeffs[j];
+            coeffs[j] += ((delay[j] >> 31) | 1) * sign;
+        }
+        for (int j = 7; j > 0; j--) {
+            delay[j] = delay[j - 1];
+        }
+        delay[0] = buffer[i];
+        buffer[i] -= (uint32_t)(dotprod >> 9);
+    }
+}
+
+//Runs the long filters of the level over a channel of a frame before
+//3930, and returns the blocks and shift of the predictor behind them.
+void APEDecoder::applyLongFilters3800(int32_t *decoded, uint32_t count,
+        uint32_t *start, int *shift) {
+    *start = 4;
+    *shift = 10;
+
+    if (mCompressionLevel == 3000) {
+        *start = 16;
+        longFilterHigh3800(decoded, 16, 9, count);
+    } else if (mCompressionLevel == 4000) {
+        int order = 128;
+        int shift2 = 11;
+        if (mVersion >= 3830) {
+            order <<= 1;
+            (*shift)++;
+            shift2++;
+            longFilterExtraHigh3830(decoded + order, (int32_t)count - order);
+        }
+        *start = order;
+        longFilterHigh3800(decoded, order, shift2, count);
+    }
+}
+
+void APEDecoder::predictorDecodeStereo3800(uint32_t count) {
+    int32_t *decoded0 = mDecoded[0];
+    int32_t *decoded1 = mDecoded[1];
+    uint32_t start;
+    int shift;
+
+    applyLongFilters3800(decoded0, count, &start, &shift);
+    applyLongFilters3800(decoded1, count, &start, &shift);
+
+    //The channels are stored X first.
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t X = decoded0[i];
+        int32_t Y = decoded1[i];
+        if (mCompressionLevel == 1000) {
+            decoded0[i] = predictorFast3320(Y, 0, YDELAYA);
+            decoded1[i] = predictorFast3320(X, 1, XDELAYA);
+        } else {
+            decoded0[i] = predictor3800(Y, 0, YDELAYA, YDELAYB, start, shift);
+            decoded1[i] = predictor3800(X, 1, XDELAYA, XDELAYB, start, shift);
+        }
+        advancePredictor();
+    }
+}
+
+void APEDecoder::predictorDecodeMono3800(uint32_t count) {
+    int32_t *decoded0 = mDecoded[0];
+    uint32_t start;
+    int shift;
+
+    applyLongFilters3800(decoded0, count, &start, &shift);
+
+    for (uint32_t i = 0; i < count; i++) {
+        if (mCompressionLevel == 1000) {
+            decoded0[i] = predictorFast3320(decoded0[i], 0, YDELAYA);
+        } else {
+            decoded0[i] = predictor3800(decoded0[i], 0, YDELAYA, YDELAYB, start, shift);
+        }
+        advancePredictor();
+    }
+}
+
+//Predictor of 3930 to 3949, the first stage of the later one alone.
+int32_t APEDecoder::predictor3930(int32_t decoded, int filter, int delayA) {
+    ApePredictor *p = &mPredictor;
+    int32_t predictionA, sign;
+    uint32_t d0, d1, d2, d3;
+
+    p->buf[delayA] = p->lastA[filter];
+    d0 = p->buf[delayA];
+    d1 = p->buf[delayA] - (uint32_t)p->buf[delayA - 1];
+    d2 = p->buf[delayA - 1] - (uint32_t)p->buf[delayA - 2];
+    d3 = p->buf[delayA - 2] - (uint32_t)p->buf[delayA - 3];
+
+    predictionA = d0 * p->coeffsA[filter][0] +
+                  d1 * p->coeffsA[filter][1] +
+                  d2 * p->coeffsA[filter][2] +
+                  d3 * p->coeffsA[filter][3];
+
+    p->lastA[filter] = decoded + (uint32_t)(predictionA >> 9);
+    p->filterA[filter] = p->lastA[filter]
+                         + (uint32_t)((int32_t)(p->filterA[filter] * 31u) >> 5);
+
+    sign = apeSign(decoded);
+    p->coeffsA[filter][0] += (((int32_t)d0 < 0) * 2 - 1) * sign;
+    p->coeffsA[filter][1] += (((int32_t)d1 < 0) * 2 - 1) * sign;
+    p->coeffsA[filter][2] += (((int32_t)d2 < 0) * 2 - 1) * sign;
+    p->coeffsA[filter][3] += (((int32_t)d3 < 0) * 2 - 1) * sign;
+
+    return p->filterA[filter];
+}
+
+void APEDecoder::predictorDecodeStereo3930(uint32_t count) {
+    int32_t *decoded0 = mDecoded[0];
+    int32_t *decoded1 = mDecoded[1];
+
+    applyFilters(decoded0, decoded1, count);
+
+    //The channels are stored X first.
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t X = decoded0[i];
+        int32_t Y = decoded1[i];
+        decoded0[i] = predictor3930(Y, 0, YDELAYA);
+        decoded1[i] = predictor3930(X, 1, XDELAYA);
+        advancePredictor();
+    }
+}
+
+void APEDecoder::predictorDecodeMono3930(uint32_t count) {
+    int32_t *decoded0 = mDecoded[0];
+
+    applyFilters(decoded0, NULL, count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        decoded0[i] = predictor3930(decoded0[i], 0, YDELAYA);
+        advancePredictor();
+    }
+}
+
+int32_t APEDecoder::predictorUpdateFilter(int32_t decoded, int filter,
+        int delayA, int delayB, int adaptA, int adaptB) {
+    ApePredictor *p = &mPredictor;
+    int32_t *buf = p->buf;
+    int32_t predictionA, predictionB, sign;
+
+    //Arithmetic wraps in 32 bits, so it is done unsigned.
+    buf[delayA] = p->lastA[filter];
+    buf[adaptA] = apeSign(buf[delayA]);
+    buf[delayA - 1] = buf[delayA] - (uint32_t)buf[delayA - 1];
+    buf[adaptA - 1] = apeSign(buf[delayA - 1]);
+
+    predictionA = buf[delayA    ] * p->coeffsA[filter][0] +
+                  buf[delayA - 1] * p->coeffsA[filter][1] +
+                  buf[delayA - 2] * p->coeffsA[filter][2] +
+                  buf[delayA - 3] * p->coeffsA[filter][3];
+
+    //Scaled first-order filter of the other channel.
+    buf[delayB] = p->filterA[filter ^ 1] - (uint32_t)((int32_t)(p->filterB[filter] * 31u) >> 5);
+    buf[adaptB] = apeSign(buf[delayB]);
+    buf[delayB - 1] = buf[delayB] - (uint32_t)buf[delayB - 1];
+    buf[adaptB - 1] = apeSign(buf[delayB - 1]);
+    p->filterB[filter] = p->filterA[filter ^ 1];
+
+    predictionB = buf[delayB    ] * p->coeffsB[filter][0] +
+                  buf[delayB - 1] * p->coeffsB[filter][1] +
+                  buf[delayB - 2] * p->coeffsB[filter][2] +
+                  buf[delayB - 3] * p->coeffsB[filter][3] +
+                  buf[delayB - 4] * p->coeffsB[filter][4];
+
+    p->lastA[filter] = decoded + (uint32_t)((int32_t)((uint32_t)predictionA
+                       + (predictionB >> 1)) >> 10);
+    p->filterA[filter] = p->lastA[filter]
+                         + (uint32_t)((int32_t)(p->filterA[filter] * 31u) >> 5);
+
+    sign = apeSign(decoded);
+    p->coeffsA[filter][0] += buf[adaptA    ] * sign;
+    p->coeffsA[filter][1] += buf[adaptA - 1] * sign;
+    p->coeffsA[filter][2] += buf[adaptA - 2] * sign;
+    p->coeffsA[filter][3] += buf[adaptA - 3] * sign;
+    p->coeffsB[filter][0] += buf[adaptB    ] * sign;
+    p->coeffsB[filter][1] += buf[adaptB - 1] * sign;
+    p->coeffsB[filter][2] += buf[adaptB - 2] * sign;
+    p->coeffsB[filter][3] += buf[adaptB - 3] * sign;
+    p->coeffsB[filter][4] += buf[adaptB - 4] * sign;
+
+    return p->filterA[filter];
+}
+
+void APEDecoder::predictorDecodeStereo(uint32_t count) {
+    int32_t *decoded0 = mDecoded[0];
+    int32_t *decoded1 = mDecoded[1];
+
+    applyFilters(decoded0, decoded1, count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        decoded0[i] = predictorUpdateFilter(decoded0[i], 0, YDELAYA, YDELAYB,
+                                            YADAPTCOEFFSA, YADAPTCOEFFSB);
+        decoded1[i] = predictorUpdateFilter(decoded1[i], 1, XDELAYA, XDELAYB,
+                                            XADAPTCOEFFSA, XADAPTCOEFFSB);
+        advancePredictor();
+    }
+}
+
+void APEDecoder::predictorDecodeMono(uint32_t count) {
+    ApePredictor *p = &mPredictor;
+    int32_t *decoded0 = mDecoded[0];
+    int32_t currentA = p->lastA[0];
+
+    applyFilters(decoded0, NULL, count);
+
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t *buf = p->buf;
+        int32_t A = decoded0[i];
+
+        buf[YDELAYA] = currentA;
+        buf[YDELAYA - 1] = buf[YDELAYA] - (uint32_t)buf[YDELAYA - 1];
+
+        int32_t predictionA = buf[YDELAYA    ] * p->coeffsA[0][0] +
+                              buf[YDELAYA - 1] * p->coeffsA[0][1] +
+                              buf[YDELAYA - 2] * p->coeffsA[0][2] +
+                              buf[YDELAYA - 3] * p->coeffsA[0][3];
+
+        currentA = A + (uint32_t)(predictionA >> 10);
+
+        buf[YADAPTCOEFFSA] = apeSign(buf[YDELAYA]);
+        buf[YADAPTCOEFFSA - 1] = apeSign(buf[YDELAYA - 1]);
+
+        int32_t sign = apeSign(A);
+        p->coeffsA[0][0] += buf[YADAPTCOEFFSA    ] * sign;
+        p->coeffsA[0][1] += buf[YADAPTCOEFFSA - 1] * sign;
+        p->coeffsA[0][2] += buf[YADAPTCOEFFSA - 2] * sign;
+        p->coeffsA[0][3] += buf[YADAPTCOEFFSA - 3] * sign;
+        advancePredictor();
+
+        p->filterA[0] = currentA + (uint32_t)((int32_t)(p->filterA[0] * 31u) >> 5);
+        decoded0[i] = p->filterA[0];
+    }
+
+    p->lastA[0] = currentA;
+}
+
+void APEDecoder::initFilter(ApeFilter *f, int16_t *buf, int order) {
+    //The history holds the last order adaption values followed by the last
+    //order outputs; a slot turns into an adaption value once it leaves the
+    //output window.
+    f->coeffs = buf;
+    f->historybuffer = buf + order;
+    f->delay = f->historybuffer + order * 2;
+    f->adaptcoeffs = f->historybuffer + order;
+
+    memset(f->historybuffer, 0, order * 2 * sizeof(*f->historybuffer));
+    memset(f->coeffs, 0, order * sizeof(*f->coeffs));
+    f->avg = 0;
+}
+
+void APEDecoder::applyFilter(ApeFilter *f, int32_t *data, uint32_t count,
+        int order, int fracbits) {
+    for (uint32_t i = 0; i < count; i++) {
+        int32_t res = mScalarProduct(f->coeffs, f->delay - order,
+                                     f->adaptcoeffs - order, order, apeSign(data[i]));
+        res = (int32_t)(((int64_t)res + (1LL << (fracbits - 1))) >> fracbits);
+        res += (uint32_t)data[i];
+        data[i] = res;
+
+        *f->delay++ = clip16(res);
+
+        if (mVersion < 3980) {
+            f->adaptcoeffs[0] = (res == 0) ? 0 : ((res >> 28) & 8) - 4;
+            f->adaptcoeffs[-4] >>= 1;
+            f->adaptcoeffs[-8] >>= 1;
+        } else {
+            //8, 16 or 32 depending on how far the output is above average.
+            uint32_t absres = res < 0 ? -(uint32_t)res : res;
+            if (absres) {
+                *f->adaptcoeffs = apeSign(res) * (8 << ((absres > f->avg * 3LL)
+                                  + (absres > (f->avg + f->avg / 3))));
+            } else {
+                *f->adaptcoeffs = 0;
+            }
+
+            f->avg += (int32_t)(absres - f->avg) / 16;
+
+            f->adaptcoeffs[-1] >>= 1;
+            f->adaptcoeffs[-2] >>= 1;
+            f->adaptcoeffs[-8] >>= 1;
+        }
+
+        f->adaptcoeffs++;
+
+        if (f->delay == f->historybuffer + APE_HISTORY_SIZE + order * 2) {
+            memmove(f->historybuffer, f->delay - order * 2,
+                    order * 2 * sizeof(*f->historybuffer));
+            f->delay = f->historybuffer + order * 2;
+            f->adaptcoeffs = f->historybuffer + order;
+        }
+    }
+}
+
+//NN filters are used from 3930 on.
+int APEDecoder::getFilterOrder(int level) const {
+    return mVersion < 3930 ? 0 : kFilterOrders[mFilterSet][level];
+}
+
+void APEDecoder::applyFilters(int32_t *decoded0, int32_t *decoded1, uint32_t count) {
+    for (int i = 0; i < APE_FILTER_LEVELS; i++) {
+        int order = getFilterOrder(i);
+        if (!order) {
+            break;
+        }
+        applyFilter(&mFilters[i][0], decoded0, count, order, kFilterFracBits[mFilterSet][i]);
+        if (decoded1 != NULL) {
+            applyFilter(&mFilters[i][1], decoded1, count, order, kFilterFracBits[mFilterSet][i]);
+        }
+    }
+}
+
+}  // namespace android
@@ -0,0 +1,208 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_DECODER_H_
+
+#define APE_DECODER_H_
+
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/Errors.h>
+
+#include "APEDSP.h"
+
+namespace android {
+
+class MediaBufferGroup;
+
+//Blocks decoded per read(), and the size of the decoder history buffers.
+#define APE_BLOCKS_PER_LOOP     4608
+#define APE_HISTORY_SIZE        512
+#define APE_PREDICTOR_SIZE      50
+#define APE_FILTER_LEVELS       3
+
+typedef struct {
+    uint32_t k;
+    uint32_t ksum;
+} ApeRice;
+
+typedef struct {
+    uint32_t low;
+    uint32_t range;
+    uint32_t help;
+    uint32_t buffer;
+} ApeRangeCoder;
+
+typedef struct {
+    //Filter coefficients, and the adaption values and outputs they run over.
+    int16_t *coeffs;
+    int16_t *adaptcoeffs;
+    int16_t *historybuffer;
+    int16_t *delay;
+    uint32_t avg;
+} ApeFilter;
+
+typedef struct {
+    int32_t *buf;
+    int32_t lastA[2];
+    int32_t filterA[2];
+    int32_t filterB[2];
+    uint32_t coeffsA[2][4];
+    uint32_t coeffsB[2][5];
+    //Blocks of the frame so far, before 3930 the first ones seed the filters.
+    uint32_t samplepos;
+    int32_t historybuffer[APE_HISTORY_SIZE + APE_PREDICTOR_SIZE];
+} ApePredictor;
+
+//Decodes the frames of an APESource to PCM in software, instead of
+//handing kFfmpegCodecSpecificData to an FFmpeg decoder. 8 and 16-bit
+//files come out as 16-bit samples, 24-bit files as packed 24-bit
+//little-endian ones; kKeyBitsPerSample of the format says which.
+//Supports file versions 3810 to 3990 at every compression level, but for
+//insane (5000) before 3930; initCheck() reports ERROR_UNSUPPORTED for
+//other files. The source is started and stopped by the decoder, prefetch,
+//read budget and zero-copy params are passed on. Each frame is decoded
+//whole before any of it is output. read() returns ERROR_MALFORMED for a
+//corrupt frame, or from 3900 for one whose CRC does not match, and none
+//of its samples; reading on goes on with the next frame.
+class APEDecoder : public MediaSource {
+public:
+    APEDecoder(const sp<MediaSource> &source);
+
+    status_t initCheck() const;
+
+    virtual status_t start(MetaData *params = NULL);
+    virtual status_t stop();
+
+    virtual sp<MetaData> getFormat();
+
+    virtual status_t read(
+            MediaBuffer **buffer, const ReadOptions *options = NULL);
+
+protected:
+    virtual ~APEDecoder();
+
+private:
+    sp<MediaSource> mSource;
+    sp<MetaData> mMeta;
+    MediaBufferGroup *mGroup;
+    bool mStarted;
+
+    uint16_t mVersion;
+    uint16_t mCompressionLevel;
+    int32_t mChannels;
+    int32_t mBitsPerSample;
+    int32_t mSampleRate;
+    //Bytes per output sample, 2 or 3.
+    int32_t mOutputBytes;
+    int mFilterSet;
+
+    ApeScalarProductFunc mScalarProduct;
+
+    //Current frame, byte swapped into 32-bit big-endian words.
+    uint8_t *mData;
+    size_t mDataSize;
+    const uint8_t *mPtr;
+    const uint8_t *mDataEnd;
+    //Position in bits of the reader of frames before 3900.
+    size_t mBitPos;
+    bool mError;
+
+    uint32_t mCRC;
+    uint32_t mCRCState;
+    uint32_t mFrameFlags;
+    //Blocks left to decode in the current frame, and blocks done so far.
+    uint32_t mSamples;
+    uint32_t mFramePosition;
+    int64_t mFrameTimeUs;
+    //Leading blocks to drop after a SEEK_CLOSEST seek or at the start of a
+    //cue sheet track, and the block of the frame where its track ends.
+    uint32_t mSkipSamples;
+    uint32_t mFrameEnd;
+
+    ApeRangeCoder mRangeCoder;
+    ApeRice mRiceX;
+    ApeRice mRiceY;
+    ApePredictor mPredictor;
+    ApeFilter mFilters[APE_FILTER_LEVELS][2];
+    int16_t *mFilterBuf[APE_FILTER_LEVELS];
+    //Decoded blocks of the whole frame, and how many of them were output.
+    int32_t *mDecoded[2];
+    uint32_t mDecodedSize;
+    uint32_t mDecodedPos;
+    uint32_t mDecodedCount;
+
+    status_t mInitCheck;
+
+    status_t decodeNextBlocks();
+    status_t readFrame(const ReadOptions *options);
+    status_t initFrameDecoder();
+    void decodeBlocks(uint32_t count);
+
+    uint32_t getBits(int n);
+    uint32_t getUnary();
+    uint32_t getRice(int k);
+
+    void rangeStartDecoding();
+    void rangeNormalize();
+    uint32_t rangeDecodeCulFreq(uint32_t totf);
+    uint32_t rangeDecodeCulShift(int shift);
+    void rangeDecodeUpdate(uint32_t syf, uint32_t ltf);
+    uint32_t rangeDecodeBits(int n);
+    uint32_t rangeGetSymbol(const uint16_t *counts, const uint16_t *countsdiff);
+    int32_t decodeValue3860(ApeRice *rice);
+    void decodeArray0000(int32_t *out, ApeRice *rice, uint32_t count);
+    int32_t decodeValue3900(ApeRice *rice);
+    int32_t decodeValue3990(ApeRice *rice);
+    void entropyDecode(uint32_t count, bool stereo);
+
+    void initPredictor();
+    void advancePredictor();
+    int32_t predictorFast3320(int32_t decoded, int filter, int delayA);
+    int32_t predictor3800(int32_t decoded, int filter,
+            int delayA, int delayB, uint32_t start, int shift);
+    void applyLongFilters3800(int32_t *decoded, uint32_t count, uint32_t *start, int *shift);
+    void predictorDecodeStereo3800(uint32_t count);
+    void predictorDecodeMono3800(uint32_t count);
+    int32_t predictor3930(int32_t decoded, int filter, int delayA);
+    void predictorDecodeStereo3930(uint32_t count);
+    void predictorDecodeMono3930(uint32_t count);
+    int32_t predictorUpdateFilter(int32_t decoded, int filter,
+            int delayA, int delayB, int adaptA, int adaptB);
+    void predictorDecodeStereo(uint32_t count);
+    void predictorDecodeMono(uint32_t count);
+
+    int getFilterOrder(int level) const;
+    void initFilter(ApeFilter *f, int16_t *buf, int order);
+    void applyFilter(ApeFilter *f, int32_t *data, uint32_t count, int order, int fracbits);
+    void applyFilters(int32_t *decoded0, int32_t *decoded1, uint32_t count);
+
+    APEDecoder(const APEDecoder &);
+    APEDecoder &operator=(const APEDecoder &);
+};
+
+}  // namespace android
+
+#endif  // APE_DECODER_H_
@@ -27,20 +27,33 @@
 #include <utils/Log.h>
 
 #include "APEExtractor.h"
+#include "APEBlockCache.h"
+#include "APEBufferPool.h"
+#include "APECueSheet.h"
+#include "APEIndexCache.h"
+#include "APEMappedFileSource.h"
+#include "APEStats.h"
+#include "APETraceSource.h"
 
 #include "include/avc_utils.h"
 
+#include <media/stagefright/foundation/ABuffer.h>
 #include <media/stagefright/foundation/ADebug.h>
 #include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/DataSource.h>
 #include <media/stagefright/MediaBuffer.h>
-#include <media/stagefright/MediaBufferGroup.h>
 #include <media/stagefright/MediaDefs.h>
 #include <media/stagefright/MediaErrors.h>
 #include <media/stagefright/MediaSource.h>
 #include <media/stagefright/MetaData.h>
 #include <media/stagefright/Utils.h>
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
+#include <utils/List.h>
 #include <utils/String8.h>
+#include <utils/threads.h>
+
+#include <pthread.h>
 
 namespace android {
 
@@ -55,10 +68,65 @@ namespace android {
 
 #define APE_MAX_TAGS_SIZE 200
 
+#define APE_TAG_FOOTER_SIZE 32
+#define ID3V1_TAG_SIZE 128
+//Item headers and text values are read through a window of this size that
+//moves along the tag, binary values are stepped over without reading them.
+#define APE_TAG_WINDOW_SIZE 4096
+//Keys are 2 to 255 characters, plus the NUL.
+#define APE_TAG_MAX_KEY_SIZE 256
+//Text values are held in memory, anything larger is treated as corrupt.
+#define APE_MAX_TEXT_ITEM_SIZE (1024 * 1024)
+
+//Upper bound of kKeyApePrefetchFrames, every prefetched frame pins a max-frame-size buffer.
+#define APE_MAX_PREFETCH_FRAMES 16
+
+//Upper bound of kKeyApeReadBudget. Coalesced reads start on an aligned offset.
+#define APE_MAX_READ_BUDGET (4 * 1024 * 1024)
+#define APE_READ_ALIGNMENT 4096
+
+//Most frames packed into one kKeyApeMultiFrame buffer.
+#define APE_MAX_FRAMES_PER_BUFFER 64
+
+//Largest single read issued while fetching the seek table.
+#define APE_SEEK_TABLE_CHUNK_SIZE (64 * 1024)
+
+//Seek table read issued by the incremental loader, small so that the
+//first frames become usable early.
+#define APE_INCREMENTAL_CHUNK_SIZE 4096
+
+//Flattened ApeHeaderData: 14 32-bit fields, durationUS, final and max frame
+//size, frame data length and MD5.
+#define APE_FLATTENED_HEADER_SIZE 96
+
+static inline uint32_t readLE32(const uint8_t *ptr) {
+    return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+static inline uint64_t readLE64(const uint8_t *ptr) {
+    return readLE32(ptr) | ((uint64_t)readLE32(ptr + 4) << 32);
+}
+
+static inline void writeLE32(uint8_t *ptr, uint32_t x) {
+    ptr[0] = x;
+    ptr[1] = x >> 8;
+    ptr[2] = x >> 16;
+    ptr[3] = x >> 24;
+}
+
+static inline void writeLE64(uint8_t *ptr, uint64_t x) {
+    writeLE32(ptr, (uint32_t)x);
+    writeLE32(ptr + 4, (uint32_t)(x >> 32));
+}
+
 class APESource : public MediaSource {
 public:
+    //Plays the samples [startsample, endsample) of the file. mappedfile is
+    //the file behind source if the extractor maps it, or NULL.
     APESource(
-            const sp<MetaData> &meta, const sp<DataSource> &source, sp<APEFrameData> apeframedata);
+            const sp<MetaData> &meta, const sp<DataSource> &source, sp<APEFrameData> apeframedata,
+            const sp<APEStats> &stats, uint64_t startsample, uint64_t endsample,
+            const sp<APEMappedFileSource> &mappedfile);
 
     virtual status_t start(MetaData *params = NULL);
     virtual status_t stop();
@@ -72,484 +140,2574 @@ protected:
     virtual ~APESource();
 
 private:
+    struct PrefetchedFrame {
+        uint32_t framenum;
+        MediaBuffer *buffer;
+        status_t err;
+    };
+
     sp<MetaData> mMeta;
     sp<DataSource> mDataSource;
     sp<APEFrameData> mAPEFrameData;
+    //NULL when stats are disabled.
+    sp<APEStats> mStats;
 
-    MediaBufferGroup *mGroup;
+    //Frame buffers come from the process wide pool, sized per frame.
+    APEBufferPool *mBufferPool;
 
     uint32_t mCurrentFrameNum;
 
+    //Frames of the track, and the samples of its first and last frame that
+    //belong to the tracks around it. Timestamps are relative to mStartTimeUs.
+    uint32_t mStartFrame;
+    uint32_t mEndFrame;
+    int32_t mStartSkip;
+    int32_t mEndTrim;
+    int64_t mStartTimeUs;
+    //kKeyApeSkipSamples of the next buffer.
+    int32_t mSkipSamples;
+
+    //The file behind mDataSource when the extractor maps it, and the same
+    //once start() chose to hand out frames as views into it.
+    sp<APEMappedFileSource> mMappedFile;
+    sp<APEMappedFileSource> mMappedSource;
+
+    //Coalesced reads, only used when start() asks for kKeyApeReadBudget.
+    //mReadBuffer holds the file bytes [mReadBufferOffset, +mReadBufferLength)
+    //and is only touched by whichever thread calls readFrame().
+    uint8_t *mReadBuffer;
+    size_t mReadBufferSize;
+    size_t mReadBudget;
+    off64_t mReadBufferOffset;
+    size_t mReadBufferLength;
+    bool mMultiFrame;
+
+    //Readahead, only used when start() asks for kKeyApePrefetchFrames.
+    //The worker keeps up to mPrefetchFrames frames loaded in mPrefetched,
+    //starting at mCurrentFrameNum; a seek bumps mPrefetchGeneration so that
+    //a frame being loaded for the old position is dropped.
+    Mutex mLock;
+    Condition mPrefetchCondition;
+    Condition mFrameReadyCondition;
+    pthread_t mThread;
+    bool mThreadStarted;
+    bool mStopping;
+    //Set by stop() so that the worker gives up waiting for an index entry
+    //of an incremental index; the index lock guards that wait, not mLock.
+    volatile int32_t mAbortWait;
+    uint32_t mPrefetchFrames;
+    uint32_t mPrefetchFrameNum;
+    uint32_t mPrefetchGeneration;
+    List<PrefetchedFrame> mPrefetched;
+
+    status_t readFrame(uint32_t framenum, MediaBuffer *buffer);
+    status_t readFrames(uint32_t framenum, MediaBuffer *buffer, uint32_t *count);
+    status_t getCoalescedFrame(uint32_t framenum, const ApeFrame &apeframe,
+            const uint8_t **data);
+    status_t mapFrame(uint32_t framenum, MediaBuffer **buffer);
+    status_t readInternal(MediaBuffer **buffer, const ReadOptions *options);
+    status_t acquireBuffer(size_t size, MediaBuffer **buffer);
+    size_t getFrameBufferSize(uint32_t framenum);
+    ssize_t readFromSource(off64_t offset, void *data, size_t size);
+
+    static void *ThreadWrapper(void *me);
+    void threadEntry();
+    void restartPrefetch(uint32_t framenum);
+    void restartPrefetch_l(uint32_t framenum);
+    void releasePrefetchedFrames_l();
+    status_t dequeuePrefetchedFrame(uint32_t framenum, MediaBuffer **buffer);
+
     APESource(const APESource &);
     APESource &operator=(const APESource &);
 };
 
-APEFrameData::APEFrameData(const sp<DataSource> &source)
-        :mDataSource(source),
-        mApeHeaderData(NULL),
-        mSeekTable(NULL),
-        mAPEFrames(NULL) {
-    uint64_t data_offset = 0;
-    uint8_t buff[2];
+//Descriptor and header of every supported version fit in the first bytes
+//of the file, so a single read normally covers both.
+#define APE_HEADER_READ_SIZE 128
+//Descriptor with the magic and version, and header, of 3980 and later.
+//Longer descriptors are allowed for, but not beyond a sane size.
+#define APE_DESCRIPTOR_SIZE 52
+#define APE_MAX_DESCRIPTOR_SIZE 4096
+#define APE_HEADER_SIZE 24
+
+//Highest sample rate taken as a sign of a real file by the sniffer.
+#define APE_MAX_SAMPLE_RATE 768000
+
+#define ID3V2_HEADER_SIZE 10
+//ID3v2 tags in front of the stream that are skipped, a file with more
+//than this is not taken for APE.
+#define ID3V2_MAX_TAGS 4
+
+//Size of the ID3v2 tag starting at data, header and footer included, or 0
+//if there is none.
+static off64_t getID3v2Size(const uint8_t *data, size_t size) {
+    if (size < ID3V2_HEADER_SIZE || memcmp(data, "ID3", 3) || data[3] == 0xff
+            || data[4] == 0xff || ((data[6] | data[7] | data[8] | data[9]) & 0x80)) {
+        return 0;
+    }
 
-    mApeHeaderData = (ApeHeaderData *)malloc(sizeof(ApeHeaderData));
-    if (!mApeHeaderData) {
-        LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
-        return;
+    //Synchsafe, 7 bits per byte.
+    off64_t tagsize = ((off64_t)data[6] << 21) | (data[7] << 14) | (data[8] << 7) | data[9];
+    tagsize += ID3V2_HEADER_SIZE;
+    if (data[5] & 0x10) {
+        tagsize += ID3V2_HEADER_SIZE;
     }
+    return tagsize;
+}
 
-    size_t n = source->readAt(data_offset + 4, buff, sizeof(buff));
-    mApeHeaderData->version = U16LE_AT(buff);
-    if (mApeHeaderData->version < APE_MIN_VERSION || mApeHeaderData->version > APE_MAX_VERSION) {
-        LOGE("Unsupported file version - %d.%02d\n",
-               mApeHeaderData->version / 1000, (mApeHeaderData->version % 1000) / 10);
-        return;
+ssize_t APEFrameData::readStreamStart(const sp<DataSource> &source,
+        uint8_t *buff, size_t size, off64_t *offset) {
+    *offset = 0;
+
+    ssize_t n = source->readAt(0, buff, size);
+    for (int i = 0; i < ID3V2_MAX_TAGS && n > 0; i++) {
+        off64_t tagsize = getID3v2Size(buff, n);
+        if (tagsize == 0) {
+            break;
+        }
+        *offset += tagsize;
+        ALOGV("Skipping %lld bytes of ID3v2 tag", (long long)tagsize);
+        n = source->readAt(*offset, buff, size);
     }
-    if (mApeHeaderData->version >= 3980) {
-        uint8_t descriptor[46];
+    return n;
+}
 
-        //Get descriptor data.
-        if (source->readAt(data_offset + 6, descriptor, sizeof(descriptor)) < sizeof(descriptor)) {
-            return;
+status_t APEFrameData::validateHeader(const ApeHeaderData *header,
+        off64_t seektableoffset, off64_t filesize) {
+    //The seek table, and from 3980 the wav header behind it, come before
+    //the frames. The table has an entry per frame, so this also bounds the
+    //index allocated for it by the size of the file.
+    off64_t data_offset = seektableoffset + header->seektablelength;
+    if (header->version >= 3980) {
+        data_offset += header->wavheaderlength;
+    }
+    if (data_offset > filesize) {
+        LOGE("Header and seek table take %lld bytes of a %lld byte file",
+                (long long)data_offset, (long long)filesize);
+        return ERROR_MALFORMED;
+    }
+    return OK;
+}
+
+status_t APEFrameData::parseHeader(const sp<DataSource> &source,
+        ApeHeaderData *header, off64_t *seektableoffset) {
+    uint8_t buff[APE_HEADER_READ_SIZE];
+
+    ssize_t n = source->readAt(0, buff, sizeof(buff));
+    if (n < 6) {
+        return ERROR_IO;
+    }
+
+    status_t err = parseHeader(buff, n, header, seektableoffset);
+    if (err == ERROR_BUFFER_TOO_SMALL) {
+        //A descriptor longer than usual pushes the header out of the first read.
+        size_t size = header->descriptorlength + APE_HEADER_SIZE;
+        uint8_t *data = (uint8_t *)malloc(size);
+        if (data == NULL) {
+            return NO_MEMORY;
         }
+        err = source->readAt(0, data, size) == (ssize_t)size
+                ? parseHeader(data, size, header, seektableoffset) : ERROR_IO;
+        free(data);
+    }
+    if (err != OK) {
+        return err;
+    }
+
+    off64_t file_size;
+    if (source->getSize(&file_size) == OK) {
+        return validateHeader(header, *seektableoffset, file_size);
+    }
+    return OK;
+}
 
-        mApeHeaderData->descriptorlength = U32LE_AT(&descriptor[2]);
-        mApeHeaderData->headerlength     = U32LE_AT(&descriptor[6]);
-        mApeHeaderData->seektablelength  = U32LE_AT(&descriptor[10]);
-        mApeHeaderData->wavheaderlength  = U32LE_AT(&descriptor[14]);
+status_t APEFrameData::parseHeader(const uint8_t *buff, size_t n,
+        ApeHeaderData *header, off64_t *seektableoffset) {
+    off64_t data_offset = 0;
 
-        uint8_t header[mApeHeaderData->headerlength];
-        data_offset += mApeHeaderData->descriptorlength;
+    if (n < 6) {
+        return ERROR_MALFORMED;
+    }
 
-        //Get header data.
-        if (source->readAt(data_offset, header, sizeof(header)) < sizeof(header)) {
-            return;
+    header->version = U16LE_AT(&buff[4]);
+    if (header->version < APE_MIN_VERSION || header->version > APE_MAX_VERSION) {
+        LOGE("Unsupported file version - %d.%02d\n",
+               header->version / 1000, (header->version % 1000) / 10);
+        return ERROR_UNSUPPORTED;
+    }
+    if (header->version >= 3980) {
+        const uint8_t *descriptor = &buff[6];
+        const uint8_t *data;
+
+        //Get descriptor data.
+        if (n < APE_DESCRIPTOR_SIZE) {
+            return ERROR_MALFORMED;
         }
 
-        mApeHeaderData->compressiontype  = U16LE_AT(&header[0]);
-        mApeHeaderData->formatflags      = U16LE_AT(&header[2]);
-        mApeHeaderData->blocksperframe   = U32LE_AT(&header[4]);
-        mApeHeaderData->finalframeblocks = U32LE_AT(&header[8]);
-        mApeHeaderData->totalframes      = U32LE_AT(&header[12]);
-        mApeHeaderData->bitspersample    = U16LE_AT(&header[16]);
-        mApeHeaderData->channels         = U16LE_AT(&header[18]);
-        mApeHeaderData->samplerate       = U32LE_AT(&header[20]);
+        header->descriptorlength = U32LE_AT(&descriptor[2]);
+        header->headerlength     = U32LE_AT(&descriptor[6]);
+        header->seektablelength  = U32LE_AT(&descriptor[10]);
+        header->wavheaderlength  = U32LE_AT(&descriptor[14]);
+        header->wavtaillength    = U32LE_AT(&descriptor[26]);
+        header->framedatalength  = U32LE_AT(&descriptor[18])
+                                   | ((uint64_t)U32LE_AT(&descriptor[22]) << 32);
+        memcpy(header->md5, &descriptor[30], sizeof(header->md5));
+
+        if (header->descriptorlength < APE_DESCRIPTOR_SIZE
+                || header->descriptorlength > APE_MAX_DESCRIPTOR_SIZE
+                || header->headerlength < APE_HEADER_SIZE) {
+            LOGE("Invalid descriptor length %u or header length %u",
+                    header->descriptorlength, header->headerlength);
+            return ERROR_MALFORMED;
+        }
 
-        data_offset += mApeHeaderData->headerlength;
+        //Get header data.
+        if (header->descriptorlength + APE_HEADER_SIZE > n) {
+            return ERROR_BUFFER_TOO_SMALL;
+        }
+        data = &buff[header->descriptorlength];
+
+        header->compressiontype  = U16LE_AT(&data[0]);
+        header->formatflags      = U16LE_AT(&data[2]);
+        header->blocksperframe   = U32LE_AT(&data[4]);
+        header->finalframeblocks = U32LE_AT(&data[8]);
+        header->totalframes      = U32LE_AT(&data[12]);
+        header->bitspersample    = U16LE_AT(&data[16]);
+        header->channels         = U16LE_AT(&data[18]);
+        header->samplerate       = U32LE_AT(&data[20]);
+
+        data_offset = (off64_t)header->descriptorlength + header->headerlength;
     } else {
-        uint8_t header[34];
+        const uint8_t *data = &buff[6];
 
-        mApeHeaderData->descriptorlength = 0;
-        mApeHeaderData->headerlength = 32;
+        header->descriptorlength = 0;
+        header->headerlength = 32;
+        header->framedatalength = 0;
+        memset(header->md5, 0, sizeof(header->md5));
 
-        data_offset += 6;
-        if (source->readAt(data_offset, header, sizeof(header)) < sizeof(header)) {
-            return;
+        if (n < 6 + 34) {
+            return ERROR_MALFORMED;
         }
 
-        mApeHeaderData->compressiontype  = U16LE_AT(&header[0]);
-        mApeHeaderData->formatflags      = U16LE_AT(&header[2]);
-        mApeHeaderData->channels         = U16LE_AT(&header[4]);
-        mApeHeaderData->samplerate       = U32LE_AT(&header[6]);
-        mApeHeaderData->wavheaderlength  = U32LE_AT(&header[10]);
-        mApeHeaderData->wavtaillength  = U32LE_AT(&header[14]);
-        mApeHeaderData->totalframes      = U32LE_AT(&header[18]);
-        mApeHeaderData->finalframeblocks = U32LE_AT(&header[22]);
-
-        if (mApeHeaderData->formatflags & APE_FLAG_HAS_PEAK_LEVEL) {
-            mApeHeaderData->headerlength += 4;
+        header->compressiontype  = U16LE_AT(&data[0]);
+        header->formatflags      = U16LE_AT(&data[2]);
+        header->channels         = U16LE_AT(&data[4]);
+        header->samplerate       = U32LE_AT(&data[6]);
+        header->wavheaderlength  = U32LE_AT(&data[10]);
+        header->wavtaillength  = U32LE_AT(&data[14]);
+        header->totalframes      = U32LE_AT(&data[18]);
+        header->finalframeblocks = U32LE_AT(&data[22]);
+
+        if (header->formatflags & APE_FLAG_HAS_PEAK_LEVEL) {
+            header->headerlength += 4;
         }
 
-        if (mApeHeaderData->formatflags & APE_FLAG_HAS_SEEK_ELEMENTS) {
-            if (mApeHeaderData->formatflags & APE_FLAG_HAS_PEAK_LEVEL) {
-                mApeHeaderData->seektablelength = U32LE_AT(&header[30]);
+        if (header->formatflags & APE_FLAG_HAS_SEEK_ELEMENTS) {
+            if (header->formatflags & APE_FLAG_HAS_PEAK_LEVEL) {
+                header->seektablelength = U32LE_AT(&data[30]);
             } else {
-                mApeHeaderData->seektablelength = U32LE_AT(&header[26]);
+                header->seektablelength = U32LE_AT(&data[26]);
             }
-            mApeHeaderData->headerlength += 4;
-            mApeHeaderData->seektablelength *= sizeof(int32_t);
+            header->headerlength += 4;
+            header->seektablelength *= sizeof(int32_t);
         } else {
-            mApeHeaderData->seektablelength = mApeHeaderData->totalframes * sizeof(int32_t);
+            header->seektablelength = header->totalframes * sizeof(int32_t);
         }
 
-        if (mApeHeaderData->formatflags & APE_FLAG_8_BIT) {
-            mApeHeaderData->bitspersample = 8;
-        } else if (mApeHeaderData->formatflags & APE_FLAG_24_BIT) {
-            mApeHeaderData->bitspersample = 24;
+        if (header->formatflags & APE_FLAG_8_BIT) {
+            header->bitspersample = 8;
+        } else if (header->formatflags & APE_FLAG_24_BIT) {
+            header->bitspersample = 24;
         } else {
-            mApeHeaderData->bitspersample = 16;
+            header->bitspersample = 16;
         }
 
-        if (mApeHeaderData->version >= 3950) {
-            mApeHeaderData->blocksperframe = 73728 * 4;
-        } else if (mApeHeaderData->version >= 3900 || (mApeHeaderData->version >= 3800
-                        && mApeHeaderData->compressiontype >= 4000)) {
-            mApeHeaderData->blocksperframe = 73728;
+        if (header->version >= 3950) {
+            header->blocksperframe = 73728 * 4;
+        } else if (header->version >= 3900 || (header->version >= 3800
+                        && header->compressiontype >= 4000)) {
+            header->blocksperframe = 73728;
         } else {
-            mApeHeaderData->blocksperframe = 9216;
+            header->blocksperframe = 9216;
         }
 
-        data_offset += mApeHeaderData->headerlength;
+        //headerlength counts from the start of the file, including the magic and version.
+        data_offset = header->headerlength;
 
-        if (mApeHeaderData->formatflags & APE_FLAG_CREATE_WAV_HEADER) {
-            data_offset += mApeHeaderData->wavheaderlength;
+        //The wav header is only stored, in front of the seek table, when the
+        //decoder is not asked to create one.
+        if (header->formatflags & APE_FLAG_CREATE_WAV_HEADER) {
+            header->wavheaderlength = 0;
         }
+        data_offset += header->wavheaderlength;
+    }
+
+    if (header->samplerate == 0 || header->blocksperframe == 0
+            || header->finalframeblocks > header->blocksperframe) {
+        LOGE("Invalid sample rate %u or blocks per frame %u/%u",
+               header->samplerate, header->blocksperframe, header->finalframeblocks);
+        return ERROR_MALFORMED;
+    }
+
+    if (header->totalframes == 0
+            || header->seektablelength / sizeof(uint32_t) < header->totalframes) {
+        LOGE("Seek table has %u entries for %u frames",
+               header->seektablelength / 4, header->totalframes);
+        return ERROR_MALFORMED;
     }
 
-    mAPEFrames = (ApeFrame *)malloc(mApeHeaderData->totalframes * sizeof(ApeFrame));
-    if (!mAPEFrames) {
+    int64_t totalblocks = (int64_t)(header->totalframes - 1)
+                    * header->blocksperframe + header->finalframeblocks;
+    header->durationUS = totalblocks * 1000000 / header->samplerate;
+
+    *seektableoffset = data_offset;
+    return OK;
+}
+
+APEFrameData::APEFrameData(const sp<DataSource> &source, const ApeHeaderData &header,
+        off64_t seektableoffset)
+        :mDataSource(source),
+        mApeHeaderData(NULL),
+        mFrameOffsets(NULL),
+        mFinalFrameSize(0),
+        mSeekTableOffset(seektableoffset),
+        mMaxFrameSize(0),
+        mIndexed(0),
+        mLoaderStarted(false),
+        mLoaderStopping(false),
+        mLoadedFrames(0),
+        mLoadError(OK),
+        mInitCheck(NO_INIT) {
+    mApeHeaderData = (ApeHeaderData *)malloc(sizeof(ApeHeaderData));
+    if (!mApeHeaderData) {
         LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
         return;
     }
 
-    //Seek table, from which can get every frame start position,
-    //and can calculate the frame size and skip values.
-    if (mApeHeaderData->seektablelength > 0) {
-        mSeekTable = (uint32_t *)malloc(mApeHeaderData->seektablelength);
-       if (!mSeekTable) {
-            LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
-            return;
-       }
-        for (uint32_t i = 0; i < mApeHeaderData->seektablelength/sizeof(uint32_t); i++) {
-            if (source->readAt(data_offset + i * 4, &mSeekTable[i],
-                                            sizeof(uint32_t)) < sizeof(uint32_t)) {
-                return;
-            }
-        }
+    *mApeHeaderData = header;
+    mInitCheck = OK;
+}
+
+APEFrameData::APEFrameData(const sp<DataSource> &source)
+        :mDataSource(source),
+        mApeHeaderData(NULL),
+        mFrameOffsets(NULL),
+        mFinalFrameSize(0),
+        mSeekTableOffset(0),
+        mMaxFrameSize(0),
+        mIndexed(0),
+        mLoaderStarted(false),
+        mLoaderStopping(false),
+        mLoadedFrames(0),
+        mLoadError(OK),
+        mInitCheck(NO_INIT) {
+    mApeHeaderData = (ApeHeaderData *)malloc(sizeof(ApeHeaderData));
+    if (!mApeHeaderData) {
+        LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+        return;
     }
-    mAPEFrames[0].pos = mApeHeaderData->descriptorlength
-                        + mApeHeaderData->headerlength
-                        + mApeHeaderData->seektablelength
-                        + mApeHeaderData->wavheaderlength;
-    mAPEFrames[0].nblocks = mApeHeaderData->blocksperframe;
-    mAPEFrames[0].skip = 0;
-    mAPEFrames[0].pts = 0;
 
-    for (uint32_t i = 1; i < mApeHeaderData->totalframes; i++) {
-        mAPEFrames[i].pos = mSeekTable[i];
-        mAPEFrames[i].nblocks = mApeHeaderData->blocksperframe;
-        mAPEFrames[i-1].size = mAPEFrames[i].pos - mAPEFrames[i-1].pos;
-        mAPEFrames[i].skip = (mAPEFrames[i].pos - mAPEFrames[0].pos) & 3;
-        mAPEFrames[i].pts = mAPEFrames[i-1].pts + mApeHeaderData->blocksperframe/4608;
+    if (parseHeader(source, mApeHeaderData, &mSeekTableOffset) != OK) {
+        return;
     }
 
-    //The frame size and block num of the last frame.
-    off64_t file_size = 0;
-    int  final_size = 0;
-    source->getSize(&file_size);
-    if (file_size > 0) {
-        final_size = file_size - mAPEFrames[mApeHeaderData->totalframes - 1].pos -
-                     mApeHeaderData->wavtaillength;
-        final_size -= final_size & 3;
+    mInitCheck = OK;
+}
+
+status_t APEFrameData::buildIndex() {
+    if (mInitCheck != OK) {
+        return mInitCheck;
     }
-    if (file_size <= 0 || final_size <= 0) {
-        final_size = mApeHeaderData->finalframeblocks * 8;
+    if (isIndexed()) {
+        return OK;
     }
-    mAPEFrames[mApeHeaderData->totalframes - 1].size = final_size;
-    mAPEFrames[mApeHeaderData->totalframes - 1].size = mApeHeaderData->finalframeblocks * 8;
-    mAPEFrames[mApeHeaderData->totalframes - 1].nblocks = mApeHeaderData->finalframeblocks;
 
-    //If the skip value is not zero, need to adjust the frame position and frame size.
-    for (uint32_t i = 0; i < mApeHeaderData->totalframes; i++) {
-        if (mAPEFrames[i].skip) {
-            mAPEFrames[i].pos -= mAPEFrames[i].skip;
-            mAPEFrames[i].size += mAPEFrames[i].skip;
+    Mutex::Autolock autoLock(mIndexLock);
+    if (mLoaderStarted) {
+        //The loader owns the table, it is only a matter of waiting for it.
+        while (!isIndexed() && mLoadError == OK && !mLoaderStopping) {
+            mIndexCondition.wait(mIndexLock);
         }
-        mAPEFrames[i].size = (mAPEFrames[i].size + 3) & ~3;
+        return isIndexed() ? OK : mLoadError;
+    }
+    if (isIndexed()) {
+        return OK;
     }
-}
 
-APEFrameData::~APEFrameData() {
-    free(mApeHeaderData);
-    mApeHeaderData = NULL;
+    //Only the frame start offsets are kept. Everything else in an ApeFrame is
+    //derived from them and the header data in getCurrentFrame().
+    const uint32_t totalframes = mApeHeaderData->totalframes;
+    uint32_t *offsets = (uint32_t *)malloc(totalframes * sizeof(uint32_t));
+    if (!offsets) {
+        LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+        return NO_MEMORY;
+    }
 
-    free(mSeekTable);
-    mSeekTable = NULL;
+    //Seek table, from which can get every frame start position,
+    //and can calculate the frame size and skip values.
+    //It is fetched straight into the offset array in large chunks.
+    for (uint32_t start = 0; start < totalframes;) {
+        uint32_t count = totalframes - start;
+        if (count > APE_SEEK_TABLE_CHUNK_SIZE / sizeof(uint32_t)) {
+            count = APE_SEEK_TABLE_CHUNK_SIZE / sizeof(uint32_t);
+        }
 
-    free(mAPEFrames);
-    mAPEFrames = NULL;
-}
+        uint8_t *entry = (uint8_t *)&offsets[start];
+        if (mDataSource->readAt(mSeekTableOffset + (off64_t)start * 4, entry,
+                           count * sizeof(uint32_t)) < (ssize_t)(count * sizeof(uint32_t))) {
+            LOGE("Truncated seek table at entry %u", start);
+            free(offsets);
+            return ERROR_MALFORMED;
+        }
 
-status_t APEFrameData::getRequiredFrameNum(int64_t seekTimeUs,int32_t *frameNum){
-    for (uint32_t i = 0; i < mApeHeaderData->totalframes; i++) {
-        if(mAPEFrames[i].pts * 1000 * 100 >= seekTimeUs) {
-            *frameNum = i;
-            return OK;
+        for (uint32_t i = 0; i < count; i++) {
+            offsets[start + i] = readLE32(&entry[i * 4]);
         }
+        start += count;
     }
-    return OK;
-}
 
-size_t APEFrameData::getMaxFrameSize(){
-    size_t maxframesize;
+    offsets[0] = getFirstFrameOffset();
 
-    maxframesize = mAPEFrames[0].size;
-    for (uint32_t i = 1; i < mApeHeaderData->totalframes; i++) {
-        if (mAPEFrames[i].size > maxframesize) {
-            maxframesize = mAPEFrames[i].size;
-        }
+    mWrapFrames.clear();
+    status_t err = findWraps(offsets, 0, totalframes);
+    if (err != OK) {
+        free(offsets);
+        return err;
     }
+    mFrameOffsets = offsets;
 
-    return maxframesize;
+    err = completeIndex();
+    if (err != OK) {
+        mFrameOffsets = NULL;
+        free(offsets);
+        return err;
+    }
+    return OK;
 }
 
-ApeFrame *APEFrameData::getCurrentFrame(uint32_t framenum){
-    if (framenum >= mApeHeaderData->totalframes) {
-        return NULL;
+//Offsets never go down, so when the last frame starts in front of the wav
+//tail every frame does. A table that points further is corrupt, or the
+//file is truncated; either way frames would be read from past its end.
+//Nothing can be checked when the length of the file is unknown.
+status_t APEFrameData::checkLastFrameOffset() const {
+    off64_t file_size;
+    if (mDataSource->getSize(&file_size) != OK || file_size <= 0) {
+        return OK;
     }
-    return &mAPEFrames[framenum];
-}
 
-ApeHeaderData *APEFrameData::getApeHeaderData(){
-    return mApeHeaderData;
+    off64_t last_pos = getFrameOffset(mApeHeaderData->totalframes - 1);
+    if (last_pos + (off64_t)mApeHeaderData->wavtaillength >= file_size) {
+        LOGE("Seek table points %lld bytes past the frame data",
+                (long long)(last_pos + mApeHeaderData->wavtaillength - file_size + 1));
+        return ERROR_MALFORMED;
+    }
+    return OK;
 }
 
-APEExtractor::APEExtractor(
-        const sp<DataSource> &source)
-        :mDataSource(source),
-         mMeta(new MetaData),
-         mFileMeta(new MetaData),
-         mAPEFrameData(NULL),
-         mInitCheck(NO_INIT) {
-
-    uint16_t channels, bitspersample;
-    uint32_t samplerate;
-    uint64_t durationUs;
-    size_t maxframesize;
-    //Extra data size is 6.
-    uint16_t extradata[3];
-
-    ApeHeaderData *apeheaderdata = NULL;
-
-    mAPEFrameData = new APEFrameData(mDataSource);
-
-    apeheaderdata = mAPEFrameData->getApeHeaderData();
-
-    if (apeheaderdata != NULL) {
-        channels = apeheaderdata->channels;
-        bitspersample = apeheaderdata->bitspersample;
-        samplerate = apeheaderdata->samplerate;
-
-        int64_t tatalblocks = (apeheaderdata->totalframes - 1)
-                        * apeheaderdata->blocksperframe + apeheaderdata->finalframeblocks;
-        //4608 sub frame size.
-        durationUs = tatalblocks/4608;
+//Works out the size of the last frame and of the largest one, and
+//publishes the index. Every entry of mFrameOffsets has to be in.
+status_t APEFrameData::completeIndex() {
+    const uint32_t totalframes = mApeHeaderData->totalframes;
 
-        // Extra data content is consist of version, compression type and format flags.
-        extradata[0] = apeheaderdata->version;
-        extradata[1] = apeheaderdata->compressiontype;
-        extradata[2] = apeheaderdata->formatflags;
+    status_t err = checkLastFrameOffset();
+    if (err != OK) {
+        return err;
+    }
 
-        maxframesize = mAPEFrameData->getMaxFrameSize();
+    off64_t file_size = 0;
+    if (mDataSource->getSize(&file_size) != OK) {
+        file_size = 0;
+    }
 
-        mMeta->setCString(kKeyMIMEType, MEDIA_MIMETYPE_AUDIO_APE);
+    off64_t last_pos = getFrameOffset(totalframes - 1);
 
-        mMeta->setInt32(kKeyChannelCount, channels);
-        mMeta->setInt32(kKeySampleRate, samplerate);
-        mMeta->setInt32(kKeyBitsPerSample,bitspersample);
-        mMeta->setInt64(kKeyDuration, durationUs * 1000 * 100);
-        mMeta->setInt32(kKeyMaxInputSize, maxframesize);
+    //The frame size of the last frame. The frame data ends in front of the
+    //wav tail; 3980 and later also store its exact length, which keeps a
+    //trailing tag out of the last frame, and is all there is to go by when
+    //the length of the file is unknown.
+    int64_t final_size = 0;
+    off64_t data_end = (off64_t)mFrameOffsets[0] + mApeHeaderData->framedatalength;
+    if (file_size > 0) {
+        off64_t end = file_size - mApeHeaderData->wavtaillength;
+        if (mApeHeaderData->framedatalength > 0 && data_end > last_pos && data_end <= end) {
+            end = data_end;
+        }
+        final_size = end - last_pos;
+    } else if (mApeHeaderData->framedatalength > 0 && data_end > last_pos) {
+        final_size = data_end - last_pos;
+    }
+    if (final_size <= 0) {
+        final_size = mApeHeaderData->finalframeblocks * 8;
+    }
+    mFinalFrameSize = final_size;
 
-        mMeta->setData(kFfmpegCodecSpecificData, 0, (uint8_t *)extradata, 6);
+    computeMaxFrameSize();
 
-        mInitCheck = OK;
-    }
+    //Publishes the index, every field above is written by now.
+    android_atomic_release_store(1, &mIndexed);
+    return OK;
 }
 
-size_t APEExtractor::countTracks() {
-    return mInitCheck != OK ? 0 : 1;
+//The first entry is where the frame data starts, which follows from the
+//header just as well and is taken from there.
+uint32_t APEFrameData::getFirstFrameOffset() const {
+    return mApeHeaderData->descriptorlength
+           + mApeHeaderData->headerlength
+           + mApeHeaderData->seektablelength
+           + mApeHeaderData->wavheaderlength;
 }
 
-sp<MediaSource> APEExtractor::getTrack(size_t index) {
-    if (mInitCheck != OK || index != 0) {
-        return NULL;
+status_t APEFrameData::startIncrementalIndex() {
+    if (mInitCheck != OK) {
+        return mInitCheck;
     }
 
-    return new APESource(mMeta, mDataSource, mAPEFrameData);
-}
-
-sp<MetaData> APEExtractor::getTrackMetaData(size_t index, uint32_t flags) {
-    if (mInitCheck != OK || index != 0) {
-        return NULL;
+    Mutex::Autolock autoLock(mIndexLock);
+    if (isIndexed() || mLoaderStarted) {
+        return OK;
     }
 
-    return mMeta;
+    //Allocated up front, the loader fills it in place.
+    mFrameOffsets = (uint32_t *)malloc(mApeHeaderData->totalframes * sizeof(uint32_t));
+    if (!mFrameOffsets) {
+        LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+        return NO_MEMORY;
+    }
+    mWrapFrames.clear();
+    mLoadedFrames = 0;
+    mLoadError = OK;
+    mLoaderStopping = false;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    mLoaderStarted = pthread_create(&mLoaderThread, &attr, LoaderWrapper, this) == 0;
+    pthread_attr_destroy(&attr);
+
+    if (!mLoaderStarted) {
+        LOGE("Failed to start the seek table loader");
+        free(mFrameOffsets);
+        mFrameOffsets = NULL;
+        return UNKNOWN_ERROR;
+    }
+    return OK;
 }
 
-sp<MetaData> APEExtractor::getMetaData() {
-    if (parseAPETag() != OK) {
-        return NULL;
-    }
+// static
+void *APEFrameData::LoaderWrapper(void *me) {
+    static_cast<APEFrameData *>(me)->loaderEntry();
 
-    mFileMeta->setCString(kKeyMIMEType, MEDIA_MIMETYPE_AUDIO_APE);
-    return mFileMeta;
+    return NULL;
 }
 
-static IdTag TagArray[] {{kKeyTitle, "Title", 5},
-                        {kKeyArtist, "Artist", 6},
-                        {kKeyAlbum, "Album", 5},
-                        {kKeyYear, "Year", 4}};
+void APEFrameData::loaderEntry() {
+    const uint32_t totalframes = mApeHeaderData->totalframes;
+    uint8_t entry[APE_INCREMENTAL_CHUNK_SIZE];
 
-status_t APEExtractor::parseAPETag() {
-    off64_t filesize = 0;
-    mDataSource->getSize(&filesize);
-    uint64_t position = filesize - 32; //skip APE Tag Footer
+    Mutex::Autolock autoLock(mIndexLock);
+    while (!mLoaderStopping && mLoadedFrames < totalframes) {
+        uint32_t start = mLoadedFrames;
+        uint32_t count = totalframes - start;
+        if (count > APE_INCREMENTAL_CHUNK_SIZE / sizeof(uint32_t)) {
+            count = APE_INCREMENTAL_CHUNK_SIZE / sizeof(uint32_t);
+        }
 
-    char *tagid = "APETAGEX";
+        //The source may take its time to deliver, readers carry on with the
+        //entries already in meanwhile.
+        mIndexLock.unlock();
+        ssize_t n = mDataSource->readAt(mSeekTableOffset + (off64_t)start * 4, entry,
+                count * sizeof(uint32_t));
+        mIndexLock.lock();
 
-    uint8_t buff[8];
-    for(uint64_t i = position - 1; i > 0; i--) {
-        mDataSource->readAt(i, buff, 8);
-        if (!memcmp(buff, (uint8_t *)tagid, 8)) {
-            position = i;
+        if (n < (ssize_t)(count * sizeof(uint32_t))) {
+            LOGE("Truncated seek table at entry %u", start);
+            mLoadError = ERROR_MALFORMED;
             break;
         }
-    }
-
-    size_t tagsize = filesize - position;
-    uint8_t *tagdata = (uint8_t *)malloc(tagsize);
-    mDataSource->readAt(position, tagdata, tagsize);
-
-    uint32_t version = U32LE_AT(tagdata + 8);
-    uint32_t itemnum = U32LE_AT(tagdata + 16);
-
-    position = 32; //start from tagdata[32] to parse.
-    for (int i = 0; i < itemnum; i++) {
-        String8 key;
-        String8 value;
-
-        uint32_t len = U32LE_AT(tagdata + position);
-        position += 8; //skip len and flag
 
-        uint64_t tmppos = position;
-        while (1) {
-            if (tagdata[tmppos] == 0x00) {
-                break;
-            }
-            tmppos++;
+        for (uint32_t i = 0; i < count; i++) {
+            mFrameOffsets[start + i] = readLE32(&entry[i * 4]);
+        }
+        if (start == 0) {
+            mFrameOffsets[0] = getFirstFrameOffset();
+        }
+        mLoadError = findWraps(mFrameOffsets, start, start + count);
+        if (mLoadError != OK) {
+            break;
         }
 
-        char string[40];
-        memcpy(string, tagdata + position, tmppos - position);
-        key.setTo(string, tmppos - position);
-
-        memcpy(string, tagdata + tmppos + 1, len);
-        value.setTo(string, len);
-
-        ALOGV("key %s, vlaue %s\n", key.string(), value.string());
-
-        for (int i = 0; i < sizeof(TagArray)/sizeof(TagArray[0]); i++) {
-            if (!strncmp(key.string(), TagArray[i].type, TagArray[i].size)) {
-                mFileMeta->setCString(TagArray[i].key, value.string());
+        //A bad last entry fails the index before the last frames are
+        //published, the ones before stay readable.
+        if (start + count == totalframes) {
+            mLoadError = completeIndex();
+            if (mLoadError != OK) {
                 break;
             }
         }
-
-        position = tmppos + 1;
-        position += len;
+        mLoadedFrames = start + count;
+        mIndexCondition.broadcast();
     }
 
-    return OK;
-}
-
-APESource::APESource(
-        const sp<MetaData> &meta, const sp<DataSource> &source, sp<APEFrameData> apeframedata)
-        :mMeta(meta),
-         mDataSource(source),
-         mAPEFrameData(apeframedata),
-         mGroup(NULL),
-         mCurrentFrameNum(0) {
+    //Also wakes up waiters after a failure, they give up on mLoadError.
+    mIndexCondition.broadcast();
 }
 
-APESource::~APESource() {
-    stop();
+//An entry only tells where its frame starts, the frame is usable once
+//the entry after it, or for the last frame the whole table, is in.
+bool APEFrameData::isFrameLoaded_l(uint32_t framenum) const {
+    return isIndexed() || framenum + 1 < mLoadedFrames;
 }
 
-status_t APESource::start(MetaData *) {
-    mGroup = new MediaBufferGroup;
-    const size_t kMaxFrameSize = mAPEFrameData->getMaxFrameSize();
-    mGroup->add_buffer(new MediaBuffer(kMaxFrameSize));
+bool APEFrameData::isFrameAvailable(uint32_t framenum) const {
+    if (mInitCheck != OK || framenum >= mApeHeaderData->totalframes) {
+        return false;
+    }
+    if (isIndexed()) {
+        return true;
+    }
 
-    return OK;
+    Mutex::Autolock autoLock(mIndexLock);
+    return isFrameLoaded_l(framenum);
 }
 
-status_t APESource::stop() {
-    delete mGroup;
-    mGroup = NULL;
+status_t APEFrameData::waitForFrame(uint32_t framenum, volatile const int32_t *abort) {
+    if (mInitCheck != OK) {
+        return mInitCheck;
+    }
+    if (framenum >= mApeHeaderData->totalframes) {
+        return ERROR_END_OF_STREAM;
+    }
+    if (isIndexed()) {
+        return OK;
+    }
 
+    Mutex::Autolock autoLock(mIndexLock);
+    while (!isFrameLoaded_l(framenum)) {
+        if (!mLoaderStarted || mLoaderStopping
+                || (abort != NULL && android_atomic_acquire_load(abort))) {
+            return NO_INIT;
+        }
+        if (mLoadError != OK) {
+            return mLoadError;
+        }
+        mIndexCondition.wait(mIndexLock);
+    }
     return OK;
 }
 
-sp<MetaData> APESource::getFormat() {
-    return mMeta;
+void APEFrameData::abortWaits() {
+    Mutex::Autolock autoLock(mIndexLock);
+    mIndexCondition.broadcast();
 }
 
-status_t APESource::read(
-        MediaBuffer **out, const ReadOptions *options) {
-    *out = NULL;
-    int64_t seekTimeUs;
-    ReadOptions::SeekMode mode;
-    bool seekCBR = false;
-
-    if (options != NULL && options->getSeekTo(&seekTimeUs, &mode)) {
-        int32_t framenum;
-        mAPEFrameData->getRequiredFrameNum(seekTimeUs, &framenum);
-        mCurrentFrameNum = framenum;
+//The seek table only holds the low 32 bits of every offset. Offsets never
+//go down, so a large step down marks the start of the next 4 GB of the
+//file; a small one is a corrupt table.
+status_t APEFrameData::findWraps(const uint32_t *offsets, uint32_t start, uint32_t end) {
+    for (uint32_t i = start > 0 ? start : 1; i < end; i++) {
+        if (offsets[i] >= offsets[i - 1]) {
+            continue;
+        }
+        if (offsets[i - 1] - offsets[i] < 0x80000000U) {
+            LOGE("Seek table goes back at frame %u", i);
+            return ERROR_MALFORMED;
+        }
+        mWrapFrames.push(i);
     }
 
-    ApeHeaderData *apeheaderdata = mAPEFrameData->getApeHeaderData();
-
-    if (mCurrentFrameNum >= apeheaderdata->totalframes){
-        return ERROR_END_OF_STREAM;
+    if (!mWrapFrames.isEmpty() && end == mApeHeaderData->totalframes) {
+        ALOGV("Frame offsets wrap %zu times", mWrapFrames.size());
     }
+    return OK;
+}
 
-    MediaBuffer *buffer;
-    status_t err = mGroup->acquire_buffer(&buffer);
-    if (err != OK) {
-        return err;
+off64_t APEFrameData::getFrameOffset(uint32_t framenum) const {
+    uint64_t high = 0;
+    for (size_t i = 0; i < mWrapFrames.size() && mWrapFrames[i] <= framenum; i++) {
+        high++;
     }
+    return (off64_t)((high << 32) | mFrameOffsets[framenum]);
+}
+
+APEFrameData::~APEFrameData() {
+    if (mLoaderStarted) {
+        {
+            Mutex::Autolock autoLock(mIndexLock);
+            mLoaderStopping = true;
+        }
+        pthread_join(mLoaderThread, NULL);
+        mLoaderStarted = false;
+    }
+
+    free(mApeHeaderData);
+    mApeHeaderData = NULL;
+
+    free(mFrameOffsets);
+    mFrameOffsets = NULL;
+}
+
+status_t APEFrameData::getRequiredFrameNum(int64_t seekTimeUs,
+        MediaSource::ReadOptions::SeekMode mode, int32_t *frameNum, int32_t *skipSamples) const {
+    //Every frame but the last holds exactly blocksperframe samples, so the
+    //target frame follows directly from the requested sample.
+    const uint32_t blocksperframe = mApeHeaderData->blocksperframe;
+    int64_t targetsample = 0;
+    if (seekTimeUs > 0) {
+        targetsample = seekTimeUs * mApeHeaderData->samplerate / 1000000;
+    }
+
+    int64_t framenum = targetsample / blocksperframe;
+    int32_t offset = targetsample % blocksperframe;
+    *skipSamples = 0;
+
+    switch (mode) {
+        case MediaSource::ReadOptions::SEEK_NEXT_SYNC:
+            if (offset > 0) {
+                framenum++;
+            }
+            break;
+        case MediaSource::ReadOptions::SEEK_CLOSEST_SYNC:
+            if ((uint32_t)offset * 2 >= blocksperframe
+                    && framenum + 1 < mApeHeaderData->totalframes) {
+                framenum++;
+            }
+            break;
+        case MediaSource::ReadOptions::SEEK_CLOSEST:
+            *skipSamples = offset;
+            break;
+        default:
+            break;
+    }
+
+    if (framenum >= mApeHeaderData->totalframes) {
+        //Past the end, the next read() reports ERROR_END_OF_STREAM.
+        framenum = mApeHeaderData->totalframes;
+        *skipSamples = 0;
+    } else if (framenum == mApeHeaderData->totalframes - 1
+            && (uint32_t)*skipSamples > mApeHeaderData->finalframeblocks) {
+        *skipSamples = mApeHeaderData->finalframeblocks;
+    }
+
+    *frameNum = framenum;
+    return OK;
+}
+
+int64_t APEFrameData::getFrameTimeUs(uint32_t framenum) const {
+    return (int64_t)framenum * mApeHeaderData->blocksperframe * 1000000
+            / mApeHeaderData->samplerate;
+}
+
+void APEFrameData::computeMaxFrameSize(){
+    mMaxFrameSize = 0;
+
+    for (uint32_t i = 0; i < mApeHeaderData->totalframes; i++) {
+        ApeFrame frame = makeFrame(i);
+        if (frame.size > mMaxFrameSize) {
+            mMaxFrameSize = frame.size;
+        }
+    }
+}
+
+size_t APEFrameData::getMaxFrameSize() const {
+    if (!isIndexed()) {
+        return getMaxFrameSizeEstimate();
+    }
+    return mMaxFrameSize;
+}
+
+size_t APEFrameData::getIndexMemory() const {
+    size_t bytes = sizeof(*this) + sizeof(ApeHeaderData);
+    if (mFrameOffsets != NULL) {
+        bytes += mApeHeaderData->totalframes * sizeof(uint32_t);
+    }
+    //The loader of an incremental index may still add to the wrap list.
+    if (isIndexed()) {
+        bytes += mWrapFrames.size() * sizeof(uint32_t);
+    }
+    return bytes;
+}
+
+size_t APEFrameData::getMaxFrameSizeEstimate() const {
+    //A frame does not in practice grow beyond the PCM it encodes, and can
+    //never be larger than the audio data in the file.
+    uint64_t estimate = (uint64_t)mApeHeaderData->blocksperframe * mApeHeaderData->channels
+                        * ((mApeHeaderData->bitspersample + 7) / 8);
+
+    off64_t file_size = 0;
+    if (mDataSource->getSize(&file_size) == OK && file_size > mSeekTableOffset
+            && (uint64_t)(file_size - mSeekTableOffset) < estimate) {
+        estimate = file_size - mSeekTableOffset;
+    }
+
+    return estimate;
+}
+
+bool APEFrameData::isIndexed() const {
+    return android_atomic_acquire_load(&mIndexed) != 0;
+}
+
+ApeFrame APEFrameData::getCurrentFrame(uint32_t framenum) const {
+    if (isIndexed()) {
+        return makeFrame(framenum);
+    }
+
+    //An incremental index is still being written, its entries are only
+    //stable under the lock.
+    Mutex::Autolock autoLock(mIndexLock);
+    if (!isFrameLoaded_l(framenum)) {
+        ApeFrame frame;
+        memset(&frame, 0, sizeof(frame));
+        return frame;
+    }
+    return makeFrame(framenum);
+}
+
+//getCurrentFrame() without the check that the frame is published, for
+//the index code itself.
+ApeFrame APEFrameData::makeFrame(uint32_t framenum) const {
+    ApeFrame frame;
+    memset(&frame, 0, sizeof(frame));
+
+    if (framenum >= mApeHeaderData->totalframes) {
+        return frame;
+    }
+
+    //Frames start on 32-bit boundaries relative to the first frame, so the
+    //position is moved back by skip bytes and the size grown to match.
+    off64_t pos = getFrameOffset(framenum);
+    frame.skip = (pos - mFrameOffsets[0]) & 3;
+    frame.pos = pos - frame.skip;
+    if (framenum + 1 < mApeHeaderData->totalframes) {
+        frame.nblocks = mApeHeaderData->blocksperframe;
+        frame.size = (getFrameOffset(framenum + 1) - pos + frame.skip + 3) & ~3;
+    } else {
+        //Not rounded up, the frame data may end just short of a whole word
+        //at the end of the file.
+        frame.nblocks = mApeHeaderData->finalframeblocks;
+        frame.size = mFinalFrameSize + frame.skip;
+    }
+    frame.pts = getFrameTimeUs(framenum);
+
+    return frame;
+}
+
+const ApeHeaderData *APEFrameData::getApeHeaderData() const {
+    return mApeHeaderData;
+}
+
+status_t APEFrameData::initCheck() const {
+    return mInitCheck;
+}
+
+APEFrameData::APEFrameData(const sp<DataSource> &source, const void *buffer, size_t size)
+        :mDataSource(source),
+        mApeHeaderData(NULL),
+        mFrameOffsets(NULL),
+        mFinalFrameSize(0),
+        mSeekTableOffset(0),
+        mMaxFrameSize(0),
+        mIndexed(0),
+        mLoaderStarted(false),
+        mLoaderStopping(false),
+        mLoadedFrames(0),
+        mLoadError(OK),
+        mInitCheck(NO_INIT) {
+    const uint8_t *data = (const uint8_t *)buffer;
+    if (size < APE_FLATTENED_HEADER_SIZE) {
+        return;
+    }
+
+    mApeHeaderData = (ApeHeaderData *)malloc(sizeof(ApeHeaderData));
+    if (!mApeHeaderData) {
+        LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+        return;
+    }
+
+    mApeHeaderData->version          = readLE32(&data[0]);
+    mApeHeaderData->descriptorlength = readLE32(&data[4]);
+    mApeHeaderData->headerlength     = readLE32(&data[8]);
+    mApeHeaderData->seektablelength  = readLE32(&data[12]);
+    mApeHeaderData->wavheaderlength  = readLE32(&data[16]);
+    mApeHeaderData->wavtaillength    = readLE32(&data[20]);
+    mApeHeaderData->compressiontype  = readLE32(&data[24]);
+    mApeHeaderData->formatflags      = readLE32(&data[28]);
+    mApeHeaderData->blocksperframe   = readLE32(&data[32]);
+    mApeHeaderData->finalframeblocks = readLE32(&data[36]);
+    mApeHeaderData->totalframes      = readLE32(&data[40]);
+    mApeHeaderData->bitspersample    = readLE32(&data[44]);
+    mApeHeaderData->channels         = readLE32(&data[48]);
+    mApeHeaderData->samplerate       = readLE32(&data[52]);
+    mApeHeaderData->durationUS       = readLE64(&data[56]);
+    mFinalFrameSize                  = readLE32(&data[64]);
+    mMaxFrameSize                    = readLE32(&data[68]);
+    mApeHeaderData->framedatalength  = readLE64(&data[72]);
+    memcpy(mApeHeaderData->md5, &data[80], sizeof(mApeHeaderData->md5));
+
+    const uint32_t totalframes = mApeHeaderData->totalframes;
+    if (totalframes == 0 || mApeHeaderData->samplerate == 0
+            || mApeHeaderData->blocksperframe == 0
+            || (size - APE_FLATTENED_HEADER_SIZE) / sizeof(uint32_t) != totalframes) {
+        LOGE("Corrupt flattened frame index");
+        return;
+    }
+
+    mFrameOffsets = (uint32_t *)malloc(totalframes * sizeof(uint32_t));
+    if (!mFrameOffsets) {
+        LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+        return;
+    }
+    for (uint32_t i = 0; i < totalframes; i++) {
+        mFrameOffsets[i] = readLE32(&data[APE_FLATTENED_HEADER_SIZE + i * 4]);
+    }
+    if (findWraps(mFrameOffsets, 0, totalframes) != OK
+            || checkLastFrameOffset() != OK) {
+        return;
+    }
+
+    mIndexed = 1;
+    mInitCheck = OK;
+}
+
+size_t APEFrameData::getFlattenedSize() const {
+    if (mInitCheck != OK || !isIndexed()) {
+        return 0;
+    }
+    return APE_FLATTENED_HEADER_SIZE + mApeHeaderData->totalframes * sizeof(uint32_t);
+}
+
+status_t APEFrameData::flatten(void *buffer, size_t size) const {
+    uint8_t *data = (uint8_t *)buffer;
+    if (mInitCheck != OK || !isIndexed() || size < getFlattenedSize()) {
+        return BAD_VALUE;
+    }
+
+    memset(data, 0, APE_FLATTENED_HEADER_SIZE);
+    writeLE32(&data[0], mApeHeaderData->version);
+    writeLE32(&data[4], mApeHeaderData->descriptorlength);
+    writeLE32(&data[8], mApeHeaderData->headerlength);
+    writeLE32(&data[12], mApeHeaderData->seektablelength);
+    writeLE32(&data[16], mApeHeaderData->wavheaderlength);
+    writeLE32(&data[20], mApeHeaderData->wavtaillength);
+    writeLE32(&data[24], mApeHeaderData->compressiontype);
+    writeLE32(&data[28], mApeHeaderData->formatflags);
+    writeLE32(&data[32], mApeHeaderData->blocksperframe);
+    writeLE32(&data[36], mApeHeaderData->finalframeblocks);
+    writeLE32(&data[40], mApeHeaderData->totalframes);
+    writeLE32(&data[44], mApeHeaderData->bitspersample);
+    writeLE32(&data[48], mApeHeaderData->channels);
+    writeLE32(&data[52], mApeHeaderData->samplerate);
+    writeLE64(&data[56], mApeHeaderData->durationUS);
+    writeLE32(&data[64], mFinalFrameSize);
+    writeLE32(&data[68], mMaxFrameSize);
+    writeLE64(&data[72], mApeHeaderData->framedatalength);
+    memcpy(&data[80], mApeHeaderData->md5, sizeof(mApeHeaderData->md5));
+
+    for (uint32_t i = 0; i < mApeHeaderData->totalframes; i++) {
+        writeLE32(&data[APE_FLATTENED_HEADER_SIZE + i * 4], mFrameOffsets[i]);
+    }
+
+    return OK;
+}
+
+//The APE stream of a file that starts with ID3v2 tags. Offsets in the
+//header and seek table count from the start of the stream, so everything
+//reads through this rather than adding the offset everywhere.
+class APEOffsetSource : public DataSource {
+public:
+    APEOffsetSource(const sp<DataSource> &source, off64_t offset)
+        :mSource(source),
+         mOffset(offset) {
+    }
+
+    virtual status_t initCheck() const {
+        return mSource->initCheck();
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        return mSource->readAt(offset + mOffset, data, size);
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        status_t err = mSource->getSize(size);
+        if (err == OK) {
+            *size = *size > mOffset ? *size - mOffset : 0;
+        }
+        return err;
+    }
+
+    virtual uint32_t flags() {
+        return mSource->flags();
+    }
+
+    virtual String8 getUri() {
+        return mSource->getUri();
+    }
+
+private:
+    sp<DataSource> mSource;
+    off64_t mOffset;
+
+    APEOffsetSource(const APEOffsetSource &);
+    APEOffsetSource &operator=(const APEOffsetSource &);
+};
+
+sp<DataSource> APEFrameData::getStreamSource(const sp<DataSource> &source) {
+    uint8_t buff[ID3V2_HEADER_SIZE];
+    off64_t offset;
+    readStreamStart(source, buff, sizeof(buff), &offset);
+    if (offset == 0) {
+        return source;
+    }
+    return new APEOffsetSource(source, offset);
+}
+
+//The same at the offset SniffAPE() found, if it ran.
+static sp<DataSource> getStreamSource(const sp<DataSource> &source,
+        const sp<AMessage> &meta) {
+    int64_t offset;
+    if (meta == NULL || !meta->findInt64("offset", &offset)) {
+        return APEFrameData::getStreamSource(source);
+    }
+    if (offset <= 0) {
+        return source;
+    }
+    return new APEOffsetSource(source, offset);
+}
+
+//Streams, and sources that cannot tell their length, hand out the file
+//front to back as it arrives, so neither the whole seek table nor the tag
+//at the end should be waited for.
+static bool useIncrementalOpen(const sp<DataSource> &source) {
+    char value[PROPERTY_VALUE_MAX];
+    if (property_get("media.ape.incremental", value, NULL) > 0) {
+        return strtol(value, NULL, 0) != 0;
+    }
+
+    off64_t size;
+    return (source->flags() & DataSource::kIsCachingDataSource)
+            || source->getSize(&size) != OK;
+}
+
+APEExtractor::APEExtractor(
+        const sp<DataSource> &source, const sp<AMessage> &meta)
+        :mDataSource(APETraceSource::wrap(getStreamSource(source, meta))),
+         mMeta(new MetaData),
+         mFileMeta(new MetaData),
+         mAPEFrameData(NULL),
+         mAPETagData(NULL),
+         mTagParsed(false),
+         mBlockCacheCreated(false),
+         mIncremental(false),
+         mInitCheck(NO_INIT) {
+
+    uint16_t channels, bitspersample;
+    uint32_t samplerate;
+    uint64_t durationUs;
+    size_t maxframesize;
+    //Extra data size is 6.
+    uint16_t extradata[3];
+
+    const ApeHeaderData *apeheaderdata = NULL;
+
+    //A cache hit restores both the frame index and the tags without
+    //touching the seek table or the tag region.
+    //Without one only the header is parsed here, and the seek table is left
+    //for the first getTrack(), or for the loader of an incremental open.
+    mStats = APEStats::create();
+    if (mStats != NULL) {
+        mStatsSource = new APEStatsSource(mDataSource, mStats);
+    }
+    mIncremental = useIncrementalOpen(mDataSource);
+
+    //The cache key covers the end of the file, which an incremental open
+    //would have to wait for.
+    mIndexCache = mIncremental ? NULL : APEIndexCache::getInstance();
+    nsecs_t startNs = beginPhase(APEStats::PHASE_INDEX_CACHE);
+    if (mIndexCache != NULL && mIndexCache->getKey(getParseSource(), &mIndexKey) == OK
+            && mIndexCache->load(mIndexKey, getParseSource(),
+                                 &mAPEFrameData, &mAPETagData) == OK) {
+        endPhase(APEStats::PHASE_INDEX_CACHE, startNs);
+        mIndexCache = NULL;
+        if (mStats != NULL) {
+            mStats->setIndexMemory(mAPEFrameData->getIndexMemory());
+        }
+    } else {
+        endPhase(APEStats::PHASE_INDEX_CACHE, startNs);
+        //The sniffer may have parsed the header already.
+        sp<ABuffer> header;
+        int64_t seektableoffset;
+        startNs = beginPhase(APEStats::PHASE_HEADER);
+        if (meta != NULL && meta->findBuffer("ape-header", &header)
+                && header->size() == sizeof(ApeHeaderData)
+                && meta->findInt64("ape-seek-table-offset", &seektableoffset)) {
+            mAPEFrameData = new APEFrameData(getParseSource(),
+                    *(const ApeHeaderData *)header->data(), seektableoffset);
+        } else {
+            mAPEFrameData = new APEFrameData(getParseSource());
+        }
+        endPhase(APEStats::PHASE_HEADER, startNs);
+    }
+
+    apeheaderdata = mAPEFrameData->getApeHeaderData();
+
+    if (mIncremental && mAPEFrameData->initCheck() == OK) {
+        if (mAPEFrameData->startIncrementalIndex() != OK) {
+            mIncremental = false;
+        } else if (mStats != NULL) {
+            mStats->setIndexMemory(mAPEFrameData->getIndexMemory());
+        }
+    }
+
+    if (apeheaderdata != NULL && mAPEFrameData->initCheck() == OK) {
+        channels = apeheaderdata->channels;
+        bitspersample = apeheaderdata->bitspersample;
+        samplerate = apeheaderdata->samplerate;
+
+        durationUs = apeheaderdata->durationUS;
+
+        // Extra data content is consist of version, compression type and format flags.
+        extradata[0] = apeheaderdata->version;
+        extradata[1] = apeheaderdata->compressiontype;
+        extradata[2] = apeheaderdata->formatflags;
+
+        //Only an estimate until the index is built.
+        maxframesize = mAPEFrameData->getMaxFrameSize();
+
+        mMeta->setCString(kKeyMIMEType, MEDIA_MIMETYPE_AUDIO_APE);
+
+        mMeta->setInt32(kKeyChannelCount, channels);
+        mMeta->setInt32(kKeySampleRate, samplerate);
+        mMeta->setInt32(kKeyBitsPerSample,bitspersample);
+        mMeta->setInt64(kKeyDuration, durationUs);
+        mMeta->setInt32(kKeyMaxInputSize, maxframesize);
+
+        mMeta->setData(kFfmpegCodecSpecificData, 0, (uint8_t *)extradata, 6);
+
+        mInitCheck = OK;
+    }
+}
+
+// static
+sp<APEExtractor> APEExtractor::createMapped(const sp<APEMappedFileSource> &source,
+        const sp<AMessage> &meta) {
+    sp<APEExtractor> extractor = new APEExtractor(source, meta);
+    if (extractor->mDataSource.get() == source.get()) {
+        extractor->mMappedSource = source;
+    }
+    return extractor;
+}
+
+status_t APEExtractor::buildIndex_l() {
+    if (mAPEFrameData->isIndexed()) {
+        return OK;
+    }
+
+    nsecs_t startNs = beginPhase(APEStats::PHASE_SEEK_TABLE);
+    status_t err = mAPEFrameData->buildIndex();
+    endPhase(APEStats::PHASE_SEEK_TABLE, startNs);
+    if (err != OK) {
+        return err;
+    }
+
+    if (mStats != NULL) {
+        mStats->setIndexMemory(mAPEFrameData->getIndexMemory());
+    }
+
+    mMeta->setInt32(kKeyMaxInputSize, mAPEFrameData->getMaxFrameSize());
+    for (size_t i = 0; i < mTracks.size(); i++) {
+        mTracks[i].meta->setInt32(kKeyMaxInputSize, mAPEFrameData->getMaxFrameSize());
+    }
+
+    if (mIndexCache != NULL) {
+        parseAPETag_l();
+        mIndexCache->save(mIndexKey, mAPEFrameData, mAPETagData);
+        mIndexCache = NULL;
+    }
+    return OK;
+}
+
+size_t APEExtractor::countTracks() {
+    if (mInitCheck != OK) {
+        return 0;
+    }
+
+    //The cue sheet lives in the tag.
+    Mutex::Autolock autoLock(mLock);
+    loadTag_l();
+    return mTracks.isEmpty() ? 1 : mTracks.size();
+}
+
+sp<MediaSource> APEExtractor::getTrack(size_t index) {
+    if (mInitCheck != OK) {
+        return NULL;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    loadTag_l();
+    if (mTracks.isEmpty()) {
+        return index == 0 ? getFileTrack_l() : NULL;
+    }
+    if (index >= mTracks.size() || buildIndex_l() != OK) {
+        return NULL;
+    }
+
+    //All tracks share the one index, so switching tracks costs no I/O.
+    const Track &track = mTracks[index];
+    return new APESource(track.meta, getFrameSource_l(), mAPEFrameData, mStats,
+            track.startsample, track.endsample, mMappedSource);
+}
+
+sp<MediaSource> APEExtractor::getFileTrack() {
+    if (mInitCheck != OK) {
+        return NULL;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    return getFileTrack_l();
+}
+
+sp<MediaSource> APEExtractor::getFileTrack_l() {
+    //An incremental index is usable from its first entries on.
+    if (!mIncremental && buildIndex_l() != OK) {
+        return NULL;
+    }
+
+    return new APESource(mMeta, getFrameSource_l(), mAPEFrameData, mStats,
+            0, getTotalSamples(), mMappedSource);
+}
+
+//Frames are read through the block cache, unless it is disabled or the
+//file is mapped, in memory already. It is created with the first track,
+//metadata-only opens never pay for it.
+sp<DataSource> APEExtractor::getFrameSource_l() {
+    if (!mBlockCacheCreated && mMappedSource == NULL) {
+        mBlockCache = APEBlockCache::create(mDataSource);
+        mBlockCacheCreated = true;
+    }
+    if (mBlockCache != NULL) {
+        return mBlockCache;
+    }
+    return mDataSource;
+}
+
+uint64_t APEExtractor::getTotalSamples() {
+    const ApeHeaderData *apeheaderdata = mAPEFrameData->getApeHeaderData();
+    return (uint64_t)(apeheaderdata->totalframes - 1) * apeheaderdata->blocksperframe
+            + apeheaderdata->finalframeblocks;
+}
+
+sp<APEFrameData> APEExtractor::getFrameData() {
+    if (mInitCheck != OK) {
+        return NULL;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    if (buildIndex_l() != OK) {
+        return NULL;
+    }
+    return mAPEFrameData;
+}
+
+sp<APEStats> APEExtractor::getStats() {
+    return mStats;
+}
+
+sp<APEBlockCache> APEExtractor::getBlockCache() {
+    Mutex::Autolock autoLock(mLock);
+    return mBlockCache;
+}
+
+sp<DataSource> APEExtractor::getParseSource() {
+    if (mStatsSource != NULL) {
+        return mStatsSource;
+    }
+    return mDataSource;
+}
+
+nsecs_t APEExtractor::beginPhase(APEStats::Phase phase) {
+    if (mStats == NULL) {
+        return 0;
+    }
+    mStatsSource->setPhase(phase);
+    return systemTime();
+}
+
+void APEExtractor::endPhase(APEStats::Phase phase, nsecs_t startNs) {
+    if (mStats != NULL) {
+        mStats->addPhaseTime(phase, systemTime() - startNs);
+    }
+}
+
+sp<MetaData> APEExtractor::getTrackMetaData(size_t index, uint32_t flags) {
+    if (mInitCheck != OK) {
+        return NULL;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    loadTag_l();
+    if (mTracks.isEmpty()) {
+        return index == 0 ? mMeta : NULL;
+    }
+    return index < mTracks.size() ? mTracks[index].meta : NULL;
+}
+
+sp<MetaData> APEExtractor::getMetaData() {
+    //A missing tag is not an error, the file still has a MIME type.
+    Mutex::Autolock autoLock(mLock);
+    loadTag_l();
+
+    mFileMeta->setCString(kKeyMIMEType, MEDIA_MIMETYPE_AUDIO_APE);
+    return mFileMeta;
+}
+
+static IdTag TagArray[] {{kKeyTitle, "Title", 5},
+                        {kKeyArtist, "Artist", 6},
+                        {kKeyAlbum, "Album", 5},
+                        {kKeyYear, "Year", 4},
+                        {kKeyAlbumArtist, "Album Artist", 12},
+                        {kKeyComposer, "Composer", 8},
+                        {kKeyGenre, "Genre", 5},
+                        {kKeyCDTrackNumber, "Track", 5},
+                        {kKeyDiscNumber, "Disc", 4}};
+
+status_t APEExtractor::parseAPETag() {
+    Mutex::Autolock autoLock(mLock);
+    return parseAPETag_l();
+}
+
+status_t APEExtractor::parseAPETag_l() {
+    if (mTagParsed) {
+        return mAPETagData->initCheck();
+    }
+    mTagParsed = true;
+
+    if (mAPETagData == NULL) {
+        nsecs_t startNs = beginPhase(APEStats::PHASE_TAG);
+        mAPETagData = new APETagData(getParseSource());
+        endPhase(APEStats::PHASE_TAG, startNs);
+    }
+    if (mAPETagData->initCheck() != OK) {
+        return mAPETagData->initCheck();
+    }
+
+    for (size_t i = 0; i < mAPETagData->countItems(); i++) {
+        const ApeTagItem *item = mAPETagData->getItem(i);
+        if ((item->flags & APE_TAG_ITEM_TYPE_MASK) != APE_TAG_ITEM_TYPE_UTF8) {
+            continue;
+        }
+
+        ALOGV("key %s, value %s\n", item->key.string(), item->value.string());
+
+        //Tracks appearing only once the file is complete would change the
+        //track count under the player, so streams keep a single one.
+        if (!strcasecmp(item->key.string(), "Cuesheet") && mInitCheck == OK
+                && !mIncremental) {
+            buildTracks_l(item->value);
+            continue;
+        }
+
+        for (size_t j = 0; j < sizeof(TagArray)/sizeof(TagArray[0]); j++) {
+            if (item->key.length() == TagArray[j].size
+                    && !strncasecmp(item->key.string(), TagArray[j].type, TagArray[j].size)) {
+                mFileMeta->setCString(TagArray[j].key, item->value.string());
+                break;
+            }
+        }
+    }
+
+    return OK;
+}
+
+status_t APEExtractor::readTagItem(const char *key, MediaBuffer **buffer) {
+    *buffer = NULL;
+
+    ApeTagItem item;
+    status_t err = findTagItem(key, false, &item);
+    if (err != OK) {
+        return err;
+    }
+    return readTagValue(item, buffer);
+}
+
+//Recognizes the formats Android decodes, NULL for anything else.
+static const char *sniffImageMIME(const uint8_t *data, size_t size) {
+    if (size >= 3 && data[0] == 0xff && data[1] == 0xd8 && data[2] == 0xff) {
+        return "image/jpeg";
+    }
+    if (size >= 8 && !memcmp(data, "\x89PNG\r\n\x1a\n", 8)) {
+        return "image/png";
+    }
+    if (size >= 4 && !memcmp(data, "GIF8", 4)) {
+        return "image/gif";
+    }
+    if (size >= 12 && !memcmp(data, "RIFF", 4) && !memcmp(data + 8, "WEBP", 4)) {
+        return "image/webp";
+    }
+    if (size >= 2 && data[0] == 'B' && data[1] == 'M') {
+        return "image/bmp";
+    }
+    return NULL;
+}
+
+status_t APEExtractor::getAlbumArt(MediaBuffer **buffer) {
+    *buffer = NULL;
+
+    ApeTagItem item;
+    status_t err = findTagItem("Cover Art (Front)", true, &item);
+    if (err != OK) {
+        return err;
+    }
+    err = readTagValue(item, buffer);
+    if (err != OK) {
+        return err;
+    }
+
+    //The value is the file name of the picture, a NUL and the image. Some
+    //writers leave the name out, which shows as an image right away.
+    const uint8_t *data = (const uint8_t *)(*buffer)->data();
+    size_t size = (*buffer)->size();
+    size_t start = 0;
+    if (sniffImageMIME(data, size) == NULL) {
+        const uint8_t *nul = (const uint8_t *)memchr(data, 0,
+                size < APE_TAG_WINDOW_SIZE ? size : APE_TAG_WINDOW_SIZE);
+        if (nul != NULL) {
+            start = nul - data + 1;
+        }
+    }
+    (*buffer)->set_range(start, size - start);
+
+    const char *mime = sniffImageMIME(data + start, size - start);
+    if (mime != NULL) {
+        (*buffer)->meta_data()->setCString(kKeyAlbumArtMIME, mime);
+    }
+    return OK;
+}
+
+//Copies the item out of the tag index, so that its value can be read
+//without holding mLock. With cover set, any binary "Cover Art" item will
+//do when key itself is missing.
+status_t APEExtractor::findTagItem(const char *key, bool cover, ApeTagItem *item) {
+    Mutex::Autolock autoLock(mLock);
+    loadTag_l();
+    if (mAPETagData == NULL || mAPETagData->initCheck() != OK) {
+        return NAME_NOT_FOUND;
+    }
+
+    const ApeTagItem *found = mAPETagData->findItem(key);
+    for (size_t i = 0; cover && found == NULL && i < mAPETagData->countItems(); i++) {
+        const ApeTagItem *candidate = mAPETagData->getItem(i);
+        if (!strncasecmp(candidate->key.string(), "Cover Art", 9)) {
+            found = candidate;
+        }
+    }
+    if (found == NULL || (cover
+            && (found->flags & APE_TAG_ITEM_TYPE_MASK) != APE_TAG_ITEM_TYPE_BINARY)) {
+        return NAME_NOT_FOUND;
+    }
+
+    *item = *found;
+    return OK;
+}
+
+status_t APEExtractor::readTagValue(const ApeTagItem &item, MediaBuffer **buffer) {
+    //Text values are in memory already, and those from ID3v1 have no
+    //place of their own in the file.
+    if ((item.flags & APE_TAG_ITEM_TYPE_MASK) == APE_TAG_ITEM_TYPE_UTF8) {
+        *buffer = new MediaBuffer(item.value.length());
+        memcpy((*buffer)->data(), item.value.string(), item.value.length());
+        return OK;
+    }
+
+    if (mMappedSource != NULL) {
+        const uint8_t *data = mMappedSource->getData(item.offset, item.size);
+        if (data == NULL) {
+            return ERROR_MALFORMED;
+        }
+
+        //No observer, the buffer is deleted on release and the mapping
+        //lives as long as the data source.
+        *buffer = new MediaBuffer((void *)data, item.size);
+        return OK;
+    }
+
+    MediaBuffer *out = new MediaBuffer(item.size);
+    if (item.size > 0 && out->data() == NULL) {
+        LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+        out->release();
+        return NO_MEMORY;
+    }
+    if (mDataSource->readAt(item.offset, out->data(), item.size) < (ssize_t)item.size) {
+        out->release();
+        return ERROR_IO;
+    }
+
+    *buffer = out;
+    return OK;
+}
+
+//Reads the tag on first use, unless the file is still arriving: the tag
+//is at its very end, and only an explicit parseAPETag() waits for that.
+void APEExtractor::loadTag_l() {
+    if (!mIncremental) {
+        parseAPETag_l();
+    }
+}
+
+void APEExtractor::buildTracks_l(const String8 &text) {
+    sp<APECueSheet> cuesheet = new APECueSheet(text.string(), text.length());
+    if (cuesheet->initCheck() != OK) {
+        return;
+    }
+
+    const ApeHeaderData *apeheaderdata = mAPEFrameData->getApeHeaderData();
+    const uint32_t samplerate = apeheaderdata->samplerate;
+    const uint64_t totalsamples = getTotalSamples();
+    const size_t count = cuesheet->countTracks();
+
+    for (size_t i = 0; i < count; i++) {
+        const ApeCueTrack *cuetrack = cuesheet->getTrack(i);
+
+        //A track runs up to the INDEX 01 of the next one, the last to the
+        //end of the file.
+        Track track;
+        track.startsample = APECueSheet::toSamples(cuetrack->start, samplerate);
+        track.endsample = i + 1 < count
+                ? APECueSheet::toSamples(cuesheet->getTrack(i + 1)->start, samplerate)
+                : totalsamples;
+        if (track.startsample >= track.endsample || track.endsample > totalsamples) {
+            LOGE("Cue sheet track %u lies outside the file", cuetrack->number);
+            mTracks.clear();
+            return;
+        }
+
+        track.meta = new MetaData(*mMeta);
+        track.meta->setInt64(kKeyDuration,
+                (track.endsample - track.startsample) * 1000000 / samplerate);
+        if (!cuetrack->title.isEmpty()) {
+            track.meta->setCString(kKeyTitle, cuetrack->title.string());
+        }
+        if (!cuetrack->performer.isEmpty()) {
+            track.meta->setCString(kKeyArtist, cuetrack->performer.string());
+        } else if (!cuesheet->getPerformer().isEmpty()) {
+            track.meta->setCString(kKeyArtist, cuesheet->getPerformer().string());
+        }
+        if (!cuesheet->getTitle().isEmpty()) {
+            track.meta->setCString(kKeyAlbum, cuesheet->getTitle().string());
+        }
+        String8 number = String8::format("%u/%zu", cuetrack->number, count);
+        track.meta->setCString(kKeyCDTrackNumber, number.string());
+
+        mTracks.push(track);
+    }
+}
+
+//Keeps the items of an APETagData.
+class APETagData::ItemCollector : public APETagItemSink {
+public:
+    ItemCollector(Vector<ApeTagItem> *items)
+        :mItems(items) {
+    }
+
+    virtual status_t beginItems(size_t maxCount) {
+        mItems->clear();
+        return OK;
+    }
+
+    virtual status_t addItem(const char *key, size_t keyLength, uint32_t flags,
+            off64_t offset, uint32_t size, const char *value, size_t valueLength) {
+        ApeTagItem item;
+        item.key.setTo(key, keyLength);
+        item.flags = flags;
+        item.offset = offset;
+        item.size = size;
+        if (value != NULL) {
+            item.value.setTo(value, valueLength);
+        }
+        mItems->push(item);
+        return OK;
+    }
+
+private:
+    Vector<ApeTagItem> *mItems;
+};
+
+APETagData::APETagData(const sp<DataSource> &source)
+        :mInitCheck(NO_INIT) {
+    ItemCollector collector(&mItems);
+    mInitCheck = parse(source, &collector);
+    if (mInitCheck != OK) {
+        mItems.clear();
+    }
+}
+
+// static
+status_t APETagData::parse(const sp<DataSource> &source, APETagItemSink *sink) {
+    off64_t filesize = 0;
+    if (source->getSize(&filesize) != OK || filesize < APE_TAG_FOOTER_SIZE) {
+        return NO_INIT;
+    }
+
+    //The APE tag footer is either the last 32 bytes of the file or sits right
+    //in front of an ID3v1 tag, so one read covers both places.
+    uint8_t tail[APE_TAG_FOOTER_SIZE + ID3V1_TAG_SIZE];
+    size_t tailsize = sizeof(tail);
+    if (filesize < (off64_t)tailsize) {
+        tailsize = filesize;
+    }
+    off64_t tailoffset = filesize - tailsize;
+    if (source->readAt(tailoffset, tail, tailsize) < (ssize_t)tailsize) {
+        return NO_INIT;
+    }
+
+    off64_t tagend = filesize;
+    const uint8_t *id3v1 = NULL;
+    if (tailsize >= ID3V1_TAG_SIZE && !memcmp(&tail[tailsize - ID3V1_TAG_SIZE], "TAG", 3)) {
+        id3v1 = &tail[tailsize - ID3V1_TAG_SIZE];
+        tagend -= ID3V1_TAG_SIZE;
+    }
+
+    if (tagend - tailoffset >= APE_TAG_FOOTER_SIZE
+            && !memcmp(&tail[tagend - tailoffset - APE_TAG_FOOTER_SIZE], "APETAGEX", 8)
+            && parseAPEv2(source, &tail[tagend - tailoffset - APE_TAG_FOOTER_SIZE],
+                    tagend, sink) == OK) {
+        return OK;
+    }
+
+    if (id3v1 != NULL) {
+        return parseID3v1(id3v1, sink);
+    }
+    return NO_INIT;
+}
+
+APETagData::~APETagData() {
+}
+
+//Window over the items of an APEv2 tag. Reads only what the parser asks
+//for, so a large binary value between two items costs a seek, not a read.
+struct APETagWindow {
+    APETagWindow(const sp<DataSource> &source, off64_t offset, size_t size)
+        :mSource(source),
+         mOffset(offset),
+         mSize(size),
+         mStart(0),
+         mLength(0) {
+    }
+
+    //The bytes [position, position + size) of the items, size being at
+    //most APE_TAG_WINDOW_SIZE. NULL if they are past the end of the tag or
+    //cannot be read.
+    const uint8_t *get(size_t position, size_t size) {
+        if (position > mSize || size > mSize - position) {
+            return NULL;
+        }
+        if (position >= mStart && position + size <= mStart + mLength) {
+            return mData + (position - mStart);
+        }
+
+        size_t length = mSize - position;
+        if (length > sizeof(mData)) {
+            length = sizeof(mData);
+        }
+        ssize_t n = mSource->readAt(mOffset + position, mData, length);
+        mStart = position;
+        mLength = n > 0 ? n : 0;
+        return mLength >= size ? mData : NULL;
+    }
+
+private:
+    sp<DataSource> mSource;
+    off64_t mOffset;
+    size_t mSize;
+    size_t mStart;
+    size_t mLength;
+    uint8_t mData[APE_TAG_WINDOW_SIZE];
+};
+
+// static
+status_t APETagData::parseAPEv2(const sp<DataSource> &source, const uint8_t *footer,
+        off64_t tagend, APETagItemSink *sink) {
+    uint32_t version = U32LE_AT(footer + 8);
+    //Tag size includes the footer and all items, but not the optional header.
+    uint32_t tagsize = U32LE_AT(footer + 12);
+    uint32_t itemnum = U32LE_AT(footer + 16);
+
+    if (version != 1000 && version != 2000) {
+        LOGE("Unsupported APE tag version %u", version);
+        return ERROR_UNSUPPORTED;
+    }
+    if (tagsize < APE_TAG_FOOTER_SIZE || tagsize > tagend) {
+        LOGE("Invalid APE tag size %u", tagsize);
+        return ERROR_MALFORMED;
+    }
+
+    //Only where every value is gets recorded. Text values are read as well,
+    //binary ones are left for whoever asks for them.
+    size_t itemsize = tagsize - APE_TAG_FOOTER_SIZE;
+    off64_t itemoffset = tagend - tagsize;
+    APETagWindow window(source, itemoffset, itemsize);
+
+    //Every item takes at least 10 bytes, which bounds a corrupt count.
+    if (itemnum > itemsize / (8 + 2)) {
+        itemnum = itemsize / (8 + 2);
+    }
+    status_t err = sink->beginItems(itemnum);
+    if (err != OK) {
+        return err;
+    }
+
+    size_t position = 0;
+    for (uint32_t i = 0; i < itemnum; i++) {
+        //Every item is value length, flags, NUL terminated key and the value.
+        if (itemsize - position < 8 + 2) {
+            break;
+        }
+        size_t headersize = itemsize - position;
+        if (headersize > 8 + APE_TAG_MAX_KEY_SIZE) {
+            headersize = 8 + APE_TAG_MAX_KEY_SIZE;
+        }
+        const uint8_t *header = window.get(position, headersize);
+        if (header == NULL) {
+            return ERROR_IO;
+        }
+        uint32_t len = U32LE_AT(header);
+        uint32_t flags = U32LE_AT(header + 4);
+
+        const uint8_t *keystart = header + 8;
+        const uint8_t *keyend = (const uint8_t *)memchr(keystart, 0, headersize - 8);
+        if (keyend == NULL || keyend == keystart) {
+            break;
+        }
+        position += 8 + (keyend - keystart) + 1;
+        if (len > itemsize - position) {
+            LOGE("APE tag item %u overruns the tag", i);
+            break;
+        }
+
+        const char *key = (const char *)keystart;
+        size_t keylength = keyend - keystart;
+        uint32_t itemflags = (version == 1000) ? APE_TAG_ITEM_TYPE_UTF8 : flags;
+        off64_t offset = itemoffset + position;
+        position += len;
+
+        if ((itemflags & APE_TAG_ITEM_TYPE_MASK) != APE_TAG_ITEM_TYPE_UTF8) {
+            err = sink->addItem(key, keylength, itemflags, offset, len, NULL, 0);
+        } else if (len > APE_MAX_TEXT_ITEM_SIZE) {
+            LOGE("Skipping %u byte APE tag text item %.*s", len, (int)keylength, key);
+            continue;
+        } else if (len <= APE_TAG_WINDOW_SIZE) {
+            //The window may move for the value, the key goes along.
+            char keycopy[APE_TAG_MAX_KEY_SIZE];
+            memcpy(keycopy, key, keylength);
+            const char *value = (const char *)window.get(position - len, len);
+            if (value == NULL) {
+                return ERROR_IO;
+            }
+            err = sink->addItem(keycopy, keylength, itemflags, offset, len,
+                    value, strnlen(value, len));
+        } else {
+            //Too long for the window, cue sheets and lyrics can be.
+            char keycopy[APE_TAG_MAX_KEY_SIZE];
+            memcpy(keycopy, key, keylength);
+            char *value = (char *)malloc(len);
+            if (!value) {
+                LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+                return NO_MEMORY;
+            }
+            if (source->readAt(offset, value, len) < (ssize_t)len) {
+                free(value);
+                return ERROR_IO;
+            }
+            err = sink->addItem(keycopy, keylength, itemflags, offset, len,
+                    value, strnlen(value, len));
+            free(value);
+        }
+        if (err != OK) {
+            return err;
+        }
+    }
+
+    return OK;
+}
+
+static status_t addID3v1Item(APETagItemSink *sink, const char *key,
+        const uint8_t *data, size_t size) {
+    while (size > 0 && (data[size - 1] == ' ' || data[size - 1] == '\0')) {
+        size--;
+    }
+    if (size == 0 || memchr(data, 0, size) != NULL) {
+        return OK;
+    }
+
+    //ID3v1 is ISO 8859-1, at most two bytes a character in UTF-8.
+    char value[ID3V1_TAG_SIZE * 2];
+    size_t length = 0;
+    for (size_t i = 0; i < size; i++) {
+        if (data[i] < 0x80) {
+            value[length++] = data[i];
+        } else {
+            value[length++] = 0xc0 | (data[i] >> 6);
+            value[length++] = 0x80 | (data[i] & 0x3f);
+        }
+    }
+    return sink->addItem(key, strlen(key), APE_TAG_ITEM_TYPE_UTF8, 0, length, value, length);
+}
+
+// static
+status_t APETagData::parseID3v1(const uint8_t *tag, APETagItemSink *sink) {
+    status_t err = sink->beginItems(5);
+    if (err == OK) {
+        err = addID3v1Item(sink, "Title", tag + 3, 30);
+    }
+    if (err == OK) {
+        err = addID3v1Item(sink, "Artist", tag + 33, 30);
+    }
+    if (err == OK) {
+        err = addID3v1Item(sink, "Album", tag + 63, 30);
+    }
+    if (err == OK) {
+        err = addID3v1Item(sink, "Year", tag + 93, 4);
+    }
+    //ID3v1.1 keeps the track number in the last byte of the comment.
+    if (err == OK && tag[125] == 0 && tag[126] != 0) {
+        char track[4];
+        snprintf(track, sizeof(track), "%u", tag[126]);
+        err = addID3v1Item(sink, "Track", (const uint8_t *)track, strlen(track));
+    }
+    return err;
+}
+
+status_t APETagData::initCheck() const {
+    return mInitCheck;
+}
+
+size_t APETagData::countItems() const {
+    return mItems.size();
+}
+
+const ApeTagItem *APETagData::getItem(size_t index) const {
+    if (index >= mItems.size()) {
+        return NULL;
+    }
+    return &mItems[index];
+}
+
+const ApeTagItem *APETagData::findItem(const char *key) const {
+    for (size_t i = 0; i < mItems.size(); i++) {
+        if (!strcasecmp(mItems[i].key.string(), key)) {
+            return &mItems[i];
+        }
+    }
+    return NULL;
+}
+
+//Flattened tag index: status, item count, then for every item flags, size,
+//offset, key and value lengths followed by the key and value bytes.
+APETagData::APETagData(const void *buffer, size_t size)
+        :mInitCheck(NO_INIT) {
+    const uint8_t *data = (const uint8_t *)buffer;
+    if (size < 8) {
+        return;
+    }
+
+    status_t err = (int32_t)readLE32(&data[0]);
+    uint32_t itemnum = readLE32(&data[4]);
+    size_t position = 8;
+    for (uint32_t i = 0; i < itemnum; i++) {
+        if (size - position < 24) {
+            mItems.clear();
+            return;
+        }
+        ApeTagItem item;
+        item.flags = readLE32(&data[position]);
+        item.size = readLE32(&data[position + 4]);
+        item.offset = readLE64(&data[position + 8]);
+        uint32_t keylen = readLE32(&data[position + 16]);
+        uint32_t valuelen = readLE32(&data[position + 20]);
+        position += 24;
+
+        if (keylen > size - position || valuelen > size - position - keylen) {
+            mItems.clear();
+            return;
+        }
+        item.key.setTo((const char *)&data[position], keylen);
+        item.value.setTo((const char *)&data[position + keylen], valuelen);
+        position += keylen + valuelen;
+        mItems.push(item);
+    }
+
+    mInitCheck = err;
+}
+
+size_t APETagData::getFlattenedSize() const {
+    size_t size = 8;
+    for (size_t i = 0; i < mItems.size(); i++) {
+        size += 24 + mItems[i].key.length() + mItems[i].value.length();
+    }
+    return size;
+}
+
+status_t APETagData::flatten(void *buffer, size_t size) const {
+    uint8_t *data = (uint8_t *)buffer;
+    if (size < getFlattenedSize()) {
+        return BAD_VALUE;
+    }
+
+    writeLE32(&data[0], mInitCheck);
+    writeLE32(&data[4], mItems.size());
+    size_t position = 8;
+    for (size_t i = 0; i < mItems.size(); i++) {
+        const ApeTagItem &item = mItems[i];
+        writeLE32(&data[position], item.flags);
+        writeLE32(&data[position + 4], item.size);
+        writeLE64(&data[position + 8], item.offset);
+        writeLE32(&data[position + 16], item.key.length());
+        writeLE32(&data[position + 20], item.value.length());
+        position += 24;
+        memcpy(&data[position], item.key.string(), item.key.length());
+        position += item.key.length();
+        memcpy(&data[position], item.value.string(), item.value.length());
+        position += item.value.length();
+    }
+
+    return OK;
+}
+
+APESource::APESource(
+        const sp<MetaData> &meta, const sp<DataSource> &source, sp<APEFrameData> apeframedata,
+        const sp<APEStats> &stats, uint64_t startsample, uint64_t endsample,
+        const sp<APEMappedFileSource> &mappedfile)
+        :mMeta(meta),
+         mDataSource(source),
+         mAPEFrameData(apeframedata),
+         mStats(stats),
+         mBufferPool(APEBufferPool::getInstance()),
+         mCurrentFrameNum(0),
+         mStartFrame(0),
+         mEndFrame(0),
+         mStartSkip(0),
+         mEndTrim(0),
+         mStartTimeUs(0),
+         mSkipSamples(0),
+         mMappedFile(mappedfile),
+         mReadBuffer(NULL),
+         mReadBufferSize(0),
+         mReadBudget(0),
+         mReadBufferOffset(0),
+         mReadBufferLength(0),
+         mMultiFrame(false),
+         mThreadStarted(false),
+         mStopping(false),
+         mAbortWait(0),
+         mPrefetchFrames(0),
+         mPrefetchFrameNum(0),
+         mPrefetchGeneration(0) {
+    //Every frame but the last holds blocksperframe samples, so the track
+    //boundaries map to frames by division.
+    const ApeHeaderData *apeheaderdata = mAPEFrameData->getApeHeaderData();
+    const uint32_t blocksperframe = apeheaderdata->blocksperframe;
+
+    mStartFrame = startsample / blocksperframe;
+    mStartSkip = startsample % blocksperframe;
+    mEndFrame = (endsample + blocksperframe - 1) / blocksperframe;
+    if (mEndFrame > apeheaderdata->totalframes) {
+        mEndFrame = apeheaderdata->totalframes;
+    }
+    if (mEndFrame > 0) {
+        //Taken from the header, the seek table may not be loaded yet.
+        uint32_t lastblocks = mEndFrame == apeheaderdata->totalframes
+                ? apeheaderdata->finalframeblocks : blocksperframe;
+        uint64_t lastend = (uint64_t)(mEndFrame - 1) * blocksperframe + lastblocks;
+        if (lastend > endsample) {
+            mEndTrim = lastend - endsample;
+        }
+    }
+    mStartTimeUs = startsample * 1000000 / apeheaderdata->samplerate;
+
+    mCurrentFrameNum = mStartFrame;
+    mSkipSamples = mStartSkip;
+}
+
+APESource::~APESource() {
+    stop();
+}
+
+status_t APESource::start(MetaData *params) {
+    int32_t prefetchframes;
+    int32_t zerocopy;
+    int32_t readbudget;
+    int32_t multiframe;
+    mPrefetchFrames = 0;
+    mMappedSource = NULL;
+    mReadBudget = 0;
+    mMultiFrame = false;
+
+    if (params != NULL && params->findInt32(kKeyApeZeroCopy, &zerocopy) && zerocopy
+            && mMappedFile != NULL) {
+        mMappedSource = mMappedFile;
+
+        //The page cache does the readahead, driven by the frame index.
+        ApeFrame first = mAPEFrameData->getCurrentFrame(mStartFrame);
+        off64_t size = 0;
+        mDataSource->getSize(&size);
+        mMappedSource->adviseSequential(first.pos, size - first.pos);
+        return OK;
+    }
+    if (params != NULL && params->findInt32(kKeyApePrefetchFrames, &prefetchframes)
+            && prefetchframes > 0) {
+        mPrefetchFrames = prefetchframes;
+        if (mPrefetchFrames > APE_MAX_PREFETCH_FRAMES) {
+            mPrefetchFrames = APE_MAX_PREFETCH_FRAMES;
+        }
+    }
+
+    const size_t kMaxFrameSize = mAPEFrameData->getMaxFrameSize();
+
+    if (params != NULL && params->findInt32(kKeyApeReadBudget, &readbudget)
+            && readbudget > 0) {
+        mReadBudget = readbudget;
+        if (mReadBudget > APE_MAX_READ_BUDGET) {
+            mReadBudget = APE_MAX_READ_BUDGET;
+        }
+
+        //A frame larger than the budget is still read on its own.
+        mReadBufferSize = (mReadBudget > kMaxFrameSize ? mReadBudget : kMaxFrameSize)
+                          + APE_READ_ALIGNMENT;
+        mReadBuffer = (uint8_t *)malloc(mReadBufferSize);
+        mReadBufferLength = 0;
+        if (!mReadBuffer) {
+            LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+            mReadBudget = 0;
+        }
+
+        if (mReadBuffer != NULL && mPrefetchFrames == 0
+                && params->findInt32(kKeyApeMultiFrame, &multiframe) && multiframe) {
+            mMultiFrame = true;
+        }
+    }
+
+    if (mPrefetchFrames > 0) {
+        mStopping = false;
+        mAbortWait = 0;
+        mPrefetchFrameNum = mCurrentFrameNum;
+
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+        mThreadStarted = pthread_create(&mThread, &attr, ThreadWrapper, this) == 0;
+        pthread_attr_destroy(&attr);
+
+        if (!mThreadStarted) {
+            LOGE("Failed to start the prefetch thread, reading synchronously");
+            mPrefetchFrames = 0;
+        }
+    }
+
+    return OK;
+}
+
+status_t APESource::stop() {
+    if (mThreadStarted) {
+        {
+            Mutex::Autolock autoLock(mLock);
+            mStopping = true;
+            mPrefetchCondition.signal();
+        }
+        //The worker may be waiting for the seek table to reach its frame.
+        android_atomic_release_store(1, &mAbortWait);
+        mAPEFrameData->abortWaits();
+        pthread_join(mThread, NULL);
+        mThreadStarted = false;
+
+        Mutex::Autolock autoLock(mLock);
+        releasePrefetchedFrames_l();
+    }
+
+    free(mReadBuffer);
+    mReadBuffer = NULL;
+    mReadBufferSize = 0;
+    mReadBufferLength = 0;
+
+    mMappedSource = NULL;
+
+    return OK;
+}
+
+sp<MetaData> APESource::getFormat() {
+    return mMeta;
+}
+
+status_t APESource::readFrame(uint32_t framenum, MediaBuffer *buffer) {
+    ApeFrame apeframe = mAPEFrameData->getCurrentFrame(framenum);
 
-    ApeFrame *apeframe = mAPEFrameData->getCurrentFrame(mCurrentFrameNum);
-
     //Add 8 bytes header for every frame, and the content is consist of block num and skip value.
     uint32_t *tmp = (uint32_t *)buffer->data();
-    tmp[0] = apeframe->nblocks;
-    tmp[1] = apeframe->skip;
+    tmp[0] = apeframe.nblocks;
+    tmp[1] = apeframe.skip;
+
+    if (mReadBuffer != NULL) {
+        const uint8_t *data;
+        if (getCoalescedFrame(framenum, apeframe, &data) != OK) {
+            return ERROR_END_OF_STREAM;
+        }
+        memcpy((uint8_t *)buffer->data() + 8, data, apeframe.size);
+    } else {
+        ssize_t n = readFromSource(apeframe.pos,
+                    (uint8_t *)buffer->data() + 8, apeframe.size);
+
+        if (n < (ssize_t)apeframe.size) {
+            return ERROR_END_OF_STREAM;
+        }
+    }
+
+    buffer->set_range(0, apeframe.size + 8);
+    buffer->meta_data()->setInt64(kKeyTime, apeframe.pts);
+
+    return OK;
+}
+
+//Packs the frames starting at framenum that are already in, or come with,
+//one coalesced read into buffer, each with its 8-byte prefix.
+status_t APESource::readFrames(uint32_t framenum, MediaBuffer *buffer, uint32_t *count) {
+    uint32_t offsets[APE_MAX_FRAMES_PER_BUFFER];
+    uint8_t *out = (uint8_t *)buffer->data();
+    size_t length = 0;
+    uint32_t n = 0;
+
+    while (n < APE_MAX_FRAMES_PER_BUFFER && framenum + n < mEndFrame
+            && mAPEFrameData->isFrameAvailable(framenum + n)) {
+        ApeFrame apeframe = mAPEFrameData->getCurrentFrame(framenum + n);
+        if (length + 8 + apeframe.size > buffer->size()) {
+            break;
+        }
+
+        //Only the first frame may trigger a read, the rest have to be resident.
+        const uint8_t *data;
+        if (n > 0 && (apeframe.pos < mReadBufferOffset || apeframe.pos + (off64_t)apeframe.size
+                > mReadBufferOffset + (off64_t)mReadBufferLength)) {
+            break;
+        }
+        if (getCoalescedFrame(framenum + n, apeframe, &data) != OK) {
+            break;
+        }
+
+        uint32_t *tmp = (uint32_t *)(out + length);
+        tmp[0] = apeframe.nblocks;
+        tmp[1] = apeframe.skip;
+        memcpy(out + length + 8, data, apeframe.size);
+
+        offsets[n++] = length;
+        length += 8 + apeframe.size;
+    }
+
+    if (n == 0) {
+        return ERROR_END_OF_STREAM;
+    }
+
+    buffer->set_range(0, length);
+    buffer->meta_data()->setInt64(kKeyTime, mAPEFrameData->getFrameTimeUs(framenum));
+    buffer->meta_data()->setInt32(kKeyApeFrameCount, n);
+    buffer->meta_data()->setData(kKeyApeFrameOffsets, 0, offsets, n * sizeof(uint32_t));
+
+    *count = n;
+    return OK;
+}
+
+status_t APESource::getCoalescedFrame(uint32_t framenum, const ApeFrame &apeframe,
+        const uint8_t **data) {
+    if (apeframe.pos < mReadBufferOffset || apeframe.pos + (off64_t)apeframe.size
+            > mReadBufferOffset + (off64_t)mReadBufferLength) {
+        //Frames follow each other on disk, so one read starting at this frame
+        //covers as many of the next ones as the budget allows.
+        off64_t start = apeframe.pos & ~(off64_t)(APE_READ_ALIGNMENT - 1);
+        off64_t end = apeframe.pos + (off64_t)apeframe.size;
+
+        for (uint32_t i = framenum + 1; i < mEndFrame && mAPEFrameData->isFrameAvailable(i);
+                i++) {
+            ApeFrame next = mAPEFrameData->getCurrentFrame(i);
+            if (next.pos + (off64_t)next.size - start > (off64_t)mReadBudget) {
+                break;
+            }
+            end = next.pos + next.size;
+        }
+
+        //The buffer is sized for the largest frame, which an incremental
+        //index only knows an estimate of.
+        if ((size_t)(end - start) > mReadBufferSize) {
+            uint8_t *buffer = (uint8_t *)realloc(mReadBuffer, end - start);
+            if (!buffer) {
+                LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+                return NO_MEMORY;
+            }
+            mReadBuffer = buffer;
+            mReadBufferSize = end - start;
+        }
+
+        ssize_t n = readFromSource(start, mReadBuffer, end - start);
+        mReadBufferOffset = start;
+        mReadBufferLength = n > 0 ? n : 0;
+
+        if (apeframe.pos + (off64_t)apeframe.size > start + (off64_t)mReadBufferLength) {
+            return ERROR_END_OF_STREAM;
+        }
+    }
+
+    *data = mReadBuffer + (apeframe.pos - mReadBufferOffset);
+    return OK;
+}
+
+status_t APESource::mapFrame(uint32_t framenum, MediaBuffer **buffer) {
+    ApeFrame apeframe = mAPEFrameData->getCurrentFrame(framenum);
+
+    const uint8_t *data = mMappedSource->getData(apeframe.pos, apeframe.size);
+    if (data == NULL) {
+        return ERROR_END_OF_STREAM;
+    }
+
+    //The buffer has no observer and is deleted on release, the mapping
+    //itself lives as long as the data source.
+    if (mStats != NULL) {
+        mStats->addRead(APEStats::PHASE_FRAMES, apeframe.size);
+    }
+
+    *buffer = new MediaBuffer((void *)data, apeframe.size);
+    (*buffer)->meta_data()->setInt64(kKeyTime, apeframe.pts);
+    (*buffer)->meta_data()->setInt32(kKeyApeFrameBlocks, apeframe.nblocks);
+    (*buffer)->meta_data()->setInt32(kKeyApeFrameSkip, apeframe.skip);
+
+    ApeFrame next = mAPEFrameData->getCurrentFrame(framenum + 1);
+    if (next.size > 0) {
+        mMappedSource->adviseWillNeed(next.pos, next.size);
+    }
+
+    return OK;
+}
+
+ssize_t APESource::readFromSource(off64_t offset, void *data, size_t size) {
+    if (mStats == NULL) {
+        return mDataSource->readAt(offset, data, size);
+    }
+
+    nsecs_t startNs = systemTime();
+    ssize_t n = mDataSource->readAt(offset, data, size);
+    mStats->addRead(APEStats::PHASE_FRAMES, n > 0 ? n : 0, systemTime() - startNs);
+    return n;
+}
+
+status_t APESource::acquireBuffer(size_t size, MediaBuffer **buffer) {
+    if (mStats == NULL) {
+        return mBufferPool->acquire(size, buffer);
+    }
+
+    nsecs_t startNs = systemTime();
+    status_t err = mBufferPool->acquire(size, buffer);
+    mStats->addSample(APEStats::HIST_ACQUIRE_WAIT, ns2us(systemTime() - startNs));
+    return err;
+}
+
+//Bytes readFrame(), or readFrames() in multi-frame mode, may write for
+//the buffer starting at framenum, 8-byte prefixes included.
+size_t APESource::getFrameBufferSize(uint32_t framenum) {
+    ApeFrame apeframe = mAPEFrameData->getCurrentFrame(framenum);
+    if (!mMultiFrame) {
+        return apeframe.size + 8;
+    }
+
+    //The frames packed together come from one read window, which spans no
+    //more than the budget unless it holds a single larger frame.
+    size_t size = apeframe.size > mReadBudget ? apeframe.size : mReadBudget;
+    return size + APE_MAX_FRAMES_PER_BUFFER * 8;
+}
+
+// static
+void *APESource::ThreadWrapper(void *me) {
+    static_cast<APESource *>(me)->threadEntry();
+
+    return NULL;
+}
+
+void APESource::threadEntry() {
+    Mutex::Autolock autoLock(mLock);
+    while (!mStopping) {
+        if (mPrefetched.size() >= mPrefetchFrames || mPrefetchFrameNum >= mEndFrame) {
+            mPrefetchCondition.wait(mLock);
+            continue;
+        }
+
+        uint32_t framenum = mPrefetchFrameNum++;
+        uint32_t generation = mPrefetchGeneration;
+
+        //The frame is loaded without the lock held, so read() can hand out
+        //frames that are already resident in the meantime.
+        mLock.unlock();
+        MediaBuffer *buffer = NULL;
+        status_t err = mAPEFrameData->waitForFrame(framenum, &mAbortWait);
+        if (err == OK) {
+            err = acquireBuffer(getFrameBufferSize(framenum), &buffer);
+        }
+        if (err == OK) {
+            err = readFrame(framenum, buffer);
+            if (err != OK) {
+                buffer->release();
+                buffer = NULL;
+            }
+        }
+        mLock.lock();
+
+        if (generation != mPrefetchGeneration) {
+            if (buffer != NULL) {
+                buffer->release();
+            }
+            continue;
+        }
+
+        if (err != OK) {
+            //Nothing past a failed frame is prefetched until the next seek.
+            mPrefetchFrameNum = mEndFrame;
+        }
+
+        PrefetchedFrame frame;
+        frame.framenum = framenum;
+        frame.buffer = buffer;
+        frame.err = err;
+        mPrefetched.push_back(frame);
+        mFrameReadyCondition.signal();
+    }
+}
+
+void APESource::restartPrefetch(uint32_t framenum) {
+    Mutex::Autolock autoLock(mLock);
+    restartPrefetch_l(framenum);
+}
+
+void APESource::restartPrefetch_l(uint32_t framenum) {
+    releasePrefetchedFrames_l();
+    mPrefetchFrameNum = framenum;
+    mPrefetchGeneration++;
+    mPrefetchCondition.signal();
+}
+
+void APESource::releasePrefetchedFrames_l() {
+    while (!mPrefetched.empty()) {
+        PrefetchedFrame &frame = *mPrefetched.begin();
+        if (frame.buffer != NULL) {
+            frame.buffer->release();
+        }
+        mPrefetched.erase(mPrefetched.begin());
+    }
+}
+
+status_t APESource::dequeuePrefetchedFrame(uint32_t framenum, MediaBuffer **buffer) {
+    Mutex::Autolock autoLock(mLock);
+    for (;;) {
+        while (mPrefetched.empty()) {
+            mFrameReadyCondition.wait(mLock);
+        }
+
+        //Seeks restart the prefetch at the new position, so frames come
+        //out in the order read() asks for them. Should the queue hold any
+        //other frame all the same, it is dropped and refilled from here.
+        if (mPrefetched.begin()->framenum == framenum) {
+            break;
+        }
+        ALOGW("Prefetched frame %u while reading frame %u, refilling",
+                mPrefetched.begin()->framenum, framenum);
+        restartPrefetch_l(framenum);
+    }
+    PrefetchedFrame frame = *mPrefetched.begin();
+
+    //A failed frame stays queued and keeps failing until the next seek.
+    if (frame.err != OK) {
+        return frame.err;
+    }
+
+    mPrefetched.erase(mPrefetched.begin());
+    mPrefetchCondition.signal();
+
+    *buffer = frame.buffer;
+    return OK;
+}
+
+status_t APESource::read(
+        MediaBuffer **out, const ReadOptions *options) {
+    if (mStats == NULL) {
+        return readInternal(out, options);
+    }
+
+    nsecs_t startNs = systemTime();
+    status_t err = readInternal(out, options);
+    mStats->addSample(APEStats::HIST_READ_LATENCY, ns2us(systemTime() - startNs));
+    return err;
+}
+
+status_t APESource::readInternal(
+        MediaBuffer **out, const ReadOptions *options) {
+    *out = NULL;
+    int64_t seekTimeUs;
+    ReadOptions::SeekMode mode;
+    int32_t skipSamples = 0;
+    int64_t targetTimeUs = -1;
 
-    size_t n = mDataSource->readAt(apeframe->pos,
-                (uint8_t *)buffer->data() + 8, apeframe->size);
+    if (options != NULL && options->getSeekTo(&seekTimeUs, &mode)) {
+        int32_t framenum;
+        mAPEFrameData->getRequiredFrameNum(seekTimeUs + mStartTimeUs, mode,
+                &framenum, &skipSamples);
+        if (mode != ReadOptions::SEEK_CLOSEST) {
+            skipSamples = 0;
+        }
+        //The start of the track is never passed, whatever the mode.
+        if (framenum <= (int32_t)mStartFrame) {
+            framenum = mStartFrame;
+            if (skipSamples < mStartSkip) {
+                skipSamples = mStartSkip;
+            }
+        }
+        //An incremental index may not reach that far yet. Waiting could
+        //take as long as the rest of the download, so the caller is told
+        //instead, and the position stays where it was.
+        if (framenum < (int32_t)mEndFrame && !mAPEFrameData->isFrameAvailable(framenum)) {
+            return WOULD_BLOCK;
+        }
+        mSkipSamples = skipSamples;
+        if (mStats != NULL) {
+            mStats->addSample(APEStats::HIST_SEEK_DISTANCE,
+                    framenum > (int32_t)mCurrentFrameNum ? framenum - mCurrentFrameNum
+                                                         : mCurrentFrameNum - framenum);
+        }
+        mCurrentFrameNum = framenum;
+        if (mode == ReadOptions::SEEK_CLOSEST) {
+            targetTimeUs = seekTimeUs;
+        }
+        if (mPrefetchFrames > 0) {
+            restartPrefetch(mCurrentFrameNum);
+        }
+    }
 
-    if (n < apeframe->size) {
-        buffer->release();
-        buffer = NULL;
+    if (mCurrentFrameNum >= mEndFrame){
         return ERROR_END_OF_STREAM;
     }
+    const uint32_t firstframe = mCurrentFrameNum;
+
+    //Playing on past the entries loaded so far waits for them, as reading
+    //frame data that is still on its way would.
+    status_t err = mAPEFrameData->waitForFrame(mCurrentFrameNum);
+    if (err != OK) {
+        return err;
+    }
+
+    MediaBuffer *buffer;
+    if (mMappedSource != NULL) {
+        err = mapFrame(mCurrentFrameNum, &buffer);
+    } else if (mPrefetchFrames > 0) {
+        err = dequeuePrefetchedFrame(mCurrentFrameNum, &buffer);
+    } else if (mMultiFrame) {
+        err = acquireBuffer(getFrameBufferSize(mCurrentFrameNum), &buffer);
+        if (err == OK) {
+            uint32_t count;
+            err = readFrames(mCurrentFrameNum, buffer, &count);
+            if (err != OK) {
+                buffer->release();
+                buffer = NULL;
+            } else {
+                //The increment below accounts for the first one.
+                mCurrentFrameNum += count - 1;
+            }
+        }
+    } else {
+        err = acquireBuffer(getFrameBufferSize(mCurrentFrameNum), &buffer);
+        if (err == OK) {
+            err = readFrame(mCurrentFrameNum, buffer);
+            if (err != OK) {
+                buffer->release();
+                buffer = NULL;
+            }
+        }
+    }
+    if (err != OK) {
+        return err;
+    }
 
-    buffer->set_range(0, apeframe->size + 8);
-    buffer->meta_data()->setInt64(kKeyTime, apeframe->pts * 1000 * 100);
+    if (targetTimeUs >= 0) {
+        buffer->meta_data()->setInt64(kKeyTargetTime, targetTimeUs);
+    }
+    if (targetTimeUs >= 0 || mSkipSamples > 0) {
+        buffer->meta_data()->setInt32(kKeyApeSkipSamples, mSkipSamples);
+        mSkipSamples = 0;
+    }
+    if (mCurrentFrameNum == mEndFrame - 1 && mEndTrim > 0) {
+        buffer->meta_data()->setInt32(kKeyApeTrimSamples, mEndTrim);
+    }
+    if (mStartFrame > 0 || mStartSkip > 0) {
+        //Computed from the sample position rather than by subtracting
+        //mStartTimeUs, so that the rounding cancels with the skip the
+        //decoder adds and the track starts at exactly 0.
+        const ApeHeaderData *apeheaderdata = mAPEFrameData->getApeHeaderData();
+        int64_t offset = (int64_t)firstframe * apeheaderdata->blocksperframe
+                - ((int64_t)mStartFrame * apeheaderdata->blocksperframe + mStartSkip);
+        buffer->meta_data()->setInt64(kKeyTime,
+                offset * 1000000 / apeheaderdata->samplerate);
+    }
     mCurrentFrameNum++;
 
     *out = buffer;
     return OK;
 }
 
+//What APEDecoder can decode. Files outside of it are still taken, with
+//the confidence of the magic alone.
+static bool isSupportedFormat(const ApeHeaderData *header) {
+    return header->channels >= 1 && header->channels <= 2
+            && (header->bitspersample == 8 || header->bitspersample == 16
+                || header->bitspersample == 24)
+            && header->compressiontype >= 1000 && header->compressiontype <= 5000
+            && header->compressiontype % 1000 == 0
+            && header->samplerate <= APE_MAX_SAMPLE_RATE;
+}
+
+//Takes a file for APE only when its header parses and, if the size is
+//known, fits in it, all from the first read past any ID3v2 tags. No
+//allocation happens before that. The offset of the stream and the parsed
+//header are passed on in meta, so that the extractor reads neither again.
 bool SniffAPE(
         const sp<DataSource> &source, String8 *mimeType,
         float *confidence, sp<AMessage> *meta) {
-    uint8_t header[4];
+    uint8_t buff[APE_HEADER_READ_SIZE];
+    off64_t offset;
+
+    ssize_t n = APEFrameData::readStreamStart(source, buff, sizeof(buff), &offset);
+    if (n < 4 || memcmp(buff, "MAC ", 4)) {
+        return false;
+    }
 
-    ssize_t n = source->readAt(0, header, sizeof(header));
-    if (n < (ssize_t)sizeof(header)) {
+    ApeHeaderData header;
+    off64_t seektableoffset;
+    status_t err = APEFrameData::parseHeader(buff, n, &header, &seektableoffset);
+    off64_t size;
+    if (err == OK && source->getSize(&size) == OK) {
+        err = APEFrameData::validateHeader(&header, seektableoffset, size - offset);
+    }
+    if (err == ERROR_BUFFER_TOO_SMALL && n < (ssize_t)sizeof(buff)) {
+        //The file ends before the header.
+        return false;
+    }
+    if (err != OK && err != ERROR_BUFFER_TOO_SMALL) {
         return false;
     }
 
-    if (header[0] == 'M' && header[1] == 'A' && header[2] == 'C' && header[3] == ' ') {
-        *mimeType = MEDIA_MIMETYPE_AUDIO_APE;
+    *meta = new AMessage;
+    (*meta)->setInt64("offset", offset);
+    *mimeType = MEDIA_MIMETYPE_AUDIO_APE;
+    if (err == ERROR_BUFFER_TOO_SMALL) {
+        //Left to the extractor to read and check.
         *confidence = 0.2f;
         return true;
     }
 
-    return false;
+    sp<ABuffer> buffer = new ABuffer(sizeof(header));
+    memcpy(buffer->data(), &header, sizeof(header));
+    (*meta)->setBuffer("ape-header", buffer);
+    (*meta)->setInt64("ape-seek-table-offset", seektableoffset);
+    *confidence = isSupportedFormat(&header) ? 0.5f : 0.2f;
+    return true;
 }
 
 }  // namespace android
@@ -27,15 +27,69 @@
 #define APE_EXTRACTOR_H_
 
 #include <utils/Errors.h>
+#include <media/stagefright/foundation/AMessage.h>
 #include <media/stagefright/MediaExtractor.h>
 #include <media/stagefright/MetaData.h>
+#include <utils/String8.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+#include <pthread.h>
+
+#include "APEBlockCache.h"
+#include "APEIndexCache.h"
+#include "APEStats.h"
 
 namespace android {
 
-struct AMessage;
 class DataSource;
-class String8;
+class MediaBuffer;
 class APEFrameData;
+class APEMappedFileSource;
+
+enum {
+    //int32_t, set on the first buffer after a SEEK_CLOSEST seek: number of
+    //leading samples the decoder drops to land on the requested time.
+    kKeyApeSkipSamples = 'apSk',
+
+    //int32_t, passed to APESource::start(): number of frames a background
+    //thread keeps loaded ahead of read(). 0 or absent reads synchronously.
+    kKeyApePrefetchFrames = 'apPf',
+
+    //int32_t, passed to APESource::start(): when non-zero and the extractor
+    //came from createMapped(), buffers point straight into the mapping and
+    //carry kKeyApeFrameBlocks/kKeyApeFrameSkip instead of the 8-byte prefix.
+    kKeyApeZeroCopy = 'apZc',
+
+    //int32_t, block num and skip value of the frame in a zero-copy buffer.
+    kKeyApeFrameBlocks = 'apNb',
+    kKeyApeFrameSkip = 'apSf',
+
+    //int32_t, passed to APESource::start(): byte budget of one coalesced
+    //read. Consecutive frames that fit are fetched with a single readAt()
+    //and handed out one by one. 0 or absent reads every frame on its own.
+    kKeyApeReadBudget = 'apRb',
+
+    //int32_t, passed to APESource::start() together with kKeyApeReadBudget:
+    //when non-zero, read() returns all frames of a coalesced read in one
+    //buffer, each with its 8-byte prefix. Ignored when prefetching.
+    kKeyApeMultiFrame = 'apMf',
+
+    //int32_t and raw uint32_t array, set on multi-frame buffers: number of
+    //frames and the offset of every frame's prefix in the buffer.
+    kKeyApeFrameCount = 'apFc',
+    kKeyApeFrameOffsets = 'apFo',
+
+    //int32_t, passed to APEParallelDecoder::start(): number of worker
+    //threads, and how many decoded frames may wait ahead of read().
+    kKeyApeDecodeThreads = 'apDt',
+    kKeyApeReorderFrames = 'apRf',
+
+    //int32_t, set on the buffer holding the last frame of a cue sheet
+    //track: number of trailing samples of that frame the decoder drops,
+    //they belong to the next track.
+    kKeyApeTrimSamples = 'apTr',
+};
 
 typedef struct {
     uint32_t key;
@@ -43,11 +97,28 @@ typedef struct {
     size_t size;
 }IdTag;
 
+#define APE_TAG_ITEM_TYPE_MASK      6
+#define APE_TAG_ITEM_TYPE_UTF8      0
+#define APE_TAG_ITEM_TYPE_BINARY    2
+#define APE_TAG_ITEM_TYPE_LOCATOR   4
+
+typedef struct {
+    String8 key;
+    uint32_t flags;
+    //Position and length of the value in the file.
+    off64_t offset;
+    uint32_t size;
+    //Only filled in for UTF-8 text items, binary values are never read
+    //while parsing the tag.
+    String8 value;
+} ApeTagItem;
+
 typedef struct {
     int64_t pos;
     int32_t nblocks;
     size_t size;
     int32_t skip;
+    //Presentation time in microseconds, from the first sample of the frame.
     int64_t pts;
 } ApeFrame;
 
@@ -59,6 +130,9 @@ typedef struct {
     uint32_t seektablelength;
     uint32_t wavheaderlength;
     uint32_t wavtaillength;
+    //Frame data length and MD5 of the file, 3980 and later only; zero before.
+    uint64_t framedatalength;
+    uint8_t md5[16];
     //Header data.
     uint32_t compressiontype;
     uint16_t formatflags;
@@ -71,34 +145,230 @@ typedef struct {
     uint64_t durationUS;
 } ApeHeaderData;
 
+//Frame index of one file. The header is parsed on construction and the
+//seek table by buildIndex(), which publishes the index only once it is
+//complete. After that nothing in it changes, so the const getters may be
+//called from any number of threads without locking.
+//
+//For a file that is still arriving startIncrementalIndex() loads the seek
+//table in the background instead, and frames become usable one by one as
+//their entries come in.
 class APEFrameData : public RefBase{
 public:
+    //Parses the header only, the seek table is read by buildIndex().
     APEFrameData(const sp<DataSource> &source);
 
-    status_t getRequiredFrameNum(int64_t seekTimeUs,int32_t *frameNum);
+    //Rebuilds the index from a buffer written by flatten(), without any I/O.
+    APEFrameData(const sp<DataSource> &source, const void *buffer, size_t size);
+
+    //Takes a header parsed by parseHeader() earlier, SniffAPE() for one,
+    //without any I/O.
+    APEFrameData(const sp<DataSource> &source, const ApeHeaderData &header,
+            off64_t seektableoffset);
+
+    //Reads the descriptor and header, without the seek table, and fills in
+    //durationUS. seektableoffset receives the file offset of the seek table.
+    static status_t parseHeader(const sp<DataSource> &source,
+            ApeHeaderData *header, off64_t *seektableoffset);
+
+    //The same from the first size bytes of the file. ERROR_BUFFER_TOO_SMALL
+    //when the header lies beyond them, which only an unusually long
+    //descriptor does.
+    static status_t parseHeader(const uint8_t *buff, size_t size,
+            ApeHeaderData *header, off64_t *seektableoffset);
 
-    size_t getMaxFrameSize();
+    //Fails with ERROR_MALFORMED when the header and seek table would not
+    //fit in a file of filesize bytes. parseHeader() from a source checks
+    //this itself when the size is known.
+    static status_t validateHeader(const ApeHeaderData *header,
+            off64_t seektableoffset, off64_t filesize);
 
-    ApeFrame *getCurrentFrame(uint32_t framenum);
+    //Reads up to size bytes from the start of the APE stream into buff,
+    //past any ID3v2 tags in front of it, and returns the number read.
+    //offset receives where the stream starts in the source.
+    static ssize_t readStreamStart(const sp<DataSource> &source,
+            uint8_t *buff, size_t size, off64_t *offset);
 
-    ApeHeaderData *getApeHeaderData();
+    //The APE stream in source, past any ID3v2 tags, which is where offsets
+    //in the header and seek table count from. source itself if it has none.
+    static sp<DataSource> getStreamSource(const sp<DataSource> &source);
+
+    //Reads the seek table. Frames and the exact max frame size are only
+    //available once this has succeeded. Safe to call concurrently, the
+    //table is read once.
+    status_t buildIndex();
+    bool isIndexed() const;
+
+    //Starts a thread that reads the seek table in small chunks, publishing
+    //the entries of each as soon as it is in. buildIndex() then waits for
+    //that thread rather than reading the table itself.
+    status_t startIncrementalIndex();
+
+    //True once the position and size of the frame are known, which for an
+    //incremental index means the entry after it has been loaded.
+    bool isFrameAvailable(uint32_t framenum) const;
+
+    //Blocks until the frame is available. Fails if the seek table turns out
+    //to be truncated or the frame does not exist, and with NO_INIT once
+    //abort is set and abortWaits() called.
+    status_t waitForFrame(uint32_t framenum, volatile const int32_t *abort = NULL);
+
+    //Wakes every waitForFrame() call, so that those whose abort flag is set
+    //return.
+    void abortWaits();
+
+    status_t getRequiredFrameNum(int64_t seekTimeUs, MediaSource::ReadOptions::SeekMode mode,
+            int32_t *frameNum, int32_t *skipSamples) const;
+
+    int64_t getFrameTimeUs(uint32_t framenum) const;
+
+    //Exact once indexed, computed a single time. Before that an estimate
+    //from the header.
+    size_t getMaxFrameSize() const;
+    size_t getMaxFrameSizeEstimate() const;
+
+    //Heap bytes held by the index: the offset table, which an incremental
+    //index allocates up front, the wrap list and the header.
+    size_t getIndexMemory() const;
+
+    ApeFrame getCurrentFrame(uint32_t framenum) const;
+
+    const ApeHeaderData *getApeHeaderData() const;
+
+    status_t initCheck() const;
+
+    size_t getFlattenedSize() const;
+    status_t flatten(void *buffer, size_t size) const;
 protected:
     virtual ~APEFrameData();
 
 private:
+    void computeMaxFrameSize();
+    status_t checkLastFrameOffset() const;
+    status_t completeIndex();
+    status_t findWraps(const uint32_t *offsets, uint32_t start, uint32_t end);
+    off64_t getFrameOffset(uint32_t framenum) const;
+    uint32_t getFirstFrameOffset() const;
+    bool isFrameLoaded_l(uint32_t framenum) const;
+    ApeFrame makeFrame(uint32_t framenum) const;
+
+    static void *LoaderWrapper(void *me);
+    void loaderEntry();
 
     sp<DataSource> mDataSource;
 
     ApeHeaderData *mApeHeaderData;
 
-    uint32_t *mSeekTable;
-    ApeFrame *mAPEFrames;
+    //Start offset of every frame, as stored in the seek table: the low 32
+    //bits only. mWrapFrames lists the first frame of every further 4 GB.
+    uint32_t *mFrameOffsets;
+    Vector<uint32_t> mWrapFrames;
+    size_t mFinalFrameSize;
+    off64_t mSeekTableOffset;
+    size_t mMaxFrameSize;
+
+    //Serializes buildIndex(). Readers of a complete index never take it,
+    //they only look at the index once mIndexed is set, which happens after
+    //the last write to it.
+    mutable Mutex mIndexLock;
+    volatile int32_t mIndexed;
+
+    //Incremental index only. The loader fills mFrameOffsets up to
+    //mLoadedFrames under mIndexLock and broadcasts mIndexCondition; until
+    //mIndexed is set readers look at the entries under the same lock.
+    Condition mIndexCondition;
+    pthread_t mLoaderThread;
+    bool mLoaderStarted;
+    bool mLoaderStopping;
+    uint32_t mLoadedFrames;
+    status_t mLoadError;
+
+    status_t mInitCheck;
+};
+
+//Receives the items of a tag as the parser finds them. key and value point
+//into the parser's buffers and are only valid during the call; value is
+//NULL but for UTF-8 text items, and neither is NUL terminated.
+class APETagItemSink {
+public:
+    //Called before the items with an upper bound on their number, and again
+    //when the parser gives up on a corrupt APE tag and falls back to ID3v1;
+    //the items added until then are void. An error from either call stops
+    //the tag as a corrupt one would, so a sink that runs out of room has to
+    //remember that itself.
+    virtual status_t beginItems(size_t maxCount) = 0;
+
+    virtual status_t addItem(const char *key, size_t keyLength, uint32_t flags,
+            off64_t offset, uint32_t size, const char *value, size_t valueLength) = 0;
+
+protected:
+    virtual ~APETagItemSink() {}
+};
+
+//APEv2/APEv1 tag located from its footer, with ID3v1 as a fallback.
+class APETagData : public RefBase{
+public:
+    APETagData(const sp<DataSource> &source);
+
+    //Parses the tag of source into sink without keeping anything, for
+    //callers with storage of their own. NO_INIT when the file has no tag.
+    static status_t parse(const sp<DataSource> &source, APETagItemSink *sink);
+
+    //Rebuilds the tag index from a buffer written by flatten(), without any I/O.
+    APETagData(const void *buffer, size_t size);
+
+    status_t initCheck() const;
+
+    size_t countItems() const;
+
+    const ApeTagItem *getItem(size_t index) const;
+
+    const ApeTagItem *findItem(const char *key) const;
+
+    size_t getFlattenedSize() const;
+    status_t flatten(void *buffer, size_t size) const;
+protected:
+    virtual ~APETagData();
+
+private:
+    class ItemCollector;
+
+    static status_t parseAPEv2(const sp<DataSource> &source, const uint8_t *footer,
+            off64_t tagend, APETagItemSink *sink);
+    static status_t parseID3v1(const uint8_t *tag, APETagItemSink *sink);
+
+    Vector<ApeTagItem> mItems;
+
+    status_t mInitCheck;
 };
 
 class APEExtractor : public MediaExtractor {
 public:
     // Extractor assumes ownership of "source".
-    APEExtractor(const sp<DataSource> &source);
+    //A file with a valid "Cuesheet" tag item has one track per cue sheet
+    //track, otherwise a single track. Any number of tracks, of the same
+    //index or not, may be read at once from different threads; they share
+    //the frame index and, when enabled, the block cache.
+    //
+    //Caching (streamed) sources and sources of unknown length are opened
+    //incrementally: the track is available as soon as the header is in,
+    //and the seek table is loaded in the background. Reads play on as its
+    //entries arrive, while a seek beyond them fails with WOULD_BLOCK and
+    //leaves the position unchanged. The tag sits at the end of the file, so
+    //it is only read by an explicit parseAPETag(), and cue sheet tracks are
+    //not offered. media.ape.incremental forces the mode on (1) or off (0).
+    //
+    //meta is what SniffAPE() passed on: where the stream starts past any
+    //ID3v2 tags, and its header. Without it both are looked up here.
+    APEExtractor(const sp<DataSource> &source, const sp<AMessage> &meta = NULL);
+
+    //The same over a mapped local file, whose frames (see kKeyApeZeroCopy)
+    //and binary tag values can then be handed out as views into the
+    //mapping. Without RTTI the plain constructor cannot tell it apart from
+    //other sources. A stream past ID3v2 tags, or a traced source, is read
+    //as usual since the mapping would miss the offset or the trace.
+    static sp<APEExtractor> createMapped(const sp<APEMappedFileSource> &source,
+            const sp<AMessage> &meta = NULL);
 
     virtual size_t countTracks();
     virtual sp<MediaSource> getTrack(size_t index);
@@ -106,13 +376,81 @@ public:
     virtual sp<MetaData> getMetaData();
 
     status_t parseAPETag();
+
+    //Frame index of the track, built on first use. NULL if it cannot be read.
+    sp<APEFrameData> getFrameData();
+
+    //The whole file as one track, whether or not it has a cue sheet.
+    sp<MediaSource> getFileTrack();
+
+    //I/O and latency counters of the extractor and its tracks, NULL unless
+    //enabled through media.ape.stats.
+    sp<APEStats> getStats();
+
+    //Cache the tracks read frames through, NULL when disabled through
+    //media.ape.block_cache.size or before the first track.
+    sp<APEBlockCache> getBlockCache();
+
+    //Value of a tag item, read on this call: the tag index only records
+    //where binary values are. Over a mapped file the buffer is a view of
+    //the mapping, valid as long as the extractor. NAME_NOT_FOUND if the
+    //tag has no such item.
+    status_t readTagItem(const char *key, MediaBuffer **buffer);
+
+    //The front cover, or else any other cover art item, ranged to the
+    //image after the file name stored in front of it. kKeyAlbumArtMIME is
+    //set on the buffer when the image type is recognized.
+    status_t getAlbumArt(MediaBuffer **buffer);
 private:
+    //Virtual track of a cue sheet, the samples [startsample, endsample).
+    struct Track {
+        uint64_t startsample;
+        uint64_t endsample;
+        sp<MetaData> meta;
+    };
+
     sp<DataSource> mDataSource;
+    //mDataSource itself when the extractor was created over a mapped file.
+    sp<APEMappedFileSource> mMappedSource;
+    sp<APEBlockCache> mBlockCache;
     sp<MetaData> mMeta;
     sp<MetaData> mFileMeta;
     sp<APEFrameData> mAPEFrameData;
+    sp<APETagData> mAPETagData;
+    bool mTagParsed;
+    //Set once mBlockCache was asked for, it stays NULL when disabled.
+    bool mBlockCacheCreated;
+    //Empty unless the tag holds a usable cue sheet.
+    Vector<Track> mTracks;
+    //Set while the index still has to be saved to the cache.
+    sp<APEIndexCache> mIndexCache;
+    ApeIndexKey mIndexKey;
+    //Header, seek table and tag reads go through mStatsSource when stats
+    //are enabled, so they are counted against the current phase.
+    sp<APEStats> mStats;
+    sp<APEStatsSource> mStatsSource;
+    //Set when the seek table is loaded in the background.
+    bool mIncremental;
     status_t mInitCheck;
 
+    //Guards the index, tag, tracks and block cache, which are set up lazily
+    //by whichever thread asks first.
+    Mutex mLock;
+
+    status_t buildIndex_l();
+    status_t parseAPETag_l();
+    void loadTag_l();
+    status_t findTagItem(const char *key, bool cover, ApeTagItem *item);
+    status_t readTagValue(const ApeTagItem &item, MediaBuffer **buffer);
+    sp<MediaSource> getFileTrack_l();
+    void buildTracks_l(const String8 &text);
+    uint64_t getTotalSamples();
+    sp<DataSource> getFrameSource_l();
+
+    sp<DataSource> getParseSource();
+    nsecs_t beginPhase(APEStats::Phase phase);
+    void endPhase(APEStats::Phase phase, nsecs_t startNs);
+
     APEExtractor(const APEExtractor &);
     APEExtractor &operator=(const APEExtractor &);
 };
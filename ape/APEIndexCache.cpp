@@ -0,0 +1,410 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "APEIndexCache"
+#include <utils/Log.h>
+
+#include "APEIndexCache.h"
+#include "APEExtractor.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/MediaErrors.h>
+#include <cutils/properties.h>
+#include <utils/Vector.h>
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define APE_INDEX_MAGIC             0x49455041  //"APEI"
+#define APE_INDEX_VERSION           4
+#define APE_INDEX_HEADER_SIZE       48
+#define APE_INDEX_HASH_SIZE         1024
+#define APE_INDEX_DEFAULT_MAX_SIZE  (8 * 1024 * 1024)
+//Temporary files older than this were left by a writer that died.
+#define APE_INDEX_STALE_TMP_SECONDS 60
+
+namespace android {
+
+static Mutex gInstanceLock;
+static bool gInstanceChecked = false;
+static sp<APEIndexCache> gInstance;
+
+static inline uint32_t readLE32(const uint8_t *data) {
+    return data[0] | (data[1] << 8) | (data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static inline uint64_t readLE64(const uint8_t *data) {
+    return readLE32(data) | ((uint64_t)readLE32(data + 4) << 32);
+}
+
+static inline void writeLE32(uint8_t *data, uint32_t value) {
+    data[0] = value;
+    data[1] = value >> 8;
+    data[2] = value >> 16;
+    data[3] = value >> 24;
+}
+
+static inline void writeLE64(uint8_t *data, uint64_t value) {
+    writeLE32(data, (uint32_t)value);
+    writeLE32(data + 4, (uint32_t)(value >> 32));
+}
+
+static inline size_t align8(size_t size) {
+    return (size + 7) & ~(size_t)7;
+}
+
+//FNV-1a, 64 bit.
+static uint64_t hashBytes(uint64_t hash, const uint8_t *data, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+static status_t readFully(int fd, uint8_t *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = read(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return ERROR_IO;
+        }
+        data += n;
+        size -= n;
+    }
+    return OK;
+}
+
+static status_t writeFully(int fd, const uint8_t *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return ERROR_IO;
+        }
+        data += n;
+        size -= n;
+    }
+    return OK;
+}
+
+sp<APEIndexCache> APEIndexCache::getInstance() {
+    Mutex::Autolock autoLock(gInstanceLock);
+    if (!gInstanceChecked) {
+        gInstanceChecked = true;
+
+        char dir[PROPERTY_VALUE_MAX];
+        char value[PROPERTY_VALUE_MAX];
+        size_t maxSize = APE_INDEX_DEFAULT_MAX_SIZE;
+
+        if (property_get("media.ape.index_cache.dir", dir, NULL) > 0) {
+            if (property_get("media.ape.index_cache.size", value, NULL) > 0) {
+                maxSize = strtoul(value, NULL, 0);
+            }
+            struct stat st;
+            if (maxSize > 0 && stat(dir, &st) == 0 && S_ISDIR(st.st_mode)) {
+                gInstance = new APEIndexCache(dir, maxSize);
+            } else {
+                LOGE("APE index cache disabled, '%s' is not usable.", dir);
+            }
+        }
+    }
+    return gInstance;
+}
+
+APEIndexCache::APEIndexCache(const char *dir, size_t maxSize)
+        :mDir(dir),
+         mMaxSize(maxSize),
+         mTotalSize(0),
+         mTotalKnown(false) {
+}
+
+APEIndexCache::~APEIndexCache() {
+}
+
+status_t APEIndexCache::getKey(const sp<DataSource> &source, ApeIndexKey *key) {
+    off64_t filesize;
+    if (source->getSize(&filesize) != OK || filesize <= 0) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    uint8_t data[APE_INDEX_HASH_SIZE];
+    size_t size = filesize < APE_INDEX_HASH_SIZE ? (size_t)filesize : APE_INDEX_HASH_SIZE;
+    uint64_t hash = 0xcbf29ce484222325ULL;
+
+    if (source->readAt(0, data, size) != (ssize_t)size) {
+        return ERROR_IO;
+    }
+    hash = hashBytes(hash, data, size);
+
+    if (source->readAt(filesize - size, data, size) != (ssize_t)size) {
+        return ERROR_IO;
+    }
+    hash = hashBytes(hash, data, size);
+
+    key->filesize = filesize;
+    key->hash = hash;
+    return OK;
+}
+
+String8 APEIndexCache::getPath(const ApeIndexKey &key) const {
+    String8 path(mDir);
+    path.appendFormat("/%016llx-%016llx.idx",
+            (unsigned long long)key.filesize, (unsigned long long)key.hash);
+    return path;
+}
+
+status_t APEIndexCache::load(const ApeIndexKey &key, const sp<DataSource> &source,
+        sp<APEFrameData> *frameData, sp<APETagData> *tagData) {
+    String8 path = getPath(key);
+
+    int fd = open(path.string(), O_RDONLY);
+    if (fd < 0) {
+        return NAME_NOT_FOUND;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < APE_INDEX_HEADER_SIZE
+            || (uint64_t)st.st_size > mMaxSize) {
+        close(fd);
+        return ERROR_MALFORMED;
+    }
+
+    size_t size = st.st_size;
+    uint8_t *data = (uint8_t *)malloc(size);
+    if (data == NULL) {
+        close(fd);
+        return NO_MEMORY;
+    }
+
+    status_t err = readFully(fd, data, size);
+    close(fd);
+
+    size_t framesize = 0, tagsize = 0;
+    if (err == OK) {
+        framesize = readLE32(data + 40);
+        tagsize = readLE32(data + 44);
+
+        if (readLE32(data) != APE_INDEX_MAGIC
+                || readLE32(data + 4) != APE_INDEX_VERSION
+                || readLE64(data + 8) != key.filesize
+                || readLE64(data + 16) != key.hash
+                || framesize > size || tagsize > size
+                || APE_INDEX_HEADER_SIZE + align8(framesize) + tagsize != size
+                || readLE64(data + 24) != hashBytes(0xcbf29ce484222325ULL,
+                        data + APE_INDEX_HEADER_SIZE, size - APE_INDEX_HEADER_SIZE)) {
+            err = ERROR_MALFORMED;
+        }
+    }
+
+    if (err == OK) {
+        *frameData = new APEFrameData(source, data + APE_INDEX_HEADER_SIZE, framesize);
+        *tagData = new APETagData(data + APE_INDEX_HEADER_SIZE + align8(framesize), tagsize);
+        if ((*frameData)->initCheck() != OK) {
+            *frameData = NULL;
+            *tagData = NULL;
+            err = ERROR_MALFORMED;
+        }
+    }
+    free(data);
+
+    if (err != OK) {
+        ALOGV("Dropping stale index %s", path.string());
+        if (unlink(path.string()) == 0) {
+            Mutex::Autolock autoLock(mLock);
+            mTotalSize -= mTotalSize < size ? mTotalSize : size;
+        }
+        return err;
+    }
+
+    //Touch the entry so eviction sees it as recently used.
+    utimes(path.string(), NULL);
+    return OK;
+}
+
+status_t APEIndexCache::save(const ApeIndexKey &key, const sp<APEFrameData> &frameData,
+        const sp<APETagData> &tagData) {
+    if (frameData == NULL || tagData == NULL || frameData->initCheck() != OK) {
+        return BAD_VALUE;
+    }
+
+    size_t framesize = frameData->getFlattenedSize();
+    size_t tagsize = tagData->getFlattenedSize();
+    size_t size = APE_INDEX_HEADER_SIZE + align8(framesize) + tagsize;
+
+    //One file should not be able to flush the whole cache.
+    if (size > mMaxSize / 4) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    uint8_t *data = (uint8_t *)calloc(1, size);
+    if (data == NULL) {
+        return NO_MEMORY;
+    }
+
+    uint8_t *payload = data + APE_INDEX_HEADER_SIZE;
+    if (frameData->flatten(payload, framesize) != OK
+            || tagData->flatten(payload + align8(framesize), tagsize) != OK) {
+        free(data);
+        return ERROR_MALFORMED;
+    }
+
+    writeLE32(data, APE_INDEX_MAGIC);
+    writeLE32(data + 4, APE_INDEX_VERSION);
+    writeLE64(data + 8, key.filesize);
+    writeLE64(data + 16, key.hash);
+    writeLE64(data + 24, hashBytes(0xcbf29ce484222325ULL, payload, size - APE_INDEX_HEADER_SIZE));
+    writeLE32(data + 40, framesize);
+    writeLE32(data + 44, tagsize);
+
+    Mutex::Autolock autoLock(mLock);
+
+    if (!mTotalKnown || mTotalSize + size > mMaxSize) {
+        evict_l(size);
+    }
+
+    //Write to a private name and rename, so other processes never see a
+    //partial entry. An entry of the same key is replaced.
+    String8 path = getPath(key);
+    struct stat st;
+    size_t replaced = stat(path.string(), &st) == 0 ? st.st_size : 0;
+    String8 tmpPath(mDir);
+    tmpPath.appendFormat("/.tmp-%d", getpid());
+
+    status_t err = ERROR_IO;
+    int fd = open(tmpPath.string(), O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (fd >= 0) {
+        err = writeFully(fd, data, size);
+        if (close(fd) != 0) {
+            err = ERROR_IO;
+        }
+        if (err == OK && rename(tmpPath.string(), path.string()) != 0) {
+            err = ERROR_IO;
+        }
+        if (err != OK) {
+            unlink(tmpPath.string());
+        }
+    }
+    free(data);
+
+    if (err != OK) {
+        LOGE("Failed to write index %s. (%s)", path.string(), strerror(errno));
+        return err;
+    }
+    mTotalSize -= mTotalSize < replaced ? mTotalSize : replaced;
+    mTotalSize += size;
+    return OK;
+}
+
+typedef struct {
+    //Into the names listed by evict_l().
+    size_t name;
+    size_t size;
+    time_t mtime;
+} ApeIndexEntry;
+
+static int compareEntries(const void *lhs, const void *rhs) {
+    time_t l = ((const ApeIndexEntry *)lhs)->mtime;
+    time_t r = ((const ApeIndexEntry *)rhs)->mtime;
+    return l < r ? -1 : l > r;
+}
+
+//Lists the directory, drops temporary files nobody is writing anymore, and
+//removes the least recently used entries until reserve more bytes fit.
+void APEIndexCache::evict_l(size_t reserve) {
+    DIR *dir = opendir(mDir.string());
+    if (dir == NULL) {
+        return;
+    }
+
+    Vector<String8> names;
+    Vector<ApeIndexEntry> entries;
+    uint64_t total = 0;
+    time_t now = time(NULL);
+    struct dirent *ent;
+    while ((ent = readdir(dir)) != NULL) {
+        size_t len = strlen(ent->d_name);
+        bool tmp = !strncmp(ent->d_name, ".tmp-", 5);
+        if (!tmp && (len < 4 || strcmp(ent->d_name + len - 4, ".idx"))) {
+            continue;
+        }
+
+        String8 path(mDir);
+        path.appendFormat("/%s", ent->d_name);
+
+        struct stat st;
+        if (stat(path.string(), &st) != 0) {
+            continue;
+        }
+        if (tmp) {
+            if (now - st.st_mtime > APE_INDEX_STALE_TMP_SECONDS) {
+                ALOGV("Removing stale %s", path.string());
+                unlink(path.string());
+            } else {
+                total += st.st_size;
+            }
+            continue;
+        }
+
+        ApeIndexEntry entry;
+        entry.name = names.size();
+        entry.size = st.st_size;
+        entry.mtime = st.st_mtime;
+        names.push(path);
+        entries.push(entry);
+        total += entry.size;
+    }
+    closedir(dir);
+
+    if (!entries.isEmpty()) {
+        qsort(entries.editArray(), entries.size(), sizeof(ApeIndexEntry), compareEntries);
+    }
+    for (size_t i = 0; i < entries.size() && total + reserve > mMaxSize; i++) {
+        const String8 &path = names[entries[i].name];
+        ALOGV("Evicting %s", path.string());
+        if (unlink(path.string()) == 0) {
+            total -= entries[i].size;
+        }
+    }
+
+    mTotalSize = total;
+    mTotalKnown = true;
+}
+
+}  // namespace android
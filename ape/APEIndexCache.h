@@ -0,0 +1,90 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_INDEX_CACHE_H_
+
+#define APE_INDEX_CACHE_H_
+
+#include <utils/Errors.h>
+#include <utils/Mutex.h>
+#include <utils/RefBase.h>
+#include <utils/String8.h>
+
+namespace android {
+
+class DataSource;
+class APEFrameData;
+class APETagData;
+
+//Identifies a file by its size and a hash of its first and last bytes.
+//DataSource does not expose a path or mtime, so this is what is available.
+typedef struct {
+    uint64_t filesize;
+    uint64_t hash;
+} ApeIndexKey;
+
+//Keeps flattened frame indexes and tags on disk, so reopening a large file
+//skips the seek table and tag reads. Enabled by media.ape.index_cache.dir,
+//bounded by media.ape.index_cache.size (bytes) with least recently used
+//entries evicted first. The size of the directory is tracked in memory,
+//it is only listed again when that total says an entry would not fit.
+//Other processes sharing the directory are caught up with then.
+class APEIndexCache : public RefBase {
+public:
+    //Returns NULL when the cache is not configured.
+    static sp<APEIndexCache> getInstance();
+
+    status_t getKey(const sp<DataSource> &source, ApeIndexKey *key);
+
+    status_t load(const ApeIndexKey &key, const sp<DataSource> &source,
+            sp<APEFrameData> *frameData, sp<APETagData> *tagData);
+
+    status_t save(const ApeIndexKey &key, const sp<APEFrameData> &frameData,
+            const sp<APETagData> &tagData);
+
+protected:
+    virtual ~APEIndexCache();
+
+private:
+    String8 mDir;
+    size_t mMaxSize;
+    Mutex mLock;
+    //Bytes in the directory as of the last listing, plus what was written
+    //and less what was removed since. Unknown before the first save().
+    uint64_t mTotalSize;
+    bool mTotalKnown;
+
+    APEIndexCache(const char *dir, size_t maxSize);
+
+    String8 getPath(const ApeIndexKey &key) const;
+    void evict_l(size_t reserve);
+
+    APEIndexCache(const APEIndexCache &);
+    APEIndexCache &operator=(const APEIndexCache &);
+};
+
+}  // namespace android
+
+#endif  // APE_INDEX_CACHE_H_
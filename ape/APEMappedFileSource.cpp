@@ -0,0 +1,170 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "APEMappedFileSource"
+#include <utils/Log.h>
+
+#include "APEMappedFileSource.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/MediaErrors.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace android {
+
+APEMappedFileSource::APEMappedFileSource(const char *filename)
+        :mFd(-1),
+         mMapBase(MAP_FAILED),
+         mMapSize(0),
+         mData(NULL),
+         mLength(0) {
+    mFd = open(filename, O_RDONLY);
+    if (mFd < 0) {
+        LOGE("Failed to open file '%s'. (%s)", filename, strerror(errno));
+        return;
+    }
+
+    struct stat st;
+    if (fstat(mFd, &st) != 0) {
+        return;
+    }
+    map(0, st.st_size);
+}
+
+APEMappedFileSource::APEMappedFileSource(int fd, int64_t offset, int64_t length)
+        :mFd(fd),
+         mMapBase(MAP_FAILED),
+         mMapSize(0),
+         mData(NULL),
+         mLength(0) {
+    CHECK(offset >= 0);
+    CHECK(length >= 0);
+
+    map(offset, length);
+}
+
+APEMappedFileSource::~APEMappedFileSource() {
+    if (mMapBase != MAP_FAILED) {
+        munmap(mMapBase, mMapSize);
+        mMapBase = MAP_FAILED;
+    }
+
+    if (mFd >= 0) {
+        close(mFd);
+        mFd = -1;
+    }
+}
+
+void APEMappedFileSource::map(int64_t offset, int64_t length) {
+    if (length <= 0 || (uint64_t)length > SIZE_MAX) {
+        return;
+    }
+
+    //mmap() wants a page aligned offset, the slack is skipped through mData.
+    const int64_t pagesize = sysconf(_SC_PAGESIZE);
+    int64_t slack = offset % pagesize;
+
+    mMapSize = length + slack;
+    mMapBase = mmap(NULL, mMapSize, PROT_READ, MAP_SHARED, mFd, offset - slack);
+    if (mMapBase == MAP_FAILED) {
+        LOGE("Failed to map %lld bytes. (%s)", (long long)length, strerror(errno));
+        mMapSize = 0;
+        return;
+    }
+
+    mData = (const uint8_t *)mMapBase + slack;
+    mLength = length;
+}
+
+status_t APEMappedFileSource::initCheck() const {
+    return mData != NULL ? OK : NO_INIT;
+}
+
+ssize_t APEMappedFileSource::readAt(off64_t offset, void *data, size_t size) {
+    if (mData == NULL || offset < 0) {
+        return NO_INIT;
+    }
+
+    if (offset >= mLength) {
+        return 0;
+    }
+    if ((int64_t)size > mLength - offset) {
+        size = mLength - offset;
+    }
+
+    memcpy(data, mData + offset, size);
+    return size;
+}
+
+status_t APEMappedFileSource::getSize(off64_t *size) {
+    if (mData == NULL) {
+        return NO_INIT;
+    }
+
+    *size = mLength;
+    return OK;
+}
+
+const uint8_t *APEMappedFileSource::getData(off64_t offset, size_t size) {
+    if (mData == NULL || offset < 0 || offset > mLength || (int64_t)size > mLength - offset) {
+        return NULL;
+    }
+
+    return mData + offset;
+}
+
+void APEMappedFileSource::adviseSequential(off64_t offset, size_t size) {
+    advise(offset, size, MADV_SEQUENTIAL);
+}
+
+void APEMappedFileSource::adviseWillNeed(off64_t offset, size_t size) {
+    advise(offset, size, MADV_WILLNEED);
+}
+
+void APEMappedFileSource::advise(off64_t offset, size_t size, int advice) {
+    const uint8_t *data = getData(offset, size);
+    if (data == NULL || size == 0) {
+        return;
+    }
+
+    //madvise() needs a page aligned start address.
+    const uintptr_t pagesize = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t)data & ~(pagesize - 1);
+    size += (uintptr_t)data - start;
+
+    if (madvise((void *)start, size, advice) != 0) {
+        ALOGV("madvise(%d) failed. (%s)", advice, strerror(errno));
+    }
+}
+
+}  // namespace android
@@ -0,0 +1,75 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+#ifndef APE_MAPPED_FILE_SOURCE_H_
+
+#define APE_MAPPED_FILE_SOURCE_H_
+
+#include <media/stagefright/DataSource.h>
+
+namespace android {
+
+//Local file DataSource that maps the whole file, so APESource can hand out
+//frames as MediaBuffers pointing straight into the mapping. Pass it to
+//APEExtractor::createMapped(), there is no RTTI to recognize it otherwise.
+class APEMappedFileSource : public DataSource {
+public:
+    APEMappedFileSource(const char *filename);
+
+    // APEMappedFileSource takes ownership and will close the fd.
+    APEMappedFileSource(int fd, int64_t offset, int64_t length);
+
+    virtual status_t initCheck() const;
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size);
+
+    virtual status_t getSize(off64_t *size);
+
+    //Returns the mapped bytes at offset, or NULL if [offset, offset + size)
+    //is not inside the file. The data stays valid for the lifetime of the source.
+    const uint8_t *getData(off64_t offset, size_t size);
+
+    void adviseSequential(off64_t offset, size_t size);
+    void adviseWillNeed(off64_t offset, size_t size);
+
+protected:
+    virtual ~APEMappedFileSource();
+
+private:
+    int mFd;
+    void *mMapBase;
+    size_t mMapSize;
+    const uint8_t *mData;
+    int64_t mLength;
+
+    void map(int64_t offset, int64_t length);
+    void advise(off64_t offset, size_t size, int advice);
+
+    APEMappedFileSource(const APEMappedFileSource &);
+    APEMappedFileSource &operator=(const APEMappedFileSource &);
+};
+
+}  // namespace android
+
+#endif  // APE_MAPPED_FILE_SOURCE_H_
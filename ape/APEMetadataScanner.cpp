@@ -0,0 +1,177 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "APEMetadataScanner"
+#include <utils/Log.h>
+
+#include "APEMetadataScanner.h"
+#include "APEWorkerPool.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/MediaErrors.h>
+#include <cutils/atomic.h>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace android {
+
+struct APEMetadataScanner::Batch {
+    const Vector<sp<DataSource> > *sources;
+    ApeScanResult *results;
+    uint8_t *arena;
+    int32_t arenaSize;
+    //Bytes of arena handed out so far.
+    volatile int32_t arenaUsed;
+};
+
+size_t APEMetadataScanner::scan(const Vector<sp<DataSource> > &sources,
+        ApeScanResult *results, void *arena, size_t arenaSize, size_t threadCount) {
+    Batch batch;
+    batch.sources = &sources;
+    batch.results = results;
+    batch.arena = (uint8_t *)arena;
+    batch.arenaSize = arenaSize > INT32_MAX ? INT32_MAX : arenaSize;
+    batch.arenaUsed = 0;
+
+    APEWorkerPool::run(sources.size(), threadCount, scanItem, &batch);
+    ALOGV("Scanned %zu files, %d bytes of arena", sources.size(), batch.arenaUsed);
+
+    return batch.arenaUsed;
+}
+
+// static
+void APEMetadataScanner::scanItem(void *cookie, size_t index) {
+    scanOne((Batch *)cookie, index);
+}
+
+void *APEMetadataScanner::allocate(Batch *batch, size_t size) {
+    size = (size + 7) & ~(size_t)7;
+
+    int32_t used;
+    do {
+        used = android_atomic_acquire_load(&batch->arenaUsed);
+        if (size > (size_t)(batch->arenaSize - used)) {
+            return NULL;
+        }
+    } while (android_atomic_cmpxchg(used, used + size, &batch->arenaUsed));
+
+    return batch->arena + used;
+}
+
+//Takes the tag items straight from the parser into the arena. Running out
+//of arena sticks, the parser would otherwise go on to an ID3v1 tag.
+struct APEMetadataScanner::ArenaSink : public APETagItemSink {
+    ArenaSink(Batch *batch)
+        :batch(batch),
+         tags(NULL),
+         count(0),
+         maxCount(0),
+         status(OK) {
+    }
+
+    virtual status_t beginItems(size_t max) {
+        if (status != OK) {
+            return status;
+        }
+        tags = NULL;
+        count = 0;
+        maxCount = max;
+        if (max > 0) {
+            tags = (ApeScanTag *)allocate(batch, max * sizeof(ApeScanTag));
+            if (tags == NULL) {
+                status = NO_MEMORY;
+            }
+        }
+        return status;
+    }
+
+    virtual status_t addItem(const char *key, size_t keyLength, uint32_t flags,
+            off64_t offset, uint32_t size, const char *value, size_t valueLength) {
+        if (status != OK) {
+            return status;
+        }
+        if (count == maxCount) {
+            return ERROR_MALFORMED;
+        }
+
+        char *keycopy = (char *)allocate(batch, keyLength + 1);
+        char *valuecopy = NULL;
+        if (value != NULL) {
+            valuecopy = (char *)allocate(batch, valueLength + 1);
+        }
+        if (keycopy == NULL || (value != NULL && valuecopy == NULL)) {
+            status = NO_MEMORY;
+            return status;
+        }
+
+        memcpy(keycopy, key, keyLength);
+        keycopy[keyLength] = '\0';
+        if (value != NULL) {
+            memcpy(valuecopy, value, valueLength);
+            valuecopy[valueLength] = '\0';
+        }
+
+        ApeScanTag *tag = &tags[count++];
+        tag->key = keycopy;
+        tag->value = valuecopy;
+        tag->flags = flags;
+        tag->offset = offset;
+        tag->size = size;
+        return OK;
+    }
+
+    Batch *batch;
+    ApeScanTag *tags;
+    size_t count;
+    size_t maxCount;
+    status_t status;
+};
+
+void APEMetadataScanner::scanOne(Batch *batch, size_t index) {
+    sp<DataSource> source = APEFrameData::getStreamSource((*batch->sources)[index]);
+    ApeScanResult *result = &batch->results[index];
+    off64_t seektableoffset;
+
+    memset(result, 0, sizeof(*result));
+
+    result->status = APEFrameData::parseHeader(source, &result->header, &seektableoffset);
+    if (result->status != OK) {
+        return;
+    }
+
+    ArenaSink sink(batch);
+    if (APETagData::parse(source, &sink) != OK || sink.status != OK) {
+        result->status = sink.status;
+        return;
+    }
+
+    result->tagCount = sink.count;
+    result->tags = sink.count > 0 ? sink.tags : NULL;
+}
+
+}  // namespace android
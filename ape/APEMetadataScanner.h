@@ -0,0 +1,86 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_METADATA_SCANNER_H_
+
+#define APE_METADATA_SCANNER_H_
+
+#include <utils/Errors.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+#include "APEExtractor.h"
+
+namespace android {
+
+class DataSource;
+
+//One tag item of a scanned file. Key and value are NUL terminated and live
+//in the caller's arena; value is NULL for binary and locator items.
+typedef struct {
+    const char *key;
+    const char *value;
+    uint32_t flags;
+    //Position and length of the value in the file.
+    off64_t offset;
+    uint32_t size;
+} ApeScanTag;
+
+typedef struct {
+    //OK, or why the file was rejected. NO_MEMORY if the arena ran out.
+    status_t status;
+    //Valid when status is OK, durationUS included.
+    ApeHeaderData header;
+    //Tags are optional, a file without them has tagCount 0.
+    size_t tagCount;
+    const ApeScanTag *tags;
+} ApeScanResult;
+
+//Collects header, duration and tags of many files for library scanning.
+//Only the descriptor/header and the tag footer region are read, the seek
+//table is never touched and no extractor is built.
+class APEMetadataScanner {
+public:
+    //Scans every source on up to threadCount threads (0 picks the number of
+    //CPUs). results must hold sources.size() entries. Tag data is carved out
+    //of arena; files that do not fit get NO_MEMORY and the rest carry on.
+    //Returns the number of bytes of arena used.
+    static size_t scan(const Vector<sp<DataSource> > &sources, ApeScanResult *results,
+            void *arena, size_t arenaSize, size_t threadCount);
+
+private:
+    struct Batch;
+    struct ArenaSink;
+
+    static void scanItem(void *cookie, size_t index);
+    static void scanOne(Batch *batch, size_t index);
+    static void *allocate(Batch *batch, size_t size);
+
+    APEMetadataScanner();
+};
+
+}  // namespace android
+
+#endif  // APE_METADATA_SCANNER_H_
@@ -0,0 +1,380 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "APEParallelDecoder"
+#include <utils/Log.h>
+
+#include "APEParallelDecoder.h"
+#include "APEDecoder.h"
+#include "APEExtractor.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+
+#include <string.h>
+#include <unistd.h>
+
+//Upper bound of worker threads, whatever start() asks for.
+#define APE_MAX_DECODE_THREADS 16
+
+namespace android {
+
+APEParallelDecoder::APEParallelDecoder(const sp<APEExtractor> &extractor)
+        :mExtractor(extractor),
+         mChannels(0),
+         mFrameSize(0),
+         mSampleRate(0),
+         mStarted(false),
+         mStopping(false),
+         mReorderFrames(0),
+         mNextFrameNum(0),
+         mOutputFrameNum(0),
+         mGeneration(0),
+         mSkipSamples(0),
+         mInitCheck(NO_INIT) {
+    mAPEFrameData = mExtractor->getFrameData();
+    if (mAPEFrameData == NULL) {
+        return;
+    }
+
+    //A throwaway decoder checks that the track is supported and provides
+    //the output format.
+    sp<MediaSource> source = mExtractor->getFileTrack();
+    if (source == NULL) {
+        return;
+    }
+    sp<APEDecoder> decoder = new APEDecoder(source);
+    mInitCheck = decoder->initCheck();
+    if (mInitCheck != OK) {
+        return;
+    }
+
+    mMeta = decoder->getFormat();
+    int32_t bitspersample = 16;
+    mMeta->findInt32(kKeyChannelCount, &mChannels);
+    mMeta->findInt32(kKeySampleRate, &mSampleRate);
+    mMeta->findInt32(kKeyBitsPerSample, &bitspersample);
+    mFrameSize = mChannels * (bitspersample / 8);
+}
+
+APEParallelDecoder::~APEParallelDecoder() {
+    stop();
+}
+
+status_t APEParallelDecoder::initCheck() const {
+    return mInitCheck;
+}
+
+status_t APEParallelDecoder::start(MetaData *params) {
+    if (mInitCheck != OK) {
+        return mInitCheck;
+    }
+    if (mStarted) {
+        return OK;
+    }
+
+    int32_t threads = 0;
+    int32_t reorderframes = 0;
+    if (params != NULL) {
+        params->findInt32(kKeyApeDecodeThreads, &threads);
+        params->findInt32(kKeyApeReorderFrames, &reorderframes);
+    }
+    if (threads <= 0) {
+        threads = sysconf(_SC_NPROCESSORS_ONLN);
+    }
+    if (threads <= 0) {
+        threads = 1;
+    } else if (threads > APE_MAX_DECODE_THREADS) {
+        threads = APE_MAX_DECODE_THREADS;
+    }
+    //Enough room that no worker waits on a slow frame of another.
+    if (reorderframes < threads) {
+        reorderframes = threads * 2;
+    }
+
+    mStopping = false;
+    mReorderFrames = reorderframes;
+    mNextFrameNum = 0;
+    mOutputFrameNum = 0;
+    mSkipSamples = 0;
+
+    for (int32_t i = 0; i < threads; i++) {
+        sp<MediaSource> source = mExtractor->getFileTrack();
+        if (source == NULL) {
+            stop();
+            return ERROR_IO;
+        }
+
+        Worker *worker = new Worker;
+        worker->owner = this;
+        worker->decoder = new APEDecoder(source);
+        worker->framenum = 0;
+        worker->started = false;
+        mWorkers.push(worker);
+
+        status_t err = worker->decoder->start(params);
+        if (err != OK) {
+            stop();
+            return err;
+        }
+    }
+
+    mStarted = true;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    for (size_t i = 0; i < mWorkers.size(); i++) {
+        Worker *worker = mWorkers[i];
+        worker->started = pthread_create(&worker->thread, &attr, ThreadWrapper, worker) == 0;
+        if (!worker->started) {
+            LOGE("Failed to start decode thread %zu", i);
+            pthread_attr_destroy(&attr);
+            stop();
+            return UNKNOWN_ERROR;
+        }
+    }
+    pthread_attr_destroy(&attr);
+
+    ALOGV("Decoding %u frames on %zu threads, %u frames ahead",
+            mAPEFrameData->getApeHeaderData()->totalframes, mWorkers.size(), mReorderFrames);
+
+    return OK;
+}
+
+status_t APEParallelDecoder::stop() {
+    {
+        Mutex::Autolock autoLock(mLock);
+        mStopping = true;
+        mWorkCondition.broadcast();
+    }
+
+    for (size_t i = 0; i < mWorkers.size(); i++) {
+        Worker *worker = mWorkers[i];
+        if (worker->started) {
+            pthread_join(worker->thread, NULL);
+        }
+        worker->decoder->stop();
+        delete worker;
+    }
+    mWorkers.clear();
+
+    Mutex::Autolock autoLock(mLock);
+    releaseDecodedFrames_l();
+    mStarted = false;
+
+    return OK;
+}
+
+sp<MetaData> APEParallelDecoder::getFormat() {
+    return mMeta;
+}
+
+status_t APEParallelDecoder::read(
+        MediaBuffer **out, const ReadOptions *options) {
+    *out = NULL;
+    if (!mStarted) {
+        return NO_INIT;
+    }
+
+    const uint32_t totalframes = mAPEFrameData->getApeHeaderData()->totalframes;
+    int64_t seekTimeUs;
+    ReadOptions::SeekMode mode;
+
+    Mutex::Autolock autoLock(mLock);
+    if (options != NULL && options->getSeekTo(&seekTimeUs, &mode)) {
+        int32_t framenum, skipsamples;
+        mAPEFrameData->getRequiredFrameNum(seekTimeUs, mode, &framenum, &skipsamples);
+
+        releaseDecodedFrames_l();
+        mNextFrameNum = framenum;
+        mOutputFrameNum = framenum;
+        mSkipSamples = skipsamples;
+        mGeneration++;
+        mWorkCondition.broadcast();
+    }
+
+    DecodedFrame frame;
+    for (;;) {
+        if (mOutputFrameNum >= totalframes) {
+            return ERROR_END_OF_STREAM;
+        }
+
+        List<DecodedFrame>::iterator it = mDecoded.begin();
+        while (it != mDecoded.end() && (*it).framenum != mOutputFrameNum) {
+            ++it;
+        }
+        if (it != mDecoded.end()) {
+            frame = *it;
+            mDecoded.erase(it);
+            break;
+        }
+        mFrameReadyCondition.wait(mLock);
+    }
+
+    if (frame.err != OK) {
+        //Nothing past a failed frame is returned until the next seek.
+        releaseDecodedFrames_l();
+        mNextFrameNum = totalframes;
+        mOutputFrameNum = totalframes;
+        mGeneration++;
+        return frame.err;
+    }
+
+    mOutputFrameNum++;
+    mWorkCondition.broadcast();
+
+    MediaBuffer *buffer = frame.buffer;
+    if (mSkipSamples > 0) {
+        const size_t framesize = mFrameSize;
+        size_t skip = mSkipSamples * framesize;
+        if (skip > buffer->range_length()) {
+            skip = buffer->range_length();
+        }
+        buffer->set_range(skip, buffer->range_length() - skip);
+
+        int64_t timeUs = 0;
+        buffer->meta_data()->findInt64(kKeyTime, &timeUs);
+        buffer->meta_data()->setInt64(kKeyTime,
+                timeUs + (int64_t)(skip / framesize) * 1000000 / mSampleRate);
+        mSkipSamples = 0;
+    }
+
+    *out = buffer;
+    return OK;
+}
+
+void *APEParallelDecoder::ThreadWrapper(void *me) {
+    Worker *worker = static_cast<Worker *>(me);
+    worker->owner->threadEntry(worker);
+
+    return NULL;
+}
+
+void APEParallelDecoder::threadEntry(Worker *worker) {
+    const uint32_t totalframes = mAPEFrameData->getApeHeaderData()->totalframes;
+
+    Mutex::Autolock autoLock(mLock);
+    while (!mStopping) {
+        if (mNextFrameNum >= totalframes
+                || mNextFrameNum >= mOutputFrameNum + mReorderFrames) {
+            mWorkCondition.wait(mLock);
+            continue;
+        }
+
+        uint32_t framenum = mNextFrameNum++;
+        uint32_t generation = mGeneration;
+
+        mLock.unlock();
+        MediaBuffer *buffer = NULL;
+        status_t err = decodeFrame(worker, framenum, &buffer);
+        mLock.lock();
+
+        if (generation != mGeneration) {
+            if (buffer != NULL) {
+                buffer->release();
+            }
+            continue;
+        }
+
+        DecodedFrame frame;
+        frame.framenum = framenum;
+        frame.buffer = buffer;
+        frame.err = err;
+        mDecoded.push_back(frame);
+        mFrameReadyCondition.signal();
+    }
+}
+
+status_t APEParallelDecoder::decodeFrame(
+        Worker *worker, uint32_t framenum, MediaBuffer **out) {
+    *out = NULL;
+    const ApeFrame apeframe = mAPEFrameData->getCurrentFrame(framenum);
+    const size_t framesize = mFrameSize;
+    const size_t size = apeframe.nblocks * framesize;
+
+    //The decoder only seeks by time; the start of a frame rounds down to the
+    //last sample of the previous one at worst, which SEEK_NEXT_SYNC moves
+    //back onto this frame.
+    ReadOptions options;
+    const ReadOptions *readoptions = NULL;
+    if (worker->framenum != framenum) {
+        options.setSeekTo(mAPEFrameData->getFrameTimeUs(framenum), ReadOptions::SEEK_NEXT_SYNC);
+        readoptions = &options;
+    }
+    worker->framenum = framenum + 1;
+
+    MediaBuffer *buffer = new MediaBuffer(size);
+    size_t filled = 0;
+    while (filled < size) {
+        MediaBuffer *pcm;
+        status_t err = worker->decoder->read(&pcm, readoptions);
+        readoptions = NULL;
+        if (err != OK) {
+            buffer->release();
+            //Frames after an error are located again.
+            worker->framenum = (uint32_t)-1;
+            return err;
+        }
+
+        if (filled == 0) {
+            int64_t timeUs = mAPEFrameData->getFrameTimeUs(framenum);
+            pcm->meta_data()->findInt64(kKeyTime, &timeUs);
+            buffer->meta_data()->setInt64(kKeyTime, timeUs);
+        }
+
+        size_t length = pcm->range_length();
+        if (length > size - filled) {
+            LOGE("Frame %u decodes to more than %u blocks", framenum, apeframe.nblocks);
+            pcm->release();
+            buffer->release();
+            worker->framenum = (uint32_t)-1;
+            return ERROR_MALFORMED;
+        }
+        memcpy((uint8_t *)buffer->data() + filled,
+               (const uint8_t *)pcm->data() + pcm->range_offset(), length);
+        filled += length;
+        pcm->release();
+    }
+
+    *out = buffer;
+    return OK;
+}
+
+void APEParallelDecoder::releaseDecodedFrames_l() {
+    while (!mDecoded.empty()) {
+        DecodedFrame &frame = *mDecoded.begin();
+        if (frame.buffer != NULL) {
+            frame.buffer->release();
+        }
+        mDecoded.erase(mDecoded.begin());
+    }
+}
+
+}  // namespace android
@@ -0,0 +1,128 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_PARALLEL_DECODER_H_
+
+#define APE_PARALLEL_DECODER_H_
+
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/Errors.h>
+#include <utils/List.h>
+#include <utils/threads.h>
+#include <utils/Vector.h>
+
+#include <pthread.h>
+
+namespace android {
+
+class APEDecoder;
+class APEExtractor;
+class APEFrameData;
+class MediaBuffer;
+
+//Decodes an APEExtractor's whole file, cue sheet tracks or not, on a pool
+//of threads, for batch jobs that want it as fast as possible. Frames
+//decode independently from their seek table offset, so every worker owns
+//an APESource/APEDecoder pair with its own read cursor and takes the next
+//frame number from the index. read() returns one buffer of PCM per frame,
+//in APEDecoder's format and in order; at most kKeyApeReorderFrames frames
+//are decoded ahead of it.
+class APEParallelDecoder : public MediaSource {
+public:
+    APEParallelDecoder(const sp<APEExtractor> &extractor);
+
+    status_t initCheck() const;
+
+    //Takes kKeyApeDecodeThreads and kKeyApeReorderFrames, the rest of params
+    //is passed on to every worker's APEDecoder.
+    virtual status_t start(MetaData *params = NULL);
+    virtual status_t stop();
+
+    virtual sp<MetaData> getFormat();
+
+    virtual status_t read(
+            MediaBuffer **buffer, const ReadOptions *options = NULL);
+
+protected:
+    virtual ~APEParallelDecoder();
+
+private:
+    struct Worker {
+        APEParallelDecoder *owner;
+        sp<APEDecoder> decoder;
+        //Frame the decoder reads next without a seek.
+        uint32_t framenum;
+        pthread_t thread;
+        bool started;
+    };
+
+    struct DecodedFrame {
+        uint32_t framenum;
+        MediaBuffer *buffer;
+        status_t err;
+    };
+
+    sp<APEExtractor> mExtractor;
+    sp<APEFrameData> mAPEFrameData;
+    sp<MetaData> mMeta;
+    int32_t mChannels;
+    //Bytes of one block of output, all channels.
+    size_t mFrameSize;
+    int32_t mSampleRate;
+    bool mStarted;
+
+    Vector<Worker *> mWorkers;
+
+    //Workers take mNextFrameNum while it is less than mOutputFrameNum plus
+    //mReorderFrames, and queue the result in mDecoded; read() waits for
+    //mOutputFrameNum to show up there. A seek bumps mGeneration so that
+    //frames still being decoded for the old position are dropped.
+    Mutex mLock;
+    Condition mWorkCondition;
+    Condition mFrameReadyCondition;
+    bool mStopping;
+    uint32_t mReorderFrames;
+    uint32_t mNextFrameNum;
+    uint32_t mOutputFrameNum;
+    uint32_t mGeneration;
+    //Leading samples of the next frame dropped after a SEEK_CLOSEST seek.
+    uint32_t mSkipSamples;
+    List<DecodedFrame> mDecoded;
+
+    status_t mInitCheck;
+
+    static void *ThreadWrapper(void *me);
+    void threadEntry(Worker *worker);
+    status_t decodeFrame(Worker *worker, uint32_t framenum, MediaBuffer **buffer);
+    void releaseDecodedFrames_l();
+
+    APEParallelDecoder(const APEParallelDecoder &);
+    APEParallelDecoder &operator=(const APEParallelDecoder &);
+};
+
+}  // namespace android
+
+#endif  // APE_PARALLEL_DECODER_H_
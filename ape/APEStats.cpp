@@ -0,0 +1,228 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "APEStats"
+#include <utils/Log.h>
+
+#include "APEStats.h"
+
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+namespace android {
+
+static Mutex gEnabledLock;
+static bool gEnabledChecked = false;
+static bool gEnabled = false;
+
+static const char *kPhaseNames[APEStats::PHASE_COUNT] = {
+    "header", "seek table", "tag", "index cache", "frames",
+};
+
+static const char *kHistogramNames[APEStats::HIST_COUNT] = {
+    "read latency (us)", "seek distance (frames)", "buffer acquire wait (us)",
+};
+
+// static
+sp<APEStats> APEStats::create() {
+    Mutex::Autolock autoLock(gEnabledLock);
+    if (!gEnabledChecked) {
+        gEnabledChecked = true;
+
+        char value[PROPERTY_VALUE_MAX];
+        if (property_get("media.ape.stats", value, NULL) > 0) {
+            gEnabled = strtol(value, NULL, 0) != 0;
+        }
+    }
+    return gEnabled ? new APEStats : NULL;
+}
+
+// static
+void APEStats::setEnabled(bool enabled) {
+    Mutex::Autolock autoLock(gEnabledLock);
+    gEnabledChecked = true;
+    gEnabled = enabled;
+}
+
+APEStats::APEStats() {
+    memset(&mData, 0, sizeof(mData));
+}
+
+APEStats::~APEStats() {
+    //Files that were only sniffed have nothing worth logging.
+    if (mData.phases[PHASE_HEADER].reads > 0) {
+        String8 out;
+        dump(&out);
+        ALOGI("%s", out.string());
+    }
+}
+
+void APEStats::addRead(Phase phase, size_t bytes, nsecs_t timeNs) {
+    Mutex::Autolock autoLock(mLock);
+    ApeStatsPhase *data = &mData.phases[phase];
+    data->reads++;
+    data->bytes += bytes;
+    data->timeNs += timeNs;
+}
+
+void APEStats::addPhaseTime(Phase phase, nsecs_t timeNs) {
+    Mutex::Autolock autoLock(mLock);
+    mData.phases[phase].timeNs += timeNs;
+}
+
+void APEStats::addSample(Histogram histogram, uint64_t value) {
+    size_t bucket = 0;
+    while (bucket < APE_STATS_BUCKETS - 1 && (value >> bucket) != 0) {
+        bucket++;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    ApeStatsHistogram *data = &mData.histograms[histogram];
+    data->count++;
+    data->sum += value;
+    if (value > data->max) {
+        data->max = value;
+    }
+    data->buckets[bucket]++;
+}
+
+void APEStats::setIndexMemory(size_t bytes) {
+    Mutex::Autolock autoLock(mLock);
+    mData.indexBytes = bytes;
+}
+
+void APEStats::getSnapshot(Snapshot *snapshot) const {
+    Mutex::Autolock autoLock(mLock);
+    *snapshot = mData;
+}
+
+void APEStats::dump(String8 *out) const {
+    Snapshot data;
+    getSnapshot(&data);
+
+    out->append("APE extractor stats:\n");
+    for (size_t i = 0; i < PHASE_COUNT; i++) {
+        const ApeStatsPhase &phase = data.phases[i];
+        out->appendFormat("  %-12s %8llu reads %12llu bytes %10.3f ms\n",
+                kPhaseNames[i], (unsigned long long)phase.reads,
+                (unsigned long long)phase.bytes, phase.timeNs / 1E6);
+    }
+    out->appendFormat("  frame index %llu bytes\n", (unsigned long long)data.indexBytes);
+
+    for (size_t i = 0; i < HIST_COUNT; i++) {
+        const ApeStatsHistogram &histogram = data.histograms[i];
+        out->appendFormat("  %s: count %llu, mean %llu, max %llu\n",
+                kHistogramNames[i], (unsigned long long)histogram.count,
+                (unsigned long long)(histogram.count > 0 ? histogram.sum / histogram.count : 0),
+                (unsigned long long)histogram.max);
+
+        for (size_t j = 0; j < APE_STATS_BUCKETS; j++) {
+            if (histogram.buckets[j] == 0) {
+                continue;
+            }
+            unsigned long long low = j == 0 ? 0 : 1ULL << (j - 1);
+            if (j == APE_STATS_BUCKETS - 1) {
+                out->appendFormat("    [%llu, inf) %llu\n",
+                        low, (unsigned long long)histogram.buckets[j]);
+            } else {
+                out->appendFormat("    [%llu, %llu) %llu\n",
+                        low, 1ULL << j, (unsigned long long)histogram.buckets[j]);
+            }
+        }
+    }
+}
+
+status_t APEStats::dump(int fd) const {
+    String8 out;
+    dump(&out);
+
+    const char *data = out.string();
+    size_t size = out.length();
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0) {
+            return -errno;
+        }
+        data += n;
+        size -= n;
+    }
+    return OK;
+}
+
+// static
+const char *APEStats::getPhaseName(Phase phase) {
+    return kPhaseNames[phase];
+}
+
+// static
+const char *APEStats::getHistogramName(Histogram histogram) {
+    return kHistogramNames[histogram];
+}
+
+APEStatsSource::APEStatsSource(const sp<DataSource> &source, const sp<APEStats> &stats)
+        :mSource(source),
+         mStats(stats),
+         mPhase(APEStats::PHASE_HEADER) {
+}
+
+APEStatsSource::~APEStatsSource() {
+}
+
+status_t APEStatsSource::initCheck() const {
+    return mSource->initCheck();
+}
+
+ssize_t APEStatsSource::readAt(off64_t offset, void *data, size_t size) {
+    APEStats::Phase phase = (APEStats::Phase)android_atomic_acquire_load(&mPhase);
+    ssize_t n = mSource->readAt(offset, data, size);
+    mStats->addRead(phase, n > 0 ? n : 0);
+    return n;
+}
+
+status_t APEStatsSource::getSize(off64_t *size) {
+    return mSource->getSize(size);
+}
+
+uint32_t APEStatsSource::flags() {
+    return mSource->flags();
+}
+
+String8 APEStatsSource::getUri() {
+    return mSource->getUri();
+}
+
+void APEStatsSource::setPhase(APEStats::Phase phase) {
+    android_atomic_release_store(phase, &mPhase);
+}
+
+}  // namespace android
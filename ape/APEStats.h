@@ -0,0 +1,152 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_STATS_H_
+
+#define APE_STATS_H_
+
+#include <media/stagefright/DataSource.h>
+#include <utils/Errors.h>
+#include <utils/RefBase.h>
+#include <utils/String8.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+//Bucket i of a histogram counts values in [2^(i-1), 2^i), bucket 0 counts
+//zeros and the last one everything above.
+#define APE_STATS_BUCKETS 24
+
+typedef struct {
+    //readAt() calls and bytes returned, mapped frames count as one read each.
+    uint64_t reads;
+    uint64_t bytes;
+    //Wall time spent in the phase. For frames only the time inside readAt().
+    int64_t timeNs;
+} ApeStatsPhase;
+
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[APE_STATS_BUCKETS];
+} ApeStatsHistogram;
+
+//Counters and histograms of one extractor and all of its sources.
+class APEStats : public RefBase {
+public:
+    enum Phase {
+        PHASE_HEADER,
+        PHASE_SEEK_TABLE,
+        PHASE_TAG,
+        PHASE_INDEX_CACHE,
+        PHASE_FRAMES,
+        PHASE_COUNT,
+    };
+
+    enum Histogram {
+        //Microseconds per APESource::read(), seeks included.
+        HIST_READ_LATENCY,
+        //Frames between the current position and the seek target.
+        HIST_SEEK_DISTANCE,
+        //Microseconds spent waiting for a free MediaBuffer.
+        HIST_ACQUIRE_WAIT,
+        HIST_COUNT,
+    };
+
+    typedef struct {
+        ApeStatsPhase phases[PHASE_COUNT];
+        ApeStatsHistogram histograms[HIST_COUNT];
+        //Heap bytes of the frame index, see APEFrameData::getIndexMemory().
+        uint64_t indexBytes;
+    } Snapshot;
+
+    //Returns NULL unless media.ape.stats is set to a non-zero value, or
+    //setEnabled(true) was called. Callers skip every hook on NULL, so
+    //disabled stats cost a pointer check.
+    static sp<APEStats> create();
+    static void setEnabled(bool enabled);
+
+    void addRead(Phase phase, size_t bytes, nsecs_t timeNs = 0);
+    void addPhaseTime(Phase phase, nsecs_t timeNs);
+    void addSample(Histogram histogram, uint64_t value);
+    void setIndexMemory(size_t bytes);
+
+    void getSnapshot(Snapshot *snapshot) const;
+
+    void dump(String8 *out) const;
+    status_t dump(int fd) const;
+
+    static const char *getPhaseName(Phase phase);
+    static const char *getHistogramName(Histogram histogram);
+
+protected:
+    virtual ~APEStats();
+
+private:
+    mutable Mutex mLock;
+    Snapshot mData;
+
+    APEStats();
+
+    APEStats(const APEStats &);
+    APEStats &operator=(const APEStats &);
+};
+
+//Forwards to another DataSource and counts every readAt() against the
+//phase the extractor is currently in. Used for the open phases only, so
+//APESource still sees the original source and its flags.
+class APEStatsSource : public DataSource {
+public:
+    APEStatsSource(const sp<DataSource> &source, const sp<APEStats> &stats);
+
+    virtual status_t initCheck() const;
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size);
+
+    virtual status_t getSize(off64_t *size);
+
+    virtual uint32_t flags();
+
+    virtual String8 getUri();
+
+    void setPhase(APEStats::Phase phase);
+
+protected:
+    virtual ~APEStatsSource();
+
+private:
+    sp<DataSource> mSource;
+    sp<APEStats> mStats;
+    volatile int32_t mPhase;
+
+    APEStatsSource(const APEStatsSource &);
+    APEStatsSource &operator=(const APEStatsSource &);
+};
+
+}  // namespace android
+
+#endif  // APE_STATS_H_
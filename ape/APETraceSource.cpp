@@ -0,0 +1,260 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "APETraceSource"
+#include <utils/Log.h>
+
+#include "APETraceSource.h"
+
+#include <media/stagefright/MediaErrors.h>
+#include <cutils/atomic.h>
+#include <cutils/properties.h>
+#include <utils/String8.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace android {
+
+#define APE_TRACE_MAGIC "APETRC01"
+#define APE_TRACE_HEADER_SIZE 16
+#define APE_TRACE_RECORD_SIZE 28
+//Records buffered before they are written out.
+#define APE_TRACE_BUFFER_SIZE (APE_TRACE_RECORD_SIZE * 256)
+
+static volatile int32_t gTraceCount = 0;
+
+static inline uint32_t readLE32(const uint8_t *ptr) {
+    return ptr[0] | (ptr[1] << 8) | (ptr[2] << 16) | ((uint32_t)ptr[3] << 24);
+}
+
+static inline uint64_t readLE64(const uint8_t *ptr) {
+    return readLE32(ptr) | ((uint64_t)readLE32(ptr + 4) << 32);
+}
+
+static inline void writeLE32(uint8_t *ptr, uint32_t x) {
+    ptr[0] = x;
+    ptr[1] = x >> 8;
+    ptr[2] = x >> 16;
+    ptr[3] = x >> 24;
+}
+
+static inline void writeLE64(uint8_t *ptr, uint64_t x) {
+    writeLE32(ptr, (uint32_t)x);
+    writeLE32(ptr + 4, (uint32_t)(x >> 32));
+}
+
+static status_t writeFully(int fd, const uint8_t *data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd, data, size);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return ERROR_IO;
+        }
+        data += n;
+        size -= n;
+    }
+    return OK;
+}
+
+APETraceSource::APETraceSource(const sp<DataSource> &source, const char *path)
+        :mSource(source),
+         mFd(-1),
+         mStartNs(systemTime()),
+         mBuffer(NULL),
+         mBufferLength(0) {
+    mBuffer = (uint8_t *)malloc(APE_TRACE_BUFFER_SIZE);
+    if (!mBuffer) {
+        LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+        return;
+    }
+
+    mFd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0600);
+    if (mFd < 0) {
+        LOGE("Failed to create trace '%s'. (%s)", path, strerror(errno));
+        return;
+    }
+
+    off64_t filesize = 0;
+    if (mSource->getSize(&filesize) != OK) {
+        filesize = 0;
+    }
+
+    uint8_t header[APE_TRACE_HEADER_SIZE];
+    memcpy(header, APE_TRACE_MAGIC, 8);
+    writeLE64(&header[8], filesize);
+    if (writeFully(mFd, header, sizeof(header)) != OK) {
+        LOGE("Failed to write trace '%s'. (%s)", path, strerror(errno));
+        close(mFd);
+        mFd = -1;
+    }
+}
+
+APETraceSource::~APETraceSource() {
+    if (mFd >= 0) {
+        Mutex::Autolock autoLock(mLock);
+        flush_l();
+        close(mFd);
+        mFd = -1;
+    }
+    free(mBuffer);
+    mBuffer = NULL;
+}
+
+// static
+sp<DataSource> APETraceSource::wrap(const sp<DataSource> &source) {
+    char dir[PROPERTY_VALUE_MAX];
+    if (property_get("media.ape.trace.dir", dir, NULL) <= 0) {
+        return source;
+    }
+
+    String8 path(dir);
+    path.appendFormat("/trace-%d-%d.apetrace", getpid(), android_atomic_inc(&gTraceCount));
+    ALOGV("Recording reads to %s", path.string());
+    return new APETraceSource(source, path.string());
+}
+
+// static
+status_t APETraceSource::load(const char *path, off64_t *filesize,
+        Vector<ApeTraceRecord> *records) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NAME_NOT_FOUND;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < APE_TRACE_HEADER_SIZE) {
+        close(fd);
+        return ERROR_MALFORMED;
+    }
+
+    size_t size = st.st_size;
+    uint8_t *data = (uint8_t *)malloc(size);
+    if (data == NULL) {
+        close(fd);
+        return NO_MEMORY;
+    }
+
+    size_t length = 0;
+    while (length < size) {
+        ssize_t n = read(fd, data + length, size - length);
+        if (n < 0 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            break;
+        }
+        length += n;
+    }
+    close(fd);
+
+    if (length != size || memcmp(data, APE_TRACE_MAGIC, 8)) {
+        free(data);
+        return ERROR_MALFORMED;
+    }
+
+    *filesize = readLE64(&data[8]);
+
+    //A trace cut short by a crash still yields its complete records.
+    records->clear();
+    size_t count = (size - APE_TRACE_HEADER_SIZE) / APE_TRACE_RECORD_SIZE;
+    records->setCapacity(count);
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t *ptr = &data[APE_TRACE_HEADER_SIZE + i * APE_TRACE_RECORD_SIZE];
+        ApeTraceRecord record;
+        record.offset = readLE64(ptr);
+        record.size = readLE32(ptr + 8);
+        record.result = readLE32(ptr + 12);
+        record.startNs = readLE64(ptr + 16);
+        record.durationNs = readLE32(ptr + 24);
+        records->push(record);
+    }
+    free(data);
+
+    return OK;
+}
+
+status_t APETraceSource::initCheck() const {
+    return mSource->initCheck();
+}
+
+ssize_t APETraceSource::readAt(off64_t offset, void *data, size_t size) {
+    nsecs_t startNs = systemTime();
+    ssize_t n = mSource->readAt(offset, data, size);
+    nsecs_t durationNs = systemTime() - startNs;
+
+    if (durationNs > UINT32_MAX) {
+        durationNs = UINT32_MAX;
+    }
+
+    Mutex::Autolock autoLock(mLock);
+    if (mFd < 0) {
+        return n;
+    }
+    if (mBufferLength + APE_TRACE_RECORD_SIZE > APE_TRACE_BUFFER_SIZE) {
+        flush_l();
+    }
+    uint8_t *ptr = &mBuffer[mBufferLength];
+    writeLE64(ptr, offset);
+    writeLE32(ptr + 8, size);
+    writeLE32(ptr + 12, n);
+    writeLE64(ptr + 16, startNs - mStartNs);
+    writeLE32(ptr + 24, durationNs);
+    mBufferLength += APE_TRACE_RECORD_SIZE;
+
+    return n;
+}
+
+void APETraceSource::flush_l() {
+    if (mBufferLength > 0 && writeFully(mFd, mBuffer, mBufferLength) != OK) {
+        LOGE("Failed to write trace, recording stopped. (%s)", strerror(errno));
+        close(mFd);
+        mFd = -1;
+    }
+    mBufferLength = 0;
+}
+
+status_t APETraceSource::getSize(off64_t *size) {
+    return mSource->getSize(size);
+}
+
+uint32_t APETraceSource::flags() {
+    return mSource->flags();
+}
+
+String8 APETraceSource::getUri() {
+    return mSource->getUri();
+}
+
+}  // namespace android
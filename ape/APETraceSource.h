@@ -0,0 +1,97 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_TRACE_SOURCE_H_
+
+#define APE_TRACE_SOURCE_H_
+
+#include <media/stagefright/DataSource.h>
+#include <utils/Errors.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+namespace android {
+
+//One readAt() of a trace. Times are relative to the creation of the
+//recording source.
+typedef struct {
+    off64_t offset;
+    uint32_t size;
+    //Return value of readAt(), the byte count or an error.
+    int32_t result;
+    nsecs_t startNs;
+    nsecs_t durationNs;
+} ApeTraceRecord;
+
+//Forwards to another DataSource and appends every readAt() to a trace file.
+//The trace starts with the magic "APETRC01" and the LE64 size of the source,
+//followed by one 28-byte record per read: LE64 offset, LE32 size, LE32
+//result, LE64 start and LE32 duration in nanoseconds.
+class APETraceSource : public DataSource {
+public:
+    APETraceSource(const sp<DataSource> &source, const char *path);
+
+    //Wraps source when media.ape.trace.dir names a directory, every source
+    //then records to its own trace-<pid>-<n>.apetrace file there. Returns
+    //source itself otherwise.
+    static sp<DataSource> wrap(const sp<DataSource> &source);
+
+    //Reads a whole trace file.
+    static status_t load(const char *path, off64_t *filesize,
+            Vector<ApeTraceRecord> *records);
+
+    virtual status_t initCheck() const;
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size);
+
+    virtual status_t getSize(off64_t *size);
+
+    virtual uint32_t flags();
+
+    virtual String8 getUri();
+
+protected:
+    virtual ~APETraceSource();
+
+private:
+    sp<DataSource> mSource;
+    int mFd;
+    nsecs_t mStartNs;
+
+    //Records are batched, reads may come from the prefetch thread too.
+    Mutex mLock;
+    uint8_t *mBuffer;
+    size_t mBufferLength;
+
+    void flush_l();
+
+    APETraceSource(const APETraceSource &);
+    APETraceSource &operator=(const APETraceSource &);
+};
+
+}  // namespace android
+
+#endif  // APE_TRACE_SOURCE_H_
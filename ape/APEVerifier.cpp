@@ -0,0 +1,403 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "APEVerifier"
+#include <utils/Log.h>
+
+#include "APEVerifier.h"
+#include "APEExtractor.h"
+#include "APEWorkerPool.h"
+
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/MediaErrors.h>
+#include <cutils/atomic.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+//Large sequential reads keep the kernel readahead ahead of the hashing, so
+//one thread per file runs close to disk bandwidth.
+#define APE_VERIFY_CHUNK_SIZE (1024 * 1024)
+//A chunk that fails to read is read again in pieces of this size, so that
+//one bad sector does not mark a whole chunk worth of frames.
+#define APE_VERIFY_RETRY_SIZE (64 * 1024)
+
+namespace android {
+
+//MD5 as in RFC 1321.
+typedef struct {
+    uint32_t state[4];
+    uint64_t length;
+    uint8_t buffer[64];
+} ApeMD5Context;
+
+static const uint32_t kMD5K[64] = {
+    0xd76aa478, 0xe8c7b756, 0x242070db, 0xc1bdceee, 0xf57c0faf, 0x4787c62a, 0xa8304613, 0xfd469501,
+    0x698098d8, 0x8b44f7af, 0xffff5bb1, 0x895cd7be, 0x6b901122, 0xfd987193, 0xa679438e, 0x49b40821,
+    0xf61e2562, 0xc040b340, 0x265e5a51, 0xe9b6c7aa, 0xd62f105d, 0x02441453, 0xd8a1e681, 0xe7d3fbc8,
+    0x21e1cde6, 0xc33707d6, 0xf4d50d87, 0x455a14ed, 0xa9e3e905, 0xfcefa3f8, 0x676f02d9, 0x8d2a4c8a,
+    0xfffa3942, 0x8771f681, 0x6d9d6122, 0xfde5380c, 0xa4beea44, 0x4bdecfa9, 0xf6bb4b60, 0xbebfbc70,
+    0x289b7ec6, 0xeaa127fa, 0xd4ef3085, 0x04881d05, 0xd9d4d039, 0xe6db99e5, 0x1fa27cf8, 0xc4ac5665,
+    0xf4292244, 0x432aff97, 0xab9423a7, 0xfc93a039, 0x655b59c3, 0x8f0ccc92, 0xffeff47d, 0x85845dd1,
+    0x6fa87e4f, 0xfe2ce6e0, 0xa3014314, 0x4e0811a1, 0xf7537e82, 0xbd3af235, 0x2ad7d2bb, 0xeb86d391,
+};
+
+static inline uint32_t rotateLeft(uint32_t x, int n) {
+    return (x << n) | (x >> (32 - n));
+}
+
+//One step of each round, unrolled; a loop with a switch runs at half speed.
+#define MD5_STEP(f, a, b, c, d, m, k, s) \
+    (a) = (b) + rotateLeft((a) + f((b), (c), (d)) + (m) + (k), (s))
+#define MD5_F(x, y, z) ((z) ^ ((x) & ((y) ^ (z))))
+#define MD5_G(x, y, z) ((y) ^ ((z) & ((x) ^ (y))))
+#define MD5_H(x, y, z) ((x) ^ (y) ^ (z))
+#define MD5_I(x, y, z) ((y) ^ ((x) | ~(z)))
+
+static void md5Transform(uint32_t state[4], const uint8_t *block) {
+    uint32_t m[16];
+    for (int i = 0; i < 16; i++) {
+        m[i] = block[i * 4] | (block[i * 4 + 1] << 8)
+                | (block[i * 4 + 2] << 16) | ((uint32_t)block[i * 4 + 3] << 24);
+    }
+
+    uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+    const uint32_t *k = kMD5K;
+
+    for (int i = 0; i < 16; i += 4, k += 4) {
+        MD5_STEP(MD5_F, a, b, c, d, m[i    ], k[0],  7);
+        MD5_STEP(MD5_F, d, a, b, c, m[i + 1], k[1], 12);
+        MD5_STEP(MD5_F, c, d, a, b, m[i + 2], k[2], 17);
+        MD5_STEP(MD5_F, b, c, d, a, m[i + 3], k[3], 22);
+    }
+    for (int i = 0; i < 16; i += 4, k += 4) {
+        MD5_STEP(MD5_G, a, b, c, d, m[(5 * i + 1) & 15], k[0],  5);
+        MD5_STEP(MD5_G, d, a, b, c, m[(5 * i + 6) & 15], k[1],  9);
+        MD5_STEP(MD5_G, c, d, a, b, m[(5 * i + 11) & 15], k[2], 14);
+        MD5_STEP(MD5_G, b, c, d, a, m[(5 * i) & 15], k[3], 20);
+    }
+    for (int i = 0; i < 16; i += 4, k += 4) {
+        MD5_STEP(MD5_H, a, b, c, d, m[(3 * i + 5) & 15], k[0],  4);
+        MD5_STEP(MD5_H, d, a, b, c, m[(3 * i + 8) & 15], k[1], 11);
+        MD5_STEP(MD5_H, c, d, a, b, m[(3 * i + 11) & 15], k[2], 16);
+        MD5_STEP(MD5_H, b, c, d, a, m[(3 * i + 14) & 15], k[3], 23);
+    }
+    for (int i = 0; i < 16; i += 4, k += 4) {
+        MD5_STEP(MD5_I, a, b, c, d, m[(7 * i) & 15], k[0],  6);
+        MD5_STEP(MD5_I, d, a, b, c, m[(7 * i + 7) & 15], k[1], 10);
+        MD5_STEP(MD5_I, c, d, a, b, m[(7 * i + 14) & 15], k[2], 15);
+        MD5_STEP(MD5_I, b, c, d, a, m[(7 * i + 21) & 15], k[3], 21);
+    }
+
+    state[0] += a;
+    state[1] += b;
+    state[2] += c;
+    state[3] += d;
+}
+
+static void md5Init(ApeMD5Context *ctx) {
+    ctx->state[0] = 0x67452301;
+    ctx->state[1] = 0xefcdab89;
+    ctx->state[2] = 0x98badcfe;
+    ctx->state[3] = 0x10325476;
+    ctx->length = 0;
+}
+
+static void md5Update(ApeMD5Context *ctx, const uint8_t *data, size_t size) {
+    size_t used = ctx->length & 63;
+    ctx->length += size;
+
+    if (used > 0) {
+        size_t fill = 64 - used;
+        if (size < fill) {
+            memcpy(ctx->buffer + used, data, size);
+            return;
+        }
+        memcpy(ctx->buffer + used, data, fill);
+        md5Transform(ctx->state, ctx->buffer);
+        data += fill;
+        size -= fill;
+    }
+
+    for (; size >= 64; data += 64, size -= 64) {
+        md5Transform(ctx->state, data);
+    }
+    memcpy(ctx->buffer, data, size);
+}
+
+static void md5Final(ApeMD5Context *ctx, uint8_t digest[16]) {
+    uint8_t padding[72];
+    const uint64_t bits = ctx->length * 8;
+    size_t used = ctx->length & 63;
+    size_t padsize = (used < 56 ? 56 : 120) - used;
+
+    memset(padding, 0, sizeof(padding));
+    padding[0] = 0x80;
+    for (int i = 0; i < 8; i++) {
+        padding[padsize + i] = bits >> (i * 8);
+    }
+    md5Update(ctx, padding, padsize + 8);
+
+    for (int i = 0; i < 16; i++) {
+        digest[i] = ctx->state[i / 4] >> ((i & 3) * 8);
+    }
+}
+
+static int compareFrameRanges(const ApeFrameRange *a, const ApeFrameRange *b) {
+    if (a->first != b->first) {
+        return a->first < b->first ? -1 : 1;
+    }
+    return 0;
+}
+
+//Sorts ranges and joins the ones that touch or overlap.
+static void mergeFrameRanges(Vector<ApeFrameRange> *ranges) {
+    if (ranges->size() < 2) {
+        return;
+    }
+    ranges->sort(compareFrameRanges);
+
+    size_t last = 0;
+    for (size_t i = 1; i < ranges->size(); i++) {
+        ApeFrameRange &prev = ranges->editItemAt(last);
+        const ApeFrameRange &range = ranges->itemAt(i);
+        if (range.first <= prev.first + prev.count) {
+            uint32_t end = range.first + range.count;
+            if (end > prev.first + prev.count) {
+                prev.count = end - prev.first;
+            }
+        } else {
+            ranges->editItemAt(++last) = range;
+        }
+    }
+    ranges->removeItemsAt(last + 1, ranges->size() - last - 1);
+}
+
+//Maps unreadable bytes back to the frames whose reads they fall in, with
+//the offsets the extractor itself works out. Without an index every frame
+//counts, none of them can be located.
+static void addUnreadableRegion(const APEFrameData *frameData, uint32_t totalframes,
+        off64_t start, off64_t end, Vector<ApeFrameRange> *badFrames) {
+    LOGE("Cannot read bytes %lld to %lld", (long long)start, (long long)end);
+    if (badFrames == NULL) {
+        return;
+    }
+
+    if (frameData == NULL) {
+        ApeFrameRange range;
+        range.first = 0;
+        range.count = totalframes;
+        badFrames->push(range);
+        return;
+    }
+
+    for (uint32_t i = 0; i < totalframes; i++) {
+        ApeFrame frame = frameData->getCurrentFrame(i);
+        if (frame.pos < end && frame.pos + (off64_t)frame.size > start) {
+            ApeFrameRange range;
+            range.first = i;
+            range.count = 1;
+            badFrames->push(range);
+        }
+    }
+}
+
+struct APEVerifier::Batch {
+    const Vector<sp<DataSource> > *sources;
+    ApeVerifyResult *results;
+    Vector<ApeFrameRange> *badFrames;
+    ApeVerifyProgressFunc progress;
+    void *cookie;
+    volatile int32_t cancelled;
+};
+
+status_t APEVerifier::verify(const sp<DataSource> &source, ApeVerifyResult *result,
+        Vector<ApeFrameRange> *badFrames, ApeVerifyProgressFunc progress, void *cookie) {
+    volatile int32_t cancelled = 0;
+    result->status = verifyOne(source, 0, result, badFrames, progress, cookie, &cancelled);
+    return result->status;
+}
+
+void APEVerifier::verify(const Vector<sp<DataSource> > &sources, ApeVerifyResult *results,
+        Vector<ApeFrameRange> *badFrames, size_t threadCount,
+        ApeVerifyProgressFunc progress, void *cookie) {
+    Batch batch;
+    batch.sources = &sources;
+    batch.results = results;
+    batch.badFrames = badFrames;
+    batch.progress = progress;
+    batch.cookie = cookie;
+    batch.cancelled = 0;
+
+    APEWorkerPool::run(sources.size(), threadCount, verifyItem, &batch);
+}
+
+// static
+void APEVerifier::verifyItem(void *cookie, size_t index) {
+    Batch *batch = (Batch *)cookie;
+
+    ApeVerifyResult *result = &batch->results[index];
+    Vector<ApeFrameRange> *badFrames =
+            batch->badFrames != NULL ? &batch->badFrames[index] : NULL;
+    result->status = verifyOne((*batch->sources)[index], index, result, badFrames,
+            batch->progress, batch->cookie, &batch->cancelled);
+}
+
+status_t APEVerifier::verifyOne(const sp<DataSource> &file, size_t index,
+        ApeVerifyResult *result, Vector<ApeFrameRange> *badFrames,
+        ApeVerifyProgressFunc progress, void *cookie, volatile int32_t *cancelled) {
+    ApeHeaderData header;
+    off64_t seektableoffset;
+
+    memset(result, 0, sizeof(*result));
+    if (badFrames != NULL) {
+        badFrames->clear();
+    }
+    if (android_atomic_acquire_load(cancelled)) {
+        return -ECANCELED;
+    }
+
+    sp<DataSource> source = APEFrameData::getStreamSource(file);
+    status_t err = APEFrameData::parseHeader(source, &header, &seektableoffset);
+    if (err != OK) {
+        return err;
+    }
+
+    static const uint8_t kNoMD5[16] = { 0 };
+    memcpy(result->expectedMD5, header.md5, sizeof(header.md5));
+    if (header.version < 3980 || !memcmp(header.md5, kNoMD5, sizeof(kNoMD5))) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    //The header and seek table follow the descriptor and are hashed last,
+    //everything from the wav header up to the tag first.
+    const off64_t headoffset = header.descriptorlength;
+    const size_t headsize = header.headerlength + header.seektablelength;
+    const off64_t bodyoffset = headoffset + headsize;
+    const off64_t bodysize = (off64_t)header.wavheaderlength + header.framedatalength
+                             + header.wavtaillength;
+    result->bytesTotal = headsize + bodysize;
+
+    uint8_t *head = (uint8_t *)malloc(headsize);
+    uint8_t *chunk = (uint8_t *)malloc(APE_VERIFY_CHUNK_SIZE);
+    if (head == NULL || chunk == NULL) {
+        LOGE("%s: Out of memory:%d", __FUNCTION__, __LINE__);
+        free(head);
+        free(chunk);
+        return NO_MEMORY;
+    }
+
+    if (source->readAt(headoffset, head, headsize) != (ssize_t)headsize) {
+        free(head);
+        free(chunk);
+        return ERROR_IO;
+    }
+    result->bytesDone = headsize;
+
+    //Frames are located as the extractor does, which also takes care of
+    //offsets past 4 GB. A seek table the extractor rejects leaves every
+    //frame unlocatable, so all of them count as damaged.
+    sp<APEFrameData> frameData = new APEFrameData(source, header, seektableoffset);
+    if (frameData->buildIndex() != OK) {
+        frameData = NULL;
+        if (badFrames != NULL) {
+            ApeFrameRange range;
+            range.first = 0;
+            range.count = header.totalframes;
+            badFrames->push(range);
+        }
+    }
+
+    ApeMD5Context md5;
+    md5Init(&md5);
+
+    bool readable = true;
+    for (off64_t pos = 0; pos < bodysize; ) {
+        if (android_atomic_acquire_load(cancelled)) {
+            err = -ECANCELED;
+            break;
+        }
+
+        size_t length = APE_VERIFY_CHUNK_SIZE;
+        if ((off64_t)length > bodysize - pos) {
+            length = bodysize - pos;
+        }
+
+        ssize_t n = source->readAt(bodyoffset + pos, chunk, length);
+        if (n == (ssize_t)length) {
+            //The hash is useless after a gap, only the reads carry on.
+            if (readable) {
+                md5Update(&md5, chunk, length);
+            }
+        } else {
+            readable = false;
+            for (size_t offset = 0; offset < length; offset += APE_VERIFY_RETRY_SIZE) {
+                size_t size = length - offset;
+                if (size > APE_VERIFY_RETRY_SIZE) {
+                    size = APE_VERIFY_RETRY_SIZE;
+                }
+                off64_t start = bodyoffset + pos + offset;
+                if (source->readAt(start, chunk, size) != (ssize_t)size) {
+                    addUnreadableRegion(frameData.get(), header.totalframes,
+                            start, start + size, badFrames);
+                }
+            }
+        }
+
+        pos += length;
+        result->bytesDone += length;
+
+        if (progress != NULL
+                && !progress(cookie, index, result->bytesDone, result->bytesTotal)) {
+            android_atomic_release_store(1, cancelled);
+            err = -ECANCELED;
+            break;
+        }
+    }
+
+    if (err == OK && !readable) {
+        err = ERROR_IO;
+    } else if (err == OK) {
+        md5Update(&md5, head, headsize);
+        md5Final(&md5, result->md5);
+        if (memcmp(result->md5, header.md5, sizeof(header.md5))) {
+            LOGE("MD5 mismatch over %lld bytes", (long long)result->bytesTotal);
+            err = ERROR_MALFORMED;
+        }
+    }
+
+    if (badFrames != NULL) {
+        mergeFrameRanges(badFrames);
+    }
+
+    free(head);
+    free(chunk);
+    return err;
+}
+
+}  // namespace android
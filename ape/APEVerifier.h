@@ -0,0 +1,97 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_VERIFIER_H_
+
+#define APE_VERIFIER_H_
+
+#include <utils/Errors.h>
+#include <utils/RefBase.h>
+#include <utils/Vector.h>
+
+#include <stdint.h>
+#include <sys/types.h>
+
+namespace android {
+
+class DataSource;
+
+//Frames [first, first + count) of a file.
+typedef struct {
+    uint32_t first;
+    uint32_t count;
+} ApeFrameRange;
+
+typedef struct {
+    //OK when the MD5 matches, ERROR_MALFORMED when it does not, ERROR_IO when
+    //part of the file could not be read, ERROR_UNSUPPORTED for files without
+    //an MD5 (before 3980, or all zero) and -ECANCELED when cancelled.
+    status_t status;
+    uint8_t expectedMD5[16];
+    uint8_t md5[16];
+    //Bytes read so far, and bytes the check covers.
+    off64_t bytesDone;
+    off64_t bytesTotal;
+} ApeVerifyResult;
+
+//Called after every chunk with the index of the file in the batch (0 for a
+//single file). Returning false cancels the file and, in a batch, every file
+//not finished yet. May be called from several threads at once.
+typedef bool (*ApeVerifyProgressFunc)(void *cookie, size_t index,
+        off64_t bytesDone, off64_t bytesTotal);
+
+//Checks APE files against the MD5 in their descriptor without decoding.
+//The wav header, frame data and wav tail are hashed in large sequential
+//reads, followed by the header and seek table, the same order the encoder
+//used. A mismatch alone cannot be narrowed down to frames; badFrames lists
+//the frames in regions that could not be read, or all of them when the
+//seek table is one the extractor rejects.
+class APEVerifier {
+public:
+    static status_t verify(const sp<DataSource> &source, ApeVerifyResult *result,
+            Vector<ApeFrameRange> *badFrames,
+            ApeVerifyProgressFunc progress = NULL, void *cookie = NULL);
+
+    //Checks every source on up to threadCount threads (0 picks the number of
+    //CPUs). results and badFrames must hold sources.size() entries;
+    //badFrames may be NULL.
+    static void verify(const Vector<sp<DataSource> > &sources, ApeVerifyResult *results,
+            Vector<ApeFrameRange> *badFrames, size_t threadCount,
+            ApeVerifyProgressFunc progress = NULL, void *cookie = NULL);
+
+private:
+    struct Batch;
+
+    static void verifyItem(void *cookie, size_t index);
+    static status_t verifyOne(const sp<DataSource> &file, size_t index,
+            ApeVerifyResult *result, Vector<ApeFrameRange> *badFrames,
+            ApeVerifyProgressFunc progress, void *cookie, volatile int32_t *cancelled);
+
+    APEVerifier();
+};
+
+}  // namespace android
+
+#endif  // APE_VERIFIER_H_
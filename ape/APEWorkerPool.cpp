@@ -0,0 +1,104 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+
+//#define LOG_NDEBUG 0
+#define LOG_TAG "APEWorkerPool"
+#include <utils/Log.h>
+
+#include "APEWorkerPool.h"
+
+#include <cutils/atomic.h>
+
+#include <pthread.h>
+#include <stdint.h>
+#include <unistd.h>
+
+namespace android {
+
+struct APEWorkerPool::Work {
+    size_t count;
+    ApeWorkFunc func;
+    void *cookie;
+    //Next item, shared by all threads.
+    volatile int32_t next;
+};
+
+void APEWorkerPool::run(size_t count, size_t threadCount, ApeWorkFunc func, void *cookie) {
+    Work work;
+    work.count = count;
+    work.func = func;
+    work.cookie = cookie;
+    work.next = 0;
+
+    if (threadCount == 0) {
+        long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        threadCount = cpus > 0 ? cpus : 1;
+    }
+    if (threadCount > APE_WORKER_MAX_THREADS) {
+        threadCount = APE_WORKER_MAX_THREADS;
+    }
+    if (threadCount > count) {
+        threadCount = count;
+    }
+
+    //The calling thread is one of the workers.
+    pthread_t threads[APE_WORKER_MAX_THREADS];
+    size_t started = 0;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+    for (size_t i = 1; i < threadCount; i++) {
+        if (pthread_create(&threads[started], &attr, ThreadWrapper, &work) != 0) {
+            break;
+        }
+        started++;
+    }
+    pthread_attr_destroy(&attr);
+
+    ThreadWrapper(&work);
+
+    for (size_t i = 0; i < started; i++) {
+        pthread_join(threads[i], NULL);
+    }
+
+    ALOGV("Ran %zu items on %zu threads", count, started + 1);
+}
+
+// static
+void *APEWorkerPool::ThreadWrapper(void *me) {
+    Work *work = (Work *)me;
+
+    for (;;) {
+        size_t index = android_atomic_inc(&work->next);
+        if (index >= work->count) {
+            break;
+        }
+        work->func(work->cookie, index);
+    }
+    return NULL;
+}
+
+}  // namespace android
@@ -0,0 +1,62 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+
+#ifndef APE_WORKER_POOL_H_
+
+#define APE_WORKER_POOL_H_
+
+#include <stddef.h>
+
+namespace android {
+
+//Upper bound on worker threads, batch work over files is I/O bound well
+//before this.
+#define APE_WORKER_MAX_THREADS 16
+
+//Handles item index of a batch.
+typedef void (*ApeWorkFunc)(void *cookie, size_t index);
+
+//Runs a batch of independent items, one per file, on a few threads. The
+//threads take the next item as they finish one, so a thread stuck on a
+//slow file does not hold up the others.
+class APEWorkerPool {
+public:
+    //Calls func for every index below count, on up to threadCount threads
+    //(0 picks the number of CPUs) of which the calling thread is one.
+    //Returns once every item is done.
+    static void run(size_t count, size_t threadCount, ApeWorkFunc func, void *cookie);
+
+private:
+    struct Work;
+
+    static void *ThreadWrapper(void *me);
+
+    APEWorkerPool();
+};
+
+}  // namespace android
+
+#endif  // APE_WORKER_POOL_H_
@@ -3,7 +3,21 @@ LOCAL_PATH:= $(call my-dir)
 include $(CLEAR_VARS)
 
 LOCAL_SRC_FILES:= \
+    APEDecoder.cpp \
+    APEDSP.cpp \
     APEExtractor.cpp \
+    APEParallelDecoder.cpp \
+    APEIndexCache.cpp \
+    APEMetadataScanner.cpp \
+    APEMappedFileSource.cpp \
+    APEVerifier.cpp \
+    APEStats.cpp \
+    APETraceSource.cpp \
+    APECueSheet.cpp \
+    APEBufferPool.cpp \
+    APEBlockCache.cpp \
+    APEClipWriter.cpp \
+    APEWorkerPool.cpp \
 
 LOCAL_C_INCLUDES:= \
     $(JNI_H_INCLUDE) \
@@ -16,3 +30,205 @@ LOCAL_PRELINK_MODULE := false
 LOCAL_MODULE:= libapeextractor
 
 include $(BUILD_STATIC_LIBRARY)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    tools/apetrace.cpp \
+
+LOCAL_C_INCLUDES:= \
+    $(TOP)/frameworks/av/include/media/stagefright/openmax \
+    $(TOP)/frameworks/av/media/libstagefright/include \
+
+LOCAL_STATIC_LIBRARIES := libapeextractor
+
+LOCAL_SHARED_LIBRARIES := \
+    libstagefright \
+    libstagefright_foundation \
+    libcutils \
+    libutils \
+
+#LOCAL_MODULE_TAGS := eng
+LOCAL_MODULE:= apetrace
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    tools/apeperf.cpp \
+
+LOCAL_C_INCLUDES:= \
+    $(TOP)/frameworks/av/include/media/stagefright/openmax \
+    $(TOP)/frameworks/av/media/libstagefright/include \
+
+LOCAL_STATIC_LIBRARIES := libapeextractor
+
+LOCAL_SHARED_LIBRARIES := \
+    libstagefright \
+    libstagefright_foundation \
+    libcutils \
+    libutils \
+
+#LOCAL_MODULE_TAGS := eng
+LOCAL_MODULE:= apeperf
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    tools/apegen.cpp \
+
+#LOCAL_MODULE_TAGS := eng
+LOCAL_MODULE:= apegen
+
+include $(BUILD_HOST_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    tools/apescale.cpp \
+
+LOCAL_C_INCLUDES:= \
+    $(TOP)/frameworks/av/include/media/stagefright/openmax \
+    $(TOP)/frameworks/av/media/libstagefright/include \
+
+LOCAL_STATIC_LIBRARIES := libapeextractor
+
+LOCAL_SHARED_LIBRARIES := \
+    libstagefright \
+    libstagefright_foundation \
+    libcutils \
+    libutils \
+
+#LOCAL_MODULE_TAGS := eng
+LOCAL_MODULE:= apescale
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    tools/apebench.cpp \
+
+LOCAL_C_INCLUDES:= \
+    $(TOP)/frameworks/av/include/media/stagefright/openmax \
+    $(TOP)/frameworks/av/media/libstagefright/include \
+
+LOCAL_STATIC_LIBRARIES := libapeextractor
+
+LOCAL_SHARED_LIBRARIES := \
+    libstagefright \
+    libstagefright_foundation \
+    libcutils \
+    libutils \
+
+#LOCAL_MODULE_TAGS := eng
+LOCAL_MODULE:= apebench
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    tools/apereaders.cpp \
+
+LOCAL_C_INCLUDES:= \
+    $(TOP)/frameworks/av/include/media/stagefright/openmax \
+    $(TOP)/frameworks/av/media/libstagefright/include \
+
+LOCAL_STATIC_LIBRARIES := libapeextractor
+
+LOCAL_SHARED_LIBRARIES := \
+    libstagefright \
+    libstagefright_foundation \
+    libcutils \
+    libutils \
+
+#LOCAL_MODULE_TAGS := eng
+LOCAL_MODULE:= apereaders
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    tools/apestream.cpp \
+
+LOCAL_C_INCLUDES:= \
+    $(TOP)/frameworks/av/include/media/stagefright/openmax \
+    $(TOP)/frameworks/av/media/libstagefright/include \
+
+LOCAL_STATIC_LIBRARIES := libapeextractor
+
+LOCAL_SHARED_LIBRARIES := \
+    libstagefright \
+    libstagefright_foundation \
+    libcutils \
+    libutils \
+
+#LOCAL_MODULE_TAGS := eng
+LOCAL_MODULE:= apestream
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    tools/apeclip.cpp \
+
+LOCAL_C_INCLUDES:= \
+    $(TOP)/frameworks/av/include/media/stagefright/openmax \
+    $(TOP)/frameworks/av/media/libstagefright/include \
+
+LOCAL_STATIC_LIBRARIES := libapeextractor
+
+LOCAL_SHARED_LIBRARIES := \
+    libstagefright \
+    libstagefright_foundation \
+    libcutils \
+    libutils \
+
+#LOCAL_MODULE_TAGS := eng
+LOCAL_MODULE:= apeclip
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    tools/apedsptest.cpp \
+
+LOCAL_STATIC_LIBRARIES := libapeextractor
+
+LOCAL_SHARED_LIBRARIES := \
+    libcutils \
+    libutils \
+
+#LOCAL_MODULE_TAGS := eng
+LOCAL_MODULE:= apedsptest
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_SRC_FILES:= \
+    tools/apescan.cpp \
+
+LOCAL_C_INCLUDES:= \
+    $(TOP)/frameworks/av/include/media/stagefright/openmax \
+    $(TOP)/frameworks/av/media/libstagefright/include \
+
+LOCAL_STATIC_LIBRARIES := libapeextractor
+
+LOCAL_SHARED_LIBRARIES := \
+    libstagefright \
+    libstagefright_foundation \
+    libcutils \
+    libutils \
+
+#LOCAL_MODULE_TAGS := eng
+LOCAL_MODULE:= apescan
+
+include $(BUILD_EXECUTABLE)
@@ -0,0 +1,526 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+//Definitions behind the stand-in framework headers in include/, enough
+//to build libapeextractor and its tools on a plain Linux host. They follow
+//the behaviour of the framework classes the extractor relies on, not
+//their implementation.
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <media/stagefright/foundation/ADebug.h>
+#include <media/stagefright/foundation/AMessage.h>
+#include <media/stagefright/DataSource.h>
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaBufferGroup.h>
+#include <media/stagefright/MediaDefs.h>
+#include <media/stagefright/MediaExtractor.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <media/stagefright/Utils.h>
+
+namespace android {
+
+const char *MEDIA_MIMETYPE_AUDIO_APE = "audio/ape";
+const char *MEDIA_MIMETYPE_AUDIO_RAW = "audio/raw";
+
+uint16_t U16_AT(const uint8_t *ptr) {
+    return ptr[0] << 8 | ptr[1];
+}
+
+uint32_t U32_AT(const uint8_t *ptr) {
+    return (uint32_t)ptr[0] << 24 | ptr[1] << 16 | ptr[2] << 8 | ptr[3];
+}
+
+uint64_t U64_AT(const uint8_t *ptr) {
+    return ((uint64_t)U32_AT(ptr)) << 32 | U32_AT(ptr + 4);
+}
+
+uint16_t U16LE_AT(const uint8_t *ptr) {
+    return ptr[0] | (ptr[1] << 8);
+}
+
+uint32_t U32LE_AT(const uint8_t *ptr) {
+    return (uint32_t)ptr[3] << 24 | ptr[2] << 16 | ptr[1] << 8 | ptr[0];
+}
+
+uint64_t U64LE_AT(const uint8_t *ptr) {
+    return ((uint64_t)U32LE_AT(ptr + 4)) << 32 | U32LE_AT(ptr);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool DataSource::getUInt16(off64_t offset, uint16_t *x) {
+    *x = 0;
+
+    uint8_t byte[2];
+    if (readAt(offset, byte, 2) != 2) {
+        return false;
+    }
+
+    *x = (byte[0] << 8) | byte[1];
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+FileSource::FileSource(const char *filename)
+    :mFd(-1),
+     mOffset(0),
+     mLength(-1) {
+    mFd = open(filename, O_RDONLY);
+}
+
+FileSource::FileSource(int fd, int64_t offset, int64_t length)
+    :mFd(fd),
+     mOffset(offset),
+     mLength(length) {
+    CHECK(offset >= 0);
+    CHECK(length >= 0);
+}
+
+FileSource::~FileSource() {
+    if (mFd >= 0) {
+        close(mFd);
+        mFd = -1;
+    }
+}
+
+status_t FileSource::initCheck() const {
+    return mFd >= 0 ? OK : NO_INIT;
+}
+
+ssize_t FileSource::readAt(off64_t offset, void *data, size_t size) {
+    if (mFd < 0) {
+        return NO_INIT;
+    }
+
+    if (mLength >= 0) {
+        if (offset >= mLength) {
+            return 0;  // read beyond EOF.
+        }
+        int64_t numAvailable = mLength - offset;
+        if ((int64_t)size > numAvailable) {
+            size = numAvailable;
+        }
+    }
+
+    return pread64(mFd, data, size, offset + mOffset);
+}
+
+status_t FileSource::getSize(off64_t *size) {
+    if (mFd < 0) {
+        return NO_INIT;
+    }
+
+    if (mLength >= 0) {
+        *size = mLength;
+        return OK;
+    }
+
+    struct stat64 st;
+    if (fstat64(mFd, &st) != 0) {
+        return ERROR_IO;
+    }
+    *size = st.st_size;
+
+    return OK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+bool MetaData::setCString(uint32_t key, const char *value) {
+    return setData(key, TYPE_C_STRING, value, strlen(value) + 1);
+}
+
+bool MetaData::setInt32(uint32_t key, int32_t value) {
+    return setData(key, TYPE_INT32, &value, sizeof(value));
+}
+
+bool MetaData::setInt64(uint32_t key, int64_t value) {
+    return setData(key, TYPE_INT64, &value, sizeof(value));
+}
+
+bool MetaData::setFloat(uint32_t key, float value) {
+    return setData(key, TYPE_FLOAT, &value, sizeof(value));
+}
+
+bool MetaData::setPointer(uint32_t key, void *value) {
+    return setData(key, TYPE_POINTER, &value, sizeof(value));
+}
+
+bool MetaData::findCString(uint32_t key, const char **value) {
+    uint32_t type;
+    const void *data;
+    size_t size;
+    if (!findData(key, &type, &data, &size) || type != TYPE_C_STRING) {
+        return false;
+    }
+
+    *value = (const char *)data;
+
+    return true;
+}
+
+bool MetaData::findInt32(uint32_t key, int32_t *value) {
+    return findValue(key, TYPE_INT32, value, sizeof(*value));
+}
+
+bool MetaData::findInt64(uint32_t key, int64_t *value) {
+    return findValue(key, TYPE_INT64, value, sizeof(*value));
+}
+
+bool MetaData::findFloat(uint32_t key, float *value) {
+    return findValue(key, TYPE_FLOAT, value, sizeof(*value));
+}
+
+bool MetaData::findPointer(uint32_t key, void **value) {
+    return findValue(key, TYPE_POINTER, value, sizeof(*value));
+}
+
+bool MetaData::findValue(uint32_t key, uint32_t type, void *value, size_t size) {
+    uint32_t foundtype;
+    const void *data;
+    size_t foundsize;
+    if (!findData(key, &foundtype, &data, &foundsize) || foundtype != type) {
+        return false;
+    }
+
+    CHECK_EQ(foundsize, size);
+    memcpy(value, data, size);
+
+    return true;
+}
+
+bool MetaData::setData(uint32_t key, uint32_t type, const void *data, size_t size) {
+    bool overwrote = mItems.find(key) != mItems.end();
+
+    Item &item = mItems[key];
+    item.type = type;
+    item.data.assign((const uint8_t *)data, (const uint8_t *)data + size);
+
+    return overwrote;
+}
+
+bool MetaData::findData(uint32_t key, uint32_t *type,
+        const void **data, size_t *size) const {
+    std::map<uint32_t, Item>::const_iterator it = mItems.find(key);
+    if (it == mItems.end()) {
+        return false;
+    }
+
+    *type = it->second.type;
+    *data = it->second.data.empty() ? NULL : &it->second.data[0];
+    *size = it->second.data.size();
+
+    return true;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+MediaBuffer::MediaBuffer(void *data, size_t size)
+    :mObserver(NULL),
+     mRefCount(0),
+     mData(data),
+     mSize(size),
+     mRangeOffset(0),
+     mRangeLength(size),
+     mOwnsData(false),
+     mMetaData(new MetaData) {
+}
+
+MediaBuffer::MediaBuffer(size_t size)
+    :mObserver(NULL),
+     mRefCount(0),
+     mData(malloc(size)),
+     mSize(size),
+     mRangeOffset(0),
+     mRangeLength(size),
+     mOwnsData(true),
+     mMetaData(new MetaData) {
+}
+
+MediaBuffer::MediaBuffer(const sp<ABuffer> &buffer)
+    :mObserver(NULL),
+     mRefCount(0),
+     mData(buffer->data()),
+     mSize(buffer->size()),
+     mRangeOffset(0),
+     mRangeLength(mSize),
+     mBuffer(buffer),
+     mOwnsData(false),
+     mMetaData(new MetaData) {
+}
+
+MediaBuffer::~MediaBuffer() {
+    CHECK(mObserver == NULL);
+
+    if (mOwnsData && mData != NULL) {
+        free(mData);
+        mData = NULL;
+    }
+}
+
+void MediaBuffer::release() {
+    if (mObserver == NULL) {
+        CHECK_EQ(mRefCount, 0);
+        delete this;
+        return;
+    }
+
+    int prevCount = __sync_fetch_and_sub(&mRefCount, 1);
+    if (prevCount == 1) {
+        mObserver->signalBufferReturned(this);
+    }
+    CHECK(prevCount > 0);
+}
+
+void MediaBuffer::add_ref() {
+    (void)__sync_fetch_and_add(&mRefCount, 1);
+}
+
+void *MediaBuffer::data() const {
+    return mData;
+}
+
+size_t MediaBuffer::size() const {
+    return mSize;
+}
+
+size_t MediaBuffer::range_offset() const {
+    return mRangeOffset;
+}
+
+size_t MediaBuffer::range_length() const {
+    return mRangeLength;
+}
+
+void MediaBuffer::set_range(size_t offset, size_t length) {
+    CHECK(offset <= mSize && length <= mSize - offset);
+
+    mRangeOffset = offset;
+    mRangeLength = length;
+}
+
+sp<MetaData> MediaBuffer::meta_data() {
+    return mMetaData;
+}
+
+void MediaBuffer::reset() {
+    mMetaData->clear();
+    set_range(0, mSize);
+}
+
+void MediaBuffer::setObserver(MediaBufferObserver *observer) {
+    CHECK(observer == NULL || mObserver == NULL);
+    mObserver = observer;
+}
+
+int MediaBuffer::refcount() const {
+    return mRefCount;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+MediaBufferGroup::MediaBufferGroup() {}
+
+MediaBufferGroup::~MediaBufferGroup() {
+    //Every buffer must have come back, as with the framework's group.
+    CHECK_EQ(mFree.size(), mBuffers.size());
+    for (size_t i = 0; i < mBuffers.size(); i++) {
+        MediaBuffer *buffer = mBuffers[i];
+        buffer->setObserver(NULL);
+        buffer->release();
+    }
+}
+
+void MediaBufferGroup::add_buffer(MediaBuffer *buffer) {
+    Mutex::Autolock autoLock(mLock);
+
+    buffer->setObserver(this);
+    mBuffers.push(buffer);
+    mFree.push(buffer);
+}
+
+status_t MediaBufferGroup::acquire_buffer(MediaBuffer **out) {
+    Mutex::Autolock autoLock(mLock);
+
+    while (mFree.isEmpty()) {
+        mCondition.wait(mLock);
+    }
+
+    MediaBuffer *buffer = mFree.top();
+    mFree.pop();
+
+    buffer->add_ref();
+    buffer->reset();
+
+    *out = buffer;
+    return OK;
+}
+
+void MediaBufferGroup::signalBufferReturned(MediaBuffer *buffer) {
+    Mutex::Autolock autoLock(mLock);
+
+    mFree.push(buffer);
+    mCondition.signal();
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+MediaSource::MediaSource() {}
+
+MediaSource::~MediaSource() {}
+
+MediaSource::ReadOptions::ReadOptions() {
+    reset();
+}
+
+void MediaSource::ReadOptions::reset() {
+    mOptions = 0;
+    mSeekTimeUs = 0;
+    mSeekMode = SEEK_CLOSEST_SYNC;
+    mLatenessUs = 0;
+}
+
+void MediaSource::ReadOptions::setSeekTo(int64_t time_us, SeekMode mode) {
+    mOptions |= kSeekTo_Option;
+    mSeekTimeUs = time_us;
+    mSeekMode = mode;
+}
+
+void MediaSource::ReadOptions::clearSeekTo() {
+    mOptions &= ~kSeekTo_Option;
+    mSeekTimeUs = 0;
+    mSeekMode = SEEK_CLOSEST_SYNC;
+}
+
+bool MediaSource::ReadOptions::getSeekTo(
+        int64_t *time_us, SeekMode *mode) const {
+    *time_us = mSeekTimeUs;
+    *mode = mSeekMode;
+    return (mOptions & kSeekTo_Option) != 0;
+}
+
+void MediaSource::ReadOptions::setLateBy(int64_t lateness_us) {
+    mLatenessUs = lateness_us;
+}
+
+int64_t MediaSource::ReadOptions::getLateBy() const {
+    return mLatenessUs;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+sp<MetaData> MediaExtractor::getMetaData() {
+    return new MetaData;
+}
+
+uint32_t MediaExtractor::flags() const {
+    return CAN_SEEK_BACKWARD | CAN_SEEK_FORWARD | CAN_PAUSE | CAN_SEEK;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+ABuffer::ABuffer(size_t capacity)
+    :mData(malloc(capacity)),
+     mCapacity(capacity),
+     mRangeOffset(0),
+     mRangeLength(capacity),
+     mOwnsData(true) {
+}
+
+ABuffer::ABuffer(void *data, size_t capacity)
+    :mData(data),
+     mCapacity(capacity),
+     mRangeOffset(0),
+     mRangeLength(capacity),
+     mOwnsData(false) {
+}
+
+ABuffer::~ABuffer() {
+    if (mOwnsData && mData != NULL) {
+        free(mData);
+        mData = NULL;
+    }
+}
+
+void ABuffer::setRange(size_t offset, size_t size) {
+    CHECK_LE(offset, mCapacity);
+    CHECK_LE(offset + size, mCapacity);
+
+    mRangeOffset = offset;
+    mRangeLength = size;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+
+void AMessage::setInt32(const char *name, int32_t value) {
+    mInt32s[name] = value;
+}
+
+void AMessage::setInt64(const char *name, int64_t value) {
+    mInt64s[name] = value;
+}
+
+void AMessage::setBuffer(const char *name, const sp<ABuffer> &buffer) {
+    mBuffers[name] = buffer;
+}
+
+bool AMessage::findInt32(const char *name, int32_t *value) const {
+    std::map<std::string, int32_t>::const_iterator it = mInt32s.find(name);
+    if (it == mInt32s.end()) {
+        return false;
+    }
+    *value = it->second;
+    return true;
+}
+
+bool AMessage::findInt64(const char *name, int64_t *value) const {
+    std::map<std::string, int64_t>::const_iterator it = mInt64s.find(name);
+    if (it == mInt64s.end()) {
+        return false;
+    }
+    *value = it->second;
+    return true;
+}
+
+bool AMessage::findBuffer(const char *name, sp<ABuffer> *buffer) const {
+    std::map<std::string, sp<ABuffer> >::const_iterator it = mBuffers.find(name);
+    if (it == mBuffers.end()) {
+        return false;
+    }
+    *buffer = it->second;
+    return true;
+}
+
+}  // namespace android
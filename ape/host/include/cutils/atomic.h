@@ -0,0 +1,86 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_HOST_CUTILS_ATOMIC_H_
+
+#define APE_HOST_CUTILS_ATOMIC_H_
+
+#include <stdint.h>
+
+//All return the old value, the cas calls 0 on success.
+static inline int32_t android_atomic_inc(volatile int32_t *addr) {
+    return __sync_fetch_and_add(addr, 1);
+}
+
+static inline int32_t android_atomic_dec(volatile int32_t *addr) {
+    return __sync_fetch_and_sub(addr, 1);
+}
+
+static inline int32_t android_atomic_add(int32_t value, volatile int32_t *addr) {
+    return __sync_fetch_and_add(addr, value);
+}
+
+static inline int32_t android_atomic_and(int32_t value, volatile int32_t *addr) {
+    return __sync_fetch_and_and(addr, value);
+}
+
+static inline int32_t android_atomic_or(int32_t value, volatile int32_t *addr) {
+    return __sync_fetch_and_or(addr, value);
+}
+
+static inline int32_t android_atomic_acquire_load(volatile const int32_t *addr) {
+    return __atomic_load_n(addr, __ATOMIC_ACQUIRE);
+}
+
+static inline int32_t android_atomic_release_load(volatile const int32_t *addr) {
+    __sync_synchronize();
+    return *addr;
+}
+
+static inline void android_atomic_acquire_store(int32_t value, volatile int32_t *addr) {
+    *addr = value;
+    __sync_synchronize();
+}
+
+static inline void android_atomic_release_store(int32_t value, volatile int32_t *addr) {
+    __atomic_store_n(addr, value, __ATOMIC_RELEASE);
+}
+
+static inline int android_atomic_cmpxchg(int32_t oldvalue, int32_t newvalue,
+        volatile int32_t *addr) {
+    return !__sync_bool_compare_and_swap(addr, oldvalue, newvalue);
+}
+
+static inline int android_atomic_acquire_cas(int32_t oldvalue, int32_t newvalue,
+        volatile int32_t *addr) {
+    return !__sync_bool_compare_and_swap(addr, oldvalue, newvalue);
+}
+
+static inline int android_atomic_release_cas(int32_t oldvalue, int32_t newvalue,
+        volatile int32_t *addr) {
+    return !__sync_bool_compare_and_swap(addr, oldvalue, newvalue);
+}
+
+#endif  // APE_HOST_CUTILS_ATOMIC_H_
@@ -0,0 +1,118 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_HOST_META_DATA_H_
+
+#define APE_HOST_META_DATA_H_
+
+#include <stdint.h>
+#include <sys/types.h>
+#include <map>
+#include <vector>
+
+#include <utils/RefBase.h>
+
+namespace android {
+
+//The keys the extractor and its tools use, with the framework's values.
+enum {
+    kKeyMIMEType          = 'mime',
+    kKeyChannelCount      = '#chn',
+    kKeySampleRate        = 'srte',
+    kKeyBitsPerSample     = 'bits',
+    kKeyDuration          = 'dura',
+    kKeyMaxInputSize      = 'inpS',
+    kKeyTime              = 'time',
+    kKeyTargetTime        = 'tarT',
+    kKeyIsSyncFrame       = 'sync',
+
+    kKeyAlbum             = 'albu',
+    kKeyArtist            = 'arti',
+    kKeyAlbumArtist       = 'aart',
+    kKeyComposer          = 'comp',
+    kKeyGenre             = 'genr',
+    kKeyTitle             = 'titl',
+    kKeyYear              = 'year',
+    kKeyAlbumArt          = 'albA',
+    kKeyAlbumArtMIME      = 'alAM',
+    kKeyCDTrackNumber     = 'cdtr',
+    kKeyDiscNumber        = 'dnum',
+
+    //Vendor key: codec private data handed to the FFmpeg decoder.
+    kFfmpegCodecSpecificData = 'ffcs',
+};
+
+class MetaData : public RefBase {
+public:
+    enum Type {
+        TYPE_NONE     = 'none',
+        TYPE_C_STRING = 'cstr',
+        TYPE_INT32    = 'in32',
+        TYPE_INT64    = 'in64',
+        TYPE_FLOAT    = 'floa',
+        TYPE_POINTER  = 'ptr ',
+    };
+
+    MetaData() {}
+    MetaData(const MetaData &from) : RefBase(), mItems(from.mItems) {}
+
+    void clear() { mItems.clear(); }
+    bool remove(uint32_t key) { return mItems.erase(key) > 0; }
+
+    bool setCString(uint32_t key, const char *value);
+    bool setInt32(uint32_t key, int32_t value);
+    bool setInt64(uint32_t key, int64_t value);
+    bool setFloat(uint32_t key, float value);
+    bool setPointer(uint32_t key, void *value);
+
+    bool findCString(uint32_t key, const char **value);
+    bool findInt32(uint32_t key, int32_t *value);
+    bool findInt64(uint32_t key, int64_t *value);
+    bool findFloat(uint32_t key, float *value);
+    bool findPointer(uint32_t key, void **value);
+
+    bool setData(uint32_t key, uint32_t type, const void *data, size_t size);
+    bool findData(uint32_t key, uint32_t *type,
+            const void **data, size_t *size) const;
+
+protected:
+    virtual ~MetaData() {}
+
+private:
+    struct Item {
+        uint32_t type;
+        std::vector<uint8_t> data;
+    };
+
+    std::map<uint32_t, Item> mItems;
+
+    bool findValue(uint32_t key, uint32_t type, void *value, size_t size);
+
+    MetaData &operator=(const MetaData &);
+};
+
+}  // namespace android
+
+#endif  // APE_HOST_META_DATA_H_
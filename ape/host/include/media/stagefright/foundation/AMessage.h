@@ -0,0 +1,66 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_HOST_A_MESSAGE_H_
+
+#define APE_HOST_A_MESSAGE_H_
+
+#include <stdint.h>
+#include <map>
+#include <string>
+
+#include <media/stagefright/foundation/ABuffer.h>
+#include <utils/RefBase.h>
+
+namespace android {
+
+//Only the typed items SniffAPE() hands to the extractor, no looper.
+struct AMessage : public RefBase {
+    AMessage(uint32_t what = 0) : mWhat(what) {}
+
+    uint32_t what() const { return mWhat; }
+
+    void setInt32(const char *name, int32_t value);
+    void setInt64(const char *name, int64_t value);
+    void setBuffer(const char *name, const sp<ABuffer> &buffer);
+
+    bool findInt32(const char *name, int32_t *value) const;
+    bool findInt64(const char *name, int64_t *value) const;
+    bool findBuffer(const char *name, sp<ABuffer> *buffer) const;
+
+protected:
+    virtual ~AMessage() {}
+
+private:
+    uint32_t mWhat;
+
+    std::map<std::string, int32_t> mInt32s;
+    std::map<std::string, int64_t> mInt64s;
+    std::map<std::string, sp<ABuffer> > mBuffers;
+};
+
+}  // namespace android
+
+#endif  // APE_HOST_A_MESSAGE_H_
@@ -0,0 +1,76 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_HOST_UTILS_CONDITION_H_
+
+#define APE_HOST_UTILS_CONDITION_H_
+
+#include <pthread.h>
+#include <time.h>
+
+#include <utils/Errors.h>
+#include <utils/Mutex.h>
+#include <utils/Timers.h>
+
+namespace android {
+
+class Condition {
+public:
+    Condition() {
+        pthread_condattr_t attr;
+        pthread_condattr_init(&attr);
+        pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+        pthread_cond_init(&mCond, &attr);
+        pthread_condattr_destroy(&attr);
+    }
+
+    ~Condition() { pthread_cond_destroy(&mCond); }
+
+    status_t wait(Mutex &mutex) {
+        return -pthread_cond_wait(&mCond, &mutex.mMutex);
+    }
+
+    status_t waitRelative(Mutex &mutex, nsecs_t reltime) {
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        nsecs_t abstime = ts.tv_sec * 1000000000LL + ts.tv_nsec + reltime;
+        ts.tv_sec = abstime / 1000000000LL;
+        ts.tv_nsec = abstime % 1000000000LL;
+        return -pthread_cond_timedwait(&mCond, &mutex.mMutex, &ts);
+    }
+
+    void signal() { pthread_cond_signal(&mCond); }
+    void broadcast() { pthread_cond_broadcast(&mCond); }
+
+private:
+    pthread_cond_t mCond;
+
+    Condition(const Condition &);
+    Condition &operator=(const Condition &);
+};
+
+}  // namespace android
+
+#endif  // APE_HOST_UTILS_CONDITION_H_
@@ -0,0 +1,108 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_HOST_UTILS_KEYED_VECTOR_H_
+
+#define APE_HOST_UTILS_KEYED_VECTOR_H_
+
+#include <sys/types.h>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+#include <utils/Errors.h>
+
+namespace android {
+
+//Sorted by key, like the framework's.
+template <typename KEY, typename VALUE>
+class KeyedVector {
+public:
+    size_t size() const { return mItems.size(); }
+    bool isEmpty() const { return mItems.empty(); }
+    void clear() { mItems.clear(); }
+
+    ssize_t indexOfKey(const KEY &key) const {
+        typename Items::const_iterator it = lowerBound(key);
+        if (it == mItems.end() || key < it->first) {
+            return NAME_NOT_FOUND;
+        }
+        return it - mItems.begin();
+    }
+
+    const VALUE &valueFor(const KEY &key) const { return mItems[indexOfKey(key)].second; }
+    const KEY &keyAt(size_t index) const { return mItems[index].first; }
+    const VALUE &valueAt(size_t index) const { return mItems[index].second; }
+    VALUE &editValueAt(size_t index) { return mItems[index].second; }
+    VALUE &editValueFor(const KEY &key) { return mItems[indexOfKey(key)].second; }
+
+    ssize_t add(const KEY &key, const VALUE &value) {
+        typename Items::iterator it = lowerBound(key);
+        if (it != mItems.end() && !(key < it->first)) {
+            it->second = value;
+        } else {
+            it = mItems.insert(it, std::make_pair(key, value));
+        }
+        return it - mItems.begin();
+    }
+
+    ssize_t replaceValueFor(const KEY &key, const VALUE &value) {
+        return add(key, value);
+    }
+
+    ssize_t removeItem(const KEY &key) {
+        ssize_t index = indexOfKey(key);
+        if (index >= 0) {
+            mItems.erase(mItems.begin() + index);
+        }
+        return index;
+    }
+
+    ssize_t removeItemsAt(size_t index, size_t count = 1) {
+        mItems.erase(mItems.begin() + index, mItems.begin() + index + count);
+        return index;
+    }
+
+private:
+    typedef std::vector<std::pair<KEY, VALUE> > Items;
+
+    static bool keyLess(const std::pair<KEY, VALUE> &item, const KEY &key) {
+        return item.first < key;
+    }
+
+    typename Items::const_iterator lowerBound(const KEY &key) const {
+        return std::lower_bound(mItems.begin(), mItems.end(), key, keyLess);
+    }
+
+    typename Items::iterator lowerBound(const KEY &key) {
+        return std::lower_bound(mItems.begin(), mItems.end(), key, keyLess);
+    }
+
+    Items mItems;
+};
+
+}  // namespace android
+
+#endif  // APE_HOST_UTILS_KEYED_VECTOR_H_
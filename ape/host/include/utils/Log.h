@@ -0,0 +1,53 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_HOST_UTILS_LOG_H_
+
+#define APE_HOST_UTILS_LOG_H_
+
+#include <stdio.h>
+
+#ifndef LOG_TAG
+#define LOG_TAG NULL
+#endif
+
+//Errors, warnings and info go to stderr, debug and verbose are compiled
+//out as in a release build.
+#define APE_HOST_LOG(level, ...) \
+    (fprintf(stderr, level "/%s: ", LOG_TAG), fprintf(stderr, __VA_ARGS__), fputc('\n', stderr))
+
+#define ALOGE(...) APE_HOST_LOG("E", __VA_ARGS__)
+#define ALOGW(...) APE_HOST_LOG("W", __VA_ARGS__)
+#define ALOGI(...) APE_HOST_LOG("I", __VA_ARGS__)
+#define ALOGD(...) ((void)0)
+#define ALOGV(...) ((void)0)
+
+#define LOGE ALOGE
+#define LOGW ALOGW
+#define LOGI ALOGI
+#define LOGD ALOGD
+#define LOGV ALOGV
+
+#endif  // APE_HOST_UTILS_LOG_H_
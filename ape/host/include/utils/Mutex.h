@@ -0,0 +1,69 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_HOST_UTILS_MUTEX_H_
+
+#define APE_HOST_UTILS_MUTEX_H_
+
+#include <pthread.h>
+
+#include <utils/Errors.h>
+
+namespace android {
+
+class Condition;
+
+class Mutex {
+public:
+    Mutex() { pthread_mutex_init(&mMutex, NULL); }
+    explicit Mutex(const char *name) { pthread_mutex_init(&mMutex, NULL); }
+    ~Mutex() { pthread_mutex_destroy(&mMutex); }
+
+    status_t lock() { return -pthread_mutex_lock(&mMutex); }
+    void unlock() { pthread_mutex_unlock(&mMutex); }
+    status_t tryLock() { return -pthread_mutex_trylock(&mMutex); }
+
+    class Autolock {
+    public:
+        explicit Autolock(Mutex &lock) : mLock(lock) { mLock.lock(); }
+        ~Autolock() { mLock.unlock(); }
+    private:
+        Mutex &mLock;
+    };
+
+private:
+    friend class Condition;
+
+    pthread_mutex_t mMutex;
+
+    Mutex(const Mutex &);
+    Mutex &operator=(const Mutex &);
+};
+
+typedef Mutex::Autolock AutoMutex;
+
+}  // namespace android
+
+#endif  // APE_HOST_UTILS_MUTEX_H_
@@ -0,0 +1,128 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_HOST_UTILS_REFBASE_H_
+
+#define APE_HOST_UTILS_REFBASE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace android {
+
+//Strong references only, which is all the extractor uses.
+class RefBase {
+public:
+    void incStrong(const void *id) const {
+        __sync_fetch_and_add(&mCount, 1);
+    }
+
+    void decStrong(const void *id) const {
+        if (__sync_fetch_and_sub(&mCount, 1) == 1) {
+            delete this;
+        }
+    }
+
+    int32_t getStrongCount() const {
+        return mCount;
+    }
+
+protected:
+    RefBase() : mCount(0) {}
+    virtual ~RefBase() {}
+
+private:
+    mutable volatile int32_t mCount;
+
+    RefBase(const RefBase &);
+    RefBase &operator=(const RefBase &);
+};
+
+template <typename T>
+class sp {
+public:
+    sp() : m_ptr(NULL) {}
+
+    sp(T *other) : m_ptr(other) {
+        if (m_ptr) m_ptr->incStrong(this);
+    }
+
+    sp(const sp<T> &other) : m_ptr(other.m_ptr) {
+        if (m_ptr) m_ptr->incStrong(this);
+    }
+
+    template <typename U>
+    sp(U *other) : m_ptr(other) {
+        if (m_ptr) m_ptr->incStrong(this);
+    }
+
+    template <typename U>
+    sp(const sp<U> &other) : m_ptr(other.get()) {
+        if (m_ptr) m_ptr->incStrong(this);
+    }
+
+    ~sp() {
+        if (m_ptr) m_ptr->decStrong(this);
+    }
+
+    sp &operator=(T *other) {
+        if (other) other->incStrong(this);
+        if (m_ptr) m_ptr->decStrong(this);
+        m_ptr = other;
+        return *this;
+    }
+
+    sp &operator=(const sp<T> &other) {
+        return *this = other.m_ptr;
+    }
+
+    template <typename U>
+    sp &operator=(const sp<U> &other) {
+        return *this = static_cast<T *>(other.get());
+    }
+
+    void clear() {
+        if (m_ptr) {
+            m_ptr->decStrong(this);
+            m_ptr = NULL;
+        }
+    }
+
+    T &operator*() const { return *m_ptr; }
+    T *operator->() const { return m_ptr; }
+    T *get() const { return m_ptr; }
+
+    bool operator==(const T *other) const { return m_ptr == other; }
+    bool operator!=(const T *other) const { return m_ptr != other; }
+    bool operator==(const sp<T> &other) const { return m_ptr == other.m_ptr; }
+    bool operator!=(const sp<T> &other) const { return m_ptr != other.m_ptr; }
+
+private:
+    T *m_ptr;
+};
+
+}  // namespace android
+
+#endif  // APE_HOST_UTILS_REFBASE_H_
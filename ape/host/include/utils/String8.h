@@ -0,0 +1,110 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_HOST_UTILS_STRING8_H_
+
+#define APE_HOST_UTILS_STRING8_H_
+
+#include <ctype.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#include <utils/Errors.h>
+
+namespace android {
+
+class String8 {
+public:
+    String8() {}
+    String8(const char *s) : mString(s != NULL ? s : "") {}
+    String8(const char *s, size_t size) : mString(s, size) {}
+
+    const char *string() const { return mString.c_str(); }
+    size_t size() const { return mString.size(); }
+    size_t length() const { return mString.size(); }
+    bool isEmpty() const { return mString.empty(); }
+
+    void clear() { mString.clear(); }
+    void setTo(const String8 &other) { mString = other.mString; }
+    status_t setTo(const char *s) { mString.assign(s); return OK; }
+    status_t setTo(const char *s, size_t size) { mString.assign(s, size); return OK; }
+
+    status_t append(const String8 &other) { mString += other.mString; return OK; }
+    status_t append(const char *s) { mString += s; return OK; }
+    status_t append(const char *s, size_t size) { mString.append(s, size); return OK; }
+
+    status_t appendFormat(const char *fmt, ...) {
+        va_list args;
+        va_start(args, fmt);
+        status_t err = appendFormatV(fmt, args);
+        va_end(args);
+        return err;
+    }
+
+    status_t appendFormatV(const char *fmt, va_list args) {
+        va_list copy;
+        va_copy(copy, args);
+        int n = vsnprintf(NULL, 0, fmt, copy);
+        va_end(copy);
+        if (n < 0) {
+            return NO_MEMORY;
+        }
+        size_t oldsize = mString.size();
+        mString.resize(oldsize + n + 1);
+        vsnprintf(&mString[oldsize], n + 1, fmt, args);
+        mString.resize(oldsize + n);
+        return OK;
+    }
+
+    static String8 format(const char *fmt, ...) {
+        String8 result;
+        va_list args;
+        va_start(args, fmt);
+        result.appendFormatV(fmt, args);
+        va_end(args);
+        return result;
+    }
+
+    void toLower() {
+        for (size_t i = 0; i < mString.size(); i++) {
+            mString[i] = tolower(mString[i]);
+        }
+    }
+
+    String8 &operator+=(const String8 &other) { mString += other.mString; return *this; }
+    bool operator==(const String8 &other) const { return mString == other.mString; }
+    bool operator!=(const String8 &other) const { return mString != other.mString; }
+    bool operator<(const String8 &other) const { return mString < other.mString; }
+    operator const char *() const { return mString.c_str(); }
+
+private:
+    std::string mString;
+};
+
+}  // namespace android
+
+#endif  // APE_HOST_UTILS_STRING8_H_
@@ -0,0 +1,62 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_HOST_UTILS_TIMERS_H_
+
+#define APE_HOST_UTILS_TIMERS_H_
+
+#include <stdint.h>
+#include <time.h>
+
+typedef int64_t nsecs_t;
+
+enum {
+    SYSTEM_TIME_REALTIME = 0,
+    SYSTEM_TIME_MONOTONIC = 1,
+};
+
+static inline nsecs_t systemTime(int clock = SYSTEM_TIME_MONOTONIC) {
+    struct timespec t;
+    clock_gettime(clock == SYSTEM_TIME_REALTIME ? CLOCK_REALTIME : CLOCK_MONOTONIC, &t);
+    return (nsecs_t)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static inline nsecs_t ns2us(nsecs_t t) {
+    return t / 1000;
+}
+
+static inline nsecs_t ns2ms(nsecs_t t) {
+    return t / 1000000;
+}
+
+static inline nsecs_t us2ns(nsecs_t t) {
+    return t * 1000;
+}
+
+static inline nsecs_t ms2ns(nsecs_t t) {
+    return t * 1000000;
+}
+
+#endif  // APE_HOST_UTILS_TIMERS_H_
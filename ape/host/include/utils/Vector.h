@@ -0,0 +1,99 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+#ifndef APE_HOST_UTILS_VECTOR_H_
+
+#define APE_HOST_UTILS_VECTOR_H_
+
+#include <stddef.h>
+#include <sys/types.h>
+#include <algorithm>
+#include <vector>
+
+#include <utils/Errors.h>
+
+namespace android {
+
+template <typename T>
+class Vector {
+public:
+    typedef int (*compar_t)(const T *lhs, const T *rhs);
+
+    size_t size() const { return mItems.size(); }
+    bool isEmpty() const { return mItems.empty(); }
+    void clear() { mItems.clear(); }
+    ssize_t setCapacity(size_t size) { mItems.reserve(size); return size; }
+    ssize_t resize(size_t size) { mItems.resize(size); return size; }
+
+    const T *array() const { return mItems.empty() ? NULL : &mItems[0]; }
+    T *editArray() { return mItems.empty() ? NULL : &mItems[0]; }
+
+    const T &operator[](size_t index) const { return mItems[index]; }
+    const T &itemAt(size_t index) const { return mItems[index]; }
+    T &editItemAt(size_t index) { return mItems[index]; }
+    const T &top() const { return mItems.back(); }
+    T &editTop() { return mItems.back(); }
+
+    ssize_t add(const T &item) { mItems.push_back(item); return mItems.size() - 1; }
+    ssize_t add() { mItems.push_back(T()); return mItems.size() - 1; }
+    ssize_t push_back(const T &item) { return add(item); }
+    void push(const T &item) { mItems.push_back(item); }
+    void push() { mItems.push_back(T()); }
+    void pop() { mItems.pop_back(); }
+
+    ssize_t insertAt(const T &item, size_t index, size_t count = 1) {
+        mItems.insert(mItems.begin() + index, count, item);
+        return index;
+    }
+
+    ssize_t removeAt(size_t index) {
+        mItems.erase(mItems.begin() + index);
+        return index;
+    }
+
+    ssize_t removeItemsAt(size_t index, size_t count = 1) {
+        mItems.erase(mItems.begin() + index, mItems.begin() + index + count);
+        return index;
+    }
+
+    //Stable, like the framework's insertion sort.
+    status_t sort(compar_t cmp) {
+        std::stable_sort(mItems.begin(), mItems.end(), Less(cmp));
+        return OK;
+    }
+
+private:
+    struct Less {
+        Less(compar_t cmp) : mCompare(cmp) {}
+        bool operator()(const T &lhs, const T &rhs) const { return mCompare(&lhs, &rhs) < 0; }
+        compar_t mCompare;
+    };
+
+    std::vector<T> mItems;
+};
+
+}  // namespace android
+
+#endif  // APE_HOST_UTILS_VECTOR_H_
@@ -0,0 +1,210 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+
+//Measures decode throughput of one APE file with APEParallelDecoder at a
+//growing number of threads, and checks that every run yields the same PCM.
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/Timers.h>
+
+#include "APEBufferPool.h"
+#include "APEExtractor.h"
+#include "APEParallelDecoder.h"
+
+using namespace android;
+
+typedef struct {
+    status_t err;
+    nsecs_t timeNs;
+    uint64_t bytes;
+    uint32_t checksum;
+} BenchResult;
+
+static void runDecode(const char *path, int32_t threads, int32_t reorderframes,
+        BenchResult *result) {
+    result->err = OK;
+    result->timeNs = 0;
+    result->bytes = 0;
+    result->checksum = 0;
+
+    //A new extractor per run, so no run starts with the index of the last.
+    sp<DataSource> source = new FileSource(path);
+    if (source->initCheck() != OK) {
+        result->err = source->initCheck();
+        return;
+    }
+    sp<APEExtractor> extractor = new APEExtractor(source);
+    if (extractor->countTracks() == 0) {
+        result->err = ERROR_UNSUPPORTED;
+        return;
+    }
+
+    nsecs_t start = systemTime();
+    sp<APEParallelDecoder> decoder = new APEParallelDecoder(extractor);
+    if (decoder->initCheck() != OK) {
+        result->err = decoder->initCheck();
+        return;
+    }
+
+    sp<MetaData> params = new MetaData;
+    params->setInt32(kKeyApeDecodeThreads, threads);
+    if (reorderframes > 0) {
+        params->setInt32(kKeyApeReorderFrames, reorderframes);
+    }
+    status_t err = decoder->start(params.get());
+    if (err != OK) {
+        result->err = err;
+        return;
+    }
+
+    //Adler-32 style sum, order sensitive so that a misordered frame shows.
+    uint32_t a = 1, b = 0;
+    MediaBuffer *buffer;
+    while ((err = decoder->read(&buffer)) == OK) {
+        const uint8_t *data = (const uint8_t *)buffer->data() + buffer->range_offset();
+        for (size_t i = 0; i < buffer->range_length(); i++) {
+            a = (a + data[i]) % 65521;
+            b = (b + a) % 65521;
+        }
+        result->bytes += buffer->range_length();
+        buffer->release();
+    }
+    decoder->stop();
+
+    result->timeNs = systemTime() - start;
+    result->checksum = (b << 16) | a;
+    result->err = err == ERROR_END_OF_STREAM ? OK : err;
+}
+
+static void usage(const char *me) {
+    fprintf(stderr,
+            "usage: %s [options] <input.ape>\n"
+            "  -t <threads>     highest thread count (default online CPUs)\n"
+            "  -q <frames>      reorder window in frames (default 2x threads)\n"
+            "  -r <runs>        runs per thread count, best is kept (default 3)\n"
+            "  -p               print the frame buffer pool stats at the end\n",
+            me);
+}
+
+int main(int argc, char **argv) {
+    int32_t maxthreads = sysconf(_SC_NPROCESSORS_ONLN);
+    int32_t reorderframes = 0;
+    int runs = 3;
+    bool poolstats = false;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "t:q:r:ph")) != -1) {
+        switch (ch) {
+            case 't': maxthreads = strtol(optarg, NULL, 0); break;
+            case 'q': reorderframes = strtol(optarg, NULL, 0); break;
+            case 'r': runs = strtol(optarg, NULL, 0); break;
+            case 'p': poolstats = true; break;
+            default:
+                usage(argv[0]);
+                return ch == 'h' ? 0 : 1;
+        }
+    }
+
+    if (optind != argc - 1 || maxthreads <= 0 || runs <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char *path = argv[optind];
+
+    //PCM duration of the whole file for the realtime factor, a cue sheet
+    //track would only cover part of it.
+    sp<DataSource> source = new FileSource(path);
+    sp<APEExtractor> extractor = new APEExtractor(source);
+    sp<APEFrameData> framedata = extractor->getFrameData();
+    if (framedata == NULL) {
+        fprintf(stderr, "%s is not a readable APE file\n", path);
+        return 1;
+    }
+    int64_t durationUs = framedata->getApeHeaderData()->durationUS;
+    framedata.clear();
+    extractor.clear();
+    source.clear();
+
+    printf("threads  time(ms)  x realtime  PCM MB/s  speedup\n");
+
+    double basetime = 0;
+    uint32_t basechecksum = 0;
+    //Powers of two, and the highest count even when it is not one.
+    for (int32_t threads = 1; ; threads *= 2) {
+        if (threads > maxthreads) {
+            threads = maxthreads;
+        }
+
+        BenchResult best;
+        memset(&best, 0, sizeof(best));
+        for (int i = 0; i < runs; i++) {
+            BenchResult result;
+            runDecode(path, threads, reorderframes, &result);
+            if (result.err != OK) {
+                fprintf(stderr, "Decoding with %d threads failed: %d\n", threads, result.err);
+                return 1;
+            }
+            if (best.timeNs == 0 || result.timeNs < best.timeNs) {
+                best = result;
+            }
+        }
+
+        double seconds = best.timeNs / 1e9;
+        if (threads == 1) {
+            basetime = seconds;
+            basechecksum = best.checksum;
+        } else if (best.checksum != basechecksum) {
+            fprintf(stderr, "Output with %d threads differs from 1 thread\n", threads);
+            return 1;
+        }
+
+        printf("%7d  %8.1f  %10.1f  %8.1f  %6.2fx\n", threads, seconds * 1000,
+                durationUs / 1e6 / seconds, best.bytes / seconds / (1024 * 1024),
+                basetime / seconds);
+
+        if (threads == maxthreads) {
+            break;
+        }
+    }
+
+    if (poolstats) {
+        String8 out;
+        APEBufferPool::getInstance()->dump(&out);
+        printf("\n%s", out.string());
+    }
+
+    return 0;
+}
@@ -0,0 +1,208 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+
+
+//Cuts a time range out of one APE file into a new one with APEClipWriter,
+//and reports how long it took and how much of the data the kernel moved.
+//With -c the clip is decoded and compared with the same frames of the
+//source.
+
+#include <errno.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/Timers.h>
+
+#include "APEClipWriter.h"
+#include "APEDecoder.h"
+#include "APEExtractor.h"
+
+using namespace android;
+
+//Adler-32 style sum, order sensitive so that a misplaced frame shows.
+typedef struct {
+    uint32_t a;
+    uint32_t b;
+    int64_t bytes;
+} Checksum;
+
+//Sums the PCM of the decoder, at most limit bytes when limit is not
+//negative. options go with the first read only.
+static status_t sumDecoded(const sp<MediaSource> &decoder,
+        const MediaSource::ReadOptions *options, int64_t limit, Checksum *sum) {
+    MediaBuffer *buffer;
+    status_t err = OK;
+    while ((limit < 0 || sum->bytes < limit)
+            && (err = decoder->read(&buffer, options)) == OK) {
+        options = NULL;
+        const uint8_t *data = (const uint8_t *)buffer->data() + buffer->range_offset();
+        size_t length = buffer->range_length();
+        if (limit >= 0 && sum->bytes + (int64_t)length > limit) {
+            length = limit - sum->bytes;
+        }
+        for (size_t i = 0; i < length; i++) {
+            sum->a = (sum->a + data[i]) % 65521;
+            sum->b = (sum->b + sum->a) % 65521;
+        }
+        sum->bytes += length;
+        buffer->release();
+    }
+    return err == ERROR_END_OF_STREAM ? OK : err;
+}
+
+static sp<MediaSource> openDecoder(const char *path) {
+    sp<APEExtractor> extractor = new APEExtractor(new FileSource(path));
+    sp<MediaSource> track = extractor->getFileTrack();
+    if (track == NULL) {
+        return NULL;
+    }
+    sp<MediaSource> decoder = new APEDecoder(track);
+    if (decoder->start() != OK) {
+        return NULL;
+    }
+    return decoder;
+}
+
+//Decodes the clip, and as much of the source from the first frame of the
+//clip on.
+static bool checkClip(const char *path, const char *clippath, const ApeClipResult &result) {
+    sp<MediaSource> clip = openDecoder(clippath);
+    sp<MediaSource> source = openDecoder(path);
+    if (clip == NULL || source == NULL) {
+        fprintf(stderr, "Failed to open the clip and the source for decoding\n");
+        return false;
+    }
+
+    Checksum clipsum = { 1, 0, 0 };
+    status_t err = sumDecoded(clip, NULL, -1, &clipsum);
+    clip->stop();
+    if (err != OK) {
+        fprintf(stderr, "Failed to decode the clip: %d\n", err);
+        return false;
+    }
+
+    //Anywhere inside the first frame of the clip lands on its start.
+    MediaSource::ReadOptions options;
+    options.setSeekTo(result.startTimeUs + result.durationUs / result.frameCount / 2,
+            MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
+    Checksum sourcesum = { 1, 0, 0 };
+    err = sumDecoded(source, &options, clipsum.bytes, &sourcesum);
+    source->stop();
+    if (err != OK) {
+        fprintf(stderr, "Failed to decode the source: %d\n", err);
+        return false;
+    }
+
+    return clipsum.bytes == sourcesum.bytes
+            && clipsum.a == sourcesum.a && clipsum.b == sourcesum.b;
+}
+
+static void usage(const char *me) {
+    fprintf(stderr,
+            "usage: %s [options] <input.ape> <output.ape>\n"
+            "  -s <ms>          start of the range (default 0)\n"
+            "  -e <ms>          end of the range (default end of the file)\n"
+            "  -c               decode the clip and compare it with the source\n",
+            me);
+}
+
+int main(int argc, char **argv) {
+    int64_t startMs = 0;
+    int64_t endMs = -1;
+    bool check = false;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "s:e:ch")) != -1) {
+        switch (ch) {
+            case 's': startMs = strtoll(optarg, NULL, 0); break;
+            case 'e': endMs = strtoll(optarg, NULL, 0); break;
+            case 'c': check = true; break;
+            default:
+                usage(argv[0]);
+                return ch == 'h' ? 0 : 1;
+        }
+    }
+
+    if (optind != argc - 2 || startMs < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char *path = argv[optind];
+    const char *clippath = argv[optind + 1];
+
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    int outFd = open(clippath, O_WRONLY | O_CREAT, 0644);
+    if (outFd < 0) {
+        fprintf(stderr, "Failed to create %s: %s\n", clippath, strerror(errno));
+        close(fd);
+        return 1;
+    }
+
+    ApeClipResult result;
+    nsecs_t startNs = systemTime();
+    status_t err = APEClipWriter::write(fd, startMs * 1000,
+            endMs < 0 ? -1 : endMs * 1000, outFd, &result);
+    if (err == OK && fsync(outFd) != 0) {
+        err = ERROR_IO;
+    }
+    nsecs_t timeNs = systemTime() - startNs;
+    close(outFd);
+    close(fd);
+    if (err != OK) {
+        fprintf(stderr, "Failed to write the clip: %d\n", err);
+        return 1;
+    }
+
+    printf("frames          %u..%u\n", result.firstFrame,
+            result.firstFrame + result.frameCount - 1);
+    printf("range           %.3f s + %.3f s\n",
+            result.startTimeUs / 1e6, result.durationUs / 1e6);
+    printf("written         %lld bytes, %lld in the kernel\n",
+            (long long)result.bytesWritten, (long long)result.bytesInKernel);
+    printf("time            %.1f ms, %.1f MB/s\n", timeNs / 1e6,
+            result.bytesWritten / (timeNs / 1e9) / (1024 * 1024));
+
+    if (check) {
+        bool match = checkClip(path, clippath, result);
+        printf("check           %s\n", match ? "matches the source" : "DIFFERS");
+        return match ? 0 : 1;
+    }
+    return 0;
+}
@@ -0,0 +1,205 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+
+//Checks that every NN filter variant the CPU supports, SIMD or not, is
+//bit-exact with apeScalarProductC(): the same dot product and the same
+//adapted coefficients. Inputs cover every order the decoder uses and
+//more, unaligned buffers, each adaption sign, and the values at which
+//16-bit products and 32-bit sums wrap. Chains of calls carry the
+//coefficients on, as the decoder does from block to block.
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "APEDSP.h"
+
+using namespace android;
+
+#define MAX_ORDER 1024
+//Buffers start up to this many samples off alignment.
+#define MAX_MISALIGN 7
+//Calls per case, the coefficients of one are the input of the next.
+#define CHAIN_LENGTH 4
+
+typedef enum {
+    PATTERN_RANDOM,
+    //Magnitudes of real filter histories and adaption values.
+    PATTERN_SMALL,
+    //-32768 everywhere, products of 2^30 that wrap the 32-bit sum.
+    PATTERN_MIN,
+    PATTERN_MAX,
+    //Alternating extremes, adaption that wraps the coefficients.
+    PATTERN_EXTREMES,
+    PATTERN_COUNT,
+} Pattern;
+
+static const char *kPatternNames[PATTERN_COUNT] = {
+    "random", "small", "min", "max", "extremes",
+};
+
+static uint32_t gSeed;
+
+static uint32_t nextRandom() {
+    gSeed = gSeed * 1664525 + 1013904223;
+    return gSeed >> 8;
+}
+
+static int16_t makeValue(Pattern pattern, int i) {
+    switch (pattern) {
+        case PATTERN_RANDOM: return (int16_t)nextRandom();
+        case PATTERN_SMALL: return (int16_t)(nextRandom() % 257) - 128;
+        case PATTERN_MIN: return -32768;
+        case PATTERN_MAX: return 32767;
+        default: return ((i + nextRandom()) & 1) ? 32767 : -32768;
+    }
+}
+
+typedef struct {
+    int order;
+    int mul;
+    Pattern pattern;
+    int misalign;
+} TestCase;
+
+//Runs one case through func and the scalar variant, from the same inputs.
+//Returns false on the first call where they differ.
+static bool runCase(ApeScalarProductFunc func, const TestCase &test, int *failedCall) {
+    //The extra room lets every buffer start off alignment.
+    static int16_t coeffs[2][MAX_ORDER + MAX_MISALIGN];
+    static int16_t history[MAX_ORDER + MAX_MISALIGN];
+    static int16_t adapt[MAX_ORDER + MAX_MISALIGN];
+
+    int16_t *c0 = coeffs[0] + test.misalign;
+    int16_t *c1 = coeffs[1] + (MAX_MISALIGN - test.misalign);
+    int16_t *h = history + (test.misalign * 3) % (MAX_MISALIGN + 1);
+    int16_t *a = adapt + (test.misalign * 5) % (MAX_MISALIGN + 1);
+
+    for (int i = 0; i < test.order; i++) {
+        c0[i] = c1[i] = makeValue(test.pattern, i);
+    }
+
+    for (int call = 0; call < CHAIN_LENGTH; call++) {
+        for (int i = 0; i < test.order; i++) {
+            h[i] = makeValue(test.pattern, i);
+            a[i] = makeValue(test.pattern, i);
+        }
+        //Alternate the sign, so that the coefficients move both ways.
+        int mul = call & 1 ? -test.mul : test.mul;
+        int32_t expected = apeScalarProductC(c0, h, a, test.order, mul);
+        int32_t actual = func(c1, h, a, test.order, mul);
+        if (actual != expected || memcmp(c0, c1, test.order * sizeof(int16_t))) {
+            *failedCall = call;
+            return false;
+        }
+    }
+    return true;
+}
+
+static void usage(const char *me) {
+    fprintf(stderr,
+            "usage: %s [options]\n"
+            "  -n <cases>       random cases per variant, on top of the fixed ones\n"
+            "                   (default 20000)\n"
+            "  -s <seed>        seed of the random inputs (default 1)\n",
+            me);
+}
+
+int main(int argc, char **argv) {
+    int randomCases = 20000;
+    uint32_t seed = 1;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "n:s:h")) != -1) {
+        switch (ch) {
+            case 'n': randomCases = strtol(optarg, NULL, 0); break;
+            case 's': seed = strtoul(optarg, NULL, 0); break;
+            default:
+                usage(argv[0]);
+                return ch == 'h' ? 0 : 1;
+        }
+    }
+
+    if (optind != argc || randomCases < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("%-8s %8s %8s\n", "variant", "cases", "failed");
+
+    bool ok = true;
+    const char *name;
+    ApeScalarProductFunc func;
+    for (size_t v = 0; (func = apeGetScalarProductVariant(v, &name)) != NULL; v++) {
+        if (func == apeScalarProductC) {
+            printf("%-8s %8s %8s\n", name, "-", "-");
+            continue;
+        }
+
+        gSeed = seed;
+        int cases = 0;
+        int failed = 0;
+
+        //Every order, sign, pattern and alignment once, then random ones.
+        const int fixedCases = (MAX_ORDER / 16) * 3 * PATTERN_COUNT * (MAX_MISALIGN + 1);
+        for (int i = 0; i < fixedCases + randomCases; i++) {
+            TestCase test;
+            if (i < fixedCases) {
+                int n = i;
+                test.order = (n % (MAX_ORDER / 16) + 1) * 16;
+                n /= MAX_ORDER / 16;
+                test.mul = n % 3 - 1;
+                n /= 3;
+                test.pattern = (Pattern)(n % PATTERN_COUNT);
+                n /= PATTERN_COUNT;
+                test.misalign = n;
+            } else {
+                test.order = (nextRandom() % (MAX_ORDER / 16) + 1) * 16;
+                test.mul = nextRandom() % 3 - 1;
+                test.pattern = (Pattern)(nextRandom() % PATTERN_COUNT);
+                test.misalign = nextRandom() % (MAX_MISALIGN + 1);
+            }
+
+            int call;
+            cases++;
+            if (!runCase(func, test, &call)) {
+                if (failed++ == 0) {
+                    printf("%s differs from c: order %d, mul %d, %s values, "
+                            "misaligned by %d, call %d\n", name, test.order, test.mul,
+                            kPatternNames[test.pattern], test.misalign, call);
+                }
+            }
+        }
+
+        printf("%-8s %8d %8d\n", name, cases, failed);
+        ok &= failed == 0;
+    }
+
+    printf("%s\n", ok ? "bit-exact" : "FAILED");
+    return ok ? 0 : 1;
+}
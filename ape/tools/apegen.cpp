@@ -0,0 +1,514 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+//Writes synthetic APE files with controlled shapes for scaling tests of
+//APEFrameData and APESource. Frame payloads are placeholders, the files
+//parse like real ones but do not decode to meaningful audio.
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+#define APE_FLAG_8_BIT                 1
+#define APE_FLAG_CRC                   2
+#define APE_FLAG_HAS_PEAK_LEVEL        4
+#define APE_FLAG_24_BIT                8
+#define APE_FLAG_HAS_SEEK_ELEMENTS    16
+#define APE_FLAG_CREATE_WAV_HEADER    32
+
+#define APE_DESCRIPTOR_LENGTH 52
+#define APE_HEADER_LENGTH 24
+#define APE_OLD_HEADER_LENGTH 32
+#define APE_TAG_FOOTER_SIZE 32
+#define ID3V1_TAG_SIZE 128
+
+typedef struct {
+    uint16_t version;
+    uint16_t compressiontype;
+    uint16_t formatflags;
+    uint16_t channels;
+    uint32_t samplerate;
+    uint16_t bitspersample;
+    uint32_t totalframes;
+    uint32_t finalframeblocks;
+    uint32_t extraseekentries;
+    uint32_t wavheaderlength;
+    uint32_t wavtaillength;
+    uint32_t minframesize;
+    uint32_t maxframesize;
+    bool aligned;
+    //Frame payloads are left as holes, for multi-GB files.
+    bool sparse;
+    int64_t tagsize;
+    bool id3v1;
+    uint32_t seed;
+} GenOptions;
+
+static uint32_t nextRandom(uint32_t *state) {
+    //xorshift32, good enough for frame sizes and reproducible across hosts.
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static void putLE16(uint8_t *ptr, uint16_t x) {
+    ptr[0] = x;
+    ptr[1] = x >> 8;
+}
+
+static void putLE32(uint8_t *ptr, uint32_t x) {
+    ptr[0] = x;
+    ptr[1] = x >> 8;
+    ptr[2] = x >> 16;
+    ptr[3] = x >> 24;
+}
+
+static uint32_t getBlocksPerFrame(const GenOptions *opts) {
+    if (opts->version >= 3950) {
+        return 73728 * 4;
+    } else if (opts->version >= 3900
+            || (opts->version >= 3800 && opts->compressiontype >= 4000)) {
+        return 73728;
+    }
+    return 9216;
+}
+
+static bool writeBytes(FILE *fp, const void *data, size_t size) {
+    return fwrite(data, 1, size, fp) == size;
+}
+
+static bool writeFiller(FILE *fp, uint8_t value, uint64_t size) {
+    uint8_t chunk[64 * 1024];
+    memset(chunk, value, sizeof(chunk));
+    while (size > 0) {
+        size_t n = size < sizeof(chunk) ? size : sizeof(chunk);
+        if (!writeBytes(fp, chunk, n)) {
+            return false;
+        }
+        size -= n;
+    }
+    return true;
+}
+
+static bool skipFiller(FILE *fp, uint8_t value, uint64_t size) {
+    //The last byte is written so that the file has its full size even when
+    //nothing follows the hole.
+    if (size == 0) {
+        return true;
+    }
+    return fseeko(fp, size - 1, SEEK_CUR) == 0 && writeBytes(fp, &value, 1);
+}
+
+static bool writeTagItem(FILE *fp, const char *key, uint32_t flags,
+        const void *value, uint32_t size) {
+    uint8_t head[8];
+    putLE32(&head[0], size);
+    putLE32(&head[4], flags);
+    return writeBytes(fp, head, sizeof(head))
+            && writeBytes(fp, key, strlen(key) + 1)
+            && (value == NULL ? writeFiller(fp, 0xa5, size) : writeBytes(fp, value, size));
+}
+
+static void makeTagFooter(uint8_t *footer, uint32_t tagsize, uint32_t itemnum, bool header) {
+    memset(footer, 0, APE_TAG_FOOTER_SIZE);
+    memcpy(footer, "APETAGEX", 8);
+    putLE32(&footer[8], 2000);
+    putLE32(&footer[12], tagsize);
+    putLE32(&footer[16], itemnum);
+    //Bit 31: tag has a header, bit 29: this is the header.
+    putLE32(&footer[20], header ? 0xa0000000 : 0x80000000);
+}
+
+//APEv2 tag of the requested total size (header and footer included), made
+//of a few text items and a binary cover art item padding it out.
+static bool writeAPETag(FILE *fp, int64_t totalsize) {
+    static const char *kTextItems[][2] = {
+        {"Title", "Synthetic Title"},
+        {"Artist", "Synthetic Artist"},
+        {"Album", "Synthetic Album"},
+        {"Year", "2013"},
+    };
+    const char *kArtKey = "Cover Art (Front)";
+
+    uint32_t itemsize = 0;
+    uint32_t itemnum = 0;
+    for (size_t i = 0; i < sizeof(kTextItems) / sizeof(kTextItems[0]); i++) {
+        uint32_t size = 8 + strlen(kTextItems[i][0]) + 1 + strlen(kTextItems[i][1]);
+        if (2 * APE_TAG_FOOTER_SIZE + itemsize + size > totalsize) {
+            break;
+        }
+        itemsize += size;
+        itemnum++;
+    }
+
+    uint32_t artsize = 0;
+    uint32_t artoverhead = 8 + strlen(kArtKey) + 1;
+    if (totalsize > 2 * APE_TAG_FOOTER_SIZE + itemsize + artoverhead) {
+        artsize = totalsize - 2 * APE_TAG_FOOTER_SIZE - itemsize - artoverhead;
+        itemsize += artoverhead + artsize;
+    }
+
+    uint8_t footer[APE_TAG_FOOTER_SIZE];
+    uint32_t tagsize = itemsize + APE_TAG_FOOTER_SIZE;
+    uint32_t tagitems = itemnum + (artsize > 0 ? 1 : 0);
+
+    makeTagFooter(footer, tagsize, tagitems, true);
+    if (!writeBytes(fp, footer, sizeof(footer))) {
+        return false;
+    }
+    for (uint32_t i = 0; i < itemnum; i++) {
+        if (!writeTagItem(fp, kTextItems[i][0], 0, kTextItems[i][1],
+                          strlen(kTextItems[i][1]))) {
+            return false;
+        }
+    }
+    if (artsize > 0 && !writeTagItem(fp, kArtKey, 2, NULL, artsize)) {
+        return false;
+    }
+    makeTagFooter(footer, tagsize, tagitems, false);
+    return writeBytes(fp, footer, sizeof(footer));
+}
+
+static bool writeID3v1(FILE *fp) {
+    uint8_t tag[ID3V1_TAG_SIZE];
+    memset(tag, 0, sizeof(tag));
+    memcpy(tag, "TAG", 3);
+    memcpy(&tag[3], "Synthetic Title", 15);
+    memcpy(&tag[33], "Synthetic Artist", 16);
+    memcpy(&tag[63], "Synthetic Album", 15);
+    memcpy(&tag[93], "2013", 4);
+    tag[126] = 1;
+    tag[127] = 0xff;
+    return writeBytes(fp, tag, sizeof(tag));
+}
+
+static int generate(const char *path, const GenOptions *opts) {
+    const bool newlayout = opts->version >= 3980;
+    const uint32_t totalframes = opts->totalframes;
+
+    uint32_t seekentries = totalframes + opts->extraseekentries;
+    if (!newlayout && !(opts->formatflags & APE_FLAG_HAS_SEEK_ELEMENTS)) {
+        //Without the seek element count, old files have one entry per frame.
+        seekentries = totalframes;
+    }
+
+    //Old files only store the wav header when the decoder is not asked to create one.
+    uint32_t wavheaderlength = opts->wavheaderlength;
+    if (!newlayout && (opts->formatflags & APE_FLAG_CREATE_WAV_HEADER)) {
+        wavheaderlength = 0;
+    }
+
+    uint8_t header[APE_DESCRIPTOR_LENGTH + APE_HEADER_LENGTH];
+    uint32_t headerlength;
+    memset(header, 0, sizeof(header));
+    memcpy(header, "MAC ", 4);
+    putLE16(&header[4], opts->version);
+
+    uint32_t *framesizes = (uint32_t *)malloc(totalframes * sizeof(uint32_t));
+    if (!framesizes) {
+        fprintf(stderr, "Out of memory for %u frames\n", totalframes);
+        return 1;
+    }
+    uint32_t state = opts->seed ? opts->seed : 1;
+    uint64_t audiodatalength = 0;
+    for (uint32_t i = 0; i < totalframes; i++) {
+        uint32_t range = opts->maxframesize - opts->minframesize + 1;
+        uint32_t size = opts->minframesize + nextRandom(&state) % range;
+        if (opts->aligned) {
+            size = (size + 3) & ~3;
+        }
+        framesizes[i] = size;
+        audiodatalength += size;
+    }
+
+    if (newlayout) {
+        headerlength = APE_HEADER_LENGTH;
+        putLE32(&header[8], APE_DESCRIPTOR_LENGTH);
+        putLE32(&header[12], APE_HEADER_LENGTH);
+        putLE32(&header[16], seekentries * 4);
+        putLE32(&header[20], wavheaderlength);
+        putLE32(&header[24], (uint32_t)audiodatalength);
+        putLE32(&header[28], (uint32_t)(audiodatalength >> 32));
+        putLE32(&header[32], opts->wavtaillength);
+        //MD5 left zeroed.
+
+        uint8_t *hdr = &header[APE_DESCRIPTOR_LENGTH];
+        putLE16(&hdr[0], opts->compressiontype);
+        putLE16(&hdr[2], opts->formatflags);
+        putLE32(&hdr[4], getBlocksPerFrame(opts));
+        putLE32(&hdr[8], opts->finalframeblocks);
+        putLE32(&hdr[12], totalframes);
+        putLE16(&hdr[16], opts->bitspersample);
+        putLE16(&hdr[18], opts->channels);
+        putLE32(&hdr[20], opts->samplerate);
+    } else {
+        headerlength = APE_OLD_HEADER_LENGTH;
+        putLE16(&header[6], opts->compressiontype);
+        putLE16(&header[8], opts->formatflags);
+        putLE16(&header[10], opts->channels);
+        putLE32(&header[12], opts->samplerate);
+        putLE32(&header[16], wavheaderlength);
+        putLE32(&header[20], opts->wavtaillength);
+        putLE32(&header[24], totalframes);
+        putLE32(&header[28], opts->finalframeblocks);
+        if (opts->formatflags & APE_FLAG_HAS_PEAK_LEVEL) {
+            putLE32(&header[headerlength], 0x7fff);
+            headerlength += 4;
+        }
+        if (opts->formatflags & APE_FLAG_HAS_SEEK_ELEMENTS) {
+            putLE32(&header[headerlength], seekentries);
+            headerlength += 4;
+        }
+    }
+
+    const uint32_t prelength = (newlayout ? APE_DESCRIPTOR_LENGTH : 0) + headerlength;
+    uint64_t firstframe = (uint64_t)prelength + seekentries * 4 + wavheaderlength;
+
+    FILE *fp = fopen(path, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "Failed to open %s: %s\n", path, strerror(errno));
+        free(framesizes);
+        return 1;
+    }
+    setvbuf(fp, NULL, _IOFBF, 1024 * 1024);
+
+    bool ok = writeBytes(fp, header, prelength);
+
+    //Old files keep the wav header in front of the seek table, new ones after it.
+    if (ok && !newlayout) {
+        ok = writeFiller(fp, 'W', wavheaderlength);
+    }
+
+    uint64_t pos = firstframe;
+    uint8_t entries[4096];
+    for (uint32_t i = 0; ok && i < seekentries; i += sizeof(entries) / 4) {
+        uint32_t count = seekentries - i;
+        if (count > sizeof(entries) / 4) {
+            count = sizeof(entries) / 4;
+        }
+        for (uint32_t j = 0; j < count; j++) {
+            putLE32(&entries[j * 4], (uint32_t)pos);
+            if (i + j < totalframes) {
+                pos += framesizes[i + j];
+            }
+        }
+        ok = writeBytes(fp, entries, count * 4);
+    }
+
+    if (ok && newlayout) {
+        ok = writeFiller(fp, 'W', wavheaderlength);
+    }
+
+    //Sparse payloads are one hole; a hole per frame would still take a
+    //block per frame, as frames are smaller than one.
+    if (ok && opts->sparse) {
+        ok = skipFiller(fp, 0, pos - firstframe);
+    }
+    for (uint32_t i = 0; ok && !opts->sparse && i < totalframes; i++) {
+        ok = writeFiller(fp, (uint8_t)i, framesizes[i]);
+    }
+
+    if (ok) {
+        ok = writeFiller(fp, 'T', opts->wavtaillength);
+    }
+    if (ok && opts->tagsize >= 0) {
+        ok = writeAPETag(fp, opts->tagsize);
+    }
+    if (ok && opts->id3v1) {
+        ok = writeID3v1(fp);
+    }
+
+    if (fclose(fp) != 0) {
+        ok = false;
+    }
+    free(framesizes);
+
+    if (!ok) {
+        fprintf(stderr, "Failed to write %s: %s\n", path, strerror(errno));
+        return 1;
+    }
+    return 0;
+}
+
+//Writes the standard scaling matrix: both header layouts, every old-layout
+//flag combination, aligned and unaligned frames, frame counts growing by
+//10x and tags from empty to multi-MB.
+static int generateCorpus(const char *dir, const GenOptions *base, uint32_t maxframes) {
+    static const uint16_t kVersions[] = {3800, 3900, 3950, 3970, 3980, 3990};
+    static const int64_t kTagSizes[] = {-1, 2 * APE_TAG_FOOTER_SIZE, 64 * 1024, 4 * 1024 * 1024};
+
+    if (mkdir(dir, 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "Failed to create %s: %s\n", dir, strerror(errno));
+        return 1;
+    }
+
+    char path[1024];
+    for (size_t v = 0; v < sizeof(kVersions) / sizeof(kVersions[0]); v++) {
+        //The flags only change the layout of old headers.
+        uint16_t flagcount = kVersions[v] < 3980 ? 64 : 1;
+        for (uint16_t flags = 0; flags < flagcount; flags++) {
+            if ((flags & APE_FLAG_8_BIT) && (flags & APE_FLAG_24_BIT)) {
+                continue;
+            }
+            for (int aligned = 0; aligned <= 1; aligned++) {
+                GenOptions opts = *base;
+                opts.version = kVersions[v];
+                opts.formatflags = flags;
+                opts.aligned = aligned;
+                opts.totalframes = 16;
+                opts.bitspersample = (flags & APE_FLAG_8_BIT) ? 8 : (flags & APE_FLAG_24_BIT) ? 24 : 16;
+                snprintf(path, sizeof(path), "%s/v%u_f%02u_%s.ape", dir, opts.version, flags,
+                         aligned ? "aligned" : "skip");
+                if (generate(path, &opts)) {
+                    return 1;
+                }
+            }
+        }
+    }
+
+    for (uint32_t frames = 1; frames <= maxframes; frames *= 10) {
+        GenOptions opts = *base;
+        opts.totalframes = frames;
+        snprintf(path, sizeof(path), "%s/frames_%u.ape", dir, frames);
+        if (generate(path, &opts)) {
+            return 1;
+        }
+    }
+
+    for (size_t t = 0; t < sizeof(kTagSizes) / sizeof(kTagSizes[0]); t++) {
+        GenOptions opts = *base;
+        opts.tagsize = kTagSizes[t];
+        opts.id3v1 = (t % 2) == 1;
+        snprintf(path, sizeof(path), "%s/tag_%lld.ape", dir, (long long)kTagSizes[t]);
+        if (generate(path, &opts)) {
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+static void usage(const char *me) {
+    fprintf(stderr,
+            "usage: %s [options] <output.ape>\n"
+            "       %s [options] -d <dir> [-m <max frames>]\n"
+            "  -v <version>     file version, 3800..3990 (default 3990)\n"
+            "  -c <level>       compression type (default 2000)\n"
+            "  -f <flags>       format flags (default 0)\n"
+            "  -n <frames>      total frames (default 100)\n"
+            "  -l <blocks>      blocks in the final frame (default 1024)\n"
+            "  -e <entries>     extra seek table entries (default 0)\n"
+            "  -r <rate>        sample rate (default 44100)\n"
+            "  -C <channels>    channel count (default 2)\n"
+            "  -b <bits>        bits per sample (default 16)\n"
+            "  -s <min>:<max>   frame payload size range (default 1000:4000)\n"
+            "  -a               keep frame sizes 32-bit aligned (no skip)\n"
+            "  -z               leave frame payloads as holes, for files beyond 4 GB\n"
+            "  -w <bytes>       wav header length (default 44)\n"
+            "  -t <bytes>       wav tail length (default 0)\n"
+            "  -T <bytes>       APEv2 tag of this total size (default none)\n"
+            "  -1               append an ID3v1 tag\n"
+            "  -S <seed>        random seed (default 1)\n"
+            "  -d <dir>         write the standard scaling corpus into dir\n"
+            "  -m <frames>      largest frame count in the corpus (default 1000000)\n",
+            me, me);
+}
+
+int main(int argc, char **argv) {
+    GenOptions opts;
+    memset(&opts, 0, sizeof(opts));
+    opts.version = 3990;
+    opts.compressiontype = 2000;
+    opts.channels = 2;
+    opts.samplerate = 44100;
+    opts.bitspersample = 16;
+    opts.totalframes = 100;
+    opts.finalframeblocks = 1024;
+    opts.wavheaderlength = 44;
+    opts.minframesize = 1000;
+    opts.maxframesize = 4000;
+    opts.tagsize = -1;
+    opts.seed = 1;
+
+    const char *corpusdir = NULL;
+    uint32_t maxframes = 1000000;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "v:c:f:n:l:e:r:C:b:s:azw:t:T:1S:d:m:h")) != -1) {
+        switch (ch) {
+            case 'v': opts.version = strtoul(optarg, NULL, 0); break;
+            case 'c': opts.compressiontype = strtoul(optarg, NULL, 0); break;
+            case 'f': opts.formatflags = strtoul(optarg, NULL, 0); break;
+            case 'n': opts.totalframes = strtoul(optarg, NULL, 0); break;
+            case 'l': opts.finalframeblocks = strtoul(optarg, NULL, 0); break;
+            case 'e': opts.extraseekentries = strtoul(optarg, NULL, 0); break;
+            case 'r': opts.samplerate = strtoul(optarg, NULL, 0); break;
+            case 'C': opts.channels = strtoul(optarg, NULL, 0); break;
+            case 'b': opts.bitspersample = strtoul(optarg, NULL, 0); break;
+            case 's':
+                if (sscanf(optarg, "%u:%u", &opts.minframesize, &opts.maxframesize) != 2) {
+                    usage(argv[0]);
+                    return 1;
+                }
+                break;
+            case 'a': opts.aligned = true; break;
+            case 'z': opts.sparse = true; break;
+            case 'w': opts.wavheaderlength = strtoul(optarg, NULL, 0); break;
+            case 't': opts.wavtaillength = strtoul(optarg, NULL, 0); break;
+            case 'T': opts.tagsize = strtoll(optarg, NULL, 0); break;
+            case '1': opts.id3v1 = true; break;
+            case 'S': opts.seed = strtoul(optarg, NULL, 0); break;
+            case 'd': corpusdir = optarg; break;
+            case 'm': maxframes = strtoul(optarg, NULL, 0); break;
+            default:
+                usage(argv[0]);
+                return ch == 'h' ? 0 : 1;
+        }
+    }
+
+    if (opts.version < 3800 || opts.version > 3990 || opts.totalframes == 0
+            || opts.minframesize == 0 || opts.minframesize > opts.maxframesize
+            || (opts.tagsize >= 0 && opts.tagsize < 2 * APE_TAG_FOOTER_SIZE)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (corpusdir != NULL) {
+        return generateCorpus(corpusdir, &opts, maxframes);
+    }
+
+    if (optind != argc - 1) {
+        usage(argv[0]);
+        return 1;
+    }
+    return generate(argv[optind], &opts);
+}
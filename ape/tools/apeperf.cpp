@@ -0,0 +1,391 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+
+//Measures what a player pays for one APE file: extractor open time,
+//getMetaData() time, sequential read() throughput, random-seek latency and
+//peak RSS. Every file is measured in a child process of its own, so that
+//the peak RSS is that of the file alone. Pass files of increasing length
+//(apegen -n) to see how each figure scales.
+//
+//-s saves the results, -c compares against saved results and fails when
+//any figure got worse by more than the tolerance, which is how a release
+//is gated against the last one. Timings are the best of -r runs.
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+#include "APEExtractor.h"
+
+using namespace android;
+
+typedef struct {
+    char name[256];
+    uint32_t frames;
+    double openMs;
+    double metaUs;
+    double readMBps;
+    double seekP50Us;
+    double seekP99Us;
+    long peakRssKB;
+} PerfResult;
+
+static uint32_t nextRandom(uint32_t *state) {
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static int compareNs(const void *a, const void *b) {
+    nsecs_t x = *(const nsecs_t *)a;
+    nsecs_t y = *(const nsecs_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double percentileUs(nsecs_t *samples, size_t count, int percent) {
+    qsort(samples, count, sizeof(nsecs_t), compareNs);
+    size_t index = (count * percent + 99) / 100;
+    return samples[index > 0 ? index - 1 : 0] / 1e3;
+}
+
+//VmHWM of this process, in KB.
+static long getPeakRssKB() {
+    FILE *fp = fopen("/proc/self/status", "r");
+    if (fp == NULL) {
+        return -1;
+    }
+    char line[256];
+    long peak = -1;
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        if (sscanf(line, "VmHWM: %ld kB", &peak) == 1) {
+            break;
+        }
+    }
+    fclose(fp);
+    return peak;
+}
+
+static status_t measureOpen(const char *path, double *openMs, double *metaUs, uint32_t *frames) {
+    nsecs_t startNs = systemTime();
+    sp<APEExtractor> extractor = new APEExtractor(new FileSource(path));
+    if (extractor->countTracks() == 0) {
+        return ERROR_UNSUPPORTED;
+    }
+    //The index is deferred until a track is asked for, a player always is.
+    sp<MediaSource> track = extractor->getTrack(0);
+    if (track == NULL) {
+        return ERROR_MALFORMED;
+    }
+    nsecs_t openNs = systemTime() - startNs;
+
+    startNs = systemTime();
+    sp<MetaData> meta = extractor->getMetaData();
+    nsecs_t metaNs = systemTime() - startNs;
+    if (meta == NULL) {
+        return ERROR_MALFORMED;
+    }
+
+    if (*openMs < 0 || openNs / 1e6 < *openMs) {
+        *openMs = openNs / 1e6;
+    }
+    if (*metaUs < 0 || metaNs / 1e3 < *metaUs) {
+        *metaUs = metaNs / 1e3;
+    }
+    *frames = extractor->getFrameData()->getApeHeaderData()->totalframes;
+    return OK;
+}
+
+static status_t measureRead(const char *path, double *readMBps) {
+    sp<APEExtractor> extractor = new APEExtractor(new FileSource(path));
+    sp<MediaSource> track = extractor->getFileTrack();
+    if (track == NULL || track->start() != OK) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    uint64_t bytes = 0;
+    nsecs_t startNs = systemTime();
+    MediaBuffer *buffer;
+    status_t err;
+    while ((err = track->read(&buffer)) == OK) {
+        bytes += buffer->range_length();
+        buffer->release();
+    }
+    nsecs_t readNs = systemTime() - startNs;
+    track->stop();
+    if (err != ERROR_END_OF_STREAM) {
+        return err;
+    }
+
+    double mbps = readNs > 0 ? bytes / (readNs / 1e9) / (1024 * 1024) : 0;
+    if (mbps > *readMBps) {
+        *readMBps = mbps;
+    }
+    return OK;
+}
+
+static status_t measureSeeks(const char *path, int seeks, double *p50Us, double *p99Us) {
+    sp<APEExtractor> extractor = new APEExtractor(new FileSource(path));
+    sp<MediaSource> track = extractor->getFileTrack();
+    int64_t durationUs;
+    if (track == NULL || !track->getFormat()->findInt64(kKeyDuration, &durationUs)
+            || track->start() != OK) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    nsecs_t *samples = new nsecs_t[seeks];
+    uint32_t state = 1;
+    status_t err = OK;
+    for (int i = 0; i < seeks && err == OK; i++) {
+        int64_t timeUs = durationUs > 0 ? nextRandom(&state) % durationUs : 0;
+        MediaSource::ReadOptions options;
+        options.setSeekTo(timeUs, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
+
+        nsecs_t startNs = systemTime();
+        MediaBuffer *buffer;
+        err = track->read(&buffer, &options);
+        samples[i] = systemTime() - startNs;
+        if (err == OK) {
+            buffer->release();
+        }
+    }
+    track->stop();
+
+    if (err == OK) {
+        double p50 = percentileUs(samples, seeks, 50);
+        double p99 = percentileUs(samples, seeks, 99);
+        if (*p50Us < 0 || p50 < *p50Us) {
+            *p50Us = p50;
+        }
+        if (*p99Us < 0 || p99 < *p99Us) {
+            *p99Us = p99;
+        }
+    }
+    delete[] samples;
+    return err;
+}
+
+static status_t measure(const char *path, int runs, int seeks, PerfResult *result) {
+    memset(result, 0, sizeof(*result));
+    const char *name = strrchr(path, '/');
+    snprintf(result->name, sizeof(result->name), "%s", name != NULL ? name + 1 : path);
+    result->openMs = result->metaUs = result->seekP50Us = result->seekP99Us = -1;
+
+    for (int i = 0; i < runs; i++) {
+        status_t err = measureOpen(path, &result->openMs, &result->metaUs, &result->frames);
+        if (err == OK) {
+            err = measureRead(path, &result->readMBps);
+        }
+        if (err == OK) {
+            err = measureSeeks(path, seeks, &result->seekP50Us, &result->seekP99Us);
+        }
+        if (err != OK) {
+            return err;
+        }
+    }
+    result->peakRssKB = getPeakRssKB();
+    return OK;
+}
+
+//Runs measure() in a child, which hands the result back through a pipe.
+static status_t measureInChild(const char *path, int runs, int seeks, PerfResult *result) {
+    int fds[2];
+    if (pipe(fds) != 0) {
+        return UNKNOWN_ERROR;
+    }
+
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        return UNKNOWN_ERROR;
+    }
+    if (pid == 0) {
+        close(fds[0]);
+        status_t err = measure(path, runs, seeks, result);
+        ssize_t n = err == OK ? write(fds[1], result, sizeof(*result)) : 0;
+        _exit(n == (ssize_t)sizeof(*result) ? 0 : 1);
+    }
+
+    close(fds[1]);
+    ssize_t n = read(fds[0], result, sizeof(*result));
+    close(fds[0]);
+    int status;
+    waitpid(pid, &status, 0);
+    if (n != (ssize_t)sizeof(*result) || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        return ERROR_MALFORMED;
+    }
+    return OK;
+}
+
+#define PERF_LINE_FORMAT "%255s %u %lf %lf %lf %lf %lf %ld"
+
+static void printResult(FILE *fp, const PerfResult *r) {
+    fprintf(fp, "%-24s %9u %9.2f %9.1f %10.1f %9.1f %9.1f %9ld\n", r->name, r->frames,
+            r->openMs, r->metaUs, r->readMBps, r->seekP50Us, r->seekP99Us, r->peakRssKB);
+}
+
+static bool loadResults(const char *path, Vector<PerfResult> *results) {
+    FILE *fp = fopen(path, "r");
+    if (fp == NULL) {
+        return false;
+    }
+    char line[512];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        PerfResult r;
+        if (line[0] != '#' && sscanf(line, PERF_LINE_FORMAT, r.name, &r.frames, &r.openMs,
+                &r.metaUs, &r.readMBps, &r.seekP50Us, &r.seekP99Us, &r.peakRssKB) == 8) {
+            results->push(r);
+        }
+    }
+    fclose(fp);
+    return true;
+}
+
+//Fails when value is worse than base by more than tolerance percent.
+//Throughput gets worse downwards, everything else upwards.
+static bool checkFigure(const char *file, const char *figure, double base, double value,
+        bool higherIsBetter, int tolerance) {
+    double worse = higherIsBetter ? base - value : value - base;
+    if (base > 0 && worse * 100 > base * tolerance) {
+        printf("REGRESSION %s: %s %.1f -> %.1f\n", file, figure, base, value);
+        return false;
+    }
+    return true;
+}
+
+static bool compareResults(const Vector<PerfResult> &baseline, const Vector<PerfResult> &results,
+        int tolerance) {
+    bool ok = true;
+    for (size_t i = 0; i < results.size(); i++) {
+        const PerfResult &r = results[i];
+        for (size_t j = 0; j < baseline.size(); j++) {
+            const PerfResult &b = baseline[j];
+            if (strcmp(b.name, r.name) != 0) {
+                continue;
+            }
+            ok &= checkFigure(r.name, "open ms", b.openMs, r.openMs, false, tolerance);
+            ok &= checkFigure(r.name, "getMetaData us", b.metaUs, r.metaUs, false, tolerance);
+            ok &= checkFigure(r.name, "read MB/s", b.readMBps, r.readMBps, true, tolerance);
+            ok &= checkFigure(r.name, "seek p50 us", b.seekP50Us, r.seekP50Us, false, tolerance);
+            ok &= checkFigure(r.name, "seek p99 us", b.seekP99Us, r.seekP99Us, false, tolerance);
+            ok &= checkFigure(r.name, "peak RSS KB", b.peakRssKB, r.peakRssKB, false, tolerance);
+            break;
+        }
+    }
+    return ok;
+}
+
+static void usage(const char *me) {
+    fprintf(stderr,
+            "usage: %s [options] <input.ape>...\n"
+            "  -r <runs>        runs per file, the best of each figure is kept (default 3)\n"
+            "  -n <seeks>       random seeks per run (default 200)\n"
+            "  -s <file>        save the results to file\n"
+            "  -c <file>        compare with results saved by -s, exit 1 on a regression\n"
+            "  -t <percent>     tolerance of -c (default 25)\n",
+            me);
+}
+
+int main(int argc, char **argv) {
+    int runs = 3;
+    int seeks = 200;
+    int tolerance = 25;
+    const char *savepath = NULL;
+    const char *baselinepath = NULL;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "r:n:s:c:t:h")) != -1) {
+        switch (ch) {
+            case 'r': runs = strtol(optarg, NULL, 0); break;
+            case 'n': seeks = strtol(optarg, NULL, 0); break;
+            case 's': savepath = optarg; break;
+            case 'c': baselinepath = optarg; break;
+            case 't': tolerance = strtol(optarg, NULL, 0); break;
+            default:
+                usage(argv[0]);
+                return ch == 'h' ? 0 : 1;
+        }
+    }
+
+    if (optind == argc || runs <= 0 || seeks <= 0 || tolerance < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Vector<PerfResult> baseline;
+    if (baselinepath != NULL && !loadResults(baselinepath, &baseline)) {
+        fprintf(stderr, "Failed to read %s\n", baselinepath);
+        return 1;
+    }
+
+    printf("%-24s %9s %9s %9s %10s %9s %9s %9s\n", "# file", "frames", "open(ms)",
+            "meta(us)", "read(MB/s)", "seek p50", "seek p99", "RSS(KB)");
+
+    Vector<PerfResult> results;
+    for (int i = optind; i < argc; i++) {
+        PerfResult result;
+        if (measureInChild(argv[i], runs, seeks, &result) != OK) {
+            fprintf(stderr, "%s is not a readable APE file\n", argv[i]);
+            return 1;
+        }
+        printResult(stdout, &result);
+        results.push(result);
+    }
+
+    if (savepath != NULL) {
+        FILE *fp = fopen(savepath, "w");
+        if (fp == NULL) {
+            fprintf(stderr, "Failed to write %s\n", savepath);
+            return 1;
+        }
+        for (size_t i = 0; i < results.size(); i++) {
+            printResult(fp, &results[i]);
+        }
+        fclose(fp);
+    }
+
+    if (baselinepath != NULL && !compareResults(baseline, results, tolerance)) {
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,298 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+
+//Reads one APE file from several threads at once through a single
+//extractor, every reader with its own track and cursor. Each frame a
+//reader gets is checked against a single-threaded pass, and the aggregate
+//throughput is reported for a growing number of readers, together with
+//the share of the blocks the shared block cache served. The cache is off
+//unless media.ape.block_cache.size is set, e.g. to 1048576.
+//
+//Readers either play the file through, or seek to random positions and
+//read a few frames after each, which is the pattern of waveform previews
+//and fingerprinting running next to playback.
+
+#include <getopt.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/KeyedVector.h>
+#include <utils/Timers.h>
+
+#include "APEExtractor.h"
+
+using namespace android;
+
+typedef struct {
+    sp<APEExtractor> extractor;
+    //Frame checksums of the single-threaded pass, by timestamp.
+    const KeyedVector<int64_t, uint32_t> *reference;
+    int64_t durationUs;
+    int32_t seeks;
+    int32_t frames;
+    unsigned int seed;
+
+    status_t err;
+    uint64_t bytes;
+    uint32_t frameCount;
+    uint32_t mismatches;
+} Reader;
+
+static uint32_t checksum(MediaBuffer *buffer) {
+    const uint8_t *data = (const uint8_t *)buffer->data() + buffer->range_offset();
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < buffer->range_length(); i++) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+static void *readerThread(void *me) {
+    Reader *reader = (Reader *)me;
+    reader->err = OK;
+
+    sp<MediaSource> source = reader->extractor->getFileTrack();
+    if (source == NULL || (reader->err = source->start()) != OK) {
+        if (reader->err == OK) {
+            reader->err = ERROR_UNSUPPORTED;
+        }
+        return NULL;
+    }
+
+    //Without seeks a single pass to the end of the file.
+    int32_t passes = reader->seeks > 0 ? reader->seeks : 1;
+    for (int32_t pass = 0; pass < passes && reader->err == OK; pass++) {
+        MediaSource::ReadOptions options;
+        if (reader->seeks > 0) {
+            int64_t seekTimeUs = (int64_t)(rand_r(&reader->seed) / (RAND_MAX + 1.0)
+                                           * reader->durationUs);
+            options.setSeekTo(seekTimeUs, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
+        }
+
+        for (int32_t i = 0; reader->seeks == 0 || i < reader->frames; i++) {
+            MediaBuffer *buffer;
+            status_t err = source->read(&buffer, i == 0 ? &options : NULL);
+            if (err == ERROR_END_OF_STREAM) {
+                break;
+            }
+            if (err != OK) {
+                reader->err = err;
+                break;
+            }
+
+            int64_t timeUs = -1;
+            buffer->meta_data()->findInt64(kKeyTime, &timeUs);
+            ssize_t index = reader->reference->indexOfKey(timeUs);
+            if (index < 0 || reader->reference->valueAt(index) != checksum(buffer)) {
+                reader->mismatches++;
+            }
+            reader->bytes += buffer->range_length();
+            reader->frameCount++;
+            buffer->release();
+        }
+    }
+
+    source->stop();
+    return NULL;
+}
+
+static status_t buildReference(const char *path, KeyedVector<int64_t, uint32_t> *reference,
+        int64_t *durationUs) {
+    sp<APEExtractor> extractor = new APEExtractor(new FileSource(path));
+    sp<APEFrameData> framedata = extractor->getFrameData();
+    sp<MediaSource> source = extractor->getFileTrack();
+    if (framedata == NULL || source == NULL || source->start() != OK) {
+        return ERROR_UNSUPPORTED;
+    }
+    *durationUs = framedata->getApeHeaderData()->durationUS;
+
+    MediaBuffer *buffer;
+    status_t err;
+    while ((err = source->read(&buffer)) == OK) {
+        int64_t timeUs;
+        if (buffer->meta_data()->findInt64(kKeyTime, &timeUs)) {
+            reference->add(timeUs, checksum(buffer));
+        }
+        buffer->release();
+    }
+    source->stop();
+
+    return err == ERROR_END_OF_STREAM ? OK : err;
+}
+
+static void usage(const char *me) {
+    fprintf(stderr,
+            "usage: %s [options] <input.ape>\n"
+            "  -n <readers>     highest reader count (default 8)\n"
+            "  -s <seeks>       random seeks per reader, 0 plays through (default 0)\n"
+            "  -f <frames>      frames read after every seek (default 8)\n"
+            "  -r <runs>        runs per reader count, best is kept (default 3)\n",
+            me);
+}
+
+int main(int argc, char **argv) {
+    int32_t maxreaders = 8;
+    int32_t seeks = 0;
+    int32_t frames = 8;
+    int runs = 3;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "n:s:f:r:h")) != -1) {
+        switch (ch) {
+            case 'n': maxreaders = strtol(optarg, NULL, 0); break;
+            case 's': seeks = strtol(optarg, NULL, 0); break;
+            case 'f': frames = strtol(optarg, NULL, 0); break;
+            case 'r': runs = strtol(optarg, NULL, 0); break;
+            default:
+                usage(argv[0]);
+                return ch == 'h' ? 0 : 1;
+        }
+    }
+
+    if (optind != argc - 1 || maxreaders <= 0 || seeks < 0 || frames <= 0 || runs <= 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char *path = argv[optind];
+
+    KeyedVector<int64_t, uint32_t> reference;
+    int64_t durationUs = 0;
+    if (buildReference(path, &reference, &durationUs) != OK) {
+        fprintf(stderr, "%s is not a readable APE file\n", path);
+        return 1;
+    }
+
+    printf("readers  time(ms)  frames/s  MB/s  source reads  cache hits\n");
+
+    Reader *readers = new Reader[maxreaders];
+    pthread_t *threads = new pthread_t[maxreaders];
+    uint32_t mismatches = 0;
+
+    //Powers of two, and the highest count even when it is not one.
+    for (int32_t count = 1; ; count *= 2) {
+        if (count > maxreaders) {
+            count = maxreaders;
+        }
+
+        nsecs_t best = 0;
+        uint64_t bestbytes = 0;
+        uint32_t bestframes = 0;
+        ApeBlockCacheStats beststats;
+        memset(&beststats, 0, sizeof(beststats));
+        bool cached = false;
+
+        for (int run = 0; run < runs; run++) {
+            //A new extractor per run, so the cache starts out empty.
+            sp<APEExtractor> extractor = new APEExtractor(new FileSource(path));
+
+            nsecs_t start = systemTime();
+            int32_t started = 0;
+            for (int32_t i = 0; i < count; i++) {
+                Reader *reader = &readers[i];
+                reader->extractor = extractor;
+                reader->reference = &reference;
+                reader->durationUs = durationUs;
+                reader->seeks = seeks;
+                reader->frames = frames;
+                reader->seed = run * maxreaders + i + 1;
+                reader->err = OK;
+                reader->bytes = 0;
+                reader->frameCount = 0;
+                reader->mismatches = 0;
+                if (pthread_create(&threads[i], NULL, readerThread, reader) != 0) {
+                    break;
+                }
+                started++;
+            }
+
+            uint64_t bytes = 0;
+            uint32_t framecount = 0;
+            status_t err = started == count ? OK : UNKNOWN_ERROR;
+            for (int32_t i = 0; i < started; i++) {
+                pthread_join(threads[i], NULL);
+                bytes += readers[i].bytes;
+                framecount += readers[i].frameCount;
+                mismatches += readers[i].mismatches;
+                if (readers[i].err != OK) {
+                    err = readers[i].err;
+                }
+                readers[i].extractor.clear();
+            }
+            nsecs_t elapsed = systemTime() - start;
+
+            if (err != OK) {
+                fprintf(stderr, "Reading with %d readers failed: %d\n", count, err);
+                return 1;
+            }
+
+            if (best == 0 || elapsed < best) {
+                best = elapsed;
+                bestbytes = bytes;
+                bestframes = framecount;
+                sp<APEBlockCache> cache = extractor->getBlockCache();
+                if (cache != NULL) {
+                    cache->getStats(&beststats);
+                    cached = true;
+                }
+            }
+        }
+
+        double seconds = best / 1e9;
+        printf("%7d  %8.1f  %8.0f  %4.0f", count, seconds * 1000,
+                bestframes / seconds, bestbytes / seconds / (1024 * 1024));
+        if (cached) {
+            uint64_t blocks = beststats.hits + beststats.misses;
+            printf("  %12llu  %9.1f%%\n", (unsigned long long)beststats.reads,
+                    blocks > 0 ? beststats.hits * 100.0 / blocks : 0.0);
+        } else {
+            //Without the cache the reads are not counted.
+            printf("  %12s  %10s\n", "-", "-");
+        }
+
+        if (count == maxreaders) {
+            break;
+        }
+    }
+
+    delete[] threads;
+    delete[] readers;
+
+    if (mismatches > 0) {
+        fprintf(stderr, "%u frames differ from the single-threaded pass\n", mismatches);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,244 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+
+//Checks that opening an APE file scales linearly with its frame count.
+//Takes files of growing frame counts, as apegen -n writes them, and
+//measures for each:
+//  - the time and heap APEFrameData takes to parse the header and build
+//    the index,
+//  - the time an APESource takes to start, read the first frame, seek to
+//    the last one and read it.
+//Per frame, none of these may grow by more than the tolerance from the
+//smallest file with at least -m frames to any larger one. Quadratic or
+//per-byte work shows up as a factor of the frame count ratio.
+
+#include <getopt.h>
+#include <malloc.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+#include "APEExtractor.h"
+
+using namespace android;
+
+typedef struct {
+    const char *path;
+    uint32_t frames;
+    nsecs_t parseNs;
+    size_t parseBytes;
+    nsecs_t sourceNs;
+} ScaleResult;
+
+static size_t getHeapBytes() {
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    return mallinfo2().uordblks;
+#else
+    return mallinfo().uordblks;
+#endif
+}
+
+static status_t measureParse(const sp<DataSource> &source, ScaleResult *result) {
+    size_t heapBytes = getHeapBytes();
+    nsecs_t startNs = systemTime();
+    sp<APEFrameData> framedata = new APEFrameData(source);
+    status_t err = framedata->initCheck();
+    if (err == OK) {
+        err = framedata->buildIndex();
+    }
+    nsecs_t parseNs = systemTime() - startNs;
+    if (err != OK) {
+        return err;
+    }
+
+    //The heap the index holds once built, scratch buffers of the build
+    //are freed by now.
+    result->parseBytes = getHeapBytes() - heapBytes;
+    result->frames = framedata->getApeHeaderData()->totalframes;
+    if (result->parseNs == 0 || parseNs < result->parseNs) {
+        result->parseNs = parseNs;
+    }
+    return OK;
+}
+
+static status_t readOne(const sp<MediaSource> &track, const MediaSource::ReadOptions *options) {
+    MediaBuffer *buffer;
+    status_t err = track->read(&buffer, options);
+    if (err == OK) {
+        buffer->release();
+    }
+    return err;
+}
+
+static status_t measureSource(const sp<DataSource> &source, ScaleResult *result) {
+    sp<APEExtractor> extractor = new APEExtractor(source);
+    sp<MediaSource> track = extractor->getFileTrack();
+    int64_t durationUs;
+    if (track == NULL || !track->getFormat()->findInt64(kKeyDuration, &durationUs)) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    //The index is built by now, only the source itself is timed.
+    nsecs_t startNs = systemTime();
+    status_t err = track->start();
+    if (err != OK) {
+        return err;
+    }
+    err = readOne(track, NULL);
+    if (err == OK) {
+        MediaSource::ReadOptions options;
+        options.setSeekTo(durationUs > 0 ? durationUs - 1 : 0,
+                MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
+        err = readOne(track, &options);
+    }
+    track->stop();
+    nsecs_t sourceNs = systemTime() - startNs;
+    if (err != OK) {
+        return err;
+    }
+
+    if (result->sourceNs == 0 || sourceNs < result->sourceNs) {
+        result->sourceNs = sourceNs;
+    }
+    return OK;
+}
+
+//Fails when the per frame cost of b is more than tolerance times that of a.
+static bool checkGrowth(const char *what, const ScaleResult &a, const ScaleResult &b,
+        double costA, double costB, double tolerance) {
+    double perFrameA = costA / a.frames;
+    double perFrameB = costB / b.frames;
+    if (perFrameB > perFrameA * tolerance) {
+        printf("NOT LINEAR %s: %.3f per frame at %u frames, %.3f at %u frames\n",
+                what, perFrameA, a.frames, perFrameB, b.frames);
+        return false;
+    }
+    return true;
+}
+
+static void usage(const char *me) {
+    fprintf(stderr,
+            "usage: %s [options] <input.ape>...\n"
+            "  -r <runs>        runs per file, the fastest is kept (default 5)\n"
+            "  -m <frames>      smallest frame count compared, fixed costs swamp\n"
+            "                   fewer (default 1000)\n"
+            "  -t <factor>      largest allowed growth of a per frame cost (default 3)\n",
+            me);
+}
+
+int main(int argc, char **argv) {
+    int runs = 5;
+    uint32_t minframes = 1000;
+    double tolerance = 3;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "r:m:t:h")) != -1) {
+        switch (ch) {
+            case 'r': runs = strtol(optarg, NULL, 0); break;
+            case 'm': minframes = strtoul(optarg, NULL, 0); break;
+            case 't': tolerance = strtod(optarg, NULL); break;
+            default:
+                usage(argv[0]);
+                return ch == 'h' ? 0 : 1;
+        }
+    }
+
+    if (optind == argc || runs <= 0 || tolerance < 1) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    printf("%-28s %10s %12s %12s %12s\n", "file", "frames", "parse(us)", "heap(KB)",
+            "source(us)");
+
+    Vector<ScaleResult> results;
+    for (int i = optind; i < argc; i++) {
+        sp<DataSource> source = new FileSource(argv[i]);
+        if (source->initCheck() != OK) {
+            fprintf(stderr, "Failed to open %s\n", argv[i]);
+            return 1;
+        }
+
+        ScaleResult result;
+        memset(&result, 0, sizeof(result));
+        result.path = argv[i];
+        for (int r = 0; r < runs; r++) {
+            status_t err = measureParse(source, &result);
+            if (err == OK) {
+                err = measureSource(source, &result);
+            }
+            if (err != OK) {
+                fprintf(stderr, "%s is not a readable APE file: %d\n", argv[i], err);
+                return 1;
+            }
+        }
+
+        const char *name = strrchr(argv[i], '/');
+        printf("%-28s %10u %12.1f %12.1f %12.1f\n", name != NULL ? name + 1 : argv[i],
+                result.frames, result.parseNs / 1E3, result.parseBytes / 1024.0,
+                result.sourceNs / 1E3);
+        results.push(result);
+    }
+
+    //Everything is compared with the smallest file of at least minframes.
+    const ScaleResult *base = NULL;
+    for (size_t i = 0; i < results.size(); i++) {
+        if (results[i].frames >= minframes
+                && (base == NULL || results[i].frames < base->frames)) {
+            base = &results[i];
+        }
+    }
+
+    bool ok = true;
+    for (size_t i = 0; base != NULL && i < results.size(); i++) {
+        const ScaleResult &r = results[i];
+        if (r.frames <= base->frames) {
+            continue;
+        }
+        ok &= checkGrowth("parse time (ns)", *base, r, base->parseNs, r.parseNs, tolerance);
+        ok &= checkGrowth("parse heap (bytes)", *base, r, base->parseBytes, r.parseBytes,
+                tolerance);
+        //Starting a source and seeking costs the same at any length; only
+        //growth beyond linear is an error, same as above.
+        ok &= checkGrowth("source time (ns)", *base, r, base->sourceNs, r.sourceNs, tolerance);
+    }
+
+    if (base == NULL) {
+        fprintf(stderr, "No file has %u frames or more\n", minframes);
+        return 1;
+    }
+    printf("%s\n", ok ? "linear" : "FAILED");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,264 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+
+//Scans APE files with APEMetadataScanner, once on a single thread and once
+//on -t threads, and checks that both runs give the same results for every
+//file, and that the scanner takes every file the extractor takes, with the
+//same duration. The scanner never reads the seek table, so files the
+//extractor rejects for theirs are only counted. Arguments are files, or
+//directories that are searched for .ape files. For a race check build with
+//SANITIZE=thread.
+
+#include <dirent.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/String8.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+#include "APEExtractor.h"
+#include "APEMetadataScanner.h"
+
+using namespace android;
+
+static void addPath(const char *path, Vector<String8> *paths) {
+    struct stat st;
+    if (stat(path, &st) != 0) {
+        fprintf(stderr, "Cannot find %s\n", path);
+        return;
+    }
+    if (!S_ISDIR(st.st_mode)) {
+        paths->push(String8(path));
+        return;
+    }
+
+    DIR *dir = opendir(path);
+    if (dir == NULL) {
+        fprintf(stderr, "Cannot open %s\n", path);
+        return;
+    }
+    //Sorted, so that runs over the same tree list files in the same order.
+    Vector<String8> entries;
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+        String8 child = String8::format("%s/%s", path, entry->d_name);
+        const char *ext = strrchr(entry->d_name, '.');
+        if ((ext != NULL && !strcasecmp(ext, ".ape"))
+                || (stat(child.string(), &st) == 0 && S_ISDIR(st.st_mode))) {
+            entries.push(child);
+        }
+    }
+    closedir(dir);
+
+    for (size_t i = 0; i < entries.size(); i++) {
+        for (size_t j = i + 1; j < entries.size(); j++) {
+            if (strcmp(entries[j].string(), entries[i].string()) < 0) {
+                String8 swap = entries[i];
+                entries.editItemAt(i) = entries[j];
+                entries.editItemAt(j) = swap;
+            }
+        }
+    }
+    for (size_t i = 0; i < entries.size(); i++) {
+        addPath(entries[i].string(), paths);
+    }
+}
+
+static bool sameString(const char *a, const char *b) {
+    return a == b || (a != NULL && b != NULL && !strcmp(a, b));
+}
+
+//Everything the scan reports for one file, from the header on.
+static bool sameResult(const ApeScanResult &a, const ApeScanResult &b) {
+    //Which files the arena runs out on depends on the order they finish in.
+    if (a.status == NO_MEMORY || b.status == NO_MEMORY) {
+        return true;
+    }
+    if (a.status != b.status) {
+        return false;
+    }
+    if (a.status != OK) {
+        return true;
+    }
+    if (a.header.version != b.header.version
+            || a.header.totalframes != b.header.totalframes
+            || a.header.channels != b.header.channels
+            || a.header.samplerate != b.header.samplerate
+            || a.header.durationUS != b.header.durationUS
+            || a.tagCount != b.tagCount) {
+        return false;
+    }
+    for (size_t i = 0; i < a.tagCount; i++) {
+        const ApeScanTag &x = a.tags[i];
+        const ApeScanTag &y = b.tags[i];
+        if (!sameString(x.key, y.key) || !sameString(x.value, y.value)
+                || x.flags != y.flags || x.offset != y.offset || x.size != y.size) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Opens the file with the extractor. Returns false when it rejects the
+//file, durationUs is the one of the whole file track.
+static bool extractDuration(const char *path, int64_t *durationUs) {
+    sp<APEExtractor> extractor = new APEExtractor(new FileSource(path));
+    sp<MediaSource> track = extractor->getFileTrack();
+    if (track == NULL) {
+        return false;
+    }
+    *durationUs = 0;
+    track->getFormat()->findInt64(kKeyDuration, durationUs);
+    return true;
+}
+
+static void usage(const char *me) {
+    fprintf(stderr,
+            "usage: %s [options] <file or directory>...\n"
+            "  -t <threads>     threads of the parallel run (default 0, the CPUs)\n"
+            "  -a <bytes>       arena of each run (default 16777216)\n"
+            "  -v               print every file\n",
+            me);
+}
+
+int main(int argc, char **argv) {
+    size_t threads = 0;
+    size_t arenaSize = 16 * 1024 * 1024;
+    bool verbose = false;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "t:a:vh")) != -1) {
+        switch (ch) {
+            case 't': threads = strtoul(optarg, NULL, 0); break;
+            case 'a': arenaSize = strtoul(optarg, NULL, 0); break;
+            case 'v': verbose = true; break;
+            default:
+                usage(argv[0]);
+                return ch == 'h' ? 0 : 1;
+        }
+    }
+
+    if (optind == argc) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    Vector<String8> paths;
+    for (int i = optind; i < argc; i++) {
+        addPath(argv[i], &paths);
+    }
+    if (paths.isEmpty()) {
+        fprintf(stderr, "No APE files found\n");
+        return 1;
+    }
+
+    Vector<sp<DataSource> > sources;
+    for (size_t i = 0; i < paths.size(); i++) {
+        sources.push(new FileSource(paths[i].string()));
+    }
+
+    ApeScanResult *serial = new ApeScanResult[sources.size()];
+    ApeScanResult *parallel = new ApeScanResult[sources.size()];
+    void *serialArena = malloc(arenaSize);
+    void *parallelArena = malloc(arenaSize);
+    if (serialArena == NULL || parallelArena == NULL) {
+        fprintf(stderr, "Cannot allocate %zu bytes of arena\n", arenaSize);
+        return 1;
+    }
+
+    nsecs_t startNs = systemTime();
+    size_t used = APEMetadataScanner::scan(sources, serial, serialArena, arenaSize, 1);
+    nsecs_t serialNs = systemTime() - startNs;
+
+    startNs = systemTime();
+    APEMetadataScanner::scan(sources, parallel, parallelArena, arenaSize, threads);
+    nsecs_t parallelNs = systemTime() - startNs;
+
+    size_t accepted = 0;
+    size_t tagged = 0;
+    size_t unplayable = 0;
+    size_t differ = 0;
+    size_t disagree = 0;
+    for (size_t i = 0; i < sources.size(); i++) {
+        const char *path = paths[i].string();
+        const ApeScanResult &result = serial[i];
+
+        bool same = sameResult(result, parallel[i]);
+        int64_t durationUs = 0;
+        bool extracted = extractDuration(path, &durationUs);
+        //The scan may only be short of arena, the extractor has no limit.
+        bool agrees = result.status == NO_MEMORY
+                || (extracted ? result.status == OK
+                        && (int64_t)result.header.durationUS == durationUs
+                        : true);
+
+        if (result.status == OK) {
+            accepted++;
+            tagged += result.tagCount > 0;
+            unplayable += !extracted;
+        }
+        differ += !same;
+        disagree += !agrees;
+
+        if (verbose || !same || !agrees) {
+            printf("%s: status %d, %llu us, %zu tags%s%s%s\n", path, result.status,
+                    (unsigned long long)result.header.durationUS, result.tagCount,
+                    extracted ? "" : ", rejected by the extractor",
+                    same ? "" : ", DIFFERS between runs",
+                    agrees ? "" : ", DISAGREES with the extractor");
+        }
+    }
+
+    printf("files           %zu, %zu accepted, %zu with tags\n", sources.size(), accepted,
+            tagged);
+    printf("arena           %zu bytes\n", used);
+    printf("scan            %.1f ms on 1 thread, %.1f ms in parallel\n", serialNs / 1E6,
+            parallelNs / 1E6);
+    printf("runs differ     %zu\n", differ);
+    printf("extractor       %zu disagree, rejects %zu accepted ones\n", disagree,
+            unplayable);
+
+    bool ok = differ == 0 && disagree == 0;
+    printf("%s\n", ok ? "consistent" : "FAILED");
+
+    free(serialArena);
+    free(parallelArena);
+    delete[] serial;
+    delete[] parallel;
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,239 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+
+
+//Opens one APE file through a stand-in for a progressive download: the
+//bytes arrive front to back at a fixed rate, and a read of bytes that are
+//not in yet blocks until they are. Reports how soon the track plays, checks
+//that a seek far ahead is turned down rather than waited out, and that
+//every frame matches a plain read of the file.
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+#include "APEExtractor.h"
+
+using namespace android;
+
+class ProgressiveSource : public DataSource {
+public:
+    ProgressiveSource(const char *path, uint64_t bytesPerSecond, bool knownSize)
+        :mSource(new FileSource(path)),
+         mBytesPerSecond(bytesPerSecond),
+         mKnownSize(knownSize),
+         mSize(0),
+         mStartNs(systemTime()) {
+        if (mSource->initCheck() == OK) {
+            mSource->getSize(&mSize);
+        }
+    }
+
+    virtual status_t initCheck() const {
+        return mSource->initCheck();
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        off64_t end = offset + size;
+        if (end > mSize) {
+            end = mSize;
+        }
+        while (getArrived() < end) {
+            usleep(1000);
+        }
+        return mSource->readAt(offset, data, size);
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        if (!mKnownSize) {
+            return ERROR_UNSUPPORTED;
+        }
+        *size = mSize;
+        return OK;
+    }
+
+    virtual uint32_t flags() {
+        return kIsCachingDataSource;
+    }
+
+private:
+    sp<DataSource> mSource;
+    uint64_t mBytesPerSecond;
+    bool mKnownSize;
+    off64_t mSize;
+    nsecs_t mStartNs;
+
+    off64_t getArrived() const {
+        return (systemTime() - mStartNs) * mBytesPerSecond / 1000000000LL;
+    }
+};
+
+static uint32_t checksum(MediaBuffer *buffer) {
+    const uint8_t *data = (const uint8_t *)buffer->data() + buffer->range_offset();
+    uint32_t a = 1, b = 0;
+    for (size_t i = 0; i < buffer->range_length(); i++) {
+        a = (a + data[i]) % 65521;
+        b = (b + a) % 65521;
+    }
+    return (b << 16) | a;
+}
+
+//Frame checksums of the whole file, in order, read without throttling.
+static status_t buildReference(const char *path, Vector<uint32_t> *reference) {
+    sp<APEExtractor> extractor = new APEExtractor(new FileSource(path));
+    sp<MediaSource> source = extractor->getFileTrack();
+    if (source == NULL || source->start() != OK) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    MediaBuffer *buffer;
+    status_t err;
+    while ((err = source->read(&buffer)) == OK) {
+        reference->push(checksum(buffer));
+        buffer->release();
+    }
+    source->stop();
+
+    return err == ERROR_END_OF_STREAM ? OK : err;
+}
+
+static status_t seekTo(const sp<MediaSource> &source, int64_t timeUs) {
+    MediaSource::ReadOptions options;
+    options.setSeekTo(timeUs, MediaSource::ReadOptions::SEEK_PREVIOUS_SYNC);
+
+    MediaBuffer *buffer;
+    status_t err = source->read(&buffer, &options);
+    if (err == OK) {
+        buffer->release();
+    }
+    return err;
+}
+
+static void usage(const char *me) {
+    fprintf(stderr,
+            "usage: %s [options] <input.ape>\n"
+            "  -r <KB/s>        rate at which the file arrives (default 512)\n"
+            "  -u               hide the length of the file\n",
+            me);
+}
+
+int main(int argc, char **argv) {
+    uint64_t rate = 512;
+    bool knownSize = true;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "r:uh")) != -1) {
+        switch (ch) {
+            case 'r': rate = strtoull(optarg, NULL, 0); break;
+            case 'u': knownSize = false; break;
+            default:
+                usage(argv[0]);
+                return ch == 'h' ? 0 : 1;
+        }
+    }
+
+    if (optind != argc - 1 || rate == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char *path = argv[optind];
+
+    Vector<uint32_t> reference;
+    if (buildReference(path, &reference) != OK) {
+        fprintf(stderr, "%s is not a readable APE file\n", path);
+        return 1;
+    }
+
+    nsecs_t startNs = systemTime();
+    sp<APEExtractor> extractor = new APEExtractor(
+            new ProgressiveSource(path, rate * 1024, knownSize));
+    sp<MediaSource> source = extractor->getTrack(0);
+    if (source == NULL || source->start() != OK) {
+        fprintf(stderr, "Failed to open the track\n");
+        return 1;
+    }
+    printf("open            %8.1f ms\n", (systemTime() - startNs) / 1e6);
+
+    //Far enough into the file that its entries have not arrived yet. The
+    //position stays at the start when the seek is turned down.
+    int64_t durationUs = 0;
+    source->getFormat()->findInt64(kKeyDuration, &durationUs);
+    int64_t seekTimeUs = durationUs * 9 / 10;
+    status_t err = seekTo(source, seekTimeUs);
+    bool deferred = err == WOULD_BLOCK;
+    printf("early seek      %s\n", deferred ? "not yet available" : "served");
+    if (!deferred && err != OK) {
+        fprintf(stderr, "Early seek failed: %d\n", err);
+        return 1;
+    }
+    if (!deferred) {
+        //The file came in fast enough, play it from the start all the same.
+        source->stop();
+        source = extractor->getTrack(0);
+        if (source == NULL || source->start() != OK) {
+            fprintf(stderr, "Failed to reopen the track\n");
+            return 1;
+        }
+    }
+
+    size_t count = 0;
+    size_t mismatches = 0;
+    MediaBuffer *buffer;
+    while ((err = source->read(&buffer)) == OK) {
+        if (count == 0) {
+            printf("first frame     %8.1f ms\n", (systemTime() - startNs) / 1e6);
+        }
+        if (count >= reference.size() || checksum(buffer) != reference[count]) {
+            mismatches++;
+        }
+        count++;
+        buffer->release();
+    }
+    if (err != ERROR_END_OF_STREAM) {
+        fprintf(stderr, "Read failed at frame %zu: %d\n", count, err);
+        return 1;
+    }
+    printf("last frame      %8.1f ms, %zu frames, %zu mismatches\n",
+            (systemTime() - startNs) / 1e6, count, mismatches);
+
+    //By now the whole seek table is in.
+    err = seekTo(source, seekTimeUs);
+    printf("late seek       %s\n", err == OK ? "served" : "failed");
+    source->stop();
+
+    return mismatches == 0 && count == reference.size() && err == OK ? 0 : 1;
+}
@@ -0,0 +1,586 @@
+/*
+* (C) Copyright 2013 Marvell International Ltd.
+* All Rights Reserved
+*
+* MARVELL CONFIDENTIAL
+* Copyright 2008 ~ 2013 Marvell International Ltd All Rights Reserved.
+* The source code contained or described herein and all documents related to
+* the source code ("Material") are owned by Marvell International Ltd or its
+* suppliers or licensors. Title to the Material remains with Marvell International Ltd
+* or its suppliers and licensors. The Material contains trade secrets and
+* proprietary and confidential information of Marvell or its suppliers and
+* licensors. The Material is protected by worldwide copyright and trade secret
+* laws and treaty provisions. No part of the Material may be used, copied,
+* reproduced, modified, published, uploaded, posted, transmitted, distributed,
+* or disclosed in any way without Marvell's prior express written permission.
+*
+* No license under any patent, copyright, trade secret or other intellectual
+* property right is granted to or conferred upon you by disclosure or delivery
+* of the Materials, either expressly, by implication, inducement, estoppel or
+* otherwise. Any license under such intellectual property rights must be
+* express and approved by Marvell in writing.
+*
+*/
+
+
+
+
+//Records the reads the extractor issues for one APE file, and replays
+//traces against simple models of slow storage so that changes to the
+//read pattern can be compared without the device at hand. "open" counts
+//the reads of opening a file phase by phase, next to the one read per
+//seek table entry a per-entry loader would issue. "latency" plays a file
+//from storage slowed down to one of the models, and reports the p50 and
+//p99 read() latency with and without prefetching.
+//
+//The models are deliberately coarse: a per-request cost, a cost for every
+//non-sequential request, a bandwidth, the largest request the storage
+//takes in one go and a readahead window. Reads are replayed one after the
+//other, with the CPU time between them taken from the trace.
+
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <media/stagefright/FileSource.h>
+#include <media/stagefright/MediaBuffer.h>
+#include <media/stagefright/MediaErrors.h>
+#include <media/stagefright/MediaSource.h>
+#include <media/stagefright/MetaData.h>
+#include <utils/threads.h>
+#include <utils/Timers.h>
+#include <utils/Vector.h>
+
+#include "APEExtractor.h"
+#include "APETraceSource.h"
+
+using namespace android;
+
+typedef struct {
+    const char *name;
+    const char *description;
+    //Microseconds per request, plus for every request that does not
+    //continue where the last one ended.
+    double requestUs;
+    double seekUs;
+    double bytesPerUs;
+    //Requests are split at this size, 0 for no limit.
+    uint32_t maxRequest;
+    //A miss reads at least this much, later reads inside it are free.
+    uint32_t readAhead;
+} StorageProfile;
+
+static StorageProfile gProfiles[] = {
+    {"sdcard", "SD card, 20 MB/s, 1 ms random access",
+            300, 700, 20, 512 * 1024, 128 * 1024},
+    {"hdd", "spinning disk, 100 MB/s, 9 ms seek",
+            100, 9000, 100, 0, 128 * 1024},
+    {"http", "HTTP range requests, 1 round trip per discontinuity, 2 MB/s",
+            0, 50000, 2, 0, 64 * 1024},
+    {"fuse", "throttled FUSE, 40 MB/s, 128 KB requests",
+            400, 0, 40, 128 * 1024, 128 * 1024},
+};
+
+#define PROFILE_COUNT (sizeof(gProfiles) / sizeof(gProfiles[0]))
+
+typedef struct {
+    size_t reads;
+    uint64_t bytes;
+    double recordedIoUs;
+    double thinkUs;
+    double simulatedIoUs;
+} ReplayResult;
+
+static void replay(const Vector<ApeTraceRecord> &records, const StorageProfile &profile,
+        ReplayResult *result) {
+    memset(result, 0, sizeof(*result));
+
+    off64_t position = -1;
+    off64_t cacheStart = 0, cacheEnd = 0;
+    nsecs_t lastEndNs = 0;
+
+    for (size_t i = 0; i < records.size(); i++) {
+        const ApeTraceRecord &record = records[i];
+        result->reads++;
+        result->bytes += record.result > 0 ? record.result : 0;
+        result->recordedIoUs += record.durationNs / 1E3;
+
+        //Reads from a prefetch thread overlap, those add no think time.
+        if (i > 0 && record.startNs > lastEndNs) {
+            result->thinkUs += (record.startNs - lastEndNs) / 1E3;
+        }
+        if (record.startNs + record.durationNs > lastEndNs) {
+            lastEndNs = record.startNs + record.durationNs;
+        }
+
+        off64_t start = record.offset;
+        off64_t end = record.offset + (record.result > 0 ? record.result : record.size);
+        if (start >= cacheStart && end <= cacheEnd) {
+            continue;
+        }
+
+        //Only the part past the cached window has to come from storage.
+        if (start >= cacheStart && start < cacheEnd) {
+            start = cacheEnd;
+        }
+        off64_t fetchEnd = end;
+        if (fetchEnd - start < (off64_t)profile.readAhead) {
+            fetchEnd = start + profile.readAhead;
+        }
+
+        while (start < fetchEnd) {
+            off64_t length = fetchEnd - start;
+            if (profile.maxRequest > 0 && length > (off64_t)profile.maxRequest) {
+                length = profile.maxRequest;
+            }
+            result->simulatedIoUs += profile.requestUs + length / profile.bytesPerUs;
+            if (start != position) {
+                result->simulatedIoUs += profile.seekUs;
+            }
+            start += length;
+            position = start;
+        }
+
+        if (record.offset < cacheStart || record.offset > cacheEnd) {
+            cacheStart = record.offset;
+        }
+        cacheEnd = fetchEnd;
+    }
+}
+
+//Forwards to another DataSource, sleeping as long as a read would take on
+//the storage of a profile. The readahead window is left out, the source
+//the extractor reads from sees every request.
+class ThrottledSource : public DataSource {
+public:
+    ThrottledSource(const sp<DataSource> &source, const StorageProfile &profile)
+        :mSource(source),
+         mProfile(profile),
+         mPosition(-1) {
+    }
+
+    virtual status_t initCheck() const {
+        return mSource->initCheck();
+    }
+
+    virtual ssize_t readAt(off64_t offset, void *data, size_t size) {
+        double us = 0;
+        {
+            Mutex::Autolock autoLock(mLock);
+            if (offset != mPosition) {
+                us += mProfile.seekUs;
+            }
+            size_t requests = 1;
+            if (mProfile.maxRequest > 0) {
+                requests = (size + mProfile.maxRequest - 1) / mProfile.maxRequest;
+            }
+            us += requests * mProfile.requestUs + size / mProfile.bytesPerUs;
+            mPosition = offset + size;
+        }
+        usleep((useconds_t)us);
+        return mSource->readAt(offset, data, size);
+    }
+
+    virtual status_t getSize(off64_t *size) {
+        return mSource->getSize(size);
+    }
+
+protected:
+    virtual ~ThrottledSource() {}
+
+private:
+    sp<DataSource> mSource;
+    StorageProfile mProfile;
+    Mutex mLock;
+    off64_t mPosition;
+};
+
+static int compareNs(const void *a, const void *b) {
+    nsecs_t x = *(const nsecs_t *)a;
+    nsecs_t y = *(const nsecs_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+//Plays the file, spending decodeUs after every read() as a decoder
+//would, and sorts the read() latencies into samples.
+static status_t measureLatency(const char *path, const StorageProfile &profile,
+        int32_t prefetchframes, int32_t decodeUs, int32_t maxframes,
+        Vector<nsecs_t> *samples, nsecs_t *totalNs) {
+    sp<DataSource> source = new FileSource(path);
+    if (source->initCheck() != OK) {
+        return source->initCheck();
+    }
+    sp<APEExtractor> extractor = new APEExtractor(new ThrottledSource(source, profile));
+    sp<MediaSource> track = extractor->getFileTrack();
+    if (track == NULL) {
+        return ERROR_UNSUPPORTED;
+    }
+
+    sp<MetaData> params = new MetaData;
+    if (prefetchframes > 0) {
+        params->setInt32(kKeyApePrefetchFrames, prefetchframes);
+    }
+    status_t err = track->start(params.get());
+    if (err != OK) {
+        return err;
+    }
+
+    nsecs_t startNs = systemTime();
+    MediaBuffer *buffer;
+    for (int32_t i = 0; maxframes <= 0 || i < maxframes; i++) {
+        nsecs_t readNs = systemTime();
+        err = track->read(&buffer);
+        if (err != OK) {
+            break;
+        }
+        samples->push(systemTime() - readNs);
+        buffer->release();
+        usleep(decodeUs);
+    }
+    *totalNs = systemTime() - startNs;
+    track->stop();
+
+    if (err != OK && err != ERROR_END_OF_STREAM) {
+        return err;
+    }
+    if (!samples->isEmpty()) {
+        qsort(samples->editArray(), samples->size(), sizeof(nsecs_t), compareNs);
+    }
+    return OK;
+}
+
+static double getPercentileUs(const Vector<nsecs_t> &samples, int percent) {
+    if (samples.isEmpty()) {
+        return 0;
+    }
+    size_t index = (samples.size() * percent + 99) / 100;
+    return samples[index > 0 ? index - 1 : 0] / 1E3;
+}
+
+static status_t record(const char *path, const char *tracepath, int32_t readbudget,
+        int32_t prefetchframes, const Vector<int64_t> &seeks, int32_t framesperseek) {
+    sp<DataSource> source = new FileSource(path);
+    if (source->initCheck() != OK) {
+        fprintf(stderr, "Failed to open %s\n", path);
+        return source->initCheck();
+    }
+    source = new APETraceSource(source, tracepath);
+
+    //The same calls a player makes: open, file metadata, then the track.
+    sp<APEExtractor> extractor = new APEExtractor(source);
+    extractor->getMetaData();
+    sp<MediaSource> track = extractor->getTrack(0);
+    if (track == NULL) {
+        fprintf(stderr, "%s is not a readable APE file\n", path);
+        return ERROR_UNSUPPORTED;
+    }
+
+    sp<MetaData> params = new MetaData;
+    if (readbudget > 0) {
+        params->setInt32(kKeyApeReadBudget, readbudget);
+    }
+    if (prefetchframes > 0) {
+        params->setInt32(kKeyApePrefetchFrames, prefetchframes);
+    }
+    status_t err = track->start(params.get());
+    if (err != OK) {
+        return err;
+    }
+
+    //Without seeks the whole file is played, otherwise framesperseek
+    //frames after every seek.
+    size_t seekindex = 0;
+    int32_t frames = 0;
+    MediaBuffer *buffer;
+    for (;;) {
+        MediaSource::ReadOptions options;
+        if (!seeks.isEmpty() && (seekindex == 0 || frames >= framesperseek)) {
+            if (seekindex == seeks.size()) {
+                break;
+            }
+            options.setSeekTo(seeks[seekindex++], MediaSource::ReadOptions::SEEK_CLOSEST);
+            frames = 0;
+        }
+
+        err = track->read(&buffer, &options);
+        if (err != OK) {
+            break;
+        }
+        buffer->release();
+        frames++;
+    }
+    track->stop();
+
+    return err == ERROR_END_OF_STREAM || err == OK ? OK : err;
+}
+
+static void usage(const char *me) {
+    fprintf(stderr,
+            "usage: %s record [options] <input.ape> <output.apetrace>\n"
+            "  -b <bytes>       read budget of coalesced reads\n"
+            "  -p <frames>      frames to prefetch\n"
+            "  -s <us>          seek there and read some frames, may be repeated\n"
+            "  -n <frames>      frames read after every seek (default 10)\n"
+            "       %s replay [options] <trace> [<trace to compare>]\n"
+            "  -P <profile>     only this storage profile (default all)\n"
+            "  -r <ms>          round trip of the http profile (default 50)\n"
+            "       %s dump <trace>\n"
+            "       %s open <input.ape>...\n"
+            "       %s latency [options] <input.ape>\n"
+            "  -P <profile>     storage profile (default sdcard)\n"
+            "  -p <frames>      frames to prefetch in the second run (default 4)\n"
+            "  -d <us>          decode time per frame (default 5000)\n"
+            "  -n <frames>      frames to play, 0 for all (default 200)\n",
+            me, me, me, me, me);
+    fprintf(stderr, "profiles:\n");
+    for (size_t i = 0; i < PROFILE_COUNT; i++) {
+        fprintf(stderr, "  %-8s %s\n", gProfiles[i].name, gProfiles[i].description);
+    }
+}
+
+static int doRecord(int argc, char **argv) {
+    int32_t readbudget = 0;
+    int32_t prefetchframes = 0;
+    int32_t framesperseek = 10;
+    Vector<int64_t> seeks;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "b:p:s:n:")) != -1) {
+        switch (ch) {
+            case 'b': readbudget = strtol(optarg, NULL, 0); break;
+            case 'p': prefetchframes = strtol(optarg, NULL, 0); break;
+            case 's': seeks.push(strtoll(optarg, NULL, 0)); break;
+            case 'n': framesperseek = strtol(optarg, NULL, 0); break;
+            default:
+                return -1;
+        }
+    }
+    if (optind != argc - 2 || framesperseek <= 0) {
+        return -1;
+    }
+
+    status_t err = record(argv[optind], argv[optind + 1], readbudget, prefetchframes,
+            seeks, framesperseek);
+    if (err != OK) {
+        fprintf(stderr, "Recording failed: %d\n", err);
+        return 1;
+    }
+    return 0;
+}
+
+static int doReplay(int argc, char **argv) {
+    const char *only = NULL;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "P:r:")) != -1) {
+        switch (ch) {
+            case 'P': only = optarg; break;
+            case 'r':
+                for (size_t i = 0; i < PROFILE_COUNT; i++) {
+                    if (!strcmp(gProfiles[i].name, "http")) {
+                        gProfiles[i].seekUs = strtod(optarg, NULL) * 1000;
+                    }
+                }
+                break;
+            default:
+                return -1;
+        }
+    }
+    int tracecount = argc - optind;
+    if (tracecount != 1 && tracecount != 2) {
+        return -1;
+    }
+
+    Vector<ApeTraceRecord> records[2];
+    for (int t = 0; t < tracecount; t++) {
+        off64_t filesize;
+        status_t err = APETraceSource::load(argv[optind + t], &filesize, &records[t]);
+        if (err != OK) {
+            fprintf(stderr, "Failed to load %s: %d\n", argv[optind + t], err);
+            return 1;
+        }
+    }
+
+    bool found = false;
+    printf("%-8s %8s %10s %12s %12s %12s", "profile", "reads", "KB", "think(ms)",
+            "io(ms)", "total(ms)");
+    if (tracecount == 2) {
+        printf(" %12s %8s", "B total(ms)", "change");
+    }
+    printf("\n");
+
+    //The recorded timings first, as measured on the recording machine.
+    for (size_t p = 0; p <= PROFILE_COUNT; p++) {
+        const char *name = p == 0 ? "recorded" : gProfiles[p - 1].name;
+        if (only != NULL && strcmp(only, name)) {
+            continue;
+        }
+        found = true;
+
+        double total[2] = {0, 0};
+        ReplayResult result[2];
+        for (int t = 0; t < tracecount; t++) {
+            replay(records[t], p == 0 ? gProfiles[0] : gProfiles[p - 1], &result[t]);
+            if (p == 0) {
+                result[t].simulatedIoUs = result[t].recordedIoUs;
+            }
+            total[t] = result[t].thinkUs + result[t].simulatedIoUs;
+        }
+
+        printf("%-8s %8zu %10llu %12.1f %12.1f %12.1f", name, result[0].reads,
+                (unsigned long long)(result[0].bytes / 1024), result[0].thinkUs / 1000,
+                result[0].simulatedIoUs / 1000, total[0] / 1000);
+        if (tracecount == 2) {
+            printf(" %12.1f %+7.1f%%", total[1] / 1000,
+                    total[0] > 0 ? (total[1] - total[0]) * 100 / total[0] : 0);
+        }
+        printf("\n");
+    }
+
+    if (!found) {
+        fprintf(stderr, "Unknown profile %s\n", only);
+        return -1;
+    }
+    return 0;
+}
+
+static int doDump(int argc, char **argv) {
+    if (argc != 2) {
+        return -1;
+    }
+
+    off64_t filesize;
+    Vector<ApeTraceRecord> records;
+    status_t err = APETraceSource::load(argv[1], &filesize, &records);
+    if (err != OK) {
+        fprintf(stderr, "Failed to load %s: %d\n", argv[1], err);
+        return 1;
+    }
+
+    printf("file size %lld, %zu reads\n", (long long)filesize, records.size());
+    printf("%12s %12s %10s %10s %10s\n", "start(us)", "offset", "size", "result", "time(us)");
+    for (size_t i = 0; i < records.size(); i++) {
+        const ApeTraceRecord &record = records[i];
+        printf("%12.1f %12lld %10u %10d %10.1f\n", record.startNs / 1E3,
+                (long long)record.offset, record.size, record.result,
+                record.durationNs / 1E3);
+    }
+    return 0;
+}
+
+static int doOpen(int argc, char **argv) {
+    if (argc < 2) {
+        return -1;
+    }
+
+    APEStats::setEnabled(true);
+
+    //The last column is what loading the table one entry at a time costs.
+    printf("%-24s %8s %10s %10s %10s %12s\n", "file", "header", "seek table", "KB",
+            "time(ms)", "per entry");
+    for (int i = 1; i < argc; i++) {
+        sp<DataSource> source = new FileSource(argv[i]);
+        if (source->initCheck() != OK) {
+            fprintf(stderr, "Failed to open %s\n", argv[i]);
+            return 1;
+        }
+
+        //The index is deferred until a track is asked for.
+        sp<APEExtractor> extractor = new APEExtractor(source);
+        sp<MediaSource> track = extractor->getTrack(0);
+        sp<APEFrameData> framedata = extractor->getFrameData();
+        sp<APEStats> stats = extractor->getStats();
+        if (track == NULL || framedata == NULL || stats == NULL) {
+            fprintf(stderr, "%s is not a readable APE file\n", argv[i]);
+            return 1;
+        }
+
+        APEStats::Snapshot snapshot;
+        stats->getSnapshot(&snapshot);
+        const ApeStatsPhase &header = snapshot.phases[APEStats::PHASE_HEADER];
+        const ApeStatsPhase &table = snapshot.phases[APEStats::PHASE_SEEK_TABLE];
+        const char *name = strrchr(argv[i], '/');
+        printf("%-24s %8llu %10llu %10llu %10.2f %12u\n", name != NULL ? name + 1 : argv[i],
+                (unsigned long long)header.reads, (unsigned long long)table.reads,
+                (unsigned long long)(table.bytes / 1024), (header.timeNs + table.timeNs) / 1E6,
+                framedata->getApeHeaderData()->seektablelength / 4);
+    }
+    return 0;
+}
+
+static int doLatency(int argc, char **argv) {
+    const char *name = "sdcard";
+    int32_t prefetchframes = 4;
+    int32_t decodeUs = 5000;
+    int32_t maxframes = 200;
+
+    int ch;
+    while ((ch = getopt(argc, argv, "P:p:d:n:")) != -1) {
+        switch (ch) {
+            case 'P': name = optarg; break;
+            case 'p': prefetchframes = strtol(optarg, NULL, 0); break;
+            case 'd': decodeUs = strtol(optarg, NULL, 0); break;
+            case 'n': maxframes = strtol(optarg, NULL, 0); break;
+            default:
+                return -1;
+        }
+    }
+    if (optind != argc - 1 || prefetchframes <= 0 || decodeUs < 0) {
+        return -1;
+    }
+
+    const StorageProfile *profile = NULL;
+    for (size_t i = 0; i < PROFILE_COUNT; i++) {
+        if (!strcmp(gProfiles[i].name, name)) {
+            profile = &gProfiles[i];
+        }
+    }
+    if (profile == NULL) {
+        fprintf(stderr, "Unknown profile %s\n", name);
+        return -1;
+    }
+
+    printf("%-10s %8s %10s %10s %10s %10s\n", "prefetch", "reads", "p50(us)", "p99(us)",
+            "max(us)", "total(ms)");
+    int32_t runs[2] = {0, prefetchframes};
+    for (int i = 0; i < 2; i++) {
+        Vector<nsecs_t> samples;
+        nsecs_t totalNs = 0;
+        status_t err = measureLatency(argv[optind], *profile, runs[i], decodeUs, maxframes,
+                &samples, &totalNs);
+        if (err != OK) {
+            fprintf(stderr, "Playing %s failed: %d\n", argv[optind], err);
+            return 1;
+        }
+        printf("%-10d %8zu %10.1f %10.1f %10.1f %10.1f\n", runs[i], samples.size(),
+                getPercentileUs(samples, 50), getPercentileUs(samples, 99),
+                samples.isEmpty() ? 0 : samples.top() / 1E3, totalNs / 1E6);
+    }
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int ret = -1;
+    if (argc >= 2) {
+        if (!strcmp(argv[1], "record")) {
+            ret = doRecord(argc - 1, argv + 1);
+        } else if (!strcmp(argv[1], "replay")) {
+            ret = doReplay(argc - 1, argv + 1);
+        } else if (!strcmp(argv[1], "dump")) {
+            ret = doDump(argc - 1, argv + 1);
+        } else if (!strcmp(argv[1], "open")) {
+            ret = doOpen(argc - 1, argv + 1);
+        } else if (!strcmp(argv[1], "latency")) {
+            ret = doLatency(argc - 1, argv + 1);
+        }
+    }
+
+    if (ret < 0) {
+        usage(argv[0]);
+        return 1;
+    }
+    return ret;
+}